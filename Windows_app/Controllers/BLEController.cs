@@ -4,16 +4,31 @@ using System.ComponentModel;
 using System.Diagnostics;
 using System.Linq;
 using System.Runtime.CompilerServices;
+using System.Runtime.InteropServices;
 using System.Threading.Tasks;
+using System.Windows.Media;
+using System.Windows.Threading;
 using Windows.Devices.Bluetooth;
 using Windows.Devices.Bluetooth.Advertisement;
 using Windows.Devices.Bluetooth.GenericAttributeProfile;
 using Windows.Devices.Enumeration;
 using Windows.Storage.Streams;
 using BLETester.Interop;
+using WinRT;
 
 namespace BLETester.Controllers
 {
+    /// <summary>
+    /// Raw access to the bytes behind a WinRT IBuffer
+    /// </summary>
+    [ComImport]
+    [Guid("905a0fef-bc53-11df-8c49-001e4fc686da")]
+    [InterfaceType(ComInterfaceType.InterfaceIsIUnknown)]
+    internal interface IBufferByteAccess
+    {
+        IntPtr Buffer { get; }
+    }
+
     /// <summary>
     /// BLE Controller - Layer 2: BLE Interface Control
     /// Handles Windows Bluetooth operations and delegates protocol logic to PSoC Driver (Layer 3)
@@ -32,6 +47,9 @@ namespace BLETester.Controllers
 
         // Transfer session
         private TransferSession _transferSession;
+        private const uint WaveformRingCapacity = 4;
+        private Waveform _displayWaveform;
+        private DispatcherTimer _statsTimer;
 
         // Properties for UI binding
         private bool _isConnected;
@@ -101,16 +119,18 @@ namespace BLETester.Controllers
         {
             _transferSession = new TransferSession();
 
-            _transferSession.OnWaveform += (waveform) =>
-            {
-                CurrentWaveform = waveform;
-                CurrentMode = waveform.IsCompressed ? "Compressed" : "Uncompressed";
-            };
+            // Waveforms land in the driver's ring; the display picks up the newest once per frame
+            _transferSession.EnableWaveformRing(WaveformRingCapacity);
+            _displayWaveform = new Waveform(null, new int[2376], false);
+            CompositionTarget.Rendering += OnRendering;
 
-            _transferSession.OnProgress += (stats) =>
+            // Stats are pulled from the driver's snapshot at 10 Hz instead of pushed per block
+            _statsTimer = new DispatcherTimer { Interval = TimeSpan.FromMilliseconds(100) };
+            _statsTimer.Tick += (sender, e) =>
             {
-                TransferStats = stats;
+                if (IsTransferActive) TransferStats = _transferSession.GetStats();
             };
+            _statsTimer.Start();
 
             _transferSession.OnCompletion += (stats) =>
             {
@@ -126,12 +146,28 @@ namespace BLETester.Controllers
             {
                 SendAck(blockNumber);
             };
+
+            _transferSession.OnSack += (message) =>
+            {
+                SendSack(message);
+            };
+        }
+
+        private void OnRendering(object sender, EventArgs e)
+        {
+            if (_transferSession == null || !_transferSession.TryReadLatestWaveform(_displayWaveform)) return;
+
+            CurrentWaveform = _displayWaveform;
+            CurrentMode = _displayWaveform.IsCompressed ? "Compressed" : "Uncompressed";
         }
 
         public async Task ScanForDeviceAsync()
         {
             ConnectionState = "Scanning...";
 
+            // Get the session ready for the first block while the device is found and connected
+            _transferSession.Prewarm();
+
             var selector = BluetoothLEDevice.GetDeviceSelectorFromDeviceName(NativeMethods.DeviceName);
             var devices = await DeviceInformation.FindAllAsync(selector);
 
@@ -184,7 +220,16 @@ namespace BLETester.Controllers
 
                         _dataBlockCharacteristic.ValueChanged += OnDataBlockValueChanged;
 
-                        Debug.WriteLine("Ready to start transfer");
+                        if (IsTransferActive)
+                        {
+                            // Reconnected mid-transfer: the firmware skips what we already have
+                            _transferSession?.Resume();
+                            Debug.WriteLine("Transfer resumed");
+                        }
+                        else
+                        {
+                            Debug.WriteLine("Ready to start transfer");
+                        }
                     }
                 }
             }
@@ -195,14 +240,13 @@ namespace BLETester.Controllers
             }
         }
 
-        private void OnDataBlockValueChanged(GattCharacteristic sender, GattValueChangedEventArgs args)
+        private unsafe void OnDataBlockValueChanged(GattCharacteristic sender, GattValueChangedEventArgs args)
         {
-            var reader = DataReader.FromBuffer(args.CharacteristicValue);
-            var data = new byte[reader.UnconsumedBufferLength];
-            reader.ReadBytes(data);
+            var buffer = args.CharacteristicValue;
 
-            // Process chunk through driver
-            _transferSession?.ProcessChunk(data);
+            // Hand the driver the WinRT buffer memory directly instead of copying it into a managed array
+            var byteAccess = buffer.As<IBufferByteAccess>();
+            _transferSession?.ProcessChunk((byte*)byteAccess.Buffer, (int)buffer.Length);
         }
 
         public async Task StartTransferAsync()
@@ -213,6 +257,7 @@ namespace BLETester.Controllers
             writer.WriteByte(0x01); // CMD_START
             writer.WriteUInt16(0);
             writer.WriteUInt32((uint)DateTimeOffset.UtcNow.ToUnixTimeSeconds());
+            writer.WriteByte(NativeMethods.StartFlagPackedFraming);
 
             await _controlCharacteristic.WriteValueAsync(writer.DetachBuffer(), GattWriteOption.WriteWithoutResponse);
 
@@ -251,6 +296,16 @@ namespace BLETester.Controllers
             await _controlCharacteristic.WriteValueAsync(writer.DetachBuffer(), GattWriteOption.WriteWithoutResponse);
         }
 
+        private async void SendSack(byte[] message)
+        {
+            if (_controlCharacteristic == null) return;
+
+            var writer = new DataWriter();
+            writer.WriteBytes(message); // CMD_SACK, built by the driver
+
+            await _controlCharacteristic.WriteValueAsync(writer.DetachBuffer(), GattWriteOption.WriteWithoutResponse);
+        }
+
         protected virtual void OnPropertyChanged([CallerMemberName] string propertyName = null)
         {
             PropertyChanged?.Invoke(this, new PropertyChangedEventArgs(propertyName));
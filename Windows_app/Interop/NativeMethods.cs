@@ -14,10 +14,15 @@ namespace BLETester.Interop
         public const string ServiceUUID = "A1B2C3D4-E5F6-4A5B-8C9D-0E1F2A3B4C5D";
         public const string DataBlockUUID = "A1B2C3D5-E5F6-4A5B-8C9D-0E1F2A3B4C5D";
         public const string ControlUUID = "A1B2C3D6-E5F6-4A5B-8C9D-0E1F2A3B4C5D";
+        public const string TelemetryUUID = "A1B2C3D7-E5F6-4A5B-8C9D-0E1F2A3B4C5D";
         public const string DeviceName = "Inductosense Temp";
         public const int TotalBlocks = 1800;
         public const int BlockSize = 7168;
         public const int AckInterval = 20;
+        public const int ChunkHeaderSize = 12;
+        public const int WaveformHeaderSize = 38;
+        public const int ProtocolVersion = 2;
+        public const byte StartFlagPackedFraming = 0x01;  // Flags byte after CMD_START: send packed records
 
         // Waveform header structure (must match C struct layout)
         [StructLayout(LayoutKind.Sequential, Pack = 1)]
@@ -27,15 +32,18 @@ namespace BLETester.Interop
             public uint TimestampMs;
             public uint SampleRateHz;
             public ushort SampleCount;
-            public ushort Reserved1;
+            public ushort BitsPerSample;
             public ushort TriggerSample;
             public uint PulseFreqHz;
-            public uint Reserved2;
+            public byte PulseCycles;
+            public byte PulseVoltage;
+            public ushort SensorId;
             public short TemperatureCx10;
             public byte GainDb;
-            public byte Reserved3;
+            public byte StatusFlags;
             public uint Crc32;
-            public ushort Reserved4;
+            public ushort Reserved0;
+            public ushort Reserved1;
         }
 
         // Transfer statistics structure
@@ -49,6 +57,115 @@ namespace BLETester.Interop
             public double ThroughputKBps;
             public double ProgressPercent;
             public double ElapsedSeconds;
+            public double EwmaThroughputKBps;
+            public double InstantThroughputKBps;
+            public double EtaSeconds;
+        }
+
+        public const int MetricsStageCount = 6;
+        public const int MetricsHistogramBuckets = 160;
+        public const int MetricsMaxChunksPerEvent = 16;
+
+        // Pipeline stages timed by the driver (metrics_stage_t)
+        public enum MetricsStage
+        {
+            ChunkIngest = 0,
+            BlockAssembly,
+            Decode,
+            Crc,
+            Callback,
+            ChunkInterval
+        }
+
+        // Latency histogram structure (latency_histogram_t)
+        [StructLayout(LayoutKind.Sequential)]
+        public struct LatencyHistogram
+        {
+            public ulong Count;
+            public ulong SumNs;
+            public ulong MinNs;
+            public ulong MaxNs;
+            [MarshalAs(UnmanagedType.ByValArray, SizeConst = MetricsHistogramBuckets)]
+            public uint[] Buckets;
+        }
+
+        // Transfer metrics structure (transfer_metrics_t)
+        [StructLayout(LayoutKind.Sequential)]
+        public struct TransferMetrics
+        {
+            [MarshalAs(UnmanagedType.ByValArray, SizeConst = MetricsStageCount)]
+            public LatencyHistogram[] Stages;
+            public ulong JitterNs;
+            [MarshalAs(UnmanagedType.ByValArray, SizeConst = MetricsMaxChunksPerEvent + 1)]
+            public uint[] ChunksPerEvent;
+            public uint OutOfOrderChunks;
+            public uint DuplicateChunks;
+        }
+
+        // Archived or lazily delivered block, still encoded (capture_block_view_t)
+        [StructLayout(LayoutKind.Sequential)]
+        public struct CaptureBlockView
+        {
+            public ushort BlockNumber;
+            public byte Codec;
+            public uint TimestampMs;
+            public IntPtr Data;
+            public UIntPtr Size;
+            public IntPtr Payload;
+            public UIntPtr PayloadSize;
+        }
+
+        // Block handed to the lazy waveform callback (waveform_handle_t)
+        [StructLayout(LayoutKind.Sequential)]
+        public struct WaveformHandle
+        {
+            public WaveformHeader Header;
+            [MarshalAs(UnmanagedType.I1)]
+            public bool IsCompressed;
+            public CaptureBlockView Block;
+        }
+
+        // sizeof(waveform_data_t): header, then 2376 int32 samples
+        public static readonly int WaveformDataSize = Marshal.SizeOf<WaveformHeader>() + 2376 * sizeof(int);
+
+        public const int WaveformSummaryMaxEchoes = 8;
+
+        // Envelope width and echo detection (waveform_summary_config_t); zero fields take the defaults
+        [StructLayout(LayoutKind.Sequential)]
+        public struct WaveformSummaryConfig
+        {
+            public ushort EnvelopeWidth;
+            public int EchoThreshold;
+            public ushort EchoMinGap;
+        }
+
+        // One detected echo (waveform_echo_t)
+        [StructLayout(LayoutKind.Sequential)]
+        public struct WaveformEcho
+        {
+            public ushort SampleIndex;
+            public ushort StartSample;
+            public ushort EndSample;
+            public int Amplitude;
+            public float TimeUs;
+        }
+
+        // Waveform summary structure (waveform_summary_t)
+        [StructLayout(LayoutKind.Sequential)]
+        public struct WaveformSummary
+        {
+            public WaveformHeader Header;
+            [MarshalAs(UnmanagedType.I1)]
+            public bool IsCompressed;
+            public int MinSample;
+            public int MaxSample;
+            public uint EchoCount;
+            [MarshalAs(UnmanagedType.ByValArray, SizeConst = WaveformSummaryMaxEchoes)]
+            public WaveformEcho[] Echoes;
+            public ushort EnvelopeWidth;
+            public IntPtr EnvelopeMin;
+            public IntPtr EnvelopeMax;
+            public IntPtr Waveform;
         }
 
         // Callback delegates
@@ -64,6 +181,15 @@ namespace BLETester.Interop
         [UnmanagedFunctionPointer(CallingConvention.Cdecl)]
         public delegate void AckCallback(ushort blockNumber, IntPtr userData);
 
+        [UnmanagedFunctionPointer(CallingConvention.Cdecl)]
+        public delegate void SackCallback(IntPtr message, UIntPtr length, IntPtr userData);
+
+        [UnmanagedFunctionPointer(CallingConvention.Cdecl)]
+        public delegate void SummaryCallback(IntPtr summary, IntPtr userData);
+
+        [UnmanagedFunctionPointer(CallingConvention.Cdecl)]
+        public delegate void LazyWaveformCallback(IntPtr handle, IntPtr userData);
+
         // Library initialization
         [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
         [return: MarshalAs(UnmanagedType.I1)]
@@ -82,28 +208,94 @@ namespace BLETester.Interop
         [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
         public static extern void transfer_session_set_waveform_callback(IntPtr session, WaveformCallback callback, IntPtr userData);
 
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern void transfer_session_set_lazy_waveform_callback(IntPtr session, LazyWaveformCallback callback, IntPtr userData);
+
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        [return: MarshalAs(UnmanagedType.I1)]
+        public static extern bool waveform_handle_decode(IntPtr handle, IntPtr waveform);
+
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        [return: MarshalAs(UnmanagedType.I1)]
+        public static extern bool transfer_session_set_waveform_ring(IntPtr session, uint capacity);
+
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern IntPtr transfer_session_acquire_latest_waveform(IntPtr session, [MarshalAs(UnmanagedType.I1)] out bool isCompressed);
+
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern void transfer_session_release_waveform(IntPtr session);
+
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern uint transfer_session_get_dropped_waveforms(IntPtr session);
+
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern void transfer_session_set_summary_callback(IntPtr session, SummaryCallback callback, ref WaveformSummaryConfig config, IntPtr userData);
+
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern void transfer_session_set_archive(IntPtr session, IntPtr writer);
+
+        // Capture archive writer
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern IntPtr capture_writer_open([MarshalAs(UnmanagedType.LPStr)] string path);
+
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        [return: MarshalAs(UnmanagedType.I1)]
+        public static extern bool capture_writer_close(IntPtr writer);
+
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern uint capture_writer_block_count(IntPtr writer);
+
         [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
         public static extern void transfer_session_set_progress_callback(IntPtr session, ProgressCallback callback, IntPtr userData);
 
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern void transfer_session_set_progress_interval(IntPtr session, uint minIntervalMs, uint minBlocks);
+
         [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
         public static extern void transfer_session_set_completion_callback(IntPtr session, CompletionCallback callback, IntPtr userData);
 
         [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
         public static extern void transfer_session_set_ack_callback(IntPtr session, AckCallback callback, IntPtr userData);
 
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern void transfer_session_set_sack_callback(IntPtr session, SackCallback callback, IntPtr userData);
+
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern void transfer_session_prewarm(IntPtr session);
+
         [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
         public static extern void transfer_session_start(IntPtr session);
 
         [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
         public static extern void transfer_session_stop(IntPtr session);
 
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern void transfer_session_resume(IntPtr session);
+
         [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
         [return: MarshalAs(UnmanagedType.I1)]
         public static extern bool transfer_session_process_chunk(IntPtr session, byte[] data, UIntPtr length);
 
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl, EntryPoint = "transfer_session_process_chunk")]
+        [return: MarshalAs(UnmanagedType.I1)]
+        public static extern unsafe bool transfer_session_process_chunk(IntPtr session, byte* data, UIntPtr length);
+
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern unsafe byte* transfer_session_begin_chunk(IntPtr session, byte* header, UIntPtr length, out UIntPtr payloadSize);
+
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern void transfer_session_commit_chunk(IntPtr session);
+
         [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
         public static extern void transfer_session_get_stats(IntPtr session, out TransferStats stats);
 
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        [return: MarshalAs(UnmanagedType.I1)]
+        public static extern bool transfer_session_get_metrics(IntPtr session, out TransferMetrics metrics);
+
+        [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern ulong metrics_percentile_ns(ref TransferMetrics metrics, MetricsStage stage, double percentile);
+
         [DllImport(DllName, CallingConvention = CallingConvention.Cdecl)]
         [return: MarshalAs(UnmanagedType.I1)]
         public static extern bool transfer_session_is_active(IntPtr session);
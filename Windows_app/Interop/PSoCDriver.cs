@@ -51,6 +51,77 @@ namespace BLETester.Interop
         }
     }
 
+    /// <summary>
+    /// A block delivered before decoding: always the header, and the samples only
+    /// when TransferSession.DecodeSamples asked for them and they passed the CRC
+    /// </summary>
+    public class LazyWaveform
+    {
+        public WaveformHeader Header { get; set; }
+        public bool IsCompressed { get; set; }
+        public Waveform Waveform { get; set; }
+    }
+
+    /// <summary>
+    /// Managed wrapper for a detected echo
+    /// </summary>
+    public class WaveformEcho
+    {
+        public ushort SampleIndex { get; set; }
+        public ushort StartSample { get; set; }
+        public ushort EndSample { get; set; }
+        public int Amplitude { get; set; }
+        public float TimeUs { get; set; }
+    }
+
+    /// <summary>
+    /// Managed wrapper for a waveform summary: envelope, range and echoes.
+    /// Waveform is only filled in when TransferSession.WantSamples asked for it.
+    /// </summary>
+    public class WaveformSummary
+    {
+        public WaveformHeader Header { get; set; }
+        public bool IsCompressed { get; set; }
+        public int MinSample { get; set; }
+        public int MaxSample { get; set; }
+        public WaveformEcho[] Echoes { get; set; }
+        public int[] EnvelopeMin { get; set; }
+        public int[] EnvelopeMax { get; set; }
+        public Waveform Waveform { get; set; }
+
+        internal static WaveformSummary FromNative(NativeMethods.WaveformSummary native)
+        {
+            var summary = new WaveformSummary
+            {
+                Header = WaveformHeader.FromNative(native.Header),
+                IsCompressed = native.IsCompressed,
+                MinSample = native.MinSample,
+                MaxSample = native.MaxSample,
+                Echoes = new WaveformEcho[native.EchoCount],
+                EnvelopeMin = new int[native.EnvelopeWidth],
+                EnvelopeMax = new int[native.EnvelopeWidth]
+            };
+            for (int i = 0; i < summary.Echoes.Length; i++)
+            {
+                var echo = native.Echoes[i];
+                summary.Echoes[i] = new WaveformEcho
+                {
+                    SampleIndex = echo.SampleIndex,
+                    StartSample = echo.StartSample,
+                    EndSample = echo.EndSample,
+                    Amplitude = echo.Amplitude,
+                    TimeUs = echo.TimeUs
+                };
+            }
+            if (native.EnvelopeWidth > 0)
+            {
+                Marshal.Copy(native.EnvelopeMin, summary.EnvelopeMin, 0, native.EnvelopeWidth);
+                Marshal.Copy(native.EnvelopeMax, summary.EnvelopeMax, 0, native.EnvelopeWidth);
+            }
+            return summary;
+        }
+    }
+
     /// <summary>
     /// Managed wrapper for transfer statistics
     /// </summary>
@@ -63,6 +134,9 @@ namespace BLETester.Interop
         public double ThroughputKBps { get; set; }
         public double ProgressPercent { get; set; }
         public double ElapsedSeconds { get; set; }
+        public double EwmaThroughputKBps { get; set; }
+        public double InstantThroughputKBps { get; set; }
+        public double EtaSeconds { get; set; }
 
         internal static TransferStats FromNative(NativeMethods.TransferStats native)
         {
@@ -74,7 +148,69 @@ namespace BLETester.Interop
                 TotalChunksReceived = native.TotalChunksReceived,
                 ThroughputKBps = native.ThroughputKBps,
                 ProgressPercent = native.ProgressPercent,
-                ElapsedSeconds = native.ElapsedSeconds
+                ElapsedSeconds = native.ElapsedSeconds,
+                EwmaThroughputKBps = native.EwmaThroughputKBps,
+                InstantThroughputKBps = native.InstantThroughputKBps,
+                EtaSeconds = native.EtaSeconds
+            };
+        }
+    }
+
+    /// <summary>
+    /// Latency summary of one pipeline stage, in microseconds
+    /// </summary>
+    public class StageLatency
+    {
+        public ulong Count { get; set; }
+        public double MeanUs { get; set; }
+        public double P50Us { get; set; }
+        public double P99Us { get; set; }
+        public double MaxUs { get; set; }
+    }
+
+    /// <summary>
+    /// Managed wrapper for transfer metrics (driver built with PSOC_DRIVER_METRICS)
+    /// </summary>
+    public class TransferMetrics
+    {
+        public StageLatency ChunkIngest { get; set; }
+        public StageLatency BlockAssembly { get; set; }
+        public StageLatency Decode { get; set; }
+        public StageLatency Crc { get; set; }
+        public StageLatency Callback { get; set; }
+        public StageLatency ChunkInterval { get; set; }
+        public double JitterUs { get; set; }
+        public uint[] ChunksPerEvent { get; set; }
+        public uint OutOfOrderChunks { get; set; }
+        public uint DuplicateChunks { get; set; }
+
+        private static StageLatency Summarize(ref NativeMethods.TransferMetrics native, NativeMethods.MetricsStage stage)
+        {
+            var histogram = native.Stages[(int)stage];
+            return new StageLatency
+            {
+                Count = histogram.Count,
+                MeanUs = histogram.Count > 0 ? histogram.SumNs / (double)histogram.Count / 1000.0 : 0,
+                P50Us = NativeMethods.metrics_percentile_ns(ref native, stage, 50) / 1000.0,
+                P99Us = NativeMethods.metrics_percentile_ns(ref native, stage, 99) / 1000.0,
+                MaxUs = histogram.MaxNs / 1000.0
+            };
+        }
+
+        internal static TransferMetrics FromNative(NativeMethods.TransferMetrics native)
+        {
+            return new TransferMetrics
+            {
+                ChunkIngest = Summarize(ref native, NativeMethods.MetricsStage.ChunkIngest),
+                BlockAssembly = Summarize(ref native, NativeMethods.MetricsStage.BlockAssembly),
+                Decode = Summarize(ref native, NativeMethods.MetricsStage.Decode),
+                Crc = Summarize(ref native, NativeMethods.MetricsStage.Crc),
+                Callback = Summarize(ref native, NativeMethods.MetricsStage.Callback),
+                ChunkInterval = Summarize(ref native, NativeMethods.MetricsStage.ChunkInterval),
+                JitterUs = native.JitterNs / 1000.0,
+                ChunksPerEvent = native.ChunksPerEvent,
+                OutOfOrderChunks = native.OutOfOrderChunks,
+                DuplicateChunks = native.DuplicateChunks
             };
         }
     }
@@ -85,15 +221,36 @@ namespace BLETester.Interop
     public class TransferSession : IDisposable
     {
         private IntPtr _session;
+        private IntPtr _archive;
         private NativeMethods.WaveformCallback _waveformCallback;
         private NativeMethods.ProgressCallback _progressCallback;
         private NativeMethods.CompletionCallback _completionCallback;
         private NativeMethods.AckCallback _ackCallback;
+        private NativeMethods.SackCallback _sackCallback;
+        private NativeMethods.SummaryCallback _summaryCallback;
+        private NativeMethods.LazyWaveformCallback _lazyWaveformCallback;
+        private IntPtr _lazyDecodeBuffer;
 
         public event Action<Waveform> OnWaveform;
         public event Action<TransferStats> OnProgress;
         public event Action<TransferStats> OnCompletion;
         public event Action<ushort> OnAck;
+        public event Action<byte[]> OnSack;
+        public event Action<WaveformSummary> OnSummary;
+
+        /// <summary>
+        /// With EnableSummary: decides, on the driver's thread, whether a summary
+        /// also carries a copy of the full samples (null for never)
+        /// </summary>
+        public Func<WaveformSummary, bool> WantSamples { get; set; }
+
+        public event Action<LazyWaveform> OnLazyWaveform;
+
+        /// <summary>
+        /// With EnableLazyDelivery: decides, on the driver's thread, whether a block's
+        /// samples are decoded (null for never; headers only)
+        /// </summary>
+        public Func<WaveformHeader, bool> DecodeSamples { get; set; }
 
         public TransferSession()
         {
@@ -111,7 +268,7 @@ namespace BLETester.Interop
             {
                 try
                 {
-                    if (waveformPtr == IntPtr.Zero) return;
+                    if (waveformPtr == IntPtr.Zero || OnWaveform == null) return;  // UI uses OnSummary instead
 
                     // Read header
                     var header = Marshal.PtrToStructure<NativeMethods.WaveformHeader>(waveformPtr);
@@ -137,7 +294,7 @@ namespace BLETester.Interop
             {
                 try
                 {
-                    if (statsPtr == IntPtr.Zero) return;
+                    if (statsPtr == IntPtr.Zero || OnProgress == null) return;  // UI polls GetStats() instead
 
                     var stats = Marshal.PtrToStructure<NativeMethods.TransferStats>(statsPtr);
                     var managedStats = TransferStats.FromNative(stats);
@@ -172,11 +329,87 @@ namespace BLETester.Interop
                 OnAck?.Invoke(blockNumber);
             };
 
+            _sackCallback = (messagePtr, length, userData) =>
+            {
+                var message = new byte[(int)length];
+                Marshal.Copy(messagePtr, message, 0, message.Length);
+                OnSack?.Invoke(message);
+            };
+
+            _summaryCallback = (summaryPtr, userData) =>
+            {
+                try
+                {
+                    if (summaryPtr == IntPtr.Zero) return;
+
+                    var native = Marshal.PtrToStructure<NativeMethods.WaveformSummary>(summaryPtr);
+                    var summary = WaveformSummary.FromNative(native);
+
+                    // The full samples are only valid during this callback
+                    var wantSamples = WantSamples;
+                    if (wantSamples != null && wantSamples(summary))
+                    {
+                        var samplesPtr = IntPtr.Add(native.Waveform, Marshal.SizeOf<NativeMethods.WaveformHeader>());
+                        var samples = new int[2376];
+                        Marshal.Copy(samplesPtr, samples, 0, 2376);
+                        summary.Waveform = new Waveform(summary.Header, samples, summary.IsCompressed);
+                    }
+
+                    Application.Current?.Dispatcher.Invoke(() => OnSummary?.Invoke(summary));
+                }
+                catch (Exception ex)
+                {
+                    System.Diagnostics.Debug.WriteLine($"Error in summary callback: {ex.Message}");
+                }
+            };
+
+            _lazyWaveformCallback = (handlePtr, userData) =>
+            {
+                try
+                {
+                    if (handlePtr == IntPtr.Zero) return;
+
+                    var handle = Marshal.PtrToStructure<NativeMethods.WaveformHandle>(handlePtr);
+                    var lazy = new LazyWaveform
+                    {
+                        Header = WaveformHeader.FromNative(handle.Header),
+                        IsCompressed = handle.IsCompressed
+                    };
+
+                    // The encoded block is only valid during this callback
+                    var decodeSamples = DecodeSamples;
+                    if (decodeSamples != null && decodeSamples(lazy.Header) &&
+                        NativeMethods.waveform_handle_decode(handlePtr, _lazyDecodeBuffer))
+                    {
+                        var samplesPtr = IntPtr.Add(_lazyDecodeBuffer, Marshal.SizeOf<NativeMethods.WaveformHeader>());
+                        var samples = new int[2376];
+                        Marshal.Copy(samplesPtr, samples, 0, 2376);
+                        lazy.Waveform = new Waveform(lazy.Header, samples, lazy.IsCompressed);
+                    }
+
+                    Application.Current?.Dispatcher.Invoke(() => OnLazyWaveform?.Invoke(lazy));
+                }
+                catch (Exception ex)
+                {
+                    System.Diagnostics.Debug.WriteLine($"Error in lazy waveform callback: {ex.Message}");
+                }
+            };
+
             // Register callbacks
             NativeMethods.transfer_session_set_waveform_callback(_session, _waveformCallback, IntPtr.Zero);
             NativeMethods.transfer_session_set_progress_callback(_session, _progressCallback, IntPtr.Zero);
             NativeMethods.transfer_session_set_completion_callback(_session, _completionCallback, IntPtr.Zero);
             NativeMethods.transfer_session_set_ack_callback(_session, _ackCallback, IntPtr.Zero);
+            NativeMethods.transfer_session_set_sack_callback(_session, _sackCallback, IntPtr.Zero);
+        }
+
+        /// <summary>
+        /// Allocate and warm up what the first blocks need, e.g. while scanning.
+        /// Call after the Enable* options and before Start.
+        /// </summary>
+        public void Prewarm()
+        {
+            NativeMethods.transfer_session_prewarm(_session);
         }
 
         public void Start()
@@ -189,17 +422,159 @@ namespace BLETester.Interop
             NativeMethods.transfer_session_stop(_session);
         }
 
+        /// <summary>
+        /// Continue after a reconnect, keeping everything received so far.
+        /// The resume messages go out through OnSack.
+        /// </summary>
+        public void Resume()
+        {
+            NativeMethods.transfer_session_resume(_session);
+        }
+
+        /// <summary>
+        /// Deliver waveforms through the driver's preallocated ring instead of OnWaveform.
+        /// Poll it with TryReadLatestWaveform, e.g. once per rendered frame.
+        /// </summary>
+        public void EnableWaveformRing(uint capacity)
+        {
+            if (!NativeMethods.transfer_session_set_waveform_ring(_session, capacity))
+                throw new ArgumentOutOfRangeException(nameof(capacity));
+        }
+
+        /// <summary>
+        /// Copy the newest waveform in the ring into a caller-owned Waveform, reusing its
+        /// Samples array. Older unread waveforms are skipped.
+        /// Returns false if nothing arrived since the last call.
+        /// </summary>
+        public bool TryReadLatestWaveform(Waveform target)
+        {
+            IntPtr waveformPtr = NativeMethods.transfer_session_acquire_latest_waveform(_session, out var isCompressed);
+            if (waveformPtr == IntPtr.Zero) return false;
+
+            try
+            {
+                var header = Marshal.PtrToStructure<NativeMethods.WaveformHeader>(waveformPtr);
+                target.Header = WaveformHeader.FromNative(header);
+
+                var samplesPtr = IntPtr.Add(waveformPtr, Marshal.SizeOf<NativeMethods.WaveformHeader>());
+                if (target.Samples == null || target.Samples.Length != 2376)
+                    target.Samples = new int[2376];
+                Marshal.Copy(samplesPtr, target.Samples, 0, 2376);
+
+                target.IsCompressed = isCompressed;
+            }
+            finally
+            {
+                NativeMethods.transfer_session_release_waveform(_session);
+            }
+            return true;
+        }
+
+        /// <summary>
+        /// Waveforms the ring dropped because the UI had not read the previous ones
+        /// </summary>
+        public uint DroppedWaveforms
+        {
+            get { return NativeMethods.transfer_session_get_dropped_waveforms(_session); }
+        }
+
+        /// <summary>
+        /// Raise OnLazyWaveform with the header of every block instead of OnWaveform,
+        /// decoding samples only where DecodeSamples says so. Replaces the waveform
+        /// ring and OnSummary too. Call before Start.
+        /// </summary>
+        public void EnableLazyDelivery()
+        {
+            if (_lazyDecodeBuffer == IntPtr.Zero)
+                _lazyDecodeBuffer = Marshal.AllocHGlobal(NativeMethods.WaveformDataSize);
+            NativeMethods.transfer_session_set_lazy_waveform_callback(_session, _lazyWaveformCallback, IntPtr.Zero);
+        }
+
+        /// <summary>
+        /// Raise OnSummary for every waveform, with an envelope envelopeWidth columns wide
+        /// (the plot's width in pixels) and the echoes found. Call before Start.
+        /// </summary>
+        public void EnableSummary(ushort envelopeWidth)
+        {
+            var config = new NativeMethods.WaveformSummaryConfig { EnvelopeWidth = envelopeWidth };
+            NativeMethods.transfer_session_set_summary_callback(_session, _summaryCallback, ref config, IntPtr.Zero);
+        }
+
+        /// <summary>
+        /// Write every received block to a capture archive at path (replacing the file)
+        /// until StopArchive. Returns false if the file could not be created.
+        /// </summary>
+        public bool StartArchive(string path)
+        {
+            StopArchive();
+            _archive = NativeMethods.capture_writer_open(path);
+            if (_archive == IntPtr.Zero) return false;
+            NativeMethods.transfer_session_set_archive(_session, _archive);
+            return true;
+        }
+
+        /// <summary>
+        /// Finish the capture archive (index and CRC footer). Returns false if any write failed.
+        /// </summary>
+        public bool StopArchive()
+        {
+            if (_archive == IntPtr.Zero) return true;
+            NativeMethods.transfer_session_set_archive(_session, IntPtr.Zero);
+            bool ok = NativeMethods.capture_writer_close(_archive);
+            _archive = IntPtr.Zero;
+            return ok;
+        }
+
+        /// <summary>
+        /// Blocks written to the capture archive so far (0 when not archiving)
+        /// </summary>
+        public uint ArchivedBlocks
+        {
+            get { return _archive == IntPtr.Zero ? 0 : NativeMethods.capture_writer_block_count(_archive); }
+        }
+
         public bool ProcessChunk(byte[] data)
         {
             return NativeMethods.transfer_session_process_chunk(_session, data, (UIntPtr)data.Length);
         }
 
+        /// <summary>
+        /// Process a notification that is still in native memory.
+        /// The payload is copied once, straight into the driver's reassembly buffer.
+        /// Handles both framings, including packed notifications holding several chunks.
+        /// </summary>
+        public unsafe void ProcessChunk(byte* data, int length)
+        {
+            NativeMethods.transfer_session_process_chunk(_session, data, (UIntPtr)length);
+        }
+
+        /// <summary>
+        /// Limit OnProgress to one event per interval or per block count (0 disables a limit)
+        /// </summary>
+        public void SetProgressInterval(uint minIntervalMs, uint minBlocks)
+        {
+            NativeMethods.transfer_session_set_progress_interval(_session, minIntervalMs, minBlocks);
+        }
+
+        /// <summary>
+        /// Latest stats snapshot; lock-free, callable from any thread
+        /// </summary>
         public TransferStats GetStats()
         {
             NativeMethods.transfer_session_get_stats(_session, out var stats);
             return TransferStats.FromNative(stats);
         }
 
+        /// <summary>
+        /// Per-stage latency and link metrics, or null if the driver was built without them
+        /// </summary>
+        public TransferMetrics GetMetrics()
+        {
+            if (!NativeMethods.transfer_session_get_metrics(_session, out var metrics))
+                return null;
+            return TransferMetrics.FromNative(metrics);
+        }
+
         public bool IsActive
         {
             get { return NativeMethods.transfer_session_is_active(_session); }
@@ -209,9 +584,15 @@ namespace BLETester.Interop
         {
             if (_session != IntPtr.Zero)
             {
+                StopArchive();
                 NativeMethods.transfer_session_destroy(_session);
                 _session = IntPtr.Zero;
             }
+            if (_lazyDecodeBuffer != IntPtr.Zero)
+            {
+                Marshal.FreeHGlobal(_lazyDecodeBuffer);
+                _lazyDecodeBuffer = IntPtr.Zero;
+            }
             GC.SuppressFinalize(this);
         }
 
@@ -47,6 +47,8 @@
 #include "app_bt_gatt_handler.h"
 #include "app_bt_utils.h"
 #include "app_data_transfer.h"
+#include "app_link_tuner.h"
+#include "app_buffer_pool.h"
 #include "GeneratedSource/cycfg_gatt_db.h"
 #include "cyhal_gpio.h"
 #include "cybt_platform_trace.h"
@@ -68,8 +70,6 @@ static void* app_alloc_buffer(int len);
 
 static void app_free_buffer(uint8_t *p_event_data);
 
-typedef void (*pfn_free_buffer_t)(uint8_t *);
-
 wiced_bt_gatt_status_t
 app_gatt_read_by_type_handler(uint16_t conn_id,
                                 wiced_bt_gatt_opcode_t opcode,
@@ -130,7 +130,8 @@ app_bt_gatt_event_callback(wiced_bt_gatt_evt_t event,
         /* Allocate buffer for GATT response - don't print to avoid console spam */
         p_buf_req->buffer.p_app_rsp_buffer = app_alloc_buffer(p_buf_req->len_requested);
         p_buf_req->buffer.p_app_ctxt = (void *)app_free_buffer;
-        gatt_status = WICED_BT_GATT_SUCCESS;
+        gatt_status = (p_buf_req->buffer.p_app_rsp_buffer != NULL) ? WICED_BT_GATT_SUCCESS
+                                                                   : WICED_BT_GATT_INSUF_RESOURCE;
     }
         break;
 
@@ -139,17 +140,14 @@ app_bt_gatt_event_callback(wiced_bt_gatt_evt_t event,
         pfn_free_buffer_t pfn_free;
         pfn_free = (pfn_free_buffer_t)p_event_data->buffer_xmitted.p_app_ctxt;
         /* If the buffer is dynamic, the context will point to a function to
-         * free it.
+         * free it. Data notifications return their flow control credit the
+         * same way, so responses and temperature notifications don't.
          */
         if (pfn_free)
         {
             pfn_free(p_event_data->buffer_xmitted.p_app_data);
         }
 
-        /* Notify data transfer module that a notification was transmitted
-         * This implements credit-based flow control to prevent buffer overflow */
-        app_data_transfer_notification_sent();
-
         gatt_status = WICED_BT_GATT_SUCCESS;
     }
        break;
@@ -208,45 +206,12 @@ app_gatt_connect_handler(wiced_bt_gatt_connection_status_t *p_conn_status)
                                                         BLE_ADDR_PUBLIC,
                                                         NULL);
 
-        /* Request optimal connection parameters for data transfer */
-        wiced_bt_ble_pref_conn_params_t conn_params = {
-            .conn_interval_min = 12,  /* 12 * 1.25ms = 15ms */
-            .conn_interval_max = 12,  /* 12 * 1.25ms = 15ms */
-            .conn_latency = 0,        /* No latency */
-            .conn_supervision_timeout = 200, /* 200 * 10ms = 2000ms */
-            .min_ce_length = 0,
-            .max_ce_length = 0
-        };
-
-        wiced_bool_t param_status = wiced_bt_l2cap_update_ble_conn_params(
-            p_conn_status->bd_addr,
-            &conn_params
-        );
-
-        printf("Requested connection parameters: interval=15ms, latency=0, timeout=2000ms\n");
-        printf("   Request status: %s\n", param_status ? "SUCCESS" : "FAILED");
-
-        /* Request LE 2M PHY for 2x speed (Bluetooth 5.0 feature) */
-        wiced_bt_ble_phy_preferences_t phy_prefs;
-        memset(&phy_prefs, 0, sizeof(phy_prefs));
-        memcpy(phy_prefs.remote_bd_addr, p_conn_status->bd_addr, BD_ADDR_LEN);
-        phy_prefs.tx_phys = BTM_BLE_PREFER_2M_PHY;  /* Prefer 2M for TX */
-        phy_prefs.rx_phys = BTM_BLE_PREFER_2M_PHY;  /* Prefer 2M for RX */
-        phy_prefs.phy_opts = BTM_BLE_PREFER_NO_LELR; /* No coded PHY */
-
-        wiced_bt_dev_status_t phy_status = wiced_bt_ble_set_phy(&phy_prefs);
-        printf("Requested LE 2M PHY (2x speed):\n");
-        printf("   Request status: %s\n", phy_status == WICED_BT_SUCCESS ? "SUCCESS" : "FAILED");
-
-        /* Request Data Length Extension for larger packets (up to 251 bytes)
-         * With 2M PHY, the time will be automatically adjusted by the controller */
-        wiced_bt_dev_status_t dle_status = wiced_bt_ble_set_data_packet_length(
-            p_conn_status->bd_addr,
-            251,    /* tx_pdu_length: Max TX packet length */
-            2120    /* tx_time: Max TX time in microseconds (251 bytes @ 1Mbps) */
-        );
-        printf("Requested Data Length Extension (251 bytes):\n");
-        printf("   Request status: %s\n", dle_status == WICED_BT_SUCCESS ? "SUCCESS" : "FAILED");
+        /* Connection interval, 2M PHY and data length are negotiated and
+         * then tuned per central by the link tuner */
+        app_link_tuner_connected(p_conn_status->bd_addr);
+
+        /* Normally already done while advertising */
+        app_data_transfer_prestage();
 
     }
     else
@@ -261,6 +226,7 @@ app_gatt_connect_handler(wiced_bt_gatt_connection_status_t *p_conn_status)
 
         /* Pause data transfer if active */
         app_data_transfer_pause();
+        app_link_tuner_disconnected();
 
         /* Handle the disconnection */
         app_bt_conn_id  = 0;
@@ -393,6 +359,34 @@ app_gatt_attr_read_handler( uint16_t conn_id,
     uint16_t len_to_send = 0;
     *p_error_handle = p_read_req->handle;
 
+    /* Data Transfer Service - Telemetry summary, computed when a read starts
+     * and kept for the blob reads that follow at small MTUs */
+    if (HDLC_DATA_TRANSFER_SERVICE_TELEMETRY_VALUE == p_read_req->handle)
+    {
+        static telemetry_summary_t telemetry_summary;
+
+        if (p_read_req->offset == 0)
+        {
+            app_data_transfer_get_telemetry(&telemetry_summary);
+        }
+        if (p_read_req->offset >= sizeof(telemetry_summary))
+        {
+            return WICED_BT_GATT_INVALID_OFFSET;
+        }
+
+        len_to_send = sizeof(telemetry_summary) - p_read_req->offset;
+        if(len_req < len_to_send)
+        {
+            len_to_send = len_req;
+        }
+
+        return wiced_bt_gatt_server_send_read_handle_rsp(conn_id,
+                                                         opcode,
+                                                         len_to_send,
+                                    (uint8_t *)&telemetry_summary + p_read_req->offset,
+                                                         NULL);
+    }
+
     /* Validate the length of the attribute and read from the attribute */
     index = app_get_attr_index_by_handle((p_read_req->handle));
     if (INVALID_ATT_TBL_INDEX != index)
@@ -632,6 +626,12 @@ wiced_bt_gatt_status_t app_set_gatt_attr_value(uint16_t attr_handle,
 
           gatt_status = WICED_BT_GATT_SUCCESS;
       }
+      /* Data Transfer Service - Telemetry Characteristic (TELEMETRY_CMD_*) */
+      else if (HDLC_DATA_TRANSFER_SERVICE_TELEMETRY_VALUE == attr_handle)
+      {
+          gatt_status = app_telemetry_command(p_val, len) ? WICED_BT_GATT_SUCCESS
+                                                          : WICED_BT_GATT_REQ_NOT_SUPPORTED;
+      }
 
   return (gatt_status);
 }
@@ -678,7 +678,7 @@ int32_t app_get_attr_index_by_handle(uint16_t attr_handle)
  * Function Name: app_free_buffer
  *******************************************************************************
  * Summary:
- *  This function frees up the memory buffer
+ *  This function returns a buffer to the buffer pool
  *
  *
  * Parameters:
@@ -687,7 +687,7 @@ int32_t app_get_attr_index_by_handle(uint16_t attr_handle)
  ******************************************************************************/
 static void app_free_buffer(uint8_t *p_buf)
 {
-    vPortFree(p_buf);
+    app_buffer_pool_free(p_buf);
 }
 
 
@@ -695,7 +695,9 @@ static void app_free_buffer(uint8_t *p_buf)
  * Function Name: app_alloc_buffer
  *******************************************************************************
  * Summary:
- *  This function allocates a memory buffer.
+ *  This function takes a buffer from the buffer pool. Stack buffers are
+ *  requested for every response; the RTOS heap would fragment under
+ *  sustained traffic.
  *
  *
  * Parameters:
@@ -704,7 +706,7 @@ static void app_free_buffer(uint8_t *p_buf)
  ******************************************************************************/
 static void* app_alloc_buffer(int len)
 {
-    return pvPortMalloc(len);
+    return app_buffer_pool_alloc((uint32_t)len);
 }
 
 /* [] END OF FILE */
@@ -0,0 +1,159 @@
+/*******************************************************************************
+ * File Name: app_buffer_pool.c
+ *
+ * Description: This file implements the fixed-size block pools used for
+ *              Bluetooth stack buffers.
+ *
+ *******************************************************************************/
+
+#include "app_buffer_pool.h"
+#include "cyhal.h"
+#include "stdio.h"
+#include <string.h>
+
+/*******************************************************************************
+ *        Global Variables
+ *******************************************************************************/
+
+/* Each class is one contiguous array, so a block's class follows from its
+ * address. Free blocks form a LIFO list through their first word. */
+typedef struct {
+    uint32_t *storage;
+    uint16_t block_words;
+    uint16_t block_count;
+    uint32_t *free_list;
+    buffer_pool_stats_t stats;
+} pool_class_t;
+
+static uint32_t small_storage[BUFFER_POOL_SMALL_COUNT][BUFFER_POOL_SMALL_SIZE / 4u];
+static uint32_t mtu_storage[BUFFER_POOL_MTU_COUNT][BUFFER_POOL_MTU_SIZE / 4u];
+
+static pool_class_t pool_classes[BUFFER_POOL_CLASS_COUNT] = {
+    { &small_storage[0][0], BUFFER_POOL_SMALL_SIZE / 4u, BUFFER_POOL_SMALL_COUNT, NULL, { 0 } },
+    { &mtu_storage[0][0], BUFFER_POOL_MTU_SIZE / 4u, BUFFER_POOL_MTU_COUNT, NULL, { 0 } },
+};
+
+/*******************************************************************************
+ *        Function Implementations
+ *******************************************************************************/
+
+/**
+ * Build the free lists
+ */
+void app_buffer_pool_init(void)
+{
+    for (uint8_t c = 0; c < BUFFER_POOL_CLASS_COUNT; c++) {
+        pool_class_t *pool = &pool_classes[c];
+
+        pool->free_list = NULL;
+        for (uint32_t i = pool->block_count; i-- > 0;) {
+            uint32_t *block = pool->storage + i * pool->block_words;
+            *(uint32_t **)block = pool->free_list;
+            pool->free_list = block;
+        }
+
+        memset(&pool->stats, 0, sizeof(pool->stats));
+        pool->stats.block_size = (uint16_t)(pool->block_words * 4u);
+        pool->stats.block_count = pool->block_count;
+    }
+}
+
+/**
+ * Take a block from the first class len fits that has one free
+ */
+void *app_buffer_pool_alloc(uint32_t len)
+{
+    pool_class_t *fitting = NULL;
+    uint32_t *block = NULL;
+
+    uint32_t irq_state = cyhal_system_critical_section_enter();
+    for (uint8_t c = 0; c < BUFFER_POOL_CLASS_COUNT; c++) {
+        pool_class_t *pool = &pool_classes[c];
+        if (len > pool->block_words * 4u) {
+            continue;
+        }
+        if (fitting == NULL) {
+            fitting = pool;
+        }
+        if (pool->free_list == NULL) {
+            continue;
+        }
+
+        block = pool->free_list;
+        pool->free_list = *(uint32_t **)block;
+        pool->stats.allocs++;
+        pool->stats.in_use++;
+        if (pool->stats.in_use > pool->stats.high_water) {
+            pool->stats.high_water = pool->stats.in_use;
+        }
+        break;
+    }
+    if (block == NULL && fitting != NULL) {
+        fitting->stats.failures++;
+    }
+    cyhal_system_critical_section_exit(irq_state);
+
+    return block;
+}
+
+/**
+ * Return a block to the class it came from
+ */
+void app_buffer_pool_free(uint8_t *p_buf)
+{
+    if (p_buf == NULL) {
+        return;
+    }
+
+    for (uint8_t c = 0; c < BUFFER_POOL_CLASS_COUNT; c++) {
+        pool_class_t *pool = &pool_classes[c];
+        uint8_t *start = (uint8_t *)pool->storage;
+        uint32_t size = (uint32_t)pool->block_words * 4u * pool->block_count;
+
+        if (p_buf >= start && p_buf < start + size) {
+            uint32_t *block = pool->storage + ((uint32_t)(p_buf - start) / 4u / pool->block_words) * pool->block_words;
+
+            uint32_t irq_state = cyhal_system_critical_section_enter();
+            *(uint32_t **)block = pool->free_list;
+            pool->free_list = block;
+            pool->stats.in_use--;
+            cyhal_system_critical_section_exit(irq_state);
+            return;
+        }
+    }
+
+    printf("ERROR: buffer %p is not from the buffer pool\n", (void *)p_buf);
+}
+
+/**
+ * Get the usage of a size class
+ */
+void app_buffer_pool_get_stats(uint8_t class_index, buffer_pool_stats_t *stats)
+{
+    if (class_index >= BUFFER_POOL_CLASS_COUNT) {
+        memset(stats, 0, sizeof(*stats));
+        return;
+    }
+
+    uint32_t irq_state = cyhal_system_critical_section_enter();
+    *stats = pool_classes[class_index].stats;
+    cyhal_system_critical_section_exit(irq_state);
+}
+
+/**
+ * Print the usage of every size class
+ */
+void app_buffer_pool_print_stats(void)
+{
+    buffer_pool_stats_t stats;
+
+    printf("Buffer pool (size: in use / high water / blocks, allocs, failures):\n");
+    for (uint8_t c = 0; c < BUFFER_POOL_CLASS_COUNT; c++) {
+        app_buffer_pool_get_stats(c, &stats);
+        printf("  %4d bytes: %d / %d / %d, %lu, %lu\n",
+               stats.block_size, stats.in_use, stats.high_water, stats.block_count,
+               stats.allocs, stats.failures);
+    }
+}
+
+/* [] END OF FILE */
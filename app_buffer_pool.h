@@ -0,0 +1,83 @@
+/*******************************************************************************
+ * File Name: app_buffer_pool.h
+ *
+ * Description: Fixed-size block pools for buffers handed to the Bluetooth
+ *              stack (ATT responses and data notifications). Allocation and
+ *              free are O(1), never touch the RTOS heap and are safe from
+ *              any task, the stack's callbacks and interrupts.
+ *
+ *******************************************************************************/
+
+#ifndef APP_BUFFER_POOL_H_
+#define APP_BUFFER_POOL_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*******************************************************************************
+ * Pool Parameters
+ *******************************************************************************/
+
+/* Size classes, smallest first; a request takes a block of the first class
+ * it fits. Blocks are multiples of 4 bytes. */
+#define BUFFER_POOL_SMALL_SIZE      (64u)       /* Short ATT responses (e.g. the telemetry summary) */
+#define BUFFER_POOL_SMALL_COUNT     (8u)
+#define BUFFER_POOL_MTU_SIZE        (512u)      /* One ATT PDU at the largest MTU (design.cybt) */
+#define BUFFER_POOL_MTU_COUNT       (10u)       /* Copied notifications and ATT responses */
+#define BUFFER_POOL_CLASS_COUNT     (2u)
+
+/*******************************************************************************
+ * Data Structures
+ *******************************************************************************/
+
+/* Context passed with a buffer to the stack: called with the buffer on
+ * GATT_APP_BUFFER_TRANSMITTED_EVT */
+typedef void (*pfn_free_buffer_t)(uint8_t *);
+
+/* Usage of one size class since boot */
+typedef struct {
+    uint16_t block_size;
+    uint16_t block_count;
+    uint16_t in_use;
+    uint16_t high_water;        /* Most blocks in use at once */
+    uint32_t allocs;
+    uint32_t failures;          /* Requests that found the class (and larger ones) empty */
+} buffer_pool_stats_t;
+
+/*******************************************************************************
+ *        Function Prototypes
+ *******************************************************************************/
+
+/**
+ * Build the free lists. Call once before the Bluetooth stack starts.
+ */
+void app_buffer_pool_init(void);
+
+/**
+ * Take a block of at least len bytes
+ * Falls back to a larger class when the fitting one is empty.
+ * @param len Bytes needed
+ * @return Block, or NULL if len is larger than any class or all are empty
+ */
+void *app_buffer_pool_alloc(uint32_t len);
+
+/**
+ * Return a block. Has the stack's buffer-free callback signature, so it can
+ * be passed as the context of a response or notification directly.
+ * @param p_buf Block from app_buffer_pool_alloc, or NULL
+ */
+void app_buffer_pool_free(uint8_t *p_buf);
+
+/**
+ * Get the usage of a size class
+ * @param class_index 0 to BUFFER_POOL_CLASS_COUNT - 1, smallest first
+ * @param stats Output usage
+ */
+void app_buffer_pool_get_stats(uint8_t class_index, buffer_pool_stats_t *stats);
+
+/**
+ * Print the usage of every size class to the console
+ */
+void app_buffer_pool_print_stats(void);
+
+#endif /* APP_BUFFER_POOL_H_ */
@@ -8,6 +8,8 @@
 
 #include "app_data_transfer.h"
 #include "app_waveform.h"
+#include "app_telemetry.h"
+#include "app_buffer_pool.h"
 #include "static_waveform_data.h"
 #include "GeneratedSource/cycfg_gatt_db.h"
 #include "wiced_bt_gatt.h"
@@ -15,6 +17,9 @@
 #include "cyhal.h"
 #include "stdio.h"
 #include <string.h>
+#include <FreeRTOS.h>
+#include <task.h>
+#include <queue.h>
 
 /*******************************************************************************
  *        Global Variables
@@ -25,20 +30,75 @@ static transfer_state_t current_state = TRANSFER_STATE_IDLE;
 static uint16_t connection_id = 0;
 static bool notifications_enabled = false;
 
-/* MTU and chunk sizing */
+/* MTU and chunk sizing (update_chunk_size) */
 static uint16_t negotiated_mtu = 23;        /* Default minimum MTU */
-static uint16_t actual_chunk_size = 12;     /* MTU(23) - ATT(3) - header(8) = 12 bytes */
+static uint16_t notification_size = 20;     /* Notification payload: MTU(23) - ATT(3), trimmed to whole LL PDUs */
+static uint16_t actual_chunk_size = 8;      /* Notification payload - header(12) = 8 bytes */
 static uint16_t actual_chunks_per_block = CHUNKS_PER_BLOCK;
+static bool packed_framing = false;         /* Phone asked for packed records (START_FLAG_PACKED_FRAMING) */
 
 /* Block and chunk tracking */
 static uint16_t current_block = 0;          /* Current block being sent (0-1799) */
 static uint16_t current_chunk = 0;          /* Current chunk within block (0-29) */
-static uint16_t last_acked_block = 0;       /* Last block acknowledged by phone */
+static uint16_t last_acked_block = 0;       /* Next block the phone still needs */
 static bool waiting_for_ack = false;
 
-/* Data buffer for current block */
-static uint8_t block_data[BLOCK_SIZE_MAX];
-static uint32_t current_block_size = BLOCK_SIZE_MAX;  /* Actual size of current block (compressed) */
+/* Send window: blocks stay buffered until acknowledged so lost chunks can be
+ * resent. Block n lives in slot n % SEND_WINDOW_BLOCKS. Slots are filled ahead
+ * of the sender by the block producer task. */
+#define NO_BLOCK                    (0xFFFFu)
+#define CHUNK_BITMAP_WORDS          ((MAX_CHUNKS_PER_BLOCK + 31u) / 32u)
+
+typedef struct {
+    volatile uint16_t block_number;             /* Block held in this slot (NO_BLOCK = empty), written last */
+    volatile uint16_t epoch;                    /* window_epoch the block was requested in */
+    uint32_t size;                              /* Actual size of the block (compressed) */
+    uint8_t codec;                              /* BLOCK_CODEC_* sent in the chunk flags */
+    uint16_t chunk_size;                        /* Payload of chunks after the first (0 = not cut yet, cut_block) */
+    uint16_t head_size;                         /* Payload of chunk 0 */
+    uint16_t total_chunks;                      /* Chunks the block is cut into */
+    uint32_t retransmit[CHUNK_BITMAP_WORDS];    /* Chunks queued for retransmission */
+    uint32_t resent[CHUNK_BITMAP_WORDS];        /* Chunks resent within the holdoff */
+    uint32_t resent_time_ms;                    /* Time of the last resend from this slot */
+    uint32_t delivered[CHUNK_BITMAP_WORDS];     /* Chunks the phone reported having when it resumed */
+    uint8_t frame_header_size;                  /* Header room before each chunk (0 = block not framed) */
+    volatile uint16_t in_flight;                /* Notifications sent from data still held by the stack */
+    uint8_t data[BLOCK_SIZE_MAX + FRAMED_CHUNKS_MAX * CHUNK_HEADER_SIZE];
+} window_slot_t;
+
+static window_slot_t send_window[SEND_WINDOW_BLOCKS];
+
+/* Block producer: generates requested blocks into their window slots at lower
+ * priority, so waveform synthesis and compression never stall the sender.
+ * Restarting the window bumps the epoch; stale requests are skipped and stale
+ * slots are ignored. */
+#define PRODUCER_TASK_STACK_SIZE    (configMINIMAL_STACK_SIZE * 4)
+#define PRODUCER_TASK_PRIORITY      (configMAX_PRIORITIES - 4)  /* Below the data transfer task */
+
+typedef struct {
+    uint16_t block_number;
+    uint16_t epoch;
+} block_request_t;
+
+static QueueHandle_t produce_queue = NULL;  /* Blocks to generate, oldest first */
+static volatile uint16_t window_epoch = 0;
+static uint16_t next_request_block = 0;     /* Next block to hand to the producer */
+static bool window_prestaged = false;       /* Window already holds the first blocks of a fresh transfer */
+
+/* Selective ACK state. The GATT handler only posts the latest SACK; the data
+ * transfer task applies it so the window is touched from one task only. */
+static volatile bool sack_enabled = false;
+static volatile bool sack_pending = false;
+static sack_msg_t pending_sack;
+static uint32_t last_progress_time_ms = 0;
+
+/* Resume state. Resume messages are queued by the GATT handler like SACKs and
+ * applied by the data transfer task, which then rewinds the window. */
+#define BLOCK_BITMAP_WORDS          ((TOTAL_BLOCKS + 31u) / 32u)
+static uint32_t delivered_blocks[BLOCK_BITMAP_WORDS];  /* Blocks past last_acked_block the phone has */
+static volatile bool resume_pending = false;
+static resume_msg_t pending_resume[RESUME_MAX_MESSAGES];
+static uint8_t pending_resume_count = 0;
 
 /* Statistics */
 static transfer_stats_t stats;
@@ -52,27 +112,40 @@ static mode_stats_t uncompressed_stats = {0};
 static mode_stats_t compressed_stats = {0};
 #endif
 
-/* Congestion tracking for adaptive rate control */
-static uint16_t consecutive_send_failures = 0;
-static uint16_t consecutive_send_successes = 0;
-static uint16_t current_delay_ms = 30;  /* Start at INITIAL_DELAY_MS */
+/* Congestion reporting */
 static uint32_t last_congestion_report_time = 0;
+#define CONGESTION_REPORT_INTERVAL_MS  5000  /* Report congestion max once per 5 sec */
 
-/* Credit-based flow control to prevent buffer overflow */
-#define MAX_NOTIFICATIONS_IN_FLIGHT  2   /* Maximum notifications queued in BLE stack at once */
-static volatile int16_t notification_credits = MAX_NOTIFICATIONS_IN_FLIGHT;
+/* Credit-based flow control: each notification handed to the stack takes a
+ * credit, GATT_APP_BUFFER_TRANSMITTED_EVT returns it and wakes the sender */
+static volatile uint16_t notification_credit_limit = NOTIFICATION_CREDITS_MIN;
+static volatile uint16_t notifications_in_flight = 0;
 static uint32_t notifications_queued = 0;
 static uint32_t notifications_transmitted = 0;
-
-/* Adaptive rate control constants - balanced for reliability */
-#define MIN_DELAY_MS           15    /* Minimum delay (fastest) - match connection interval */
-#define MAX_DELAY_MS           50    /* Maximum delay (slowest) */
-#define INITIAL_DELAY_MS       15    /* Start at minimum for max speed */
-#define CONGESTION_THRESHOLD   3     /* Consecutive failures before backing off */
-#define SUCCESS_THRESHOLD      50    /* Consecutive successes before speeding up (was 150) */
-#define BACKOFF_INCREMENT      5     /* Add 5ms on congestion (granular steps) */
-#define SPEEDUP_DECREMENT      1     /* Subtract 1ms on success (gradual speedup) */
-#define CONGESTION_REPORT_INTERVAL_MS  5000  /* Report congestion max once per 5 sec */
+static bool sender_blocked = false;     /* Last call made no progress: sleep until an event */
+
+/* Link parameters used to size the credit limit (LE defaults until updated) */
+#define LL_IFS_US               150     /* Inter frame space */
+#define LL_EMPTY_PDU_1M_US      80      /* Peer's empty PDU on LE 1M */
+#define LL_EMPTY_PDU_2M_US      44      /* Peer's empty PDU on LE 2M */
+#define L2CAP_ATT_OVERHEAD      7       /* L2CAP header (4) + ATT notification header (3) */
+#define DEFAULT_CONN_INTERVAL   12      /* 15 ms, the link tuner's first request */
+#define DEFAULT_LL_TX_OCTETS    27
+#define DEFAULT_LL_TX_TIME_US   328
+static uint16_t conn_interval_units = DEFAULT_CONN_INTERVAL;
+static uint16_t ll_max_tx_octets = DEFAULT_LL_TX_OCTETS;
+static uint16_t ll_max_tx_time_us = DEFAULT_LL_TX_TIME_US;
+static uint16_t ll_empty_pdu_us = LL_EMPTY_PDU_1M_US;
+
+/* Sender task, woken by TX-complete, control and producer events */
+extern TaskHandle_t data_transfer_task_handle;
+
+#if USE_COMPRESSION
+/* Adaptive codec selection estimates (producer task only) */
+static uint32_t encode_time_us_avg = 0;         /* EWMA of app_waveform_compress time */
+static uint32_t compressed_size_avg = 0;        /* EWMA of compressed block size (0 = not measured) */
+static uint16_t raw_blocks_since_probe = 0;
+#endif
 
 /* Timer for getting timestamps */
 extern cyhal_timer_t data_transfer_timer_obj;  /* We'll reuse the existing timer for timing */
@@ -80,8 +153,43 @@ extern cyhal_timer_t data_transfer_timer_obj;  /* We'll reuse the existing timer
 /*******************************************************************************
  *        Forward Declarations
  *******************************************************************************/
-static uint32_t generate_block_data(uint16_t block_num, uint8_t *buffer);
-static bool send_chunk(uint16_t block_num, uint16_t chunk_num);
+static uint32_t generate_block_data(uint16_t block_num, uint8_t *buffer, uint8_t *codec);
+#if USE_COMPRESSION
+static bool should_compress(void);
+static uint32_t link_bytes_per_second(void);
+#endif
+static void block_producer_task(void *pvParam);
+static void restart_send_window(void);
+static void request_blocks(void);
+static bool slot_holds(const window_slot_t *slot, uint16_t block_num);
+static void update_notification_credits(void);
+static void reset_flow_control(void);
+static void wake_sender(uint32_t event);
+static void update_chunk_size(void);
+static void cut_block(window_slot_t *slot, uint16_t head_size);
+static uint32_t chunk_offset(const window_slot_t *slot, uint16_t chunk_num);
+static uint16_t chunk_payload_size(const window_slot_t *slot, uint16_t chunk_num);
+static bool pack_next_block(const window_slot_t *slot);
+static void apply_pending_sack(void);
+static void queue_resume(const resume_msg_t *msg);
+static void apply_pending_resume(void);
+static void apply_resume_message(const resume_msg_t *msg);
+static void rewind_send_window(void);
+static void finish_block(void);
+static bool block_delivered(uint16_t block_num);
+static bool chunk_delivered(const window_slot_t *slot, uint16_t chunk_num);
+static bool send_next_retransmit(void);
+static void probe_if_stalled(void);
+static void frame_block(window_slot_t *slot);
+static void unframe_block(window_slot_t *slot);
+static const uint8_t *chunk_data(const window_slot_t *slot, uint16_t chunk_num);
+static bool send_chunk(uint16_t block_num, uint16_t chunk_num, bool pack_next);
+static uint16_t put_chunk(uint8_t *buffer, uint16_t block_num, uint16_t chunk_num, bool more);
+static uint16_t put_header(uint8_t *buffer, uint16_t block_num, uint16_t chunk_num, bool more);
+static void framed_notification_transmitted(uint8_t *p_buf);
+static void copied_notification_transmitted(uint8_t *p_buf);
+static void notification_transmitted(void);
+static uint8_t free_credits(void);
 static void reset_transfer_state(void);
 static uint32_t get_time_ms(void);
 
@@ -96,17 +204,14 @@ void app_data_transfer_init(void)
 {
     /* Initialize waveform generation subsystem */
     app_waveform_init();
+    app_telemetry_init();
 
     reset_transfer_state();
     printf("Data Transfer Service initialized\n");
     printf("  Flow Control Configuration:\n");
-    printf("    Initial delay:   %d ms\n", INITIAL_DELAY_MS);
-    printf("    Min delay:       %d ms\n", MIN_DELAY_MS);
-    printf("    Max delay:       %d ms\n", MAX_DELAY_MS);
-    printf("    Backoff increment: +%d ms (granular)\n", BACKOFF_INCREMENT);
-    printf("    Speedup decrement: -%d ms\n", SPEEDUP_DECREMENT);
-    printf("    Congestion threshold: %d failures\n", CONGESTION_THRESHOLD);
-    printf("    Success threshold:    %d successes\n", SUCCESS_THRESHOLD);
+    printf("    Event-driven, credits sized from link: %d-%d notifications\n",
+           NOTIFICATION_CREDITS_MIN, NOTIFICATION_CREDITS_MAX);
+    printf("    Current credit limit: %d\n", notification_credit_limit);
 }
 
 /**
@@ -115,22 +220,110 @@ void app_data_transfer_init(void)
 void app_data_transfer_set_mtu(uint16_t mtu)
 {
     negotiated_mtu = mtu;
+    printf("MTU set to %d bytes\n", mtu);
+
+    update_chunk_size();
+    update_notification_credits();
+}
+
+/**
+ * Size notifications and chunk payloads from the MTU, the LL data length and
+ * the framing
+ * A notification spanning several LL PDUs pays a whole PDU's airtime for its
+ * last few bytes. Under the same cost model as the credit limit (every PDU
+ * takes one PDU slot) it is trimmed to whole PDUs when that carries more
+ * chunk data per PDU. Blocks already cut into chunks keep their cut.
+ */
+static void update_chunk_size(void)
+{
+    uint32_t header_size = packed_framing ? PACKED_RECORD_HEADER_SIZE : sizeof(chunk_header_t);
+    uint32_t payload = negotiated_mtu - 3u;  /* ATT notification header */
+    uint32_t link_bytes = payload + L2CAP_ATT_OVERHEAD;
+    uint32_t pdus = (link_bytes + ll_max_tx_octets - 1) / ll_max_tx_octets;
+
+    if (pdus > 1 && (link_bytes % ll_max_tx_octets) != 0) {
+        uint32_t trimmed = (pdus - 1) * ll_max_tx_octets - L2CAP_ATT_OVERHEAD;
+        if ((trimmed - header_size) * pdus >= (payload - header_size) * (pdus - 1)) {
+            payload = trimmed;
+        }
+    }
 
-    /* Calculate usable chunk size: MTU - ATT overhead (3) - header (8) */
-    actual_chunk_size = mtu - 3 - sizeof(chunk_header_t);
+    notification_size = (uint16_t)payload;
+    actual_chunk_size = (uint16_t)(payload - header_size);
 
     /* Recalculate chunks per block (using max size for allocation) */
     actual_chunks_per_block = (BLOCK_SIZE_MAX + actual_chunk_size - 1) / actual_chunk_size;
 
-    printf("MTU set to %d bytes\n", mtu);
+    printf("  Notification payload: %d bytes (%s framing, %d octets per LL PDU)\n",
+           notification_size, packed_framing ? "packed" : "chunk header", ll_max_tx_octets);
     printf("  Usable chunk size: %d bytes\n", actual_chunk_size);
     printf("  Chunks per block: %d\n", actual_chunks_per_block);
 }
 
+/**
+ * Set connection interval for sizing the credit limit
+ */
+void app_data_transfer_set_conn_interval(uint16_t conn_interval)
+{
+    conn_interval_units = conn_interval;
+    update_notification_credits();
+}
+
+/**
+ * Set LL data length for sizing the credit limit
+ */
+void app_data_transfer_set_data_length(uint16_t max_tx_octets, uint16_t max_tx_time_us)
+{
+    ll_max_tx_octets = max_tx_octets;
+    ll_max_tx_time_us = max_tx_time_us;
+    update_chunk_size();
+    update_notification_credits();
+}
+
+/**
+ * Set the central's PHY for sizing the credit limit
+ */
+void app_data_transfer_set_phy(uint8_t rx_phy)
+{
+    ll_empty_pdu_us = (rx_phy == 2) ? LL_EMPTY_PDU_2M_US : LL_EMPTY_PDU_1M_US;
+    update_notification_credits();
+}
+
+/**
+ * Size the credit limit to the notifications one connection event can carry
+ * The controller may use the whole interval as its event length. One extra
+ * credit keeps a notification queued for the start of the next event while
+ * TX-complete events for the current one are still being delivered.
+ */
+static void update_notification_credits(void)
+{
+    uint32_t event_us = (uint32_t)conn_interval_units * 1250u;
+    uint32_t pdu_us = ll_max_tx_time_us + LL_IFS_US + ll_empty_pdu_us + LL_IFS_US;
+    uint32_t pdus_per_event = event_us / pdu_us;
+
+    uint32_t notification_bytes = notification_size + L2CAP_ATT_OVERHEAD;
+    uint32_t pdus_per_notification = (notification_bytes + ll_max_tx_octets - 1) / ll_max_tx_octets;
+
+    uint32_t credits = pdus_per_event / pdus_per_notification + 1;
+    if (credits < NOTIFICATION_CREDITS_MIN) {
+        credits = NOTIFICATION_CREDITS_MIN;
+    }
+    if (credits > NOTIFICATION_CREDITS_MAX) {
+        credits = NOTIFICATION_CREDITS_MAX;
+    }
+
+    if (credits != notification_credit_limit) {
+        notification_credit_limit = (uint16_t)credits;
+        printf("Flow control: %d notification credits (interval %d x 1.25 ms, %d octets / %d us per PDU)\n",
+               (int)credits, conn_interval_units, ll_max_tx_octets, ll_max_tx_time_us);
+        wake_sender(DATA_TASK_NOTIFY_TX_COMPLETE);
+    }
+}
+
 /**
  * Start data transfer
  */
-bool app_data_transfer_start(uint16_t conn_id)
+bool app_data_transfer_start(uint16_t conn_id, uint8_t start_flags)
 {
     if (!notifications_enabled) {
         printf("Cannot start transfer: notifications not enabled\n");
@@ -138,15 +331,27 @@ bool app_data_transfer_start(uint16_t conn_id)
     }
 
     connection_id = conn_id;
+    packed_framing = (start_flags & START_FLAG_PACKED_FRAMING) != 0;
+    update_chunk_size();
     current_state = TRANSFER_STATE_ACTIVE;
     current_block = 0;
     current_chunk = 0;
     last_acked_block = 0;
     waiting_for_ack = false;
+    sack_enabled = false;
+    sack_pending = false;
+    resume_pending = false;
+    pending_resume_count = 0;
+    memset(delivered_blocks, 0, sizeof(delivered_blocks));
+    if (!window_prestaged) {
+        restart_send_window();
+    }
 
     /* Initialize statistics */
     memset(&stats, 0, sizeof(stats));
+    app_telemetry_reset();
     stats.start_time_ms = get_time_ms();
+    last_progress_time_ms = stats.start_time_ms;
 
 #if BENCHMARK_MODE_ENABLED
     /* Initialize benchmark mode */
@@ -167,13 +372,14 @@ bool app_data_transfer_start(uint16_t conn_id)
            BENCHMARK_UNCOMPRESSED_DURATION_MS / 1000);
 #endif
 
-    /* Generate first block */
-    current_block_size = generate_block_data(current_block, block_data);
+    /* Start generating the first blocks (or top up a pre-staged window) */
+    request_blocks();
+    window_prestaged = false;
 
     printf("\n========================================\n");
     printf("Data Transfer STARTED\n");
     printf("Total blocks: %d\n", TOTAL_BLOCKS);
-    printf("Block size: ~%d bytes (compressed)\n", (int)current_block_size);
+    printf("Block size: up to %d bytes\n", (int)BLOCK_SIZE_MAX);
     printf("Total data: ~%lu MB (uncompressed)\n", (uint32_t)((uint32_t)TOTAL_BLOCKS * BLOCK_SIZE_RAW) / (1024 * 1024));
     printf("========================================\n\n");
 
@@ -188,6 +394,33 @@ void app_data_transfer_stop(void)
     printf("Data Transfer STOPPED by user\n");
     current_state = TRANSFER_STATE_IDLE;
     app_data_transfer_print_stats();
+
+    /* A new start command sends from block 0 again */
+    app_data_transfer_prestage();
+}
+
+/**
+ * Generate the first blocks of a transfer before it is started
+ */
+void app_data_transfer_prestage(void)
+{
+    if (current_state != TRANSFER_STATE_IDLE || produce_queue == NULL || window_prestaged) {
+        return;
+    }
+
+    /* The state app_data_transfer_start() sets up for block generation */
+    current_block = 0;
+    last_acked_block = 0;
+    sack_enabled = false;
+    memset(delivered_blocks, 0, sizeof(delivered_blocks));
+#if BENCHMARK_MODE_ENABLED
+    current_mode = TRANSFER_MODE_UNCOMPRESSED;
+    mode_switched = false;
+#endif
+
+    restart_send_window();
+    request_blocks();
+    window_prestaged = true;
 }
 
 /**
@@ -203,6 +436,9 @@ void app_data_transfer_pause(void)
         printf("  Last sent: Block %d, Chunk %d\n", current_block, current_chunk);
         printf("  Last ACK'd: Block %d\n", last_acked_block);
     }
+
+    /* Notifications queued on the old link never complete */
+    reset_flow_control();
 }
 
 /**
@@ -210,7 +446,7 @@ void app_data_transfer_pause(void)
  */
 bool app_data_transfer_resume(uint16_t conn_id)
 {
-    if (current_state != TRANSFER_STATE_PAUSED) {
+    if (current_state != TRANSFER_STATE_PAUSED && current_state != TRANSFER_STATE_COMPLETE) {
         return false;
     }
 
@@ -220,24 +456,16 @@ bool app_data_transfer_resume(uint16_t conn_id)
     }
 
     connection_id = conn_id;
+    sack_pending = false;
 
-    /* Resume from last acknowledged block + 1 */
-    current_block = last_acked_block;
-    if (current_block > 0 && current_chunk == 0) {
-        /* If we were mid-block, restart that block */
-        /* Otherwise continue from next block */
-    }
-    current_chunk = 0;
-    waiting_for_ack = false;
-
-    /* Regenerate current block data */
-    current_block_size = generate_block_data(current_block, block_data);
-
+    /* The sender rewinds to the first block the phone needs before sending again */
+    resume_pending = true;
+    last_progress_time_ms = get_time_ms();
     current_state = TRANSFER_STATE_ACTIVE;
 
     printf("Data Transfer RESUMED\n");
-    printf("  Resuming from Block %d\n", current_block);
-    printf("  Blocks remaining: %d\n", TOTAL_BLOCKS - current_block);
+    printf("  Last sent: Block %d, Chunk %d\n", current_block, current_chunk);
+    printf("  Blocks remaining: %d\n", TOTAL_BLOCKS - last_acked_block);
 
     return true;
 }
@@ -252,10 +480,8 @@ bool app_data_transfer_process_next_chunk(void)
         return false;
     }
 
-    if (waiting_for_ack) {
-        /* Waiting for ACK, don't send more chunks yet */
-        return true;
-    }
+    apply_pending_resume();
+    apply_pending_sack();
 
 #if BENCHMARK_MODE_ENABLED
     /* Check if it's time to switch modes */
@@ -299,8 +525,7 @@ bool app_data_transfer_process_next_chunk(void)
         printf("\nContinuing in COMPRESSED mode...\n");
         printf("========================================\n\n");
 
-        /* Regenerate current block with new mode */
-        current_block_size = generate_block_data(current_block, block_data);
+        /* Blocks requested from here on are generated in the new mode */
     }
 
     /* Track per-mode statistics */
@@ -315,8 +540,25 @@ bool app_data_transfer_process_next_chunk(void)
     }
 #endif
 
-    /* Check if transfer is complete */
-    if (current_block >= TOTAL_BLOCKS) {
+    /* Keep the producer busy with every free window slot */
+    request_blocks();
+
+    /* Assume no progress until a chunk goes out */
+    sender_blocked = true;
+
+    /* Lost chunks go out before new data */
+    if (sack_enabled && send_next_retransmit()) {
+        return true;
+    }
+
+    /* Blocks the phone reported when resuming are not sent again */
+    while (current_block < TOTAL_BLOCKS && block_delivered(current_block)) {
+        current_block++;
+        current_chunk = 0;
+    }
+
+    /* Check if transfer is complete (with SACK, only once everything is acknowledged) */
+    if (current_block >= TOTAL_BLOCKS && (!sack_enabled || last_acked_block >= TOTAL_BLOCKS)) {
         current_state = TRANSFER_STATE_COMPLETE;
         stats.end_time_ms = get_time_ms();
 
@@ -328,64 +570,80 @@ bool app_data_transfer_process_next_chunk(void)
         return false;
     }
 
-    /* Try to send current chunk */
-    if (!send_chunk(current_block, current_chunk)) {
-        /* Send failed - likely congestion. Return true to indicate transfer is still active
-         * but don't advance to next chunk. Caller should retry after delay. */
+    /* Stay within the window of unacknowledged blocks */
+    uint16_t window_blocks = sack_enabled ? SEND_WINDOW_BLOCKS : ACK_INTERVAL;
+    if (current_block >= TOTAL_BLOCKS || current_block >= last_acked_block + window_blocks) {
+        if (!waiting_for_ack) {
+            waiting_for_ack = true;
+            if (!sack_enabled) {
+                uint32_t elapsed = get_time_ms() - stats.start_time_ms;
+                uint32_t rate_kbps = 0;
+                if (elapsed > 0) {
+                    rate_kbps = (uint32_t)(((uint64_t)stats.total_bytes * 8u) / elapsed);
+                }
+                APP_LOG("Block %d sent. Waiting for ACK (blocks %d-%d) | Rate: %lu Kbps\n",
+                        current_block - 1,
+                        current_block - ACK_INTERVAL,
+                        current_block - 1,
+                        rate_kbps);
+            }
+        }
+        if (sack_enabled) {
+            probe_if_stalled();
+        }
+        return true;
+    }
+
+    /* Producer still generating this block: DATA_TASK_NOTIFY_BLOCK_READY wakes us */
+    window_slot_t *slot = &send_window[current_block % SEND_WINDOW_BLOCKS];
+    if (!slot_holds(slot, current_block)) {
         return true;
     }
 
-    /* Chunk sent successfully */
-    stats.total_chunks++;
-    stats.total_bytes += actual_chunk_size;  /* Approximate */
+    /* The block is cut into chunks when its first one goes out */
+    if (slot->chunk_size == 0) {
+        cut_block(slot, actual_chunk_size);
+    }
 
-    /* Move to next chunk */
-    current_chunk++;
+    /* Skip chunks the phone already had before the disconnect */
+    uint16_t total_chunks = slot->total_chunks;
+    while (current_chunk < total_chunks && chunk_delivered(slot, current_chunk)) {
+        current_chunk++;
+    }
 
-    /* Check if block is complete */
-    uint16_t chunks_in_current_block = (current_block_size + actual_chunk_size - 1) / actual_chunk_size;
-    if (current_chunk >= chunks_in_current_block) {
-        current_chunk = 0;
-        current_block++;
-        stats.blocks_sent++;
+    if (current_chunk < total_chunks) {
+        /* With packed framing the next block's first chunk fills the room the last one leaves */
+        bool pack_next = (current_chunk == total_chunks - 1) && pack_next_block(slot);
 
-        /* Check if we need to wait for ACK */
-        if ((current_block % ACK_INTERVAL) == 0 && current_block < TOTAL_BLOCKS) {
-            current_state = TRANSFER_STATE_WAITING_ACK;
-            waiting_for_ack = true;
-            uint32_t now = get_time_ms();
-            uint32_t elapsed = now - stats.start_time_ms;
-            float rate_kbps = 0.0f;
-            if (elapsed > 0) {
-                rate_kbps = ((float)stats.total_bytes * 8.0f) / (float)elapsed;
-            }
-            printf("[%lu ms] Block %d sent. Waiting for ACK (blocks %d-%d) | Rate: %.2f Kbps\n",
-                   now,
-                   current_block - 1,
-                   current_block - ACK_INTERVAL,
-                   current_block - 1,
-                   rate_kbps);
-        } else if ((current_block % 100) == 0) {
-            /* Print progress every 100 blocks */
-            uint32_t now = get_time_ms();
-            uint32_t elapsed = now - stats.start_time_ms;
-            float rate_kbps = 0.0f;
-            if (elapsed > 0) {
-                rate_kbps = ((float)stats.total_bytes * 8.0f) / (float)elapsed;
-            }
-            printf("[%lu ms] Progress: %d/%d blocks (%.1f%%) | Rate: %.2f Kbps\n",
-                   now,
-                   current_block, TOTAL_BLOCKS,
-                   (float)current_block * 100.0f / TOTAL_BLOCKS,
-                   rate_kbps);
+        /* Try to send current chunk */
+        if (!send_chunk(current_block, current_chunk, pack_next)) {
+            /* Out of credits or congested. Return true to indicate transfer is still
+             * active but don't advance; the next TX-complete event wakes the sender. */
+            return true;
         }
 
-        /* Generate next block data */
-        if (current_block < TOTAL_BLOCKS) {
-            current_block_size = generate_block_data(current_block, block_data);
+        /* Chunk sent successfully */
+        stats.total_chunks++;
+        stats.total_bytes += actual_chunk_size;  /* Approximate */
+
+        /* Move to next chunk */
+        current_chunk++;
+
+        if (pack_next) {
+            /* This block is done and chunk 0 of the next one went out with it.
+             * A next block of one chunk completes on the following call. */
+            finish_block();
+            stats.total_chunks++;
+            current_chunk = 1;
+            return true;
         }
     }
 
+    /* Check if block is complete */
+    if (current_chunk >= total_chunks) {
+        finish_block();
+    }
+
     return true;
 }
 
@@ -404,7 +662,8 @@ void app_data_transfer_control_write_handler(uint16_t conn_id, wiced_bt_gatt_wri
     switch (msg->command) {
         case CTRL_CMD_START:
             printf("Received START command from phone\n");
-            app_data_transfer_start(conn_id);
+            app_data_transfer_start(conn_id, (p_write_req->val_len > START_FLAGS_OFFSET) ?
+                                             p_write_req->p_val[START_FLAGS_OFFSET] : 0u);
             break;
 
         case CTRL_CMD_STOP:
@@ -415,33 +674,63 @@ void app_data_transfer_control_write_handler(uint16_t conn_id, wiced_bt_gatt_wri
         case CTRL_CMD_ACK:
         {
             uint32_t now = get_time_ms();
-            printf("[%lu ms] Received ACK for blocks up to %d\n", now, msg->block_number);
+            APP_LOG("Received ACK for blocks up to %d\n", msg->block_number);
 
             if (msg->block_number >= last_acked_block) {
                 last_acked_block = msg->block_number + 1;  /* Next block to send */
+                last_progress_time_ms = now;
 
                 /* Resume sending if we were waiting */
                 if (waiting_for_ack) {
                     waiting_for_ack = false;
                     current_state = TRANSFER_STATE_ACTIVE;
-                    printf("[%lu ms] ACK received. Resuming transfer from block %d\n", now, current_block);
+                    APP_LOG("ACK received. Resuming transfer from block %d\n", current_block);
                 }
             } else {
-                printf("[%lu ms] WARNING: Received old ACK (current last_acked=%d)\n", now, last_acked_block);
+                APP_LOG("WARNING: Received old ACK (current last_acked=%d)\n", last_acked_block);
             }
         }
             break;
 
+        case CTRL_CMD_SACK:
+            if (p_write_req->val_len < sizeof(sack_msg_t)) {
+                printf("Invalid SACK message size\n");
+                break;
+            }
+            {
+                /* Keep only the latest SACK; it supersedes any not yet applied */
+                uint32_t irq_state = cyhal_system_critical_section_enter();
+                memcpy(&pending_sack, p_write_req->p_val, sizeof(sack_msg_t));
+                sack_pending = true;
+                cyhal_system_critical_section_exit(irq_state);
+            }
+            break;
+
         case CTRL_CMD_REQUEST_RESUME:
-            printf("Received RESUME REQUEST from phone\n");
-            /* Phone is asking where we left off - send response */
-            /* This would be implemented if phone needs to query state */
+            if (p_write_req->val_len < sizeof(resume_msg_t)) {
+                printf("Invalid RESUME message size\n");
+                break;
+            }
+            printf("Received RESUME from phone (needs block %d)\n",
+                   ((const resume_msg_t *)p_write_req->p_val)->cumulative_block);
+
+            /* Nothing to resume (e.g. after a reset): start over, skipping what the phone has */
+            if (current_state == TRANSFER_STATE_IDLE && !app_data_transfer_start(conn_id, 0u)) {
+                break;
+            }
+            queue_resume((const resume_msg_t *)p_write_req->p_val);
+            if (current_state == TRANSFER_STATE_PAUSED || current_state == TRANSFER_STATE_COMPLETE) {
+                app_data_transfer_resume(conn_id);
+            }
             break;
 
         default:
             printf("Unknown control command: 0x%02X\n", msg->command);
             break;
     }
+
+    /* A command or acknowledgement may unblock the sender */
+    wake_sender(DATA_TASK_NOTIFY_CONTROL);
 }
 
 /**
@@ -468,6 +757,14 @@ const transfer_stats_t* app_data_transfer_get_stats(void)
     return &stats;
 }
 
+/**
+ * Summarize the telemetry ring for the Telemetry characteristic
+ */
+void app_data_transfer_get_telemetry(telemetry_summary_t *summary)
+{
+    app_telemetry_get_summary(summary, (uint8_t)notification_credit_limit);
+}
+
 /**
  * Get current transfer state
  */
@@ -508,10 +805,12 @@ void app_data_transfer_print_stats(void)
     printf("Retransmissions:    %d\n", stats.retransmits);
     printf("Congestion events:  %lu\n", stats.congestion_events);
     printf("Send failures:      %lu\n", stats.send_failures);
+    printf("Compressed blocks:  %d / %d\n", stats.compressed_blocks, stats.blocks_sent);
     if (stats.total_chunks > 0) {
         float success_rate = 100.0f * (1.0f - ((float)stats.send_failures / (float)(stats.total_chunks + stats.send_failures)));
         printf("Success rate:       %.2f%%\n", success_rate);
     }
+    app_buffer_pool_print_stats();
     printf("========================================\n\n");
 }
 
@@ -523,9 +822,10 @@ void app_data_transfer_print_stats(void)
  * Generate waveform data for a block (with optional compression)
  * @param block_num Block number to generate
  * @param buffer Output buffer for compressed data
+ * @param codec Receives the BLOCK_CODEC_* the block was encoded with
  * @return Actual size of generated block (compressed or raw)
  */
-static uint32_t generate_block_data(uint16_t block_num, uint8_t *buffer)
+static uint32_t generate_block_data(uint16_t block_num, uint8_t *buffer, uint8_t *codec)
 {
 #if BENCHMARK_MODE_ENABLED
     /* Benchmark mode: Use static waveforms for both compressed and uncompressed */
@@ -541,6 +841,7 @@ static uint32_t generate_block_data(uint16_t block_num, uint8_t *buffer)
         waveform_header.crc32 = STATIC_WAVEFORM_CRC32;
 
         /* Pack header + compressed data */
+        *codec = BLOCK_CODEC_ZLIB_DELTA;
         memcpy(buffer, &waveform_header, sizeof(waveform_block_header_t));
         memcpy(buffer + sizeof(waveform_block_header_t),
                compressed_waveform_data,
@@ -558,10 +859,12 @@ static uint32_t generate_block_data(uint16_t block_num, uint8_t *buffer)
     } else {
         /* UNCOMPRESSED mode: use static uncompressed data */
 
-        /* Set correct CRC for uncompressed data */
+        /* Set correct CRC for uncompressed data (checked when the table is
+         * generated, so it is not recomputed here) */
         waveform_header.crc32 = STATIC_WAVEFORM_CRC32;
 
         /* Pack header + uncompressed data */
+        *codec = BLOCK_CODEC_RAW;
         memcpy(buffer, &waveform_header, sizeof(waveform_block_header_t));
         memcpy(buffer + sizeof(waveform_block_header_t),
                uncompressed_waveform_data,
@@ -573,21 +876,6 @@ static uint32_t generate_block_data(uint16_t block_num, uint8_t *buffer)
         if (block_num < 3) {
             printf("Block %d: STATIC UNCOMPRESSED %d bytes (CRC:0x%08lX)\n",
                    block_num, (int)total_size, waveform_header.crc32);
-            printf("  First 12 data bytes: %02X %02X %02X %02X %02X %02X %02X %02X %02X %02X %02X %02X\n",
-                   uncompressed_waveform_data[0], uncompressed_waveform_data[1],
-                   uncompressed_waveform_data[2], uncompressed_waveform_data[3],
-                   uncompressed_waveform_data[4], uncompressed_waveform_data[5],
-                   uncompressed_waveform_data[6], uncompressed_waveform_data[7],
-                   uncompressed_waveform_data[8], uncompressed_waveform_data[9],
-                   uncompressed_waveform_data[10], uncompressed_waveform_data[11]);
-            printf("  Verify: static array address = %p, size = %d\n",
-                   (void*)uncompressed_waveform_data, UNCOMPRESSED_WAVEFORM_DATA_SIZE);
-
-            /* Calculate CRC of the static data to verify it matches */
-            uint32_t verify_crc = app_waveform_crc32(uncompressed_waveform_data, UNCOMPRESSED_WAVEFORM_DATA_SIZE);
-            printf("  Static array CRC32: 0x%08lX (expected: 0x%08lX) %s\n",
-                   verify_crc, STATIC_WAVEFORM_CRC32,
-                   (verify_crc == STATIC_WAVEFORM_CRC32) ? "MATCH!" : "MISMATCH!");
         }
 
         return total_size;
@@ -604,12 +892,43 @@ static uint32_t generate_block_data(uint16_t block_num, uint8_t *buffer)
 
     uint32_t compressed_size = 0;
     uint8_t *compressed_data_start = buffer + sizeof(waveform_block_header_t);
+    bool compressed = false;
+
+    if (should_compress()) {
+        uint32_t start_cycles = DWT->CYCCNT;
+        bool fits = app_waveform_compress(&waveform_header, raw_waveform_data,
+                                          compressed_data_start, &compressed_size,
+                                          WAVEFORM_RAW_DATA_SIZE - 1);
+        uint32_t encode_us = (DWT->CYCCNT - start_cycles) / (SystemCoreClock / 1000000u);
+
+        /* Incompressible blocks (e.g. full-scale noise) count as raw-sized */
+        uint32_t measured_size = fits ? compressed_size : WAVEFORM_RAW_DATA_SIZE;
+        if (compressed_size_avg == 0) {
+            encode_time_us_avg = encode_us;
+            compressed_size_avg = measured_size;
+        } else {
+            encode_time_us_avg += ((int32_t)encode_us - (int32_t)encode_time_us_avg) >> CODEC_EWMA_SHIFT;
+            compressed_size_avg += ((int32_t)measured_size - (int32_t)compressed_size_avg) >> CODEC_EWMA_SHIFT;
+        }
+        raw_blocks_since_probe = 0;
+        compressed = fits;
+    } else {
+        raw_blocks_since_probe++;
+    }
 
-    if (!app_waveform_compress(&waveform_header, raw_waveform_data,
-                               compressed_data_start, &compressed_size,
-                               BLOCK_SIZE_MAX - sizeof(waveform_block_header_t))) {
-        printf("ERROR: Failed to compress waveform for block %d\n", block_num);
-        return 0;
+    if (compressed) {
+        *codec = BLOCK_CODEC_RICE;
+        stats.compressed_blocks++;
+    } else {
+        *codec = BLOCK_CODEC_RAW;
+        memcpy(compressed_data_start, raw_waveform_data, WAVEFORM_RAW_DATA_SIZE);
+        compressed_size = WAVEFORM_RAW_DATA_SIZE;
+    }
+
+    if (block_num < 3) {
+        printf("Block %d: %s %d bytes (encode ~%lu us, avg %lu bytes compressed)\n",
+               block_num, compressed ? "RICE" : "RAW", (int)compressed_size,
+               encode_time_us_avg, compressed_size_avg);
     }
 
     memcpy(buffer, &waveform_header, sizeof(waveform_block_header_t));
@@ -626,6 +945,7 @@ static uint32_t generate_block_data(uint16_t block_num, uint8_t *buffer)
     }
 
     /* Pack header + raw samples */
+    *codec = BLOCK_CODEC_RAW;
     memcpy(buffer, &waveform_header, sizeof(waveform_block_header_t));
     memcpy(buffer + sizeof(waveform_block_header_t), raw_waveform_data, WAVEFORM_RAW_DATA_SIZE);
 
@@ -642,149 +962,824 @@ static uint32_t generate_block_data(uint16_t block_num, uint8_t *buffer)
 }
 
 /**
- * Send a chunk via GATT notification
+ * Create the block producer task and its queues
  */
-static bool send_chunk(uint16_t block_num, uint16_t chunk_num)
+bool app_data_transfer_create_producer(void)
 {
-    /* Check if we have credits to send (flow control to prevent buffer overflow) */
-    if (notification_credits <= 0) {
-        /* No credits available - BLE stack buffer is full */
-        uint32_t now = get_time_ms();
-        if ((now - last_congestion_report_time) > CONGESTION_REPORT_INTERVAL_MS) {
-            printf("[%lu ms] Flow control: waiting for transmission (credits=0, queued=%lu, transmitted=%lu)\n",
-                   now, notifications_queued, notifications_transmitted);
-            last_congestion_report_time = now;
-        }
+    produce_queue = xQueueCreate(SEND_WINDOW_BLOCKS, sizeof(block_request_t));
+    if (produce_queue == NULL) {
         return false;
     }
 
-    /* Calculate total chunks needed for this block */
-    uint16_t total_chunks_for_block = (current_block_size + actual_chunk_size - 1) / actual_chunk_size;
+    /* The encoder is timed with the cycle counter started by app_telemetry_init() */
+    return xTaskCreate(block_producer_task, "Block Producer Task", PRODUCER_TASK_STACK_SIZE,
+                       NULL, PRODUCER_TASK_PRIORITY, NULL) == pdPASS;
+}
 
-    /* CRITICAL: Use static buffer to prevent stack corruption
-     * BLE stack may not copy data immediately - it might just store a pointer
-     * and transmit later, by which time a local buffer would be invalid */
-    static uint8_t packet[sizeof(chunk_header_t) + 512];  /* Max possible with our MTU setting */
-    chunk_header_t *header = (chunk_header_t *)packet;
+/**
+ * Block producer task: generates each requested block into its window slot
+ */
+static void block_producer_task(void *pvParam)
+{
+    block_request_t request;
 
-    /* Fill header */
-    header->block_number = block_num;
-    header->chunk_number = chunk_num;
-    header->total_chunks = total_chunks_for_block;
-    header->block_size_total = (uint16_t)current_block_size;
+    (void)pvParam;
 
-#if BENCHMARK_MODE_ENABLED
-    /* Set compression flag based on current mode */
-    header->flags = (current_mode == TRANSFER_MODE_COMPRESSED) ? 0x01 : 0x00;
-#else
-    header->flags = USE_COMPRESSION ? 0x01 : 0x00;  /* Bit 0: compressed */
+    while (true) {
+        if (xQueueReceive(produce_queue, &request, portMAX_DELAY) != pdPASS) {
+            continue;
+        }
+        if (request.epoch != window_epoch) {
+            continue;  /* Window was restarted since this was requested */
+        }
+
+        window_slot_t *slot = &send_window[request.block_number % SEND_WINDOW_BLOCKS];
+
+        /* Notifications still queued point into the old block. A slot is
+         * normally reused only after its block was acknowledged (SACK) or
+         * fully sent, so this wait is short. */
+        while (slot->in_flight != 0) {
+            vTaskDelay(pdMS_TO_TICKS(1));
+        }
+
+        slot->block_number = NO_BLOCK;
+        __DMB();  /* Unpublished before any field changes */
+        slot->size = generate_block_data(request.block_number, slot->data, &slot->codec);
+        slot->chunk_size = 0;
+        slot->frame_header_size = 0;
+        memset(slot->retransmit, 0, sizeof(slot->retransmit));
+        memset(slot->resent, 0, sizeof(slot->resent));
+        memset(slot->delivered, 0, sizeof(slot->delivered));
+        slot->resent_time_ms = 0;
+        slot->epoch = request.epoch;
+
+        /* Publish only once the data is complete: the barrier keeps the
+         * plain stores above from sinking past the publishing store */
+        __DMB();
+        slot->block_number = request.block_number;
+        wake_sender(DATA_TASK_NOTIFY_BLOCK_READY);
+    }
+}
+
+/**
+ * Discard all buffered blocks and restart production from current_block
+ */
+static void restart_send_window(void)
+{
+    window_prestaged = false;
+    window_epoch++;
+    if (produce_queue != NULL) {
+        (void)xQueueReset(produce_queue);
+    }
+    next_request_block = current_block;
+}
+
+/**
+ * Hand the producer every block whose slot is free. A slot is free once the
+ * block it held is acknowledged (SACK) or fully sent (ACK mode never resends).
+ */
+static void request_blocks(void)
+{
+    uint16_t oldest_needed = sack_enabled ? last_acked_block : current_block;
+
+    while (next_request_block < TOTAL_BLOCKS &&
+           next_request_block < oldest_needed + SEND_WINDOW_BLOCKS) {
+        if (block_delivered(next_request_block)) {
+            next_request_block++;  /* The phone already has it */
+            continue;
+        }
+        block_request_t request = { next_request_block, window_epoch };
+        if (xQueueSend(produce_queue, &request, 0) != pdPASS) {
+            break;
+        }
+        next_request_block++;
+    }
+}
+
+/**
+ * Check whether a slot holds a block generated for the current window
+ * Pairs with the barrier before the producer publishes the slot: the slot's
+ * fields are read only after block_number was seen.
+ */
+static bool slot_holds(const window_slot_t *slot, uint16_t block_num)
+{
+    bool holds = slot->block_number == block_num && slot->epoch == window_epoch;
+    __DMB();
+    return holds;
+}
+
+#if USE_COMPRESSION
+/**
+ * Decide whether the next block should be compressed
+ * The producer works ahead of the sender, so encoding only holds up the radio
+ * when it takes longer than sending the compressed block would.
+ */
+static bool should_compress(void)
+{
+    /* Measure first, and every CODEC_PROBE_INTERVAL raw blocks to follow changes */
+    if (compressed_size_avg == 0 || raw_blocks_since_probe >= CODEC_PROBE_INTERVAL) {
+        return true;
+    }
+    if (compressed_size_avg >= WAVEFORM_RAW_DATA_SIZE) {
+        return false;  /* Signal is not compressing */
+    }
+
+    uint32_t link_rate = link_bytes_per_second();
+    if (link_rate == 0) {
+        return true;  /* No throughput measured yet */
+    }
+
+    uint32_t airtime_us = (uint32_t)(((uint64_t)compressed_size_avg * 1000000u) / link_rate);
+    return encode_time_us_avg < airtime_us;
+}
+
+/**
+ * Current link goodput in bytes per second (0 until measured)
+ */
+static uint32_t link_bytes_per_second(void)
+{
+    uint32_t elapsed_ms = get_time_ms() - stats.start_time_ms;
+    if (current_state != TRANSFER_STATE_ACTIVE || elapsed_ms < 1000u) {
+        return 0;
+    }
+    return (uint32_t)(((uint64_t)stats.total_bytes * 1000u) / elapsed_ms);
+}
 #endif
-    header->reserved = 0;
 
-    /* Calculate chunk size (last chunk might be smaller) */
-    uint32_t offset = chunk_num * actual_chunk_size;
-    uint16_t this_chunk_size = actual_chunk_size;
-    if (offset + actual_chunk_size > current_block_size) {
-        this_chunk_size = current_block_size - offset;
+/**
+ * Cut a buffered block into chunks: chunk 0 carries head_size bytes, every
+ * later chunk actual_chunk_size and the last one what is left. The head only
+ * differs from the rest when it shares a notification with the previous
+ * block's last chunk. The cut is kept until the block is generated again, so
+ * chunk numbers mean the same to the phone however long the block is in flight.
+ */
+static void cut_block(window_slot_t *slot, uint16_t head_size)
+{
+    unframe_block(slot);
+
+    if (head_size > slot->size) {
+        head_size = (uint16_t)slot->size;
+    }
+    slot->chunk_size = actual_chunk_size;
+    slot->head_size = head_size;
+    slot->total_chunks = 1u + (uint16_t)((slot->size - head_size + actual_chunk_size - 1) / actual_chunk_size);
+
+    frame_block(slot);
+}
+
+/**
+ * Spread a cut block so that each chunk has room for its header right in
+ * front of it, and write the headers. Each notification is then sent straight
+ * from the slot: header and payload are already one contiguous buffer.
+ * Blocks cut into more than FRAMED_CHUNKS_MAX chunks (small MTUs) stay
+ * contiguous and are copied into pool buffers instead.
+ */
+static void frame_block(window_slot_t *slot)
+{
+    uint8_t header_size = packed_framing ? PACKED_RECORD_HEADER_SIZE : CHUNK_HEADER_SIZE;
+    uint16_t block_num = slot->block_number;
+
+    if (slot->total_chunks > FRAMED_CHUNKS_MAX) {
+        return;
     }
-    header->chunk_size = this_chunk_size;
 
-    /* Debug: log last chunk details */
-    if (chunk_num == total_chunks_for_block - 1 && block_num < 20) {
-        printf("[DEBUG] Last chunk B%d C%d: offset=%lu, size=%d, block_size=%lu\n",
-               block_num, chunk_num, offset, this_chunk_size, current_block_size);
+    /* Last chunk first: every chunk moves up, past the ones already moved */
+    for (uint16_t chunk = slot->total_chunks; chunk-- > 0;) {
+        uint32_t offset = chunk_offset(slot, chunk);
+        memmove(&slot->data[offset + (uint32_t)(chunk + 1u) * header_size], &slot->data[offset],
+                chunk_payload_size(slot, chunk));
     }
+    slot->frame_header_size = header_size;
 
-    /* Copy data */
-    memcpy(packet + sizeof(chunk_header_t), &block_data[offset], this_chunk_size);
+    for (uint16_t chunk = 0; chunk < slot->total_chunks; chunk++) {
+        (void)put_header((uint8_t *)chunk_data(slot, chunk) - header_size, block_num, chunk, false);
+    }
+}
 
-    /* Send notification */
-    uint16_t packet_size = sizeof(chunk_header_t) + this_chunk_size;
+/**
+ * Undo frame_block before a block is cut again
+ */
+static void unframe_block(window_slot_t *slot)
+{
+    uint8_t header_size = slot->frame_header_size;
+    if (header_size == 0) {
+        return;
+    }
 
-    /* Debug: log header bytes for last chunk of first 20 blocks */
-    if (chunk_num == total_chunks_for_block - 1 && block_num < 20) {
-        printf("[DEBUG] Header bytes: %02X %02X %02X %02X %02X %02X %02X %02X %02X %02X %02X %02X\n",
-               packet[0], packet[1], packet[2], packet[3], packet[4], packet[5],
-               packet[6], packet[7], packet[8], packet[9], packet[10], packet[11]);
+    /* First chunk first: every chunk moves down, into room already vacated */
+    for (uint16_t chunk = 0; chunk < slot->total_chunks; chunk++) {
+        uint32_t offset = chunk_offset(slot, chunk);
+        memmove(&slot->data[offset], &slot->data[offset + (uint32_t)(chunk + 1u) * header_size],
+                chunk_payload_size(slot, chunk));
     }
+    slot->frame_header_size = 0;
+}
+
+/**
+ * Payload of a chunk in its (cut) block, wherever framing put it
+ */
+static const uint8_t *chunk_data(const window_slot_t *slot, uint16_t chunk_num)
+{
+    return &slot->data[chunk_offset(slot, chunk_num) + (uint32_t)(chunk_num + 1u) * slot->frame_header_size];
+}
+
+/**
+ * Byte offset of a chunk in its (cut) block
+ */
+static uint32_t chunk_offset(const window_slot_t *slot, uint16_t chunk_num)
+{
+    if (chunk_num == 0) {
+        return 0;
+    }
+    return slot->head_size + (uint32_t)(chunk_num - 1) * slot->chunk_size;
+}
+
+/**
+ * Payload size of a chunk in its (cut) block, the last one possibly short
+ */
+static uint16_t chunk_payload_size(const window_slot_t *slot, uint16_t chunk_num)
+{
+    uint32_t offset = chunk_offset(slot, chunk_num);
+    uint32_t size = (chunk_num == 0) ? slot->head_size : slot->chunk_size;
+    if (offset + size > slot->size) {
+        size = slot->size - offset;
+    }
+    return (uint16_t)size;
+}
+
+/**
+ * Decide whether the next block's first chunk goes out in the notification
+ * carrying this block's last chunk (packed framing only). A next block with
+ * nothing sent yet is cut so that its first chunk fills the room left.
+ */
+static bool pack_next_block(const window_slot_t *slot)
+{
+    uint16_t next_block = current_block + 1;
+    uint16_t window_blocks = sack_enabled ? SEND_WINDOW_BLOCKS : ACK_INTERVAL;
+    if (!packed_framing || next_block >= TOTAL_BLOCKS || next_block >= last_acked_block + window_blocks ||
+        block_delivered(next_block)) {
+        return false;
+    }
+
+    window_slot_t *next_slot = &send_window[next_block % SEND_WINDOW_BLOCKS];
+    if (!slot_holds(next_slot, next_block)) {
+        return false;
+    }
+
+    /* This block's record (with its length), then the next block's header */
+    uint32_t used = PACKED_RECORD_HEADER_SIZE + PACKED_RECORD_LENGTH_SIZE +
+                    chunk_payload_size(slot, slot->total_chunks - 1) + PACKED_RECORD_HEADER_SIZE;
+    if (used + PACKED_MIN_HEAD_SIZE > notification_size) {
+        return false;
+    }
+    uint16_t room = (uint16_t)(notification_size - used);
+
+    if (next_slot->chunk_size == 0) {
+        cut_block(next_slot, room);
+    }
+    return !chunk_delivered(next_slot, 0) && chunk_payload_size(next_slot, 0) <= room;
+}
+
+/**
+ * Apply the latest SACK from the phone: advance the window and queue the
+ * chunks it reports missing for retransmission
+ */
+static void apply_pending_sack(void)
+{
+    sack_msg_t sack;
+
+    if (!sack_pending) {
+        return;
+    }
+
+    uint32_t irq_state = cyhal_system_critical_section_enter();
+    memcpy(&sack, &pending_sack, sizeof(sack));
+    sack_pending = false;
+    cyhal_system_critical_section_exit(irq_state);
 
-    /* Log chunk sends for first 5 blocks to diagnose packet loss */
     uint32_t now = get_time_ms();
-    if (block_num < 5) {
-        printf("[%lu ms] Sending B%d C%d/%d (credits=%d)\n",
-               now, block_num, chunk_num, actual_chunks_per_block - 1, notification_credits);
+
+    uint16_t cumulative = sack.cumulative_block;
+    if (cumulative > TOTAL_BLOCKS) {
+        cumulative = TOTAL_BLOCKS;
+    }
+
+    if (!sack_enabled) {
+        /* In ACK mode slots are reused as soon as a block is sent, so blocks the
+         * phone is missing may no longer be buffered. If so, go back once to the
+         * first unacknowledged block and continue windowed from there. */
+        sack_enabled = true;
+        printf("Selective ACK enabled (window: %d blocks)\n", SEND_WINDOW_BLOCKS);
+        if (cumulative > last_acked_block) {
+            last_acked_block = cumulative;
+        }
+        for (uint16_t b = last_acked_block; b < current_block; b++) {
+            if (!block_delivered(b) && !slot_holds(&send_window[b % SEND_WINDOW_BLOCKS], b)) {
+                printf("Selective ACK: resending from block %d\n", last_acked_block);
+                current_block = last_acked_block;
+                current_chunk = 0;
+                waiting_for_ack = false;
+                last_progress_time_ms = now;
+                restart_send_window();
+                return;
+            }
+        }
+    }
+
+    if (cumulative > last_acked_block) {
+        last_acked_block = cumulative;
+        last_progress_time_ms = now;
+        waiting_for_ack = false;
+
+        /* The phone finishes a block before the sender reaches its end when
+         * the remaining chunks were delivered before a disconnect */
+        if (current_block < last_acked_block) {
+            current_block = last_acked_block;
+            current_chunk = 0;
+        }
+    }
+
+    uint8_t entry_count = sack.entry_count;
+    if (entry_count > SACK_MAX_ENTRIES) {
+        entry_count = SACK_MAX_ENTRIES;
+    }
+
+    for (uint8_t e = 0; e < entry_count; e++) {
+        const sack_entry_t *entry = &sack.entries[e];
+        uint16_t block_num = entry->block_number;
+
+        /* Only blocks that are unacknowledged and still buffered can be resent */
+        if (block_num < last_acked_block || block_num > current_block) {
+            continue;
+        }
+        window_slot_t *slot = &send_window[block_num % SEND_WINDOW_BLOCKS];
+        if (!slot_holds(slot, block_num) || slot->chunk_size == 0) {
+            continue;
+        }
+
+        /* Repeat requests within the holdoff are already covered by a resend in flight */
+        if ((now - slot->resent_time_ms) > SACK_RETRANSMIT_HOLDOFF_MS) {
+            memset(slot->resent, 0, sizeof(slot->resent));
+        }
+
+        uint16_t total_chunks = slot->total_chunks;
+        for (uint32_t i = 0; i < SACK_CHUNKS_PER_ENTRY; i++) {
+            uint32_t chunk = (uint32_t)entry->first_chunk + i;
+            if (chunk >= total_chunks || (block_num == current_block && chunk >= current_chunk)) {
+                break;  /* Past the end of the block or not sent yet */
+            }
+            uint32_t word = chunk / 32u;
+            uint32_t bit = 1UL << (chunk % 32u);
+            if ((entry->missing_chunks & (1UL << i)) && !(slot->resent[word] & bit)) {
+                slot->retransmit[word] |= bit;
+            }
+        }
+    }
+}
+
+/**
+ * Queue a resume message from the GATT handler for the data transfer task
+ */
+static void queue_resume(const resume_msg_t *msg)
+{
+    uint32_t irq_state = cyhal_system_critical_section_enter();
+    if (pending_resume_count < RESUME_MAX_MESSAGES) {
+        memcpy(&pending_resume[pending_resume_count], msg, sizeof(resume_msg_t));
+        pending_resume_count++;
+    }
+    resume_pending = true;
+    cyhal_system_critical_section_exit(irq_state);
+}
+
+/**
+ * Apply the resume messages received since the last call and rewind the
+ * window to the first block the phone still needs
+ */
+static void apply_pending_resume(void)
+{
+    resume_msg_t messages[RESUME_MAX_MESSAGES];
+
+    if (!resume_pending) {
+        return;
+    }
+
+    uint32_t irq_state = cyhal_system_critical_section_enter();
+    uint8_t count = pending_resume_count;
+    memcpy(messages, pending_resume, count * sizeof(resume_msg_t));
+    pending_resume_count = 0;
+    resume_pending = false;
+    cyhal_system_critical_section_exit(irq_state);
+
+    for (uint8_t i = 0; i < count; i++) {
+        apply_resume_message(&messages[i]);
+    }
+    rewind_send_window();
+}
+
+/**
+ * Record the blocks and chunks one resume message reports as received
+ * Chunk progress is only kept for a block still buffered and already cut
+ * into the same chunks; anything else is sent whole.
+ */
+static void apply_resume_message(const resume_msg_t *msg)
+{
+    uint16_t cumulative = msg->cumulative_block;
+    if (cumulative > TOTAL_BLOCKS) {
+        cumulative = TOTAL_BLOCKS;
+    }
+    if (cumulative > last_acked_block) {
+        last_acked_block = cumulative;
+    }
+
+    for (uint32_t i = 0; i < RESUME_BLOCKS_PER_MESSAGE; i++) {
+        uint32_t block_num = (uint32_t)cumulative + 1u + i;
+        if (block_num < TOTAL_BLOCKS && (msg->received_blocks & (1UL << i))) {
+            delivered_blocks[block_num / 32u] |= 1UL << (block_num % 32u);
+        }
+    }
+
+    if (msg->entry_count == 0) {
+        return;
+    }
+
+    const sack_entry_t *entry = &msg->entry;
+    uint16_t block_num = entry->block_number;
+    if (block_num < last_acked_block || block_num >= TOTAL_BLOCKS) {
+        return;
+    }
+    window_slot_t *slot = &send_window[block_num % SEND_WINDOW_BLOCKS];
+    if (!slot_holds(slot, block_num) || slot->chunk_size == 0 || msg->chunk_size != slot->chunk_size ||
+        msg->total_chunks != slot->total_chunks) {
+        return;
     }
 
+    uint16_t total_chunks = slot->total_chunks;
+    for (uint32_t chunk = 0; chunk < total_chunks; chunk++) {
+        uint32_t i = chunk - entry->first_chunk;
+        bool received = chunk < entry->first_chunk ||
+                        (i < SACK_CHUNKS_PER_ENTRY && !(entry->missing_chunks & (1UL << i)));
+        if (received) {
+            slot->delivered[chunk / 32u] |= 1UL << (chunk % 32u);
+        }
+    }
+}
+
+/**
+ * Go back to the first block the phone still needs. Blocks still buffered are
+ * kept, so their delivered chunks are skipped; the rest are generated again
+ * (generation is deterministic, so the copies match).
+ */
+static void rewind_send_window(void)
+{
+    current_block = last_acked_block;
+    current_chunk = 0;
+    waiting_for_ack = false;
+    last_progress_time_ms = get_time_ms();
+
+    /* Requests behind the rewind are dropped; the producer may still finish
+     * the one it is working on, which is harmless */
+    if (produce_queue != NULL) {
+        (void)xQueueReset(produce_queue);
+    }
+    next_request_block = current_block;
+    while (next_request_block < TOTAL_BLOCKS && next_request_block < current_block + SEND_WINDOW_BLOCKS) {
+        window_slot_t *slot = &send_window[next_request_block % SEND_WINDOW_BLOCKS];
+        if (slot_holds(slot, next_request_block)) {
+            /* Resend requests from before the disconnect are superseded */
+            memset(slot->retransmit, 0, sizeof(slot->retransmit));
+
+            /* Chunks too big for the new link: cut the block again, and send it whole */
+            if (slot->chunk_size > actual_chunk_size) {
+                unframe_block(slot);  /* Needs the old cut, so before it is cleared */
+                slot->chunk_size = 0;
+                memset(slot->delivered, 0, sizeof(slot->delivered));
+            }
+        } else if (!block_delivered(next_request_block)) {
+            break;
+        }
+        next_request_block++;
+    }
+
+    printf("Resuming from Block %d (next %d blocks ready)\n",
+           current_block, next_request_block - current_block);
+}
+
+/**
+ * Move on to the next block once every chunk of the current one is sent
+ */
+static void finish_block(void)
+{
+    current_chunk = 0;
+    current_block++;
+    stats.blocks_sent++;
+
+    if ((current_block % 100) == 0) {
+        /* Print progress every 100 blocks */
+        uint32_t elapsed = get_time_ms() - stats.start_time_ms;
+        uint32_t rate_kbps = 0;
+        if (elapsed > 0) {
+            rate_kbps = (uint32_t)(((uint64_t)stats.total_bytes * 8u) / elapsed);
+        }
+        APP_LOG("Progress: %d/%d blocks (%lu%%) | Rate: %lu Kbps\n",
+                current_block, TOTAL_BLOCKS,
+                ((uint32_t)current_block * 100u) / TOTAL_BLOCKS,
+                rate_kbps);
+    }
+}
+
+/**
+ * Check whether the phone reported a block as received when it resumed
+ */
+static bool block_delivered(uint16_t block_num)
+{
+    return block_num >= last_acked_block &&
+           (delivered_blocks[block_num / 32u] & (1UL << (block_num % 32u))) != 0;
+}
+
+/**
+ * Check whether the phone reported a chunk of a buffered block as received
+ */
+static bool chunk_delivered(const window_slot_t *slot, uint16_t chunk_num)
+{
+    return (slot->delivered[chunk_num / 32u] & (1UL << (chunk_num % 32u))) != 0;
+}
+
+/**
+ * Resend the oldest chunk queued for retransmission
+ * @return true if a chunk was queued (sent or retried later), false if none
+ */
+static bool send_next_retransmit(void)
+{
+    for (uint32_t block_num = last_acked_block;
+         block_num <= current_block && block_num < TOTAL_BLOCKS; block_num++) {
+        window_slot_t *slot = &send_window[block_num % SEND_WINDOW_BLOCKS];
+        if (!slot_holds(slot, block_num)) {
+            continue;
+        }
+
+        for (uint32_t word = 0; word < CHUNK_BITMAP_WORDS; word++) {
+            if (slot->retransmit[word] == 0) {
+                continue;
+            }
+
+            uint32_t bit_index = (uint32_t)__builtin_ctz(slot->retransmit[word]);
+            uint16_t chunk = (uint16_t)(word * 32u + bit_index);
+            if (!send_chunk((uint16_t)block_num, chunk, false)) {
+                return true;  /* Congested - retry after delay */
+            }
+
+            slot->retransmit[word] &= ~(1UL << bit_index);
+            slot->resent[word] |= 1UL << bit_index;
+            slot->resent_time_ms = get_time_ms();
+            stats.retransmits++;
+            stats.total_chunks++;
+            stats.total_bytes += actual_chunk_size;  /* Approximate */
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * Window stalled with no SACK for a while (last chunk or SACK lost):
+ * resend the oldest block's last chunk so the phone answers with a fresh SACK
+ */
+static void probe_if_stalled(void)
+{
+    uint32_t now = get_time_ms();
+    if ((now - last_progress_time_ms) < SACK_PROBE_TIMEOUT_MS || last_acked_block >= TOTAL_BLOCKS) {
+        return;
+    }
+    last_progress_time_ms = now;
+
+    window_slot_t *slot = &send_window[last_acked_block % SEND_WINDOW_BLOCKS];
+    if (!slot_holds(slot, last_acked_block) || slot->chunk_size == 0) {
+        return;
+    }
+
+    uint16_t last_chunk = slot->total_chunks - 1;
+    memset(slot->resent, 0, sizeof(slot->resent));
+    slot->retransmit[last_chunk / 32u] |= 1UL << (last_chunk % 32u);
+}
+
+/**
+ * Send a chunk via GATT notification
+ * @param pack_next Chunk 0 of the next block follows in the same notification
+ *                  (pack_next_block)
+ */
+static bool send_chunk(uint16_t block_num, uint16_t chunk_num, bool pack_next)
+{
+    /* Check if we have credits to send (flow control to prevent buffer overflow).
+     * Running out is the normal steady state: the sender sleeps until a
+     * notification is transmitted. */
+    if (notifications_in_flight >= notification_credit_limit) {
+        return false;
+    }
+
+    const window_slot_t *slot = &send_window[block_num % SEND_WINDOW_BLOCKS];
+    uint16_t this_chunk_size = chunk_payload_size(slot, chunk_num);
+
+    /* The stack keeps the pointer until the notification is transmitted;
+     * GATT_APP_BUFFER_TRANSMITTED_EVT then calls the context, which returns
+     * the credit. A framed block is sent in place and pinned in its slot
+     * until then. Anything else (two records in one notification, or a block
+     * too finely cut to frame) is copied into a pool buffer; an empty pool
+     * blocks the sender like running out of credits. */
+    uint8_t *packet;
+    uint16_t packet_size;
+    pfn_free_buffer_t on_transmitted;
+
+    if (slot->frame_header_size != 0 && !pack_next) {
+        packet = (uint8_t *)chunk_data(slot, chunk_num) - slot->frame_header_size;
+        packet_size = slot->frame_header_size + this_chunk_size;
+        on_transmitted = framed_notification_transmitted;
+    } else {
+        packet = app_buffer_pool_alloc(notification_size);
+        if (packet == NULL) {
+            return false;
+        }
+        packet_size = put_chunk(packet, block_num, chunk_num, pack_next);
+        if (pack_next) {
+            packet_size += put_chunk(packet + packet_size, block_num + 1, 0, false);
+        }
+        on_transmitted = copied_notification_transmitted;
+    }
+
+    /* Counted before the send: the stack may report the transmission before it returns */
+    uint32_t irq_state = cyhal_system_critical_section_enter();
+    notifications_in_flight++;
+    if (on_transmitted == framed_notification_transmitted) {
+        send_window[block_num % SEND_WINDOW_BLOCKS].in_flight++;
+    }
+    cyhal_system_critical_section_exit(irq_state);
+
+    uint32_t now = get_time_ms();
+
     wiced_bt_gatt_status_t status = wiced_bt_gatt_server_send_notification(
         connection_id,
         HDLC_DATA_TRANSFER_SERVICE_DATA_BLOCK_VALUE,
         packet_size,
         packet,
-        NULL
+        (wiced_bt_gatt_app_context_t)on_transmitted
     );
 
     if (status != WICED_BT_GATT_SUCCESS) {
-        /* Track failure */
-        consecutive_send_failures++;
-        consecutive_send_successes = 0;
+        /* Track failure; the stack did not take the buffer, so release it
+         * here without waking the sender */
+        irq_state = cyhal_system_critical_section_enter();
+        notifications_in_flight--;
+        if (on_transmitted == framed_notification_transmitted) {
+            send_window[block_num % SEND_WINDOW_BLOCKS].in_flight--;
+        } else {
+            app_buffer_pool_free(packet);
+        }
+        cyhal_system_critical_section_exit(irq_state);
         stats.send_failures++;
+        app_telemetry_record(TELEMETRY_EVENT_SEND, block_num, chunk_num, this_chunk_size, (uint8_t)status,
+                             free_credits(), (uint8_t)app_data_transfer_get_wait_ms());
 
         /* Log failures for first 5 blocks */
         if (block_num < 5) {
-            printf("[%lu ms] FAILED to send B%d C%d - status=0x%x (credits=%d)\n",
-                   now, block_num, chunk_num, status, notification_credits);
+            APP_LOG("FAILED to send B%d C%d - status=0x%x (in flight=%d)\n",
+                    block_num, chunk_num, status, notifications_in_flight);
         }
 
         if (status == WICED_BT_GATT_CONGESTED) {
-            /* Stack is congested - adapt delay with granular additive backoff */
-            if (consecutive_send_failures >= CONGESTION_THRESHOLD) {
-                uint16_t old_delay = current_delay_ms;
-                current_delay_ms = current_delay_ms + BACKOFF_INCREMENT;
-                if (current_delay_ms > MAX_DELAY_MS) {
-                    current_delay_ms = MAX_DELAY_MS;
-                }
-
-                /* Report congestion (throttled to avoid flooding console) */
-                if ((now - last_congestion_report_time) > CONGESTION_REPORT_INTERVAL_MS) {
-                    stats.congestion_events++;
-                    printf("[%lu ms] WARNING: BLE congestion detected! ", now);
-                    printf("Backing off: %d ms -> %d ms (failures: %d)\n",
-                           old_delay, current_delay_ms, consecutive_send_failures);
-                    last_congestion_report_time = now;
-                }
+            /* Stack buffers are full even with credits left (e.g. other
+             * notifications queued): wait for the next TX-complete event */
+            if ((now - last_congestion_report_time) > CONGESTION_REPORT_INTERVAL_MS) {
+                stats.congestion_events++;
+                APP_LOG("WARNING: BLE congestion detected (in flight=%d/%d)\n",
+                        notifications_in_flight, notification_credit_limit);
+                last_congestion_report_time = now;
             }
             return false;
         } else {
-            printf("[%lu ms] ERROR: send_notification B%d C%d returned status 0x%x\n",
-                   now, block_num, chunk_num, status);
+            APP_LOG("ERROR: send_notification B%d C%d returned status 0x%x\n",
+                    block_num, chunk_num, status);
             return false;
         }
     }
 
-    /* Send successful - decrement credits and track stats */
-    notification_credits--;
+    /* Send successful - track stats */
     notifications_queued++;
-    consecutive_send_successes++;
-    consecutive_send_failures = 0;
+    sender_blocked = false;
+    app_telemetry_record(TELEMETRY_EVENT_SEND, block_num, chunk_num, this_chunk_size, WICED_BT_GATT_SUCCESS,
+                         free_credits(), (uint8_t)app_data_transfer_get_wait_ms());
+    if (pack_next) {
+        const window_slot_t *next_slot = &send_window[(block_num + 1) % SEND_WINDOW_BLOCKS];
+        app_telemetry_record(TELEMETRY_EVENT_SEND, block_num + 1, 0, chunk_payload_size(next_slot, 0),
+                             WICED_BT_GATT_SUCCESS, free_credits(), (uint8_t)app_data_transfer_get_wait_ms());
+    }
+
+    return true;
+}
+
+/**
+ * Write one chunk of a buffered block into a notification buffer, behind a
+ * chunk header or, with packed framing, a packed record header
+ * @param more Another record follows in the same notification (packed framing)
+ * @return Bytes written
+ */
+static uint16_t put_chunk(uint8_t *buffer, uint16_t block_num, uint16_t chunk_num, bool more)
+{
+    const window_slot_t *slot = &send_window[block_num % SEND_WINDOW_BLOCKS];
+    uint16_t header_size = put_header(buffer, block_num, chunk_num, more);
+    uint16_t this_chunk_size = chunk_payload_size(slot, chunk_num);
+
+    memcpy(buffer + header_size, chunk_data(slot, chunk_num), this_chunk_size);
+    return header_size + this_chunk_size;
+}
 
-    /* Gradually speed up if we're having sustained success */
-    if (consecutive_send_successes >= SUCCESS_THRESHOLD && current_delay_ms > MIN_DELAY_MS) {
-        current_delay_ms -= SPEEDUP_DECREMENT;
-        if (current_delay_ms < MIN_DELAY_MS) {
-            current_delay_ms = MIN_DELAY_MS;
+/**
+ * Write the chunk header or packed record header (with its length if more)
+ * for one chunk of a buffered block
+ * @return Bytes written
+ */
+static uint16_t put_header(uint8_t *buffer, uint16_t block_num, uint16_t chunk_num, bool more)
+{
+    const window_slot_t *slot = &send_window[block_num % SEND_WINDOW_BLOCKS];
+    uint32_t offset = chunk_offset(slot, chunk_num);
+    uint16_t this_chunk_size = chunk_payload_size(slot, chunk_num);
+    uint16_t header_size;
+
+    if (packed_framing) {
+        packed_record_header_t *record = (packed_record_header_t *)buffer;
+        record->block_word = (uint16_t)(PACKED_RECORD_MARKER | (slot->codec << PACKED_RECORD_CODEC_SHIFT) | block_num);
+        record->chunk_word = (uint16_t)(chunk_num | (more ? PACKED_RECORD_MORE : 0u));
+        record->total_chunks = slot->total_chunks;
+        record->chunk_offset = (uint16_t)offset;
+        header_size = sizeof(packed_record_header_t);
+
+        /* Only a record with another one behind it needs its length */
+        if (more) {
+            buffer[header_size] = (uint8_t)this_chunk_size;
+            buffer[header_size + 1] = (uint8_t)(this_chunk_size >> 8);
+            header_size += PACKED_RECORD_LENGTH_SIZE;
         }
-        consecutive_send_successes = 0;  /* Reset counter */
+    } else {
+        chunk_header_t *header = (chunk_header_t *)buffer;
+        header->block_number = block_num;
+        header->chunk_number = chunk_num;
+        header->chunk_size = this_chunk_size;
+        header->total_chunks = slot->total_chunks;
+        header->block_size_total = (uint16_t)slot->size;
+        header->flags = slot->codec;  /* Chosen per block by the producer */
+        header->reserved = 0;
+        header_size = sizeof(chunk_header_t);
     }
 
-    return true;
+    return header_size;
 }
 
 /**
- * Get recommended delay based on current congestion
+ * Notification credits not currently in use
  */
-uint16_t app_data_transfer_get_recommended_delay(void)
+static uint8_t free_credits(void)
 {
-    return current_delay_ms;
+    uint16_t in_flight = notifications_in_flight;
+    uint16_t limit = notification_credit_limit;
+    return (in_flight < limit) ? (uint8_t)(limit - in_flight) : 0;
+}
+
+/**
+ * Return all credits and go back to default link parameters
+ * until the next connection reports its own
+ */
+static void reset_flow_control(void)
+{
+    /* The stack drops what was queued on a lost link: nothing stays pinned */
+    uint32_t irq_state = cyhal_system_critical_section_enter();
+    notifications_in_flight = 0;
+    for (uint32_t i = 0; i < SEND_WINDOW_BLOCKS; i++) {
+        send_window[i].in_flight = 0;
+    }
+    cyhal_system_critical_section_exit(irq_state);
+    sender_blocked = false;
+    conn_interval_units = DEFAULT_CONN_INTERVAL;
+    ll_max_tx_octets = DEFAULT_LL_TX_OCTETS;
+    ll_max_tx_time_us = DEFAULT_LL_TX_TIME_US;
+    ll_empty_pdu_us = LL_EMPTY_PDU_1M_US;
+    update_notification_credits();
+}
+
+/**
+ * Get how long the sender may sleep before the next call
+ */
+uint32_t app_data_transfer_get_wait_ms(void)
+{
+    return sender_blocked ? FLOW_CONTROL_WAIT_MS : 0;
+}
+
+/**
+ * Wake the sender task
+ */
+static void wake_sender(uint32_t event)
+{
+    if (data_transfer_task_handle != NULL) {
+        (void)xTaskNotify(data_transfer_task_handle, event, eSetBits);
+    }
 }
 
 /**
@@ -799,18 +1794,22 @@ static void reset_transfer_state(void)
     current_chunk = 0;
     last_acked_block = 0;
     waiting_for_ack = false;
+    sack_enabled = false;
+    sack_pending = false;
+    resume_pending = false;
+    pending_resume_count = 0;
+    memset(delivered_blocks, 0, sizeof(delivered_blocks));
+    last_progress_time_ms = 0;
+    restart_send_window();
     memset(&stats, 0, sizeof(stats));
 
     /* Reset congestion tracking */
-    consecutive_send_failures = 0;
-    consecutive_send_successes = 0;
-    current_delay_ms = INITIAL_DELAY_MS;
     last_congestion_report_time = 0;
 
     /* Reset flow control credits */
-    notification_credits = MAX_NOTIFICATIONS_IN_FLIGHT;
     notifications_queued = 0;
     notifications_transmitted = 0;
+    reset_flow_control();
 }
 
 /**
@@ -825,16 +1824,52 @@ static uint32_t get_time_ms(void)
 }
 
 /**
- * Notification transmission complete callback
- * Called from GATT event handler when a notification has been transmitted
+ * Context of a notification sent in place from a framed slot: unpin the slot
+ */
+static void framed_notification_transmitted(uint8_t *p_buf)
+{
+    uint32_t irq_state = cyhal_system_critical_section_enter();
+    for (uint32_t i = 0; i < SEND_WINDOW_BLOCKS; i++) {
+        window_slot_t *slot = &send_window[i];
+        if (p_buf >= slot->data && p_buf < slot->data + sizeof(slot->data)) {
+            if (slot->in_flight > 0) {
+                slot->in_flight--;
+            }
+            break;
+        }
+    }
+    cyhal_system_critical_section_exit(irq_state);
+
+    notification_transmitted();
+}
+
+/**
+ * Context of a notification copied into a pool buffer: free the buffer
  */
-void app_data_transfer_notification_sent(void)
+static void copied_notification_transmitted(uint8_t *p_buf)
 {
-    /* Increment credits - a notification slot is now available */
-    if (notification_credits < MAX_NOTIFICATIONS_IN_FLIGHT) {
-        notification_credits++;
+    app_buffer_pool_free(p_buf);
+    notification_transmitted();
+}
+
+/**
+ * A data notification has been transmitted (GATT_APP_BUFFER_TRANSMITTED_EVT,
+ * through its context): return its credit and wake the sender
+ */
+static void notification_transmitted(void)
+{
+    /* Return the credit - a notification slot is now available */
+    uint32_t irq_state = cyhal_system_critical_section_enter();
+    if (notifications_in_flight > 0) {
+        notifications_in_flight--;
         notifications_transmitted++;
     }
+    cyhal_system_critical_section_exit(irq_state);
+
+    app_telemetry_record(TELEMETRY_EVENT_TX_COMPLETE, TELEMETRY_NO_BLOCK, TELEMETRY_NO_BLOCK, 0,
+                         WICED_BT_GATT_SUCCESS, free_credits(), (uint8_t)app_data_transfer_get_wait_ms());
+
+    wake_sender(DATA_TASK_NOTIFY_TX_COMPLETE);
 }
 
 #if BENCHMARK_MODE_ENABLED
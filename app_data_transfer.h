@@ -12,6 +12,8 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include "wiced_bt_gatt.h"
+#include "app_telemetry.h"
+#include "psoc_driver/wire_format.h"
 
 /*******************************************************************************
  *        Constants
@@ -24,15 +26,50 @@
 #define CHUNK_SIZE                  (244u)      /* Max chunk size per notification (MTU-3 for ATT overhead) */
 #define CHUNKS_PER_BLOCK            ((BLOCK_SIZE_MAX + CHUNK_SIZE - 1) / CHUNK_SIZE)  /* ~30 chunks per block */
 #define ACK_INTERVAL                (20u)       /* Send ACK every 20 blocks */
+#define MAX_CHUNKS_PER_BLOCK        (BLOCK_SIZE_MAX / 8u)  /* Chunks per block at the minimum MTU (8-byte payload) */
+
+/* Selective ACK configuration (used once the phone sends CTRL_CMD_SACK).
+ * SEND_WINDOW_BLOCKS and the SACK_* message limits are in wire_format.h. */
+#define SACK_RETRANSMIT_HOLDOFF_MS  (100u)      /* Ignore repeat requests for a chunk resent this recently */
+#define SACK_PROBE_TIMEOUT_MS       (250u)      /* Window stalled this long: resend a chunk to prompt a SACK */
+
+/* Packed framing (phone sets START_FLAG_PACKED_FRAMING): records instead of
+ * chunk headers, so a block's last chunk and the next block's first can share
+ * a notification (wire_format.h) */
+#define PACKED_MIN_HEAD_SIZE        (16u)       /* Smallest first chunk worth packing behind the previous block */
+
+/* Flow control: notifications queued in the BLE stack at once, sized from the
+ * link so the controller can fill a whole connection event */
+#define NOTIFICATION_CREDITS_MIN    (2u)
+#define NOTIFICATION_CREDITS_MAX    (16u)       /* Framed blocks are sent in place, so credits cost no buffers */
+#define FLOW_CONTROL_WAIT_MS        (20u)       /* Max sleep while blocked; wake-ups normally come from events */
+
+/* Notifications go out straight from the send window: a block is laid out
+ * with room for a header in front of each chunk when it is cut. Blocks cut
+ * finer than this (MTU below ~130) are copied into pool buffers instead. */
+#define FRAMED_CHUNKS_MAX           (64u)
+
+/* Task notification bits set on the sender task (data_transfer_task) */
+#define DATA_TASK_NOTIFY_TX_COMPLETE    (1UL << 1)  /* Notification transmitted, credit returned */
+#define DATA_TASK_NOTIFY_CONTROL        (1UL << 2)  /* Command, ACK or SACK received */
+#define DATA_TASK_NOTIFY_BLOCK_READY    (1UL << 3)  /* Producer finished a block */
+#define DATA_TASK_NOTIFY_TRANSFER_EVENTS \
+    (DATA_TASK_NOTIFY_TX_COMPLETE | DATA_TASK_NOTIFY_CONTROL | DATA_TASK_NOTIFY_BLOCK_READY)
 
 /* Benchmark test configuration */
 #define BENCHMARK_MODE_ENABLED      (0)         /* Disabled - uncompressed mode only for demo */
 #define BENCHMARK_UNCOMPRESSED_DURATION_MS  (120000u)  /* 2 minutes in uncompressed mode */
 
 /* Compression configuration */
-#define USE_COMPRESSION             (0)         /* Enable waveform compression (disabled for now) */
+#define USE_COMPRESSION             (1)         /* Choose raw or Rice per block (see CODEC_* below) */
 #define USE_PRECOMPRESSED_DATA      (1)         /* Use pre-compressed static waveform for benchmark */
 
+/* Adaptive codec selection: a block is compressed when it comes out smaller
+ * and encoding it takes less time than the radio needs to send it, so the
+ * producer stays ahead of the sender. Otherwise it goes out raw. */
+#define CODEC_PROBE_INTERVAL        (16u)       /* Re-measure compression after this many raw blocks */
+#define CODEC_EWMA_SHIFT            (3u)        /* Estimates move 1/8 of the way per measurement */
+
 /* Transfer modes */
 typedef enum {
     TRANSFER_MODE_UNCOMPRESSED,     /* Send uncompressed 7KB blocks */
@@ -43,8 +80,13 @@ typedef enum {
 #define CTRL_CMD_START              (0x01)      /* Start transfer command */
 #define CTRL_CMD_STOP               (0x02)      /* Stop transfer command */
 #define CTRL_CMD_ACK                (0x03)      /* Acknowledgment */
-#define CTRL_CMD_REQUEST_RESUME     (0x04)      /* Request resume info */
+#define CTRL_CMD_REQUEST_RESUME     (0x04)      /* Resume after reconnecting (resume_msg_t) */
 #define CTRL_CMD_RESUME_RESPONSE    (0x05)      /* Resume response */
+#define CTRL_CMD_SACK               (0x06)      /* Selective ACK (sack_msg_t) */
+
+/* Block codecs (BLOCK_CODEC_*), the start command's flags byte
+ * (START_FLAGS_OFFSET, START_FLAG_*) and the SACK and resume messages
+ * (sack_msg_t, resume_msg_t) are defined in wire_format.h */
 
 /* Transfer states */
 typedef enum {
@@ -55,17 +97,40 @@ typedef enum {
     TRANSFER_STATE_COMPLETE
 } transfer_state_t;
 
-/* Data chunk header structure (prepended to each notification) */
+/* Data chunk header structure (prepended to each notification without packed framing) */
 typedef struct __attribute__((packed)) {
     uint16_t block_number;      /* Current block number (0-1799) */
     uint16_t chunk_number;      /* Chunk within block (0-29) */
     uint16_t chunk_size;        /* Size of data in this chunk */
     uint16_t total_chunks;      /* Total chunks in this block */
     uint16_t block_size_total;  /* Total size of this block (compressed) */
-    uint8_t  flags;             /* Bit 0: compressed (1) or raw (0) */
+    uint8_t  flags;             /* Bits 0-3: BLOCK_CODEC_* */
     uint8_t  reserved;          /* Reserved for future use */
 } chunk_header_t;
 
+PSOC_WIRE_CHECK_SIZE(chunk_header_t, CHUNK_HEADER_SIZE);
+PSOC_WIRE_CHECK_FIELD(chunk_header_t, block_number, CHUNK_HDR_BLOCK_NUMBER);
+PSOC_WIRE_CHECK_FIELD(chunk_header_t, chunk_number, CHUNK_HDR_CHUNK_NUMBER);
+PSOC_WIRE_CHECK_FIELD(chunk_header_t, chunk_size, CHUNK_HDR_CHUNK_SIZE);
+PSOC_WIRE_CHECK_FIELD(chunk_header_t, total_chunks, CHUNK_HDR_TOTAL_CHUNKS);
+PSOC_WIRE_CHECK_FIELD(chunk_header_t, block_size_total, CHUNK_HDR_BLOCK_SIZE_TOTAL);
+PSOC_WIRE_CHECK_FIELD(chunk_header_t, flags, CHUNK_HDR_FLAGS);
+PSOC_WIRE_CHECK_FIELD(chunk_header_t, reserved, CHUNK_HDR_RESERVED);
+
+/* Packed framing record header (one or more per notification) */
+typedef struct __attribute__((packed)) {
+    uint16_t block_word;        /* PACKED_RECORD_MARKER | codec << 11 | block number */
+    uint16_t chunk_word;        /* PACKED_RECORD_MORE if another record follows | chunk number */
+    uint16_t total_chunks;      /* Total chunks in this block */
+    uint16_t chunk_offset;      /* Byte offset of this chunk in the block */
+} packed_record_header_t;
+
+PSOC_WIRE_CHECK_SIZE(packed_record_header_t, PACKED_RECORD_HEADER_SIZE);
+PSOC_WIRE_CHECK_FIELD(packed_record_header_t, block_word, PACKED_HDR_BLOCK_WORD);
+PSOC_WIRE_CHECK_FIELD(packed_record_header_t, chunk_word, PACKED_HDR_CHUNK_WORD);
+PSOC_WIRE_CHECK_FIELD(packed_record_header_t, total_chunks, PACKED_HDR_TOTAL_CHUNKS);
+PSOC_WIRE_CHECK_FIELD(packed_record_header_t, chunk_offset, PACKED_HDR_CHUNK_OFFSET);
+
 /* Control message structure */
 typedef struct __attribute__((packed)) {
     uint8_t command;            /* Command type */
@@ -84,6 +149,7 @@ typedef struct {
     uint32_t disconnections;    /* Number of disconnections during transfer */
     uint32_t congestion_events; /* Number of times congestion detected */
     uint32_t send_failures;     /* Total send failures */
+    uint16_t compressed_blocks; /* Blocks sent with a compressing codec */
 } transfer_stats_t;
 
 /* Per-mode statistics for benchmark comparison */
@@ -106,12 +172,20 @@ typedef struct {
  */
 void app_data_transfer_init(void);
 
+/**
+ * Create the background task that generates blocks ahead of the sender
+ * Call once before the scheduler starts.
+ * @return true if created successfully
+ */
+bool app_data_transfer_create_producer(void);
+
 /**
  * Start data transfer
  * @param conn_id Connection ID
+ * @param start_flags START_FLAG_* from the start command (0 if none)
  * @return true if started successfully
  */
-bool app_data_transfer_start(uint16_t conn_id);
+bool app_data_transfer_start(uint16_t conn_id, uint8_t start_flags);
 
 /**
  * Stop data transfer
@@ -123,8 +197,19 @@ void app_data_transfer_stop(void);
  */
 void app_data_transfer_pause(void);
 
+/**
+ * Generate the first blocks of a transfer ahead of the start command
+ * Fills the send window while advertising or connecting, so the first chunk
+ * goes out as soon as the phone starts the transfer. Does nothing unless the
+ * transfer is idle. app_data_transfer_start() uses the pre-staged blocks.
+ */
+void app_data_transfer_prestage(void);
+
 /**
  * Resume data transfer (on reconnection)
+ * Continues from the first block the phone still needs, keeping the blocks
+ * still buffered in the send window. Called for CTRL_CMD_REQUEST_RESUME, whose
+ * resume_msg_t lists the blocks and chunks that are then skipped.
  * @param conn_id Connection ID
  * @return true if resumed successfully
  */
@@ -156,6 +241,12 @@ void app_data_transfer_cccd_write_handler(uint16_t conn_id, bool notifications_e
  */
 const transfer_stats_t* app_data_transfer_get_stats(void);
 
+/**
+ * Summarize recent sends, TX-completes and credits (Telemetry characteristic)
+ * @param summary Output summary
+ */
+void app_data_transfer_get_telemetry(telemetry_summary_t *summary);
+
 /**
  * Get current transfer state
  * @return Current state
@@ -169,21 +260,40 @@ void app_data_transfer_print_stats(void);
 
 /**
  * Set MTU for data transfer (called after MTU exchange)
+ * Chunk payloads are sized from the MTU and the LL data length together.
  * @param mtu Negotiated MTU value
  */
 void app_data_transfer_set_mtu(uint16_t mtu);
 
 /**
- * Get recommended delay in milliseconds based on current congestion
- * @return Recommended delay in milliseconds
+ * Set connection interval (called on connection parameter update)
+ * @param conn_interval Connection interval in 1.25 ms units
+ */
+void app_data_transfer_set_conn_interval(uint16_t conn_interval);
+
+/**
+ * Set link layer data length (called on data length update)
+ * Notifications are trimmed to whole LL PDUs when that carries more data per PDU.
+ * @param max_tx_octets Negotiated max TX payload per LL PDU
+ * @param max_tx_time_us Negotiated max TX time per LL PDU in microseconds
+ */
+void app_data_transfer_set_data_length(uint16_t max_tx_octets, uint16_t max_tx_time_us);
+
+/**
+ * Set the PHY the central transmits on (called on PHY update)
+ * Its empty PDUs take part of every connection event.
+ * @param rx_phy 1 = LE 1M, 2 = LE 2M
  */
-uint16_t app_data_transfer_get_recommended_delay(void);
+void app_data_transfer_set_phy(uint8_t rx_phy);
 
 /**
- * Notification transmission complete callback
- * Called when a notification has been successfully transmitted
+ * Get how long the sender task may sleep before the next
+ * app_data_transfer_process_next_chunk() call
+ * Non-zero only while the sender is blocked (out of credits, window full or
+ * waiting for the producer); the sleep is cut short by DATA_TASK_NOTIFY_* events.
+ * @return Maximum sleep in milliseconds, 0 to call again immediately
  */
-void app_data_transfer_notification_sent(void);
+uint32_t app_data_transfer_get_wait_ms(void);
 
 /**
  * Get current transfer mode
@@ -0,0 +1,487 @@
+/*******************************************************************************
+ * File Name: app_link_tuner.c
+ *
+ * Description: This file implements connection parameter tuning: interval
+ *              probing against measured throughput, PHY and data length
+ *              retries, and peripheral latency while idle.
+ *
+ *******************************************************************************/
+
+#include "app_link_tuner.h"
+#include "app_data_transfer.h"
+#include "app_telemetry.h"
+#include "wiced_bt_ble.h"
+#include "wiced_bt_l2c.h"
+#include "cyhal.h"
+#include "stdio.h"
+#include <string.h>
+#include <FreeRTOS.h>
+#include <task.h>
+
+/*******************************************************************************
+ *        Global Variables
+ *******************************************************************************/
+
+typedef enum {
+    TUNER_DISCONNECTED,
+    TUNER_PROBING,          /* Trying each candidate interval in turn */
+    TUNER_CONVERGED         /* Holding the best one, watching for a drop */
+} tuner_phase_t;
+
+static const uint16_t candidate_intervals[LINK_TUNER_INTERVAL_COUNT] = LINK_TUNER_INTERVALS;
+
+/* Link state. The connection and update handlers run in the stack's context
+ * and only post the result; app_link_tuner_poll() (data transfer task) acts on it. */
+static tuner_phase_t phase = TUNER_DISCONNECTED;
+static wiced_bt_device_address_t peer_addr;     /* Poll's copy of link_addr, taken with connect_event */
+static volatile uint16_t granted_interval = 0;
+static volatile uint16_t granted_latency = 0;
+static volatile bool update_event = false;      /* Parameter update (applied or declined) not yet seen by poll */
+static volatile bool connect_event = false;     /* Connection not yet seen by poll */
+static volatile bool link_up = false;           /* Cleared by the disconnect handler */
+
+/* Stack context only: PHY and data length requests */
+static wiced_bt_device_address_t link_addr;
+static uint8_t phy_retries = 0;
+static uint8_t data_length_retries = 0;
+
+/* Outstanding connection parameter request */
+static bool request_pending = false;
+static uint32_t request_time_ms = 0;
+static uint16_t requested_latency = 0;
+static bool idle_latency_declined = false;     /* Central refused latency once; don't ask again */
+static uint32_t idle_since_ms = 0;
+
+/* Probing */
+static uint8_t tried_candidates = 0;            /* Bit i = candidate_intervals[i] requested or measured */
+static uint16_t best_interval = 0;
+static uint32_t best_rate = 0;                  /* Bytes per second at best_interval */
+static uint8_t low_windows = 0;
+
+/* Measurement window: LINK_TUNER_SETTLE_MS, then LINK_TUNER_MEASURE_MS */
+static bool window_open = false;
+static bool measuring = false;
+static uint32_t window_start_ms = 0;
+static telemetry_counters_t window_start;
+
+/* Best interval of recently tuned centrals, oldest overwritten */
+typedef struct {
+    wiced_bt_device_address_t bd_addr;
+    uint16_t interval;
+} peer_entry_t;
+
+static peer_entry_t peer_cache[LINK_TUNER_PEER_CACHE_SIZE];
+static uint8_t peer_cache_next = 0;
+
+/*******************************************************************************
+ *        Forward Declarations
+ *******************************************************************************/
+static void start_link(void);
+static void request_conn_params(uint16_t interval, uint16_t latency);
+static void request_phy(void);
+static void request_data_length(void);
+static void finish_window(uint32_t now);
+static void probe_next_candidate(void);
+static void mark_tried(uint16_t interval);
+static uint16_t cached_interval(void);
+static void cache_interval(uint16_t interval);
+static uint32_t get_time_ms(void);
+
+/*******************************************************************************
+ *        Function Implementations
+ *******************************************************************************/
+
+/**
+ * A central connected: ask for 2M PHY and the longest data length, post the
+ * link for the tuner
+ */
+void app_link_tuner_connected(const wiced_bt_device_address_t bd_addr)
+{
+    wiced_bt_ble_conn_params_t conn_params;
+    uint16_t interval = 0;
+    uint16_t latency = 0;
+
+    memcpy(link_addr, bd_addr, BD_ADDR_LEN);
+    if (wiced_bt_ble_get_connection_parameters(link_addr, &conn_params) == WICED_BT_SUCCESS) {
+        interval = conn_params.conn_interval;
+        latency = conn_params.conn_latency;
+        app_data_transfer_set_conn_interval(conn_params.conn_interval);
+    }
+
+    uint32_t irq_state = cyhal_system_critical_section_enter();
+    granted_interval = interval;
+    granted_latency = latency;
+    update_event = false;
+    connect_event = true;
+    link_up = true;
+    cyhal_system_critical_section_exit(irq_state);
+
+    phy_retries = 0;
+    data_length_retries = 0;
+    request_phy();
+    request_data_length();
+}
+
+/**
+ * The central disconnected: post it, poll forgets the link
+ */
+void app_link_tuner_disconnected(void)
+{
+    uint32_t irq_state = cyhal_system_critical_section_enter();
+    link_up = false;
+    connect_event = false;
+    cyhal_system_critical_section_exit(irq_state);
+}
+
+/**
+ * Connection parameter update: pass the interval on for pacing, post the
+ * result for the tuner
+ */
+void app_link_tuner_conn_params_updated(uint8_t status, uint16_t conn_interval, uint16_t conn_latency)
+{
+    if (status == 0) {
+        app_data_transfer_set_conn_interval(conn_interval);
+    }
+
+    uint32_t irq_state = cyhal_system_critical_section_enter();
+    if (status == 0) {
+        granted_interval = conn_interval;
+        granted_latency = conn_latency;
+    }
+    update_event = true;
+    cyhal_system_critical_section_exit(irq_state);
+}
+
+/**
+ * PHY update: pace for the new PHY, ask again once if 2M was declined
+ */
+void app_link_tuner_phy_updated(uint8_t status, uint8_t tx_phy, uint8_t rx_phy)
+{
+    if (status == 0) {
+        app_data_transfer_set_phy(rx_phy);
+    }
+    if ((status != 0 || tx_phy != 2) && link_up && phy_retries < LINK_TUNER_MAX_RETRIES) {
+        phy_retries++;
+        request_phy();
+    }
+}
+
+/**
+ * Data length update: size chunks and credits, ask again once if the
+ * central settled on less than the full LL payload
+ */
+void app_link_tuner_data_length_updated(uint16_t max_tx_octets, uint16_t max_tx_time_us)
+{
+    app_data_transfer_set_data_length(max_tx_octets, max_tx_time_us);
+
+    if (max_tx_octets < LINK_TUNER_DATA_LENGTH && link_up &&
+        data_length_retries < LINK_TUNER_MAX_RETRIES) {
+        data_length_retries++;
+        request_data_length();
+    }
+}
+
+/**
+ * Measure and move on
+ * Latency only changes while no transfer runs, and intervals are only
+ * judged while one does, so the two never overlap in a window.
+ */
+void app_link_tuner_poll(void)
+{
+    uint32_t irq_state = cyhal_system_critical_section_enter();
+    bool connected = connect_event;
+    bool up = link_up;
+    connect_event = false;
+    if (connected) {
+        memcpy(peer_addr, link_addr, BD_ADDR_LEN);
+        update_event = false;  /* Posted before start_link() asked for anything */
+    }
+    cyhal_system_critical_section_exit(irq_state);
+
+    if (!up) {
+        phase = TUNER_DISCONNECTED;
+        request_pending = false;
+        window_open = false;
+        return;
+    }
+    if (connected) {
+        start_link();
+        return;
+    }
+    if (phase == TUNER_DISCONNECTED) {
+        return;
+    }
+
+    uint32_t now = get_time_ms();
+
+    if (update_event) {
+        update_event = false;
+        if (request_pending && granted_latency != requested_latency && requested_latency != 0) {
+            idle_latency_declined = true;
+        }
+        request_pending = false;
+        window_open = false;
+    } else if (request_pending) {
+        if ((now - request_time_ms) < LINK_TUNER_UPDATE_TIMEOUT_MS) {
+            return;
+        }
+        /* Ignored: keep what we have and go on */
+        if (requested_latency != 0) {
+            idle_latency_declined = true;
+        }
+        request_pending = false;
+        window_open = false;
+    }
+
+    if (app_data_transfer_get_state() != TRANSFER_STATE_ACTIVE) {
+        window_open = false;
+        if (granted_latency == 0 && !idle_latency_declined && granted_interval != 0 &&
+            (now - idle_since_ms) >= LINK_TUNER_IDLE_AFTER_MS) {
+            request_conn_params(granted_interval, LINK_TUNER_IDLE_LATENCY);
+        }
+        return;
+    }
+    idle_since_ms = now;
+
+    if (granted_interval == 0) {
+        return;  /* Interval not known yet, so a window could not be scored */
+    }
+
+    /* A skipped event delays the phone's SACKs: no latency while sending */
+    if (granted_latency != 0) {
+        request_conn_params(granted_interval, 0);
+        return;
+    }
+
+    if (!window_open) {
+        window_open = true;
+        measuring = false;
+        window_start_ms = now;
+        return;
+    }
+    if (!measuring) {
+        if ((now - window_start_ms) >= LINK_TUNER_SETTLE_MS) {
+            measuring = true;
+            window_start_ms = now;
+            app_telemetry_get_counters(&window_start);
+        }
+        return;
+    }
+    if ((now - window_start_ms) >= LINK_TUNER_MEASURE_MS) {
+        finish_window(now);
+    }
+}
+
+/*******************************************************************************
+ *        Private Helper Functions
+ *******************************************************************************/
+
+/**
+ * New link: forget the last one's tuning state and request the first
+ * interval. A central tuned earlier in this power cycle gets its best
+ * interval straight away.
+ */
+static void start_link(void)
+{
+    request_pending = false;
+    idle_latency_declined = false;
+    idle_since_ms = get_time_ms();
+    tried_candidates = 0;
+    best_rate = 0;
+    low_windows = 0;
+    window_open = false;
+
+    best_interval = cached_interval();
+    if (best_interval != 0) {
+        phase = TUNER_CONVERGED;
+        printf("Link tuner: known central, using %d x 1.25 ms\n", best_interval);
+    } else {
+        phase = TUNER_PROBING;
+        best_interval = candidate_intervals[0];
+        mark_tried(best_interval);
+    }
+
+    request_conn_params(best_interval, 0);
+}
+
+/**
+ * Score the interval the window ran at, then probe the next candidate,
+ * settle on the best, or start over if the best has stopped performing
+ */
+static void finish_window(uint32_t now)
+{
+    telemetry_counters_t counters;
+    app_telemetry_get_counters(&counters);
+
+    uint32_t elapsed_ms = now - window_start_ms;
+    uint32_t bytes = counters.bytes_sent - window_start.bytes_sent;
+    uint32_t events = counters.conn_events - window_start.conn_events;
+    uint32_t rate = (uint32_t)(((uint64_t)bytes * 1000u) / elapsed_ms);
+    uint16_t interval = granted_interval;
+
+    APP_LOG("Link tuner: %d x 1.25 ms -> %lu B/s (%lu B per event)\n",
+            interval, rate, (events > 0) ? bytes / events : 0u);
+
+    /* Next window starts after the settle time again */
+    window_open = false;
+
+    if (phase == TUNER_PROBING) {
+        mark_tried(interval);
+        if (rate > best_rate) {
+            best_rate = rate;
+            best_interval = interval;
+        }
+        probe_next_candidate();
+        return;
+    }
+
+    if (interval != best_interval) {
+        request_conn_params(best_interval, 0);  /* Central moved us: go back */
+        return;
+    }
+    if (best_rate == 0 || rate > best_rate) {
+        best_rate = rate;  /* First window for a cached central, or a better link */
+        low_windows = 0;
+    } else if ((uint64_t)rate * 100u < (uint64_t)best_rate * LINK_TUNER_RETUNE_PCT) {
+        if (++low_windows >= 2) {
+            APP_LOG("Link tuner: throughput fell to %lu B/s, tuning again\n", rate);
+            phase = TUNER_PROBING;
+            tried_candidates = 0;
+            best_rate = rate;
+            low_windows = 0;
+            mark_tried(interval);
+            probe_next_candidate();
+        }
+    } else {
+        low_windows = 0;
+    }
+}
+
+/**
+ * Request the next untried candidate, or settle on the best one measured
+ */
+static void probe_next_candidate(void)
+{
+    for (uint8_t i = 0; i < LINK_TUNER_INTERVAL_COUNT; i++) {
+        if (!(tried_candidates & (1u << i))) {
+            tried_candidates |= (uint8_t)(1u << i);
+            request_conn_params(candidate_intervals[i], 0);
+            return;
+        }
+    }
+
+    phase = TUNER_CONVERGED;
+    low_windows = 0;
+    cache_interval(best_interval);
+    APP_LOG("Link tuner: settled on %d x 1.25 ms (%lu B/s)\n", best_interval, best_rate);
+    if (granted_interval != best_interval) {
+        request_conn_params(best_interval, 0);
+    }
+}
+
+/**
+ * Ask the central for an interval and latency. The outcome arrives as
+ * BTM_BLE_CONNECTION_PARAM_UPDATE, or not at all if the central ignores it.
+ */
+static void request_conn_params(uint16_t interval, uint16_t latency)
+{
+    wiced_bt_ble_pref_conn_params_t conn_params = {
+        .conn_interval_min = interval,
+        .conn_interval_max = interval,
+        .conn_latency = latency,
+        .conn_supervision_timeout = LINK_TUNER_SUPERVISION_TIMEOUT,
+        .min_ce_length = 0,
+        .max_ce_length = 0
+    };
+
+    request_pending = true;
+    request_time_ms = get_time_ms();
+    requested_latency = latency;
+    window_open = false;
+
+    if (!wiced_bt_l2cap_update_ble_conn_params(peer_addr, &conn_params)) {
+        APP_LOG("Link tuner: request for %d x 1.25 ms, latency %d not sent\n", interval, latency);
+        request_pending = false;
+        if (latency != 0) {
+            idle_latency_declined = true;
+        }
+    }
+}
+
+/**
+ * Ask for LE 2M PHY in both directions
+ */
+static void request_phy(void)
+{
+    wiced_bt_ble_phy_preferences_t phy_prefs;
+    memset(&phy_prefs, 0, sizeof(phy_prefs));
+    memcpy(phy_prefs.remote_bd_addr, link_addr, BD_ADDR_LEN);
+    phy_prefs.tx_phys = BTM_BLE_PREFER_2M_PHY;
+    phy_prefs.rx_phys = BTM_BLE_PREFER_2M_PHY;
+    phy_prefs.phy_opts = BTM_BLE_PREFER_NO_LELR;  /* No coded PHY */
+
+    wiced_bt_dev_status_t status = wiced_bt_ble_set_phy(&phy_prefs);
+    printf("Link tuner: requested LE 2M PHY (%s)\n", status == WICED_BT_SUCCESS ? "SUCCESS" : "FAILED");
+}
+
+/**
+ * Ask for the longest LL data length
+ */
+static void request_data_length(void)
+{
+    wiced_bt_dev_status_t status = wiced_bt_ble_set_data_packet_length(link_addr, LINK_TUNER_DATA_LENGTH,
+                                                                       LINK_TUNER_DATA_LENGTH_TIME_US);
+    printf("Link tuner: requested data length %d (%s)\n", LINK_TUNER_DATA_LENGTH,
+           status == WICED_BT_SUCCESS ? "SUCCESS" : "FAILED");
+}
+
+/**
+ * Mark the candidate(s) equal to an interval as tried
+ */
+static void mark_tried(uint16_t interval)
+{
+    for (uint8_t i = 0; i < LINK_TUNER_INTERVAL_COUNT; i++) {
+        if (candidate_intervals[i] == interval) {
+            tried_candidates |= (uint8_t)(1u << i);
+        }
+    }
+}
+
+/**
+ * Best interval found for this central earlier, 0 if none
+ */
+static uint16_t cached_interval(void)
+{
+    for (uint8_t i = 0; i < LINK_TUNER_PEER_CACHE_SIZE; i++) {
+        if (peer_cache[i].interval != 0 && memcmp(peer_cache[i].bd_addr, peer_addr, BD_ADDR_LEN) == 0) {
+            return peer_cache[i].interval;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Remember the best interval for this central
+ */
+static void cache_interval(uint16_t interval)
+{
+    for (uint8_t i = 0; i < LINK_TUNER_PEER_CACHE_SIZE; i++) {
+        if (peer_cache[i].interval != 0 && memcmp(peer_cache[i].bd_addr, peer_addr, BD_ADDR_LEN) == 0) {
+            peer_cache[i].interval = interval;
+            return;
+        }
+    }
+    memcpy(peer_cache[peer_cache_next].bd_addr, peer_addr, BD_ADDR_LEN);
+    peer_cache[peer_cache_next].interval = interval;
+    peer_cache_next = (uint8_t)((peer_cache_next + 1u) % LINK_TUNER_PEER_CACHE_SIZE);
+}
+
+/**
+ * Get current time in milliseconds
+ */
+static uint32_t get_time_ms(void)
+{
+    return xTaskGetTickCount();  /* Assumes 1ms tick */
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,93 @@
+/*******************************************************************************
+ * File Name: app_link_tuner.h
+ *
+ * Description: Connection parameter tuning for the data transfer service.
+ *              Each central accepts different connection intervals, so the
+ *              tuner tries a short list of them during a transfer, measures
+ *              the throughput each one gives from the send telemetry and
+ *              settles on the best. PHY and data length requests are retried
+ *              if the central first declines them, and peripheral latency is
+ *              only allowed while no transfer is running.
+ *
+ *******************************************************************************/
+
+#ifndef APP_LINK_TUNER_H_
+#define APP_LINK_TUNER_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "wiced_bt_dev.h"
+
+/*******************************************************************************
+ * Tuner Parameters
+ *******************************************************************************/
+
+/* Connection intervals tried, in 1.25 ms units. 15 ms first: it is what every
+ * central we use grants, so the transfer starts well while the others are
+ * tried. Apple centrals round requests to multiples of 15 ms. */
+#define LINK_TUNER_INTERVALS            { 12u, 6u, 9u, 24u, 36u }
+#define LINK_TUNER_INTERVAL_COUNT       (5u)
+
+#define LINK_TUNER_SUPERVISION_TIMEOUT  (200u)      /* 2 s, in 10 ms units */
+#define LINK_TUNER_IDLE_LATENCY         (4u)        /* Events the peripheral may skip with no transfer running */
+
+#define LINK_TUNER_DATA_LENGTH          (251u)      /* LL payload octets requested */
+#define LINK_TUNER_DATA_LENGTH_TIME_US  (2120u)     /* 251 octets on 1M PHY; the controller adjusts for 2M */
+
+#define LINK_TUNER_SETTLE_MS            (300u)      /* Ignore throughput this long after the link changes */
+#define LINK_TUNER_MEASURE_MS           (1500u)     /* Throughput measured over this window */
+#define LINK_TUNER_UPDATE_TIMEOUT_MS    (3000u)     /* No update event by then: the central ignored the request */
+#define LINK_TUNER_MAX_RETRIES          (1u)        /* Repeats of a declined PHY or data length request */
+#define LINK_TUNER_IDLE_AFTER_MS        (5000u)     /* Connected without a transfer this long: allow latency */
+#define LINK_TUNER_RETUNE_PCT           (70u)       /* Retune after two windows below this % of the best */
+#define LINK_TUNER_PEER_CACHE_SIZE      (4u)        /* Centrals whose best interval is remembered */
+
+/*******************************************************************************
+ *        Function Prototypes
+ *******************************************************************************/
+
+/**
+ * A central connected: request 2M PHY and the longest LL data length, and
+ * post the link so app_link_tuner_poll() requests the first connection
+ * parameters. A central tuned earlier in this power cycle gets its best
+ * interval straight away.
+ * @param bd_addr Address of the central
+ */
+void app_link_tuner_connected(const wiced_bt_device_address_t bd_addr);
+
+/**
+ * The central disconnected: app_link_tuner_poll() forgets the link, keeps
+ * the peer cache
+ */
+void app_link_tuner_disconnected(void);
+
+/**
+ * BTM_BLE_CONNECTION_PARAM_UPDATE from the stack
+ * @param status HCI status, 0 if the central applied new parameters
+ * @param conn_interval Connection interval in 1.25 ms units
+ * @param conn_latency Peripheral latency in connection events
+ */
+void app_link_tuner_conn_params_updated(uint8_t status, uint16_t conn_interval, uint16_t conn_latency);
+
+/**
+ * BTM_BLE_PHY_UPDATE_EVT from the stack
+ * @param status HCI status
+ * @param tx_phy PHY now used for TX (1 = 1M, 2 = 2M)
+ * @param rx_phy PHY now used for RX
+ */
+void app_link_tuner_phy_updated(uint8_t status, uint8_t tx_phy, uint8_t rx_phy);
+
+/**
+ * BTM_BLE_DATA_LENGTH_UPDATE_EVENT from the stack
+ * @param max_tx_octets Negotiated max TX payload per LL PDU
+ * @param max_tx_time_us Negotiated max TX time per LL PDU in microseconds
+ */
+void app_link_tuner_data_length_updated(uint16_t max_tx_octets, uint16_t max_tx_time_us);
+
+/**
+ * Measure and, when a window is complete, move to the next parameters.
+ * Call from the data transfer task; returns at once between windows.
+ */
+void app_link_tuner_poll(void);
+
+#endif /* APP_LINK_TUNER_H_ */
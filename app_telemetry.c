@@ -0,0 +1,338 @@
+/*******************************************************************************
+ * File Name: app_telemetry.c
+ *
+ * Description: This file implements the transfer telemetry ring and the
+ *              deferred logging used on the data transfer hot path.
+ *
+ *******************************************************************************/
+
+#include "app_telemetry.h"
+#include "wiced_bt_gatt.h"
+#include "cyhal.h"
+#include "stdio.h"
+#include <string.h>
+#include <FreeRTOS.h>
+#include <task.h>
+
+/*******************************************************************************
+ *        Global Variables
+ *******************************************************************************/
+
+/* Telemetry ring. telemetry_head counts every record ever written; record n
+ * lives in slot n % TELEMETRY_RING_SIZE until overwritten. */
+static telemetry_record_t telemetry_ring[TELEMETRY_RING_SIZE];
+static volatile uint32_t telemetry_head = 0;
+static volatile bool dump_requested = false;
+
+/* Running totals, updated with each record and kept across resets */
+static telemetry_counters_t telemetry_counters;
+static uint32_t last_tx_cycles = 0;
+
+/* Deferred log queue: any task posts under a critical section, the log task
+ * is the only consumer */
+#define LOG_TASK_STACK_SIZE         (configMINIMAL_STACK_SIZE * 4)
+#define LOG_TASK_PRIORITY           (tskIDLE_PRIORITY + 1)    /* Below everything on the data path */
+
+typedef struct {
+    const char *fmt;
+    uint32_t time_ms;
+    uint32_t args[APP_LOG_MAX_ARGS];
+} log_entry_t;
+
+static log_entry_t log_queue[APP_LOG_QUEUE_SIZE];
+static volatile uint32_t log_head = 0;
+static volatile uint32_t log_tail = 0;
+static volatile uint32_t log_dropped = 0;
+
+/*******************************************************************************
+ *        Forward Declarations
+ *******************************************************************************/
+static void log_task(void *pvParam);
+static void dump_ring(void);
+static uint32_t cycles_per_us(void);
+
+/*******************************************************************************
+ *        Function Implementations
+ *******************************************************************************/
+
+/**
+ * Initialize telemetry and start the cycle counter used for timestamps
+ */
+void app_telemetry_init(void)
+{
+    /* Also times the encoder (app_data_transfer.c) */
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+    app_telemetry_reset();
+}
+
+/**
+ * Create the log task
+ */
+bool app_telemetry_create_task(void)
+{
+    return xTaskCreate(log_task, "Log Task", LOG_TASK_STACK_SIZE,
+                       NULL, LOG_TASK_PRIORITY, NULL) == pdPASS;
+}
+
+/**
+ * Append a record to the ring
+ */
+void app_telemetry_record(uint8_t event, uint16_t block_num, uint16_t chunk_num, uint16_t payload_size,
+                          uint8_t status, uint8_t credits_left, uint8_t wait_ms)
+{
+    uint32_t irq_state = cyhal_system_critical_section_enter();
+    telemetry_record_t *record = &telemetry_ring[telemetry_head % TELEMETRY_RING_SIZE];
+    record->time_cycles = DWT->CYCCNT;
+    record->block_number = block_num;
+    record->chunk_number = chunk_num;
+    record->payload_size = payload_size;
+    record->event = event;
+    record->status = status;
+    record->credits_left = credits_left;
+    record->wait_ms = wait_ms;
+    record->reserved = 0;
+    telemetry_head++;
+
+    if (event == TELEMETRY_EVENT_SEND && status == WICED_BT_GATT_SUCCESS) {
+        telemetry_counters.bytes_sent += payload_size;
+    } else if (event == TELEMETRY_EVENT_TX_COMPLETE) {
+        if (telemetry_counters.tx_completes == 0 ||
+            (record->time_cycles - last_tx_cycles) / cycles_per_us() > TELEMETRY_EVENT_GAP_US) {
+            telemetry_counters.conn_events++;
+        }
+        telemetry_counters.tx_completes++;
+        last_tx_cycles = record->time_cycles;
+    }
+    cyhal_system_critical_section_exit(irq_state);
+}
+
+/**
+ * Discard all records
+ */
+void app_telemetry_reset(void)
+{
+    uint32_t irq_state = cyhal_system_critical_section_enter();
+    telemetry_head = 0;
+    cyhal_system_critical_section_exit(irq_state);
+}
+
+/**
+ * Summarize the ring
+ * Connection events are not visible to the application, so they are inferred
+ * from TX-complete events: the stack reports the notifications sent in one
+ * event back to back, and events are at least 7.5 ms apart.
+ */
+void app_telemetry_get_summary(telemetry_summary_t *summary, uint8_t credit_limit)
+{
+    uint32_t us_divider = cycles_per_us();
+    uint32_t head = telemetry_head;
+    uint32_t count = (head < TELEMETRY_RING_SIZE) ? head : TELEMETRY_RING_SIZE;
+    uint32_t first_time = 0;
+    uint32_t last_time = 0;
+    uint32_t last_send_time = 0;
+    uint32_t last_tx_time = 0;
+    bool have_send = false;
+    bool have_tx = false;
+    uint16_t event_notifications = 0;
+    uint32_t last_credit_sends = 0;
+
+    memset(summary, 0, sizeof(*summary));
+    summary->version = TELEMETRY_SUMMARY_VERSION;
+    summary->credit_limit = credit_limit;
+    summary->record_count = (uint16_t)count;
+    summary->dropped_logs = (log_dropped > 0xFFFFu) ? 0xFFFFu : (uint16_t)log_dropped;
+    summary->min_credits_left = 0xFF;
+
+    for (uint32_t n = head - count; n != head; n++) {
+        telemetry_record_t record = telemetry_ring[n % TELEMETRY_RING_SIZE];
+
+        if (n == head - count) {
+            first_time = record.time_cycles;
+        }
+        last_time = record.time_cycles;
+
+        if (record.event == TELEMETRY_EVENT_SEND) {
+            if (have_send) {
+                uint32_t gap_us = (record.time_cycles - last_send_time) / us_divider;
+                if (gap_us > summary->max_send_gap_us) {
+                    summary->max_send_gap_us = gap_us;
+                }
+            }
+            have_send = true;
+            last_send_time = record.time_cycles;
+
+            if (record.status == WICED_BT_GATT_SUCCESS) {
+                summary->sends_ok++;
+                summary->bytes_sent += record.payload_size;
+                if (record.credits_left < summary->min_credits_left) {
+                    summary->min_credits_left = record.credits_left;
+                }
+                if (record.credits_left == 0) {
+                    last_credit_sends++;
+                }
+            } else if (record.status == WICED_BT_GATT_CONGESTED) {
+                summary->sends_congested++;
+            } else {
+                summary->sends_failed++;
+            }
+        } else if (record.event == TELEMETRY_EVENT_TX_COMPLETE) {
+            summary->tx_completes++;
+            if (!have_tx || (record.time_cycles - last_tx_time) / us_divider > TELEMETRY_EVENT_GAP_US) {
+                summary->conn_events++;
+                event_notifications = 0;
+            }
+            have_tx = true;
+            last_tx_time = record.time_cycles;
+
+            event_notifications++;
+            if (event_notifications > summary->max_per_event) {
+                summary->max_per_event = event_notifications;
+            }
+        }
+    }
+
+    summary->window_us = (last_time - first_time) / us_divider;
+    if (summary->sends_ok > 0) {
+        summary->last_credit_pct = (uint8_t)((last_credit_sends * 100u) / summary->sends_ok);
+    } else {
+        summary->min_credits_left = 0;
+    }
+}
+
+/**
+ * Read the running totals
+ */
+void app_telemetry_get_counters(telemetry_counters_t *counters)
+{
+    uint32_t irq_state = cyhal_system_critical_section_enter();
+    *counters = telemetry_counters;
+    cyhal_system_critical_section_exit(irq_state);
+}
+
+/**
+ * Handle a write to the Telemetry characteristic
+ */
+bool app_telemetry_command(const uint8_t *p_val, uint16_t len)
+{
+    if (len < 1) {
+        return false;
+    }
+
+    switch (p_val[0]) {
+        case TELEMETRY_CMD_RESET:
+            app_telemetry_reset();
+            return true;
+
+        case TELEMETRY_CMD_DUMP:
+            dump_requested = true;  /* Printed by the log task */
+            return true;
+
+        default:
+            return false;
+    }
+}
+
+/**
+ * Queue a message for the log task; drops it if the queue is full
+ */
+void app_log_post(const char *fmt, const uint32_t *args)
+{
+    uint32_t irq_state = cyhal_system_critical_section_enter();
+    if (log_head - log_tail < APP_LOG_QUEUE_SIZE) {
+        log_entry_t *entry = &log_queue[log_head % APP_LOG_QUEUE_SIZE];
+        entry->fmt = fmt;
+        entry->time_ms = xTaskGetTickCount();  /* Assumes 1ms tick */
+        memcpy(entry->args, &args[1], sizeof(entry->args));
+        log_head++;
+    } else {
+        log_dropped++;
+    }
+    cyhal_system_critical_section_exit(irq_state);
+}
+
+/*******************************************************************************
+ *        Private Helper Functions
+ *******************************************************************************/
+
+/**
+ * Log task: prints queued messages, then any requested ring dump
+ */
+static void log_task(void *pvParam)
+{
+    uint32_t reported_drops = 0;
+
+    (void)pvParam;
+
+    while (true) {
+        vTaskDelay(pdMS_TO_TICKS(APP_LOG_DRAIN_PERIOD_MS));
+
+        while (log_tail != log_head) {
+            /* The slot stays ours until log_tail moves past it */
+            log_entry_t entry = log_queue[log_tail % APP_LOG_QUEUE_SIZE];
+            log_tail++;
+
+            printf("[%lu ms] ", entry.time_ms);
+            printf(entry.fmt, entry.args[0], entry.args[1], entry.args[2], entry.args[3]);
+        }
+
+        uint32_t dropped = log_dropped;
+        if (dropped != reported_drops) {
+            printf("(%lu log messages dropped)\n", dropped - reported_drops);
+            reported_drops = dropped;
+        }
+
+        if (dump_requested) {
+            dump_requested = false;
+            dump_ring();
+        }
+    }
+}
+
+/**
+ * Print the ring oldest first, one line per record
+ */
+static void dump_ring(void)
+{
+    uint32_t us_divider = cycles_per_us();
+    uint32_t head = telemetry_head;
+    uint32_t count = (head < TELEMETRY_RING_SIZE) ? head : TELEMETRY_RING_SIZE;
+    uint32_t first_time = 0;
+
+    printf("\n========================================\n");
+    printf("Telemetry: %lu records\n", count);
+    printf("  time_us event block chunk size status credits_left wait_ms\n");
+
+    for (uint32_t n = head - count; n != head; n++) {
+        telemetry_record_t record = telemetry_ring[n % TELEMETRY_RING_SIZE];
+        if (n == head - count) {
+            first_time = record.time_cycles;
+        }
+
+        if (record.event == TELEMETRY_EVENT_SEND) {
+            printf("  %lu SEND %u %u %u 0x%02X %u %u\n",
+                   (record.time_cycles - first_time) / us_divider,
+                   record.block_number, record.chunk_number, record.payload_size,
+                   record.status, record.credits_left, record.wait_ms);
+        } else {
+            printf("  %lu DONE - - - - %u %u\n",
+                   (record.time_cycles - first_time) / us_divider,
+                   record.credits_left, record.wait_ms);
+        }
+    }
+
+    printf("========================================\n\n");
+}
+
+/**
+ * Cycle counter ticks per microsecond
+ */
+static uint32_t cycles_per_us(void)
+{
+    uint32_t divider = SystemCoreClock / 1000000u;
+    return (divider > 0) ? divider : 1;
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,152 @@
+/*******************************************************************************
+ * File Name: app_telemetry.h
+ *
+ * Description: Transfer telemetry and deferred console logging for the data
+ *              transfer service. The sender records each notification into a
+ *              RAM ring instead of printing from the hot path; a summary is
+ *              readable over the Telemetry characteristic.
+ *
+ *******************************************************************************/
+
+#ifndef APP_TELEMETRY_H_
+#define APP_TELEMETRY_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*******************************************************************************
+ * Telemetry Parameters
+ *******************************************************************************/
+#define TELEMETRY_RING_SIZE         (512u)      /* Records kept, oldest overwritten (power of two) */
+#define TELEMETRY_EVENT_GAP_US      (1500u)     /* TX-completes closer than this share a connection event */
+#define TELEMETRY_NO_BLOCK          (0xFFFFu)   /* Block/chunk not known for this record */
+
+/* Record types */
+#define TELEMETRY_EVENT_SEND        (0x01u)     /* wiced_bt_gatt_server_send_notification called */
+#define TELEMETRY_EVENT_TX_COMPLETE (0x02u)     /* Notification transmitted, credit returned */
+
+/* Telemetry characteristic commands (single byte write) */
+#define TELEMETRY_CMD_RESET         (0x00u)     /* Clear the ring */
+#define TELEMETRY_CMD_DUMP          (0x01u)     /* Print the ring as a timeline from the log task */
+
+#define TELEMETRY_SUMMARY_VERSION   (1u)
+
+/* Deferred logging: APP_LOG() only queues the format and arguments; the log
+ * task formats and prints them at idle priority */
+#define APP_LOG_QUEUE_SIZE          (32u)       /* Messages buffered (power of two) */
+#define APP_LOG_MAX_ARGS            (4u)        /* Integer arguments per message */
+#define APP_LOG_DRAIN_PERIOD_MS     (50u)       /* Log task polling period */
+
+/*******************************************************************************
+ * Data Structures
+ *******************************************************************************/
+
+/* One ring entry (16 bytes) */
+typedef struct {
+    uint32_t time_cycles;       /* DWT cycle count at SystemCoreClock (wraps) */
+    uint16_t block_number;      /* TELEMETRY_NO_BLOCK for TX-complete records */
+    uint16_t chunk_number;
+    uint16_t payload_size;      /* Chunk bytes in the notification */
+    uint8_t event;              /* TELEMETRY_EVENT_* */
+    uint8_t status;             /* wiced_bt_gatt_status_t of the send */
+    uint8_t credits_left;       /* Free notification credits after the event */
+    uint8_t wait_ms;            /* Sender sleep in effect (app_data_transfer_get_wait_ms) */
+    uint16_t reserved;
+} telemetry_record_t;
+
+/* Telemetry characteristic value, computed over the records in the ring.
+ * Bytes per connection event = bytes_sent / conn_events. */
+typedef struct __attribute__((packed)) {
+    uint8_t version;            /* TELEMETRY_SUMMARY_VERSION */
+    uint8_t credit_limit;       /* Current notification credit limit */
+    uint16_t record_count;      /* Records the summary covers */
+    uint32_t window_us;         /* Oldest to newest record */
+    uint32_t sends_ok;
+    uint32_t sends_congested;   /* Refused with WICED_BT_GATT_CONGESTED */
+    uint32_t sends_failed;      /* Refused with any other status */
+    uint32_t bytes_sent;        /* Payload bytes accepted by the stack */
+    uint32_t tx_completes;
+    uint16_t conn_events;       /* Bursts of TX-completes (inferred connection events) */
+    uint16_t max_per_event;     /* Most notifications completed in one event */
+    uint32_t max_send_gap_us;   /* Longest pause between send attempts */
+    uint8_t min_credits_left;   /* Fewest free credits after a successful send */
+    uint8_t last_credit_pct;    /* Successful sends that took the last free credit, in % */
+    uint16_t dropped_logs;      /* Deferred log messages lost to a full queue */
+} telemetry_summary_t;
+
+/* Running totals since boot, never reset (app_telemetry_get_counters).
+ * Consumers take differences between two reads. */
+typedef struct {
+    uint32_t bytes_sent;        /* Payload bytes accepted by the stack */
+    uint32_t tx_completes;
+    uint32_t conn_events;       /* Bursts of TX-completes, as in telemetry_summary_t */
+} telemetry_counters_t;
+
+/*******************************************************************************
+ *        Function Prototypes
+ *******************************************************************************/
+
+/**
+ * Initialize telemetry and start the cycle counter used for timestamps
+ */
+void app_telemetry_init(void);
+
+/**
+ * Create the log task that prints deferred messages and ring dumps
+ * Call once before the scheduler starts.
+ * @return true if created successfully
+ */
+bool app_telemetry_create_task(void);
+
+/**
+ * Append a record to the ring. Safe from any task or the BT stack.
+ * @param event TELEMETRY_EVENT_*
+ * @param block_num Block number, or TELEMETRY_NO_BLOCK
+ * @param chunk_num Chunk number, or TELEMETRY_NO_BLOCK
+ * @param payload_size Chunk bytes in the notification
+ * @param status Status returned by the send
+ * @param credits_left Free credits after the event
+ * @param wait_ms Sender sleep in effect
+ */
+void app_telemetry_record(uint8_t event, uint16_t block_num, uint16_t chunk_num, uint16_t payload_size,
+                          uint8_t status, uint8_t credits_left, uint8_t wait_ms);
+
+/**
+ * Discard all records (start of a transfer, or TELEMETRY_CMD_RESET)
+ */
+void app_telemetry_reset(void);
+
+/**
+ * Summarize the ring. Approximate while a transfer is running.
+ * @param summary Output summary
+ * @param credit_limit Current notification credit limit
+ */
+void app_telemetry_get_summary(telemetry_summary_t *summary, uint8_t credit_limit);
+
+/**
+ * Read the running totals. Cheap enough to call every few hundred ms.
+ * @param counters Output totals
+ */
+void app_telemetry_get_counters(telemetry_counters_t *counters);
+
+/**
+ * Handle a write to the Telemetry characteristic
+ * @param p_val Written value
+ * @param len Length of value
+ * @return true if the command was recognized
+ */
+bool app_telemetry_command(const uint8_t *p_val, uint16_t len);
+
+/**
+ * Queue a message for the log task. Use APP_LOG() rather than calling this.
+ * @param fmt printf format; must stay valid (a string literal)
+ * @param args args[1..APP_LOG_MAX_ARGS] are the integer arguments
+ */
+void app_log_post(const char *fmt, const uint32_t *args);
+
+/* Deferred printf for hot paths: up to APP_LOG_MAX_ARGS integer arguments,
+ * printed with a "[ms] " prefix taken when the message was queued */
+#define APP_LOG(fmt, ...) \
+    app_log_post((fmt), (const uint32_t[APP_LOG_MAX_ARGS + 1]){ 0, ##__VA_ARGS__ })
+
+#endif /* APP_TELEMETRY_H_ */
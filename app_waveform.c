@@ -7,15 +7,14 @@
 
 #include "app_waveform.h"
 #include "compressed_waveform_data.h"
+#include "waveform_model_tables.h"
+#include "psoc_driver/crc32_table.h"
 #include <string.h>
-#include <math.h>
 #include <stdlib.h>
 
 /*******************************************************************************
  * Constants
  *******************************************************************************/
-#define PI 3.14159265358979323846f
-
 /* Waveform simulation parameters */
 #define BASELINE_NOISE_AMPLITUDE   100        /* ±100 counts noise floor (out of ±8M range) */
 #define FIRST_ECHO_AMPLITUDE       2500000    /* ~30% of full scale (24-bit signed) */
@@ -30,22 +29,73 @@
 
 /* Echo characteristics */
 #define ECHO_DURATION_SAMPLES      100        /* ~2 μs echo duration */
-#define ECHO_DECAY_RATE            0.03f      /* Exponential decay per sample */
+#define ECHO_WINDOW_SAMPLES        (ECHO_DURATION_SAMPLES * 3)  /* Samples synthesized per echo */
+#define ECHO_COUNT                 3
+
+/* Decay rates and the carrier are baked into waveform_model_tables.h */
+#if WAVEFORM_MODEL_SAMPLE_RATE_HZ != WAVEFORM_SAMPLE_RATE_HZ || \
+    WAVEFORM_MODEL_CARRIER_FREQ_HZ != WAVEFORM_CARRIER_FREQ_HZ
+#error "waveform_model_tables.h is stale: run generate_compressed_waveform.py --tables-only"
+#endif
+
+/* Per-block variation, so every block of a load test carries a different signal */
+#define ECHO_JITTER_SAMPLES        4          /* Echo arrival varies by -3..+4 samples */
+#define ECHO_GAIN_STEPS            32         /* Echo amplitude varies by -6%..+6% in 32 steps */
 
 /*******************************************************************************
  * Private Function Prototypes
  *******************************************************************************/
-static int32_t generate_baseline_noise(uint32_t sample_index);
-static int32_t generate_echo(uint32_t sample_index, uint32_t echo_center,
-                             int32_t amplitude, float decay_rate);
+static int32_t generate_baseline_noise(void);
 static void pack_24bit_sample(int32_t sample, uint8_t *buffer, uint32_t index);
 static int32_t unpack_24bit_sample(const uint8_t *buffer, uint32_t index);
 
+/* Bit writer/reader for the Rice stream (MSB first) */
+typedef struct {
+    uint8_t *buffer;
+    uint32_t capacity;
+    uint32_t position;      /* Bytes written */
+    uint32_t accumulator;   /* Pending bits, right-aligned */
+    uint32_t bit_count;     /* Number of pending bits (< 8 between calls) */
+    bool overflow;
+} bit_writer_t;
+
+typedef struct {
+    const uint8_t *buffer;
+    uint32_t size;
+    uint32_t position;      /* Next byte to load */
+    uint32_t accumulator;
+    uint32_t bit_count;
+    bool overrun;
+} bit_reader_t;
+
+static void put_bits(bit_writer_t *writer, uint32_t value, uint32_t count);
+static void flush_bits(bit_writer_t *writer);
+static uint32_t get_bits(bit_reader_t *reader, uint32_t count);
+static int32_t predict_sample(uint32_t order, int32_t prev1, int32_t prev2);
+
 /*******************************************************************************
  * Static Variables
  *******************************************************************************/
 static uint32_t random_seed = 12345;
 
+/* Echo models. Each echo is a decaying 5 MHz sinusoid, which a two-term
+ * recurrence produces without per-sample expf/sinf calls:
+ *   y[n+1] = 2 r cos(w) y[n] - r^2 y[n-1],  r = exp(-decay), w = 2 pi f / fs
+ * The coefficients are precomputed, so the models are const and stay in flash. */
+typedef struct {
+    uint32_t center;        /* Nominal arrival (sample index) */
+    int32_t amplitude;
+    float ratio;            /* r: envelope ratio between adjacent samples */
+    float coeff1;           /* 2 r cos(w) */
+    float coeff2;           /* r^2 */
+} echo_model_t;
+
+static const echo_model_t echo_models[ECHO_COUNT] = {
+    { FIRST_ECHO_TIME_SAMPLES,  FIRST_ECHO_AMPLITUDE,  WAVEFORM_ECHO1_RATIO, WAVEFORM_ECHO1_COEFF1, WAVEFORM_ECHO1_COEFF2 },
+    { SECOND_ECHO_TIME_SAMPLES, SECOND_ECHO_AMPLITUDE, WAVEFORM_ECHO2_RATIO, WAVEFORM_ECHO2_COEFF1, WAVEFORM_ECHO2_COEFF2 },
+    { THIRD_ECHO_TIME_SAMPLES,  THIRD_ECHO_AMPLITUDE,  WAVEFORM_ECHO3_RATIO, WAVEFORM_ECHO3_COEFF1, WAVEFORM_ECHO3_COEFF2 },
+};
+
 /*******************************************************************************
  * Public Functions
  *******************************************************************************/
@@ -92,24 +142,43 @@ bool app_waveform_generate(uint32_t block_num, waveform_block_header_t *header,
         return true;
     }
 
+    /* Noise and echo variation depend only on the block number, so a block
+     * generated again (resent after a reconnect) is identical to the first copy */
+    uint32_t block_hash = block_num * 2654435761u;
+    random_seed = (12345u + block_hash) & 0x7FFFFFFF;
+
+    /* Echo state: start sample, current and next output of the recurrence.
+     * Only the two starting values need the carrier phase, read from the table. */
+    uint32_t echo_start[ECHO_COUNT];
+    float echo_current[ECHO_COUNT];
+    float echo_next[ECHO_COUNT];
+
+    for (uint32_t e = 0; e < ECHO_COUNT; e++) {
+        const echo_model_t *model = &echo_models[e];
+        uint32_t bits = block_hash >> (8 * e + 4);
+        int32_t shift = (int32_t)(bits % (2 * ECHO_JITTER_SAMPLES)) - (ECHO_JITTER_SAMPLES - 1);
+        float gain = 1.0f + ((float)((bits >> 3) % ECHO_GAIN_STEPS) - (ECHO_GAIN_STEPS / 2)) / 256.0f;
+        float amplitude = (float)model->amplitude * gain;
+
+        echo_start[e] = (uint32_t)((int32_t)model->center + shift);
+        echo_current[e] = amplitude * waveform_carrier_sine[echo_start[e] % WAVEFORM_CARRIER_PERIOD_SAMPLES];
+        echo_next[e] = amplitude * model->ratio *
+                       waveform_carrier_sine[(echo_start[e] + 1) % WAVEFORM_CARRIER_PERIOD_SAMPLES];
+    }
+
     /* Generate waveform samples */
     for (uint32_t i = 0; i < WAVEFORM_SAMPLES_PER_BLOCK; i++) {
-        int32_t sample = 0;
-
         /* Add baseline noise throughout */
-        sample += generate_baseline_noise(i);
-
-        /* Generate echoes at specific time points */
-        if (i >= FIRST_ECHO_TIME_SAMPLES && i < FIRST_ECHO_TIME_SAMPLES + ECHO_DURATION_SAMPLES * 3) {
-            sample += generate_echo(i, FIRST_ECHO_TIME_SAMPLES, FIRST_ECHO_AMPLITUDE, ECHO_DECAY_RATE);
-        }
-
-        if (i >= SECOND_ECHO_TIME_SAMPLES && i < SECOND_ECHO_TIME_SAMPLES + ECHO_DURATION_SAMPLES * 3) {
-            sample += generate_echo(i, SECOND_ECHO_TIME_SAMPLES, SECOND_ECHO_AMPLITUDE, ECHO_DECAY_RATE);
-        }
-
-        if (i >= THIRD_ECHO_TIME_SAMPLES && i < THIRD_ECHO_TIME_SAMPLES + ECHO_DURATION_SAMPLES * 3) {
-            sample += generate_echo(i, THIRD_ECHO_TIME_SAMPLES, THIRD_ECHO_AMPLITUDE, ECHO_DECAY_RATE * 1.5f);
+        int32_t sample = generate_baseline_noise();
+
+        /* Add each echo inside its window, then advance its recurrence */
+        for (uint32_t e = 0; e < ECHO_COUNT; e++) {
+            if (i - echo_start[e] < ECHO_WINDOW_SAMPLES) {
+                float following = echo_models[e].coeff1 * echo_next[e] - echo_models[e].coeff2 * echo_current[e];
+                sample += (int32_t)echo_current[e];
+                echo_current[e] = echo_next[e];
+                echo_next[e] = following;
+            }
         }
 
         /* Clamp to 24-bit signed range: -8,388,608 to 8,388,607 */
@@ -132,7 +201,9 @@ bool app_waveform_generate(uint32_t block_num, waveform_block_header_t *header,
 }
 
 /**
- * Compress a waveform block using delta encoding + DEFLATE
+ * Compress a waveform block (prediction + Rice coding)
+ * Each partition is coded with whichever predictor order gives the smallest
+ * estimated size; the Rice parameter follows the mean residual.
  */
 bool app_waveform_compress(const waveform_block_header_t *header,
                            const uint8_t *raw_samples,
@@ -140,14 +211,89 @@ bool app_waveform_compress(const waveform_block_header_t *header,
                            uint32_t *compressed_size_out,
                            uint32_t max_compressed_size)
 {
-    /* Compression disabled - just copy raw data */
-    if (WAVEFORM_RAW_DATA_SIZE > max_compressed_size) {
+    (void)header;
+
+    if (max_compressed_size < 3) {
         return false;
     }
 
-    memcpy(compressed_out, raw_samples, WAVEFORM_RAW_DATA_SIZE);
-    *compressed_size_out = WAVEFORM_RAW_DATA_SIZE;
+    compressed_out[0] = WAVEFORM_CODEC_RICE;
+    compressed_out[1] = (uint8_t)(WAVEFORM_SAMPLES_PER_BLOCK & 0xFF);
+    compressed_out[2] = (uint8_t)(WAVEFORM_SAMPLES_PER_BLOCK >> 8);
+
+    bit_writer_t writer = { compressed_out, max_compressed_size, 3, 0, 0, false };
+    int32_t prev1 = 0;
+    int32_t prev2 = 0;
+
+    for (uint32_t start = 0; start < WAVEFORM_SAMPLES_PER_BLOCK; start += WAVEFORM_RICE_PARTITION) {
+        uint32_t count = WAVEFORM_SAMPLES_PER_BLOCK - start;
+        if (count > WAVEFORM_RICE_PARTITION) {
+            count = WAVEFORM_RICE_PARTITION;
+        }
+
+        /* Zigzag residuals for each predictor order */
+        uint32_t residuals[3][WAVEFORM_RICE_PARTITION];
+        uint64_t sums[3] = { 0, 0, 0 };
+        for (uint32_t order = 0; order < 3; order++) {
+            int32_t p1 = prev1;
+            int32_t p2 = prev2;
+            for (uint32_t i = 0; i < count; i++) {
+                int32_t sample = unpack_24bit_sample(raw_samples, start + i);
+                int32_t residual = sample - predict_sample(order, p1, p2);
+                uint32_t mapped = ((uint32_t)residual << 1) ^ (uint32_t)(residual >> 31);
+                residuals[order][i] = mapped;
+                sums[order] += mapped;
+                p2 = p1;
+                p1 = sample;
+            }
+        }
+
+        /* Pick the order and Rice parameter with the smallest estimated size */
+        uint32_t best_order = 0;
+        uint32_t best_k = 0;
+        uint64_t best_bits = UINT64_MAX;
+        for (uint32_t order = 0; order < 3; order++) {
+            uint32_t k = 0;
+            while (k < WAVEFORM_RICE_MAX_K && ((uint64_t)count << (k + 1)) <= sums[order]) {
+                k++;
+            }
+            uint64_t bits = (uint64_t)count * (k + 1) + (sums[order] >> k);
+            if (bits < best_bits) {
+                best_bits = bits;
+                best_order = order;
+                best_k = k;
+            }
+        }
+
+        put_bits(&writer, best_order, 2);
+        put_bits(&writer, best_k, 5);
+        for (uint32_t i = 0; i < count; i++) {
+            uint32_t mapped = residuals[best_order][i];
+            uint32_t quotient = mapped >> best_k;
+            if (quotient >= WAVEFORM_RICE_ESCAPE) {
+                put_bits(&writer, (1UL << WAVEFORM_RICE_ESCAPE) - 1, WAVEFORM_RICE_ESCAPE);
+                put_bits(&writer, mapped >> 16, WAVEFORM_RICE_ESCAPE_BITS - 16);
+                put_bits(&writer, mapped & 0xFFFF, 16);
+                continue;
+            }
+            /* quotient one-bits then a zero */
+            put_bits(&writer, ((1UL << quotient) - 1) << 1, quotient + 1);
+            if (best_k > 0) {
+                put_bits(&writer, mapped & ((1UL << best_k) - 1), best_k);
+            }
+        }
+
+        /* Partitions hold at least 2 samples (2376 = 74 * 32 + 8) */
+        prev1 = unpack_24bit_sample(raw_samples, start + count - 1);
+        prev2 = unpack_24bit_sample(raw_samples, start + count - 2);
+    }
+
+    flush_bits(&writer);
+    if (writer.overflow) {
+        return false;
+    }
 
+    *compressed_size_out = writer.position;
     return true;
 }
 
@@ -158,12 +304,55 @@ bool app_waveform_decompress(const uint8_t *compressed_data,
                              uint32_t compressed_size,
                              uint8_t *raw_samples_out)
 {
-    /* Compression disabled - just copy raw data */
-    if (compressed_size != WAVEFORM_RAW_DATA_SIZE) {
+    if (compressed_size < 3 || compressed_data[0] != WAVEFORM_CODEC_RICE) {
+        return false;
+    }
+    if ((uint32_t)(compressed_data[1] | (compressed_data[2] << 8)) != WAVEFORM_SAMPLES_PER_BLOCK) {
         return false;
     }
 
-    memcpy(raw_samples_out, compressed_data, WAVEFORM_RAW_DATA_SIZE);
+    bit_reader_t reader = { compressed_data, compressed_size, 3, 0, 0, false };
+    int32_t prev1 = 0;
+    int32_t prev2 = 0;
+
+    for (uint32_t start = 0; start < WAVEFORM_SAMPLES_PER_BLOCK; start += WAVEFORM_RICE_PARTITION) {
+        uint32_t count = WAVEFORM_SAMPLES_PER_BLOCK - start;
+        if (count > WAVEFORM_RICE_PARTITION) {
+            count = WAVEFORM_RICE_PARTITION;
+        }
+
+        uint32_t order = get_bits(&reader, 2);
+        uint32_t k = get_bits(&reader, 5);
+        if (order > 2 || k > WAVEFORM_RICE_MAX_K) {
+            return false;
+        }
+
+        for (uint32_t i = 0; i < count; i++) {
+            uint32_t quotient = 0;
+            while (quotient < WAVEFORM_RICE_ESCAPE && get_bits(&reader, 1)) {
+                quotient++;
+            }
+
+            uint32_t mapped;
+            if (quotient == WAVEFORM_RICE_ESCAPE) {
+                mapped = get_bits(&reader, WAVEFORM_RICE_ESCAPE_BITS - 16) << 16;
+                mapped |= get_bits(&reader, 16);
+            } else {
+                mapped = (quotient << k) | ((k > 0) ? get_bits(&reader, k) : 0);
+            }
+            if (reader.overrun) {
+                return false;
+            }
+
+            /* Wrap to 24 bits so a corrupt stream cannot overflow the predictor */
+            int32_t residual = (int32_t)(mapped >> 1) ^ -(int32_t)(mapped & 1);
+            uint32_t wrapped = ((uint32_t)predict_sample(order, prev1, prev2) + (uint32_t)residual) & 0xFFFFFF;
+            int32_t sample = (int32_t)(wrapped ^ 0x800000) - 0x800000;
+            pack_24bit_sample(sample, raw_samples_out, start + i);
+            prev2 = prev1;
+            prev1 = sample;
+        }
+    }
 
     return true;
 }
@@ -173,17 +362,21 @@ bool app_waveform_decompress(const uint8_t *compressed_data,
  */
 uint32_t app_waveform_crc32(const uint8_t *data, uint32_t length)
 {
+    /* Table-driven: one lookup per byte instead of 8 shift/xor steps.
+     * The table is shared with the host driver and lives in flash. */
     uint32_t crc = 0xFFFFFFFF;
 
-    for (uint32_t i = 0; i < length; i++) {
-        crc ^= data[i];
-        for (uint8_t j = 0; j < 8; j++) {
-            if (crc & 1) {
-                crc = (crc >> 1) ^ 0xEDB88320;
-            } else {
-                crc >>= 1;
-            }
-        }
+    while (length >= 4) {
+        crc = (crc >> 8) ^ crc32_lookup_table[(crc ^ data[0]) & 0xFF];
+        crc = (crc >> 8) ^ crc32_lookup_table[(crc ^ data[1]) & 0xFF];
+        crc = (crc >> 8) ^ crc32_lookup_table[(crc ^ data[2]) & 0xFF];
+        crc = (crc >> 8) ^ crc32_lookup_table[(crc ^ data[3]) & 0xFF];
+        data += 4;
+        length -= 4;
+    }
+
+    while (length--) {
+        crc = (crc >> 8) ^ crc32_lookup_table[(crc ^ *data++) & 0xFF];
     }
 
     return ~crc;
@@ -195,34 +388,79 @@ uint32_t app_waveform_crc32(const uint8_t *data, uint32_t length)
 
 /**
  * Generate baseline noise using simple PRNG
+ * The range is taken from the generator's high bits with a multiply, not a division.
  */
-static int32_t generate_baseline_noise(uint32_t sample_index)
+static inline int32_t generate_baseline_noise(void)
 {
     /* Simple linear congruential generator for noise */
     random_seed = (random_seed * 1103515245 + 12345) & 0x7FFFFFFF;
-    int32_t noise = (int32_t)(random_seed % (BASELINE_NOISE_AMPLITUDE * 2)) - BASELINE_NOISE_AMPLITUDE;
+    int32_t noise = (int32_t)(((random_seed >> 15) * (BASELINE_NOISE_AMPLITUDE * 2)) >> 16) - BASELINE_NOISE_AMPLITUDE;
     return noise;
 }
 
 /**
- * Generate an echo with 5MHz carrier and exponential decay envelope
+ * Fixed polynomial predictor: 0, x[n-1], or 2x[n-1] - x[n-2]
  */
-static int32_t generate_echo(uint32_t sample_index, uint32_t echo_center,
-                             int32_t amplitude, float decay_rate)
+static int32_t predict_sample(uint32_t order, int32_t prev1, int32_t prev2)
 {
-    int32_t relative_time = (int32_t)sample_index - (int32_t)echo_center;
+    switch (order) {
+        case 1:
+            return prev1;
+        case 2:
+            return 2 * prev1 - prev2;
+        default:
+            return 0;
+    }
+}
 
-    /* Exponential decay envelope */
-    float envelope = expf(-decay_rate * fabsf((float)relative_time));
+/**
+ * Append up to 24 bits, MSB first
+ */
+static void put_bits(bit_writer_t *writer, uint32_t value, uint32_t count)
+{
+    writer->accumulator = (writer->accumulator << count) | (value & ((1UL << count) - 1));
+    writer->bit_count += count;
+
+    while (writer->bit_count >= 8) {
+        writer->bit_count -= 8;
+        if (writer->position < writer->capacity) {
+            writer->buffer[writer->position] = (uint8_t)(writer->accumulator >> writer->bit_count);
+        } else {
+            writer->overflow = true;
+        }
+        writer->position++;
+    }
+}
 
-    /* 5 MHz carrier wave (10 samples per cycle at 50 MHz sampling) */
-    float carrier_phase = 2.0f * PI * WAVEFORM_CARRIER_FREQ_HZ * (float)sample_index / (float)WAVEFORM_SAMPLE_RATE_HZ;
-    float carrier = sinf(carrier_phase);
+/**
+ * Pad the last byte with zero bits
+ */
+static void flush_bits(bit_writer_t *writer)
+{
+    if (writer->bit_count > 0) {
+        put_bits(writer, 0, 8 - writer->bit_count);
+    }
+}
 
-    /* Modulate carrier with envelope */
-    int32_t echo = (int32_t)(amplitude * envelope * carrier);
+/**
+ * Read up to 24 bits, MSB first (zeros past the end, flagging overrun)
+ */
+static uint32_t get_bits(bit_reader_t *reader, uint32_t count)
+{
+    while (reader->bit_count < count) {
+        uint32_t byte = 0;
+        if (reader->position < reader->size) {
+            byte = reader->buffer[reader->position];
+        } else {
+            reader->overrun = true;
+        }
+        reader->position++;
+        reader->accumulator = (reader->accumulator << 8) | byte;
+        reader->bit_count += 8;
+    }
 
-    return echo;
+    reader->bit_count -= count;
+    return (reader->accumulator >> reader->bit_count) & ((1UL << count) - 1);
 }
 
 /**
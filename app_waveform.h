@@ -11,22 +11,38 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include "psoc_driver/wire_format.h"
 
 /*******************************************************************************
  * Waveform Parameters
  *******************************************************************************/
 #define WAVEFORM_SAMPLE_RATE_HZ      50000000   /* 50 MHz sampling rate */
-#define WAVEFORM_SAMPLES_PER_BLOCK   2376       /* Samples per 7KB block (with 40-byte header) */
+#define WAVEFORM_SAMPLES_PER_BLOCK   2376       /* Samples per 7KB block (with 38-byte header) */
 #define WAVEFORM_TIME_WINDOW_US      47.52f     /* Time window in microseconds */
 #define WAVEFORM_CARRIER_FREQ_HZ     5000000    /* 5 MHz carrier frequency */
 #define WAVEFORM_BITS_PER_SAMPLE     24         /* 24-bit ADC resolution */
 
-/* Block size definitions */
-#define WAVEFORM_HEADER_SIZE         40         /* Header size in bytes */
+/* Block size definitions (WAVEFORM_HEADER_SIZE comes from psoc_driver/wire_format.h) */
 #define WAVEFORM_RAW_DATA_SIZE       (WAVEFORM_SAMPLES_PER_BLOCK * 3)  /* 24-bit samples = 3 bytes each */
-#define WAVEFORM_BLOCK_SIZE          (WAVEFORM_HEADER_SIZE + WAVEFORM_RAW_DATA_SIZE)  /* 7128 bytes total */
+#define WAVEFORM_BLOCK_SIZE          (WAVEFORM_HEADER_SIZE + WAVEFORM_RAW_DATA_SIZE)  /* 7166 bytes total */
 #define WAVEFORM_MAX_COMPRESSED_SIZE 4096       /* Maximum compressed size (conservative estimate) */
 
+/* On-device codec: per-partition fixed polynomial prediction (order 0-2) with
+ * Rice-coded residuals. Stream layout:
+ *   byte 0     WAVEFORM_CODEC_RICE
+ *   bytes 1-2  sample count (little-endian)
+ *   then, MSB-first bits, for each partition of WAVEFORM_RICE_PARTITION samples:
+ *     2-bit predictor order, 5-bit Rice parameter k, then per residual
+ *     (zigzag-mapped) q = r >> k as q one-bits and a zero, then the low k bits.
+ *     q >= WAVEFORM_RICE_ESCAPE is sent as WAVEFORM_RICE_ESCAPE one-bits
+ *     followed by the full residual in WAVEFORM_RICE_ESCAPE_BITS bits.
+ * Predictor history carries across partitions and starts at zero. */
+#define WAVEFORM_CODEC_RICE          0x01       /* Never the first byte of a zlib stream */
+#define WAVEFORM_RICE_PARTITION      32         /* Samples per partition */
+#define WAVEFORM_RICE_MAX_K          24         /* Largest Rice parameter */
+#define WAVEFORM_RICE_ESCAPE         16         /* Quotient that switches to a raw residual */
+#define WAVEFORM_RICE_ESCAPE_BITS    27         /* Zigzag residual of a 24-bit order-2 prediction */
+
 /* Status flags for waveform capture */
 #define STATUS_FLAG_CALIBRATED       0x01       /* Sensor has been calibrated */
 #define STATUS_FLAG_TEMP_VALID       0x02       /* Temperature reading valid */
@@ -36,7 +52,7 @@
 #define STATUS_FLAG_ERROR            0x80       /* General error flag */
 
 /*******************************************************************************
- * Waveform Block Header Structure (40 bytes)
+ * Waveform Block Header Structure (38 bytes, layout in psoc_driver/wire_format.h)
  *******************************************************************************/
 typedef struct __attribute__((packed)) {
     /* Block identification */
@@ -64,9 +80,26 @@ typedef struct __attribute__((packed)) {
     uint32_t crc32;                 /* CRC32 of sample data for validation */
 
     /* Reserved for future use */
-    uint16_t reserved[2];           /* Padding to 40 bytes */
+    uint16_t reserved[2];           /* Padding to 38 bytes */
 } waveform_block_header_t;
 
+PSOC_WIRE_CHECK_SIZE(waveform_block_header_t, WAVEFORM_HEADER_SIZE);
+PSOC_WIRE_CHECK_FIELD(waveform_block_header_t, block_number, WAVEFORM_HDR_BLOCK_NUMBER);
+PSOC_WIRE_CHECK_FIELD(waveform_block_header_t, timestamp_ms, WAVEFORM_HDR_TIMESTAMP_MS);
+PSOC_WIRE_CHECK_FIELD(waveform_block_header_t, sample_rate_hz, WAVEFORM_HDR_SAMPLE_RATE_HZ);
+PSOC_WIRE_CHECK_FIELD(waveform_block_header_t, sample_count, WAVEFORM_HDR_SAMPLE_COUNT);
+PSOC_WIRE_CHECK_FIELD(waveform_block_header_t, bits_per_sample, WAVEFORM_HDR_BITS_PER_SAMPLE);
+PSOC_WIRE_CHECK_FIELD(waveform_block_header_t, trigger_sample, WAVEFORM_HDR_TRIGGER_SAMPLE);
+PSOC_WIRE_CHECK_FIELD(waveform_block_header_t, pulse_freq_hz, WAVEFORM_HDR_PULSE_FREQ_HZ);
+PSOC_WIRE_CHECK_FIELD(waveform_block_header_t, pulse_cycles, WAVEFORM_HDR_PULSE_CYCLES);
+PSOC_WIRE_CHECK_FIELD(waveform_block_header_t, pulse_voltage, WAVEFORM_HDR_PULSE_VOLTAGE);
+PSOC_WIRE_CHECK_FIELD(waveform_block_header_t, sensor_id, WAVEFORM_HDR_SENSOR_ID);
+PSOC_WIRE_CHECK_FIELD(waveform_block_header_t, temperature_c_x10, WAVEFORM_HDR_TEMPERATURE_CX10);
+PSOC_WIRE_CHECK_FIELD(waveform_block_header_t, gain_db, WAVEFORM_HDR_GAIN_DB);
+PSOC_WIRE_CHECK_FIELD(waveform_block_header_t, status_flags, WAVEFORM_HDR_STATUS_FLAGS);
+PSOC_WIRE_CHECK_FIELD(waveform_block_header_t, crc32, WAVEFORM_HDR_CRC32);
+PSOC_WIRE_CHECK_FIELD(waveform_block_header_t, reserved, WAVEFORM_HDR_RESERVED);
+
 /*******************************************************************************
  * Function Prototypes
  *******************************************************************************/
@@ -78,6 +111,9 @@ void app_waveform_init(void);
 
 /**
  * Generate a simulated ultrasound waveform for a given block number
+ * The output depends only on block_num, so a block can be generated again.
+ * Echo arrival (a few samples) and amplitude (a few percent) vary with block_num,
+ * so consecutive blocks carry different signals.
  *
  * @param block_num Block number (0-1799)
  * @param header Pointer to header structure to fill
@@ -87,14 +123,15 @@ void app_waveform_init(void);
 bool app_waveform_generate(uint32_t block_num, waveform_block_header_t *header, uint8_t *samples);
 
 /**
- * Compress a waveform block using delta encoding + DEFLATE
+ * Compress a waveform block losslessly (prediction + Rice coding, see WAVEFORM_CODEC_RICE)
+ * Low-amplitude noise between echoes codes in a few bits per sample.
  *
  * @param header Waveform header
  * @param raw_samples Raw 24-bit samples (7128 bytes)
  * @param compressed_out Output buffer for compressed data
  * @param compressed_size_out Pointer to store compressed size
  * @param max_compressed_size Maximum size of output buffer
- * @return true if successful, false on error
+ * @return true if successful, false if the output does not fit
  */
 bool app_waveform_compress(const waveform_block_header_t *header,
                            const uint8_t *raw_samples,
@@ -103,7 +140,7 @@ bool app_waveform_compress(const waveform_block_header_t *header,
                            uint32_t max_compressed_size);
 
 /**
- * Decompress a waveform block
+ * Decompress a waveform block produced by app_waveform_compress
  *
  * @param compressed_data Compressed data buffer
  * @param compressed_size Size of compressed data
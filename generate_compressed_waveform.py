@@ -2,8 +2,13 @@
 """
 Generate a pre-compressed waveform for benchmark testing.
 This creates a static C array that can be embedded in the PSoC firmware.
+
+Also writes waveform_model_tables.h, the echo recurrence coefficients and
+carrier sine table app_waveform.c uses, so the firmware does no expf/cosf/sinf
+at start-up or per block. Run with --tables-only to write just that header.
 """
 
+import argparse
 import struct
 import zlib
 import math
@@ -28,6 +33,9 @@ THIRD_ECHO_TIME_SAMPLES = 1250
 ECHO_DURATION_SAMPLES = 100
 ECHO_DECAY_RATE = 0.03
 
+# Per-echo decay of the firmware model (the third echo decays faster)
+ECHO_DECAY_RATES = [ECHO_DECAY_RATE, ECHO_DECAY_RATE, ECHO_DECAY_RATE * 1.5]
+
 def generate_baseline_noise(sample_index, seed=12345):
     """Simple PRNG for noise"""
     # Linear congruential generator
@@ -124,7 +132,77 @@ def generate_c_array(data, name):
 
     return '\n'.join(lines)
 
+def c_float(value):
+    """Format a float literal that rounds to the nearest single-precision value"""
+    if abs(value) < 1e-9:
+        value = 0.0  # sin(pi) and friends
+    text = f"{struct.unpack('<f', struct.pack('<f', value))[0]:.9g}"
+    if '.' not in text and 'e' not in text:
+        text += '.0'
+    return text + 'f'
+
+def generate_model_tables():
+    """Write the echo recurrence coefficients and carrier sine table"""
+    period = SAMPLE_RATE_HZ // CARRIER_FREQ_HZ
+    if period * CARRIER_FREQ_HZ != SAMPLE_RATE_HZ:
+        raise SystemExit("Carrier period must be a whole number of samples")
+
+    # y[n+1] = 2 r cos(w) y[n] - r^2 y[n-1],  r = exp(-decay), w = 2 pi f / fs
+    omega = 2.0 * PI * CARRIER_FREQ_HZ / SAMPLE_RATE_HZ
+    echo_lines = []
+    for index, decay in enumerate(ECHO_DECAY_RATES, start=1):
+        ratio = math.exp(-decay)
+        echo_lines.append(f"/* Echo {index}: decay {decay:g} per sample */")
+        echo_lines.append(f"#define WAVEFORM_ECHO{index}_RATIO   {c_float(ratio)}")
+        echo_lines.append(f"#define WAVEFORM_ECHO{index}_COEFF1  {c_float(2.0 * ratio * math.cos(omega))}")
+        echo_lines.append(f"#define WAVEFORM_ECHO{index}_COEFF2  {c_float(ratio * ratio)}")
+    echo_defines = '\n'.join(echo_lines)
+
+    sine = ', '.join(c_float(math.sin(omega * k)) for k in range(period))
+
+    c_code = f"""/*
+ * Waveform model tables for app_waveform.c
+ * Generated by generate_compressed_waveform.py
+ *
+ * Echo recurrence coefficients and one carrier period of sine, computed here
+ * so the firmware keeps them in flash instead of calling expf/cosf/sinf.
+ * Sample rate: {SAMPLE_RATE_HZ} Hz, carrier: {CARRIER_FREQ_HZ} Hz
+ */
+
+#ifndef WAVEFORM_MODEL_TABLES_H_
+#define WAVEFORM_MODEL_TABLES_H_
+
+/* Rates the tables were computed for (checked against app_waveform.h) */
+#define WAVEFORM_MODEL_SAMPLE_RATE_HZ   {SAMPLE_RATE_HZ}
+#define WAVEFORM_MODEL_CARRIER_FREQ_HZ  {CARRIER_FREQ_HZ}
+
+/* Echo recurrence: r, 2 r cos(w) and r^2 */
+{echo_defines}
+
+/* sin(2 pi k / period): the carrier at sample n is entry n % period */
+#define WAVEFORM_CARRIER_PERIOD_SAMPLES {period}
+static const float waveform_carrier_sine[WAVEFORM_CARRIER_PERIOD_SAMPLES] = {{
+    {sine}
+}};
+
+#endif /* WAVEFORM_MODEL_TABLES_H_ */
+"""
+
+    with open('waveform_model_tables.h', 'w') as f:
+        f.write(c_code)
+
+    print("Wrote waveform_model_tables.h")
+
 def main():
+    parser = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    parser.add_argument('--tables-only', action='store_true',
+                        help='only write waveform_model_tables.h')
+    args = parser.parse_args()
+
+    generate_model_tables()
+    if args.tables_only:
+        return
+
     print("Generating reference waveform...")
     samples = generate_waveform()
 
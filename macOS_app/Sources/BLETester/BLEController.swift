@@ -26,6 +26,8 @@ class BLEController: NSObject, ObservableObject {
 
     // PSoC Driver Session
     private var transferSession: PSoCTransferSession?
+    private var displayTimer: Timer?
+    private var statsTimer: Timer?
 
     override init() {
         super.init()
@@ -36,18 +38,16 @@ class BLEController: NSObject, ObservableObject {
     private func setupTransferSession() {
         transferSession = PSoCTransferSession()
 
-        // Waveform callback
-        transferSession?.onWaveform = { [weak self] waveform in
-            guard let self = self else { return }
-            self.currentWaveform = waveform
-            self.currentMode = waveform.isCompressed ? "Compressed" : "Uncompressed"
-            self.waveformFlashTrigger = UUID()
+        // Waveforms land in the driver's ring; pick up the newest at display rate
+        transferSession?.enableWaveformRing(capacity: 4)
+        displayTimer = Timer.scheduledTimer(withTimeInterval: 1.0 / 30.0, repeats: true) { [weak self] _ in
+            self?.showLatestWaveform()
         }
 
-        // Progress callback
-        transferSession?.onProgress = { [weak self] stats in
-            guard let self = self else { return }
-            self.transferStats = stats
+        // Stats are pulled from the driver's snapshot at 10 Hz instead of pushed per block
+        statsTimer = Timer.scheduledTimer(withTimeInterval: 0.1, repeats: true) { [weak self] _ in
+            guard let self = self, self.isTransferActive else { return }
+            self.transferStats = self.transferSession?.getStats()
         }
 
         // Completion callback
@@ -66,6 +66,19 @@ class BLEController: NSObject, ObservableObject {
             guard let self = self else { return }
             self.sendAck(forBlock: blockNumber)
         }
+
+        // Selective ACK callback
+        transferSession?.onSack = { [weak self] message in
+            guard let self = self else { return }
+            self.sendSack(message)
+        }
+    }
+
+    private func showLatestWaveform() {
+        guard let waveform = transferSession?.latestWaveform() else { return }
+        currentWaveform = waveform
+        currentMode = waveform.isCompressed ? "Compressed" : "Uncompressed"
+        waveformFlashTrigger = UUID()
     }
 
     func startScanning() {
@@ -73,6 +86,9 @@ class BLEController: NSObject, ObservableObject {
         centralManager.scanForPeripherals(withServices: nil, options: nil)
         connectionStateText = "Scanning..."
         connectionStateColor = .orange
+
+        // Get the session ready for the first block while the device is found and connected
+        transferSession?.prewarm()
     }
 
     func startTransfer() {
@@ -92,6 +108,7 @@ class BLEController: NSObject, ObservableObject {
         data.append(0x01)  // CMD_START
         data.append(contentsOf: withUnsafeBytes(of: UInt16(0).littleEndian) { Data($0) })
         data.append(contentsOf: withUnsafeBytes(of: UInt32(Date().timeIntervalSince1970).littleEndian) { Data($0) })
+        data.append(0x01)  // START_FLAG_PACKED_FRAMING: tail and head of consecutive blocks share notifications
 
         peripheral.writeValue(data, for: characteristic, type: .withoutResponse)
 
@@ -137,6 +154,16 @@ class BLEController: NSObject, ObservableObject {
 
         peripheral.writeValue(data, for: characteristic, type: .withoutResponse)
     }
+
+    private func sendSack(_ message: Data) {
+        guard let characteristic = controlCharacteristic,
+              let peripheral = peripheral else {
+            return
+        }
+
+        // CMD_SACK, built by the driver
+        peripheral.writeValue(message, for: characteristic, type: .withoutResponse)
+    }
 }
 
 // MARK: - CBCentralManagerDelegate
@@ -275,6 +302,12 @@ extension BLEController: CBPeripheralDelegate {
         if characteristic.uuid == dataBlockUUID {
             if characteristic.isNotifying {
                 print("Subscribed to Data Block notifications")
+
+                // Reconnected mid-transfer: the firmware skips what we already have
+                if isTransferActive {
+                    transferSession?.resume()
+                    print("Transfer resumed")
+                }
             }
         }
     }
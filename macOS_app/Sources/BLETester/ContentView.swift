@@ -140,7 +140,7 @@ struct ContentView: View {
                     HStack {
                         Text("Rate:")
                         Spacer()
-                        Text(String(format: "%.1f KB/s", stats.throughputKBps))
+                        Text(String(format: "%.1f KB/s", stats.ewmaThroughputKBps))
                             .fontWeight(.semibold)
                     }
 
@@ -163,7 +163,7 @@ struct ContentView: View {
                             HStack {
                                 Text("Remaining:")
                                 Spacer()
-                                Text(formatTime(estimateRemaining(stats: stats)))
+                                Text(formatTime(stats.etaSeconds))
                                     .fontWeight(.semibold)
                                     .foregroundColor(.orange)
                             }
@@ -171,7 +171,7 @@ struct ContentView: View {
                             HStack {
                                 Text("Est. Total:")
                                 Spacer()
-                                Text(formatTime(estimateTotal(stats: stats)))
+                                Text(formatTime(stats.elapsedSeconds + stats.etaSeconds))
                                     .fontWeight(.semibold)
                                     .foregroundColor(.secondary)
                             }
@@ -239,18 +239,6 @@ struct ContentView: View {
             return String(format: "%.1fs", seconds)
         }
     }
-
-    private func estimateRemaining(stats: PSoCTransferStats) -> Double {
-        guard stats.throughputKBps > 0 else { return 0 }
-        let remainingBytes = Double((stats.totalBlocks - stats.blocksReceived) * 7168)
-        return remainingBytes / (stats.throughputKBps * 1000.0)
-    }
-
-    private func estimateTotal(stats: PSoCTransferStats) -> Double {
-        guard stats.throughputKBps > 0 else { return 0 }
-        let totalBytes = Double(stats.totalBlocks * 7168)
-        return totalBytes / (stats.throughputKBps * 1000.0)
-    }
 }
 
 // Wrapper view to add flash animation
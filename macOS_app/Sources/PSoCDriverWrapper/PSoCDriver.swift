@@ -49,6 +49,15 @@ public struct PSoCWaveform {
         }
         self.isCompressed = isCompressed
     }
+
+    // Read straight from driver memory (a waveform ring entry) without copying the C struct
+    init(from cWaveform: UnsafePointer<waveform_data_t>, isCompressed: Bool) {
+        self.header = PSoCWaveformHeader(from: cWaveform.pointee.header)
+        let samplesOffset = MemoryLayout<waveform_data_t>.offset(of: \waveform_data_t.samples)!
+        let samplesPtr = (UnsafeRawPointer(cWaveform) + samplesOffset).assumingMemoryBound(to: Int32.self)
+        self.samples = Array(UnsafeBufferPointer(start: samplesPtr, count: Int(SAMPLES_PER_WAVEFORM)))
+        self.isCompressed = isCompressed
+    }
 }
 
 public struct PSoCTransferStats {
@@ -59,6 +68,9 @@ public struct PSoCTransferStats {
     public let throughputKBps: Double
     public let progressPercent: Double
     public let elapsedSeconds: Double
+    public let ewmaThroughputKBps: Double
+    public let instantThroughputKBps: Double
+    public let etaSeconds: Double
 
     init(from cStats: transfer_stats_t) {
         self.blocksReceived = cStats.blocks_received
@@ -68,15 +80,127 @@ public struct PSoCTransferStats {
         self.throughputKBps = cStats.throughput_kbps
         self.progressPercent = cStats.progress_percent
         self.elapsedSeconds = cStats.elapsed_seconds
+        self.ewmaThroughputKBps = cStats.ewma_throughput_kbps
+        self.instantThroughputKBps = cStats.instant_throughput_kbps
+        self.etaSeconds = cStats.eta_seconds
+    }
+}
+
+/// Latency summary of one pipeline stage, in microseconds
+public struct PSoCStageLatency {
+    public let count: UInt64
+    public let meanUs: Double
+    public let p50Us: Double
+    public let p99Us: Double
+    public let maxUs: Double
+}
+
+/// Per-stage latency and link metrics (driver built with PSOC_DRIVER_METRICS)
+public struct PSoCTransferMetrics {
+    public let chunkIngest: PSoCStageLatency
+    public let blockAssembly: PSoCStageLatency
+    public let decode: PSoCStageLatency
+    public let crc: PSoCStageLatency
+    public let callback: PSoCStageLatency
+    public let chunkInterval: PSoCStageLatency
+    public let jitterUs: Double
+    public let chunksPerEvent: [UInt32]
+    public let outOfOrderChunks: UInt32
+    public let duplicateChunks: UInt32
+
+    init(from cMetrics: transfer_metrics_t) {
+        var metrics = cMetrics
+        func summarize(_ stage: metrics_stage_t) -> PSoCStageLatency {
+            let histogram = withUnsafeBytes(of: &metrics.stages) { stages in
+                stages.bindMemory(to: latency_histogram_t.self)[Int(stage.rawValue)]
+            }
+            return PSoCStageLatency(
+                count: histogram.count,
+                meanUs: histogram.count > 0 ? Double(histogram.sum_ns) / Double(histogram.count) / 1000.0 : 0,
+                p50Us: Double(metrics_percentile_ns(&metrics, stage, 50)) / 1000.0,
+                p99Us: Double(metrics_percentile_ns(&metrics, stage, 99)) / 1000.0,
+                maxUs: Double(histogram.max_ns) / 1000.0)
+        }
+        self.chunkIngest = summarize(METRICS_STAGE_CHUNK_INGEST)
+        self.blockAssembly = summarize(METRICS_STAGE_BLOCK_ASSEMBLY)
+        self.decode = summarize(METRICS_STAGE_DECODE)
+        self.crc = summarize(METRICS_STAGE_CRC)
+        self.callback = summarize(METRICS_STAGE_CALLBACK)
+        self.chunkInterval = summarize(METRICS_STAGE_CHUNK_INTERVAL)
+        self.jitterUs = Double(metrics.jitter_ns) / 1000.0
+        self.chunksPerEvent = withUnsafeBytes(of: &metrics.chunks_per_event) { Array($0.bindMemory(to: UInt32.self)) }
+        self.outOfOrderChunks = metrics.out_of_order_chunks
+        self.duplicateChunks = metrics.duplicate_chunks
+    }
+}
+
+// A block delivered before decoding: always the header, and the samples only
+// when the session's decodeSamples asked for them and they passed the CRC
+public struct PSoCLazyWaveform {
+    public let header: PSoCWaveformHeader
+    public let isCompressed: Bool
+    public let waveform: PSoCWaveform?
+}
+
+public struct PSoCEcho {
+    public let sampleIndex: UInt16
+    public let startSample: UInt16
+    public let endSample: UInt16
+    public let amplitude: Int32
+    public let timeUs: Float
+}
+
+// Envelope, range and echoes of one waveform; waveform is only set when the
+// session's wantsSamples asked for it
+public struct PSoCWaveformSummary {
+    public let header: PSoCWaveformHeader
+    public let isCompressed: Bool
+    public let minSample: Int32
+    public let maxSample: Int32
+    public let echoes: [PSoCEcho]
+    public let envelopeMin: [Int32]
+    public let envelopeMax: [Int32]
+    public internal(set) var waveform: PSoCWaveform?
+
+    init(from cSummary: UnsafePointer<waveform_summary_t>) {
+        let summary = cSummary.pointee
+        self.header = PSoCWaveformHeader(from: summary.header)
+        self.isCompressed = summary.is_compressed
+        self.minSample = summary.min_sample
+        self.maxSample = summary.max_sample
+        var cEchoes = summary.echoes
+        self.echoes = withUnsafeBytes(of: &cEchoes) { bytes in
+            bytes.bindMemory(to: waveform_echo_t.self).prefix(Int(summary.echo_count)).map {
+                PSoCEcho(sampleIndex: $0.sample_index, startSample: $0.start_sample, endSample: $0.end_sample,
+                         amplitude: $0.amplitude, timeUs: $0.time_us)
+            }
+        }
+        let width = Int(summary.envelope_width)
+        if width > 0, let minPtr = summary.envelope_min, let maxPtr = summary.envelope_max {
+            self.envelopeMin = Array(UnsafeBufferPointer(start: minPtr, count: width))
+            self.envelopeMax = Array(UnsafeBufferPointer(start: maxPtr, count: width))
+        } else {
+            self.envelopeMin = []
+            self.envelopeMax = []
+        }
+        self.waveform = nil
     }
 }
 
 public class PSoCTransferSession {
     private var session: OpaquePointer?
+    private var archive: OpaquePointer?
     public var onWaveform: ((PSoCWaveform) -> Void)?
     public var onProgress: ((PSoCTransferStats) -> Void)?
     public var onCompletion: ((PSoCTransferStats) -> Void)?
     public var onAck: ((UInt16) -> Void)?
+    public var onSack: ((Data) -> Void)?
+    public var onSummary: ((PSoCWaveformSummary) -> Void)?
+    /// With enableSummary: decides, on the driver's thread, whether a summary also carries the full samples
+    public var wantsSamples: ((PSoCWaveformSummary) -> Bool)?
+    public var onLazyWaveform: ((PSoCLazyWaveform) -> Void)?
+    /// With enableLazyDelivery: decides, on the driver's thread, whether a block's samples are decoded
+    public var decodeSamples: ((PSoCWaveformHeader) -> Bool)?
 
     public init() {
         session = transfer_session_create()
@@ -84,6 +208,7 @@ public class PSoCTransferSession {
     }
 
     deinit {
+        stopArchive()
         if let session = session {
             transfer_session_destroy(session)
         }
@@ -97,6 +222,7 @@ public class PSoCTransferSession {
         transfer_session_set_waveform_callback(session, { waveformPtr, isCompressed, userData in
             guard let waveformPtr = waveformPtr, let userData = userData else { return }
             let selfRef = Unmanaged<PSoCTransferSession>.fromOpaque(userData).takeUnretainedValue()
+            guard selfRef.onWaveform != nil else { return }  // UI uses onSummary instead
             let waveform = waveformPtr.pointee
             let swiftWaveform = PSoCWaveform(from: waveform, isCompressed: isCompressed)
             DispatchQueue.main.async {
@@ -109,6 +235,7 @@ public class PSoCTransferSession {
         transfer_session_set_progress_callback(session, { statsPtr, userData in
             guard let statsPtr = statsPtr, let userData = userData else { return }
             let selfRef = Unmanaged<PSoCTransferSession>.fromOpaque(userData).takeUnretainedValue()
+            guard selfRef.onProgress != nil else { return }  // UI polls getStats() instead
             let stats = PSoCTransferStats(from: statsPtr.pointee)
             DispatchQueue.main.async {
                 selfRef.onProgress?(stats)
@@ -133,6 +260,21 @@ public class PSoCTransferSession {
             let selfRef = Unmanaged<PSoCTransferSession>.fromOpaque(userData).takeUnretainedValue()
             selfRef.onAck?(blockNumber)
         }, ackContext)
+
+        // Selective ACK callback
+        let sackContext = Unmanaged.passUnretained(self).toOpaque()
+        transfer_session_set_sack_callback(session, { messagePtr, length, userData in
+            guard let messagePtr = messagePtr, let userData = userData else { return }
+            let selfRef = Unmanaged<PSoCTransferSession>.fromOpaque(userData).takeUnretainedValue()
+            selfRef.onSack?(Data(bytes: messagePtr, count: length))
+        }, sackContext)
+    }
+
+    /// Allocate and warm up what the first blocks need, e.g. while scanning.
+    /// Call after the enable* options and before start().
+    public func prewarm() {
+        guard let session = session else { return }
+        transfer_session_prewarm(session)
     }
 
     public func start() {
@@ -145,6 +287,110 @@ public class PSoCTransferSession {
         transfer_session_stop(session)
     }
 
+    /// Continue after a reconnect, keeping everything received so far; the resume messages go out through onSack
+    public func resume() {
+        guard let session = session else { return }
+        transfer_session_resume(session)
+    }
+
+    /// Deliver waveforms through the driver's preallocated ring instead of onWaveform.
+    /// Poll it with latestWaveform(), e.g. from a display-rate timer.
+    @discardableResult
+    public func enableWaveformRing(capacity: UInt32) -> Bool {
+        guard let session = session else { return false }
+        return transfer_session_set_waveform_ring(session, capacity)
+    }
+
+    /// Newest waveform in the ring (older unread ones are skipped), or nil if none arrived
+    public func latestWaveform() -> PSoCWaveform? {
+        guard let session = session else { return nil }
+        var isCompressed = false
+        guard let waveformPtr = transfer_session_acquire_latest_waveform(session, &isCompressed) else { return nil }
+        defer { transfer_session_release_waveform(session) }
+        return PSoCWaveform(from: waveformPtr, isCompressed: isCompressed)
+    }
+
+    /// Waveforms the ring dropped because the UI had not read the previous ones
+    public var droppedWaveforms: UInt32 {
+        guard let session = session else { return 0 }
+        return transfer_session_get_dropped_waveforms(session)
+    }
+
+    /// Call onLazyWaveform with the header of every block instead of onWaveform, decoding
+    /// samples only where decodeSamples says so. Replaces the waveform ring and onSummary
+    /// too. Call before start().
+    public func enableLazyDelivery() {
+        guard let session = session else { return }
+        let lazyContext = Unmanaged.passUnretained(self).toOpaque()
+        transfer_session_set_lazy_waveform_callback(session, { handlePtr, userData in
+            guard let handlePtr = handlePtr, let userData = userData else { return }
+            let selfRef = Unmanaged<PSoCTransferSession>.fromOpaque(userData).takeUnretainedValue()
+            let header = PSoCWaveformHeader(from: handlePtr.pointee.header)
+            let isCompressed = handlePtr.pointee.is_compressed
+            // The encoded block is only valid during this callback
+            var waveform: PSoCWaveform? = nil
+            if let decodeSamples = selfRef.decodeSamples, decodeSamples(header) {
+                let decoded = UnsafeMutablePointer<waveform_data_t>.allocate(capacity: 1)
+                defer { decoded.deallocate() }
+                if waveform_handle_decode(handlePtr, decoded) {
+                    waveform = PSoCWaveform(from: UnsafePointer(decoded), isCompressed: isCompressed)
+                }
+            }
+            let lazy = PSoCLazyWaveform(header: header, isCompressed: isCompressed, waveform: waveform)
+            DispatchQueue.main.async {
+                selfRef.onLazyWaveform?(lazy)
+            }
+        }, lazyContext)
+    }
+
+    /// Call onSummary for every waveform, with an envelope envelopeWidth columns wide
+    /// (the plot's width in points) and the echoes found. Call before start().
+    public func enableSummary(envelopeWidth: UInt16) {
+        guard let session = session else { return }
+        var config = waveform_summary_config_t(envelope_width: envelopeWidth, echo_threshold: 0, echo_min_gap: 0)
+        let summaryContext = Unmanaged.passUnretained(self).toOpaque()
+        transfer_session_set_summary_callback(session, { summaryPtr, userData in
+            guard let summaryPtr = summaryPtr, let userData = userData else { return }
+            let selfRef = Unmanaged<PSoCTransferSession>.fromOpaque(userData).takeUnretainedValue()
+            var summary = PSoCWaveformSummary(from: summaryPtr)
+            // The full samples are only valid during this callback
+            if let wantsSamples = selfRef.wantsSamples, wantsSamples(summary), let waveformPtr = summaryPtr.pointee.waveform {
+                summary.waveform = PSoCWaveform(from: waveformPtr, isCompressed: summary.isCompressed)
+            }
+            DispatchQueue.main.async {
+                selfRef.onSummary?(summary)
+            }
+        }, &config, summaryContext)
+    }
+
+    /// Write every received block to a capture archive at path (replacing the file) until stopArchive()
+    @discardableResult
+    public func startArchive(path: String) -> Bool {
+        guard let session = session else { return false }
+        stopArchive()
+        guard let writer = capture_writer_open(path) else { return false }
+        archive = writer
+        transfer_session_set_archive(session, writer)
+        return true
+    }
+
+    /// Finish the capture archive (index and CRC footer); false if any write failed
+    @discardableResult
+    public func stopArchive() -> Bool {
+        guard let writer = archive else { return true }
+        if let session = session {
+            transfer_session_set_archive(session, nil)
+        }
+        archive = nil
+        return capture_writer_close(writer)
+    }
+
+    /// Blocks written to the capture archive so far (0 when not archiving)
+    public var archivedBlocks: UInt32 {
+        guard let writer = archive else { return 0 }
+        return capture_writer_block_count(writer)
+    }
+
     public func processChunk(data: Data) -> Bool {
         guard let session = session else { return false }
         return data.withUnsafeBytes { bytes in
@@ -153,6 +399,13 @@ public class PSoCTransferSession {
         }
     }
 
+    /// Limit onProgress to one event per interval or per block count (0 disables a limit)
+    public func setProgressInterval(minIntervalMs: UInt32, minBlocks: UInt32) {
+        guard let session = session else { return }
+        transfer_session_set_progress_interval(session, minIntervalMs, minBlocks)
+    }
+
+    /// Latest stats snapshot; lock-free, callable from any thread
     public func getStats() -> PSoCTransferStats? {
         guard let session = session else { return nil }
         var stats = transfer_stats_t()
@@ -160,6 +413,14 @@ public class PSoCTransferSession {
         return PSoCTransferStats(from: stats)
     }
 
+    /// Per-stage latency and link metrics, or nil if the driver was built without them
+    public func getMetrics() -> PSoCTransferMetrics? {
+        guard let session = session else { return nil }
+        var metrics = transfer_metrics_t()
+        guard transfer_session_get_metrics(session, &metrics) else { return nil }
+        return PSoCTransferMetrics(from: metrics)
+    }
+
     public var isActive: Bool {
         guard let session = session else { return false }
         return transfer_session_is_active(session)
@@ -5,7 +5,10 @@
 #include "../../../shared_driver/include/psoc_driver/protocol.h"
 #include "../../../shared_driver/include/psoc_driver/data_types.h"
 #include "../../../shared_driver/include/psoc_driver/crc32.h"
+#include "../../../shared_driver/include/psoc_driver/sample_unpack.h"
 #include "../../../shared_driver/include/psoc_driver/compression.h"
+#include "../../../shared_driver/include/psoc_driver/metrics.h"
+#include "../../../shared_driver/include/psoc_driver/capture_archive.h"
 #include "../../../shared_driver/include/psoc_driver/transfer_session.h"
 
 #endif // PSOC_DRIVER_WRAPPER_H
@@ -32,6 +32,7 @@ cat > "$BUILD_DIR/BridgingHeader.h" << 'EOF'
 #import "../../shared_driver/include/psoc_driver/protocol.h"
 #import "../../shared_driver/include/psoc_driver/data_types.h"
 #import "../../shared_driver/include/psoc_driver/crc32.h"
+#import "../../shared_driver/include/psoc_driver/sample_unpack.h"
 #import "../../shared_driver/include/psoc_driver/compression.h"
 #import "../../shared_driver/include/psoc_driver/transfer_session.h"
 
@@ -60,6 +60,8 @@
 #include "app_bt_gatt_handler.h"
 #include "app_bt_utils.h"
 #include "app_data_transfer.h"
+#include "app_link_tuner.h"
+#include "app_buffer_pool.h"
 #include "wiced_bt_ble.h"
 #include "wiced_bt_uuid.h"
 #include "wiced_memory.h"
@@ -82,6 +84,10 @@
 #define MIN_TEMPERATURE_LIMIT           (2000u)
 #define DELTA_TEMPERATURE               (100u)
 
+/* Task notification bit for the temperature timer; the data transfer module
+ * uses the DATA_TASK_NOTIFY_* bits */
+#define DATA_TASK_NOTIFY_TIMER          (1UL << 0)
+
 /* Number of advertisment packet */
 #define NUM_ADV_PACKETS                 (3u)
 
@@ -184,6 +190,9 @@ int main(void)
 
     printf("****** Inductosense RTC Data Transfer ******\n");
 
+    /* Buffers for the stack come from fixed pools, ready before it starts */
+    app_buffer_pool_init();
+
     /* Register call back and configuration with stack */
     wiced_result = wiced_bt_stack_init(app_bt_management_callback,
                                  &wiced_bt_cfg_settings);
@@ -207,6 +216,26 @@ int main(void)
         printf("Data Transfer Service Task creation failed\n");
     }
 
+    /* Lower-priority task that generates blocks ahead of the sender */
+    if (app_data_transfer_create_producer())
+    {
+        printf("Block Producer Task created successfully\n");
+    }
+    else
+    {
+        printf("Block Producer Task creation failed\n");
+    }
+
+    /* Idle-priority task that prints deferred log messages */
+    if (app_telemetry_create_task())
+    {
+        printf("Log Task created successfully\n");
+    }
+    else
+    {
+        printf("Log Task creation failed\n");
+    }
+
     /* Start the FreeRTOS scheduler */
     vTaskStartScheduler();
 
@@ -294,6 +323,10 @@ app_bt_management_callback(wiced_bt_management_evt_t event,
         printf("Status:              0x%02X\n", p_conn_params->status);
         printf("========================================\n\n");
 
+        /* Pacing follows the new interval; the tuner judges it */
+        app_link_tuner_conn_params_updated(p_conn_params->status, p_conn_params->conn_interval,
+                                           p_conn_params->conn_latency);
+
         /* Calculate max throughput based on connection interval */
         float interval_ms = p_conn_params->conn_interval * 1.25;
         float max_packets_per_sec = 1000.0 / interval_ms;
@@ -316,6 +349,8 @@ app_bt_management_callback(wiced_bt_management_evt_t event,
                               p_phy_update->rx_phy == 1 ? "LE 1M (1 Mbps)" : "Unknown");
         printf("Status: 0x%02X\n", p_phy_update->status);
         printf("========================================\n\n");
+
+        app_link_tuner_phy_updated(p_phy_update->status, p_phy_update->tx_phy, p_phy_update->rx_phy);
         status = WICED_BT_SUCCESS;
     }break;
 
@@ -330,6 +365,9 @@ app_bt_management_callback(wiced_bt_management_evt_t event,
         printf("Max RX Octets: %d bytes\n", p_data_len->max_rx_octets);
         printf("Max RX Time:   %d microseconds\n", p_data_len->max_rx_time);
         printf("========================================\n\n");
+
+        /* Size notification credits to what the new PDU length can carry */
+        app_link_tuner_data_length_updated(p_data_len->max_tx_octets, p_data_len->max_tx_time);
         status = WICED_BT_SUCCESS;
     }break;
 
@@ -405,6 +443,9 @@ static void bt_app_init(void)
     /* Start Bluetooth LE advertisements */
     app_start_advertisement();
 
+    /* Generate the first blocks while the phone finds and connects to us */
+    app_data_transfer_prestage();
+
 }
 
 
@@ -473,7 +514,7 @@ void data_transfer_timer_callb(void *callback_arg, cyhal_timer_event_t event)
 {
     BaseType_t xHigherPriorityTaskWoken;
     xHigherPriorityTaskWoken = pdFALSE;
-    vTaskNotifyGiveFromISR(data_transfer_task_handle, &xHigherPriorityTaskWoken);
+    xTaskNotifyFromISR(data_transfer_task_handle, DATA_TASK_NOTIFY_TIMER, eSetBits, &xHigherPriorityTaskWoken);
     portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
 }
 
@@ -496,22 +537,30 @@ void data_transfer_task(void *pvParam)
 
     while(true)
     {
+        /* Measure the link and renegotiate its parameters when due */
+        app_link_tuner_poll();
+
         /* Process data transfer chunks continuously when active */
         if (app_data_transfer_process_next_chunk())
         {
-            /* Use adaptive delay based on congestion detection.
-             * Delay automatically adjusts from 2-100ms based on BLE stack congestion.
-             * Starts at 10ms, speeds up on success, backs off on congestion. */
-            uint16_t delay_ms = app_data_transfer_get_recommended_delay();
-            vTaskDelay(pdMS_TO_TICKS(delay_ms));
+            /* Fill every free credit back to back. Once blocked (out of credits,
+             * window full or block not ready yet) sleep until a TX-complete,
+             * control or producer event; the timeout only covers SACK probes.
+             * The timer bit is left pending for when the transfer ends. */
+            uint32_t wait_ms = app_data_transfer_get_wait_ms();
+            if (wait_ms > 0)
+            {
+                (void)xTaskNotifyWait(0, DATA_TASK_NOTIFY_TRANSFER_EVENTS, NULL, pdMS_TO_TICKS(wait_ms));
+            }
             continue;  /* Keep processing chunks */
         }
 
         /* If no data transfer active, wait for timer with timeout */
-        uint32_t notif = ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(100));
-
-        if (notif == 0) {
-            /* Timeout - just loop back to check data transfer */
+        uint32_t events = 0;
+        if (xTaskNotifyWait(0, ~0UL, &events, pdMS_TO_TICKS(100)) != pdTRUE ||
+            (events & DATA_TASK_NOTIFY_TIMER) == 0)
+        {
+            /* Timeout or transfer event - just loop back to check data transfer */
             continue;
         }
 
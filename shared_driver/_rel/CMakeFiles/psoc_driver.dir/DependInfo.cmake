@@ -0,0 +1,29 @@
+
+# Consider dependencies only in project.
+set(CMAKE_DEPENDS_IN_PROJECT_ONLY OFF)
+
+# The set of languages for which implicit dependencies are needed:
+set(CMAKE_DEPENDS_LANGUAGES
+  )
+
+# The set of dependency files which are needed:
+set(CMAKE_DEPENDS_DEPENDENCY_FILES
+  "/root/repo/shared_driver/src/capture_archive.cpp" "CMakeFiles/psoc_driver.dir/src/capture_archive.cpp.o" "gcc" "CMakeFiles/psoc_driver.dir/src/capture_archive.cpp.o.d"
+  "/root/repo/shared_driver/src/compression.cpp" "CMakeFiles/psoc_driver.dir/src/compression.cpp.o" "gcc" "CMakeFiles/psoc_driver.dir/src/compression.cpp.o.d"
+  "/root/repo/shared_driver/src/crc32.cpp" "CMakeFiles/psoc_driver.dir/src/crc32.cpp.o" "gcc" "CMakeFiles/psoc_driver.dir/src/crc32.cpp.o.d"
+  "/root/repo/shared_driver/src/mapped_file.cpp" "CMakeFiles/psoc_driver.dir/src/mapped_file.cpp.o" "gcc" "CMakeFiles/psoc_driver.dir/src/mapped_file.cpp.o.d"
+  "/root/repo/shared_driver/src/metrics.cpp" "CMakeFiles/psoc_driver.dir/src/metrics.cpp.o" "gcc" "CMakeFiles/psoc_driver.dir/src/metrics.cpp.o.d"
+  "/root/repo/shared_driver/src/psoc_driver.cpp" "CMakeFiles/psoc_driver.dir/src/psoc_driver.cpp.o" "gcc" "CMakeFiles/psoc_driver.dir/src/psoc_driver.cpp.o.d"
+  "/root/repo/shared_driver/src/replay.cpp" "CMakeFiles/psoc_driver.dir/src/replay.cpp.o" "gcc" "CMakeFiles/psoc_driver.dir/src/replay.cpp.o.d"
+  "/root/repo/shared_driver/src/sample_unpack.cpp" "CMakeFiles/psoc_driver.dir/src/sample_unpack.cpp.o" "gcc" "CMakeFiles/psoc_driver.dir/src/sample_unpack.cpp.o.d"
+  "/root/repo/shared_driver/src/transfer_session.cpp" "CMakeFiles/psoc_driver.dir/src/transfer_session.cpp.o" "gcc" "CMakeFiles/psoc_driver.dir/src/transfer_session.cpp.o.d"
+  "/root/repo/shared_driver/src/waveform_summary.cpp" "CMakeFiles/psoc_driver.dir/src/waveform_summary.cpp.o" "gcc" "CMakeFiles/psoc_driver.dir/src/waveform_summary.cpp.o.d"
+  "/root/repo/shared_driver/src/worker_pool.cpp" "CMakeFiles/psoc_driver.dir/src/worker_pool.cpp.o" "gcc" "CMakeFiles/psoc_driver.dir/src/worker_pool.cpp.o.d"
+  )
+
+# Targets to which this target links.
+set(CMAKE_TARGET_LINKED_INFO_FILES
+  )
+
+# Fortran module output directory.
+set(CMAKE_Fortran_TARGET_MODULE_DIR "")
@@ -0,0 +1,31 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/psoc_driver.dir/src/capture_archive.cpp.o"
+  "CMakeFiles/psoc_driver.dir/src/capture_archive.cpp.o.d"
+  "CMakeFiles/psoc_driver.dir/src/compression.cpp.o"
+  "CMakeFiles/psoc_driver.dir/src/compression.cpp.o.d"
+  "CMakeFiles/psoc_driver.dir/src/crc32.cpp.o"
+  "CMakeFiles/psoc_driver.dir/src/crc32.cpp.o.d"
+  "CMakeFiles/psoc_driver.dir/src/mapped_file.cpp.o"
+  "CMakeFiles/psoc_driver.dir/src/mapped_file.cpp.o.d"
+  "CMakeFiles/psoc_driver.dir/src/metrics.cpp.o"
+  "CMakeFiles/psoc_driver.dir/src/metrics.cpp.o.d"
+  "CMakeFiles/psoc_driver.dir/src/psoc_driver.cpp.o"
+  "CMakeFiles/psoc_driver.dir/src/psoc_driver.cpp.o.d"
+  "CMakeFiles/psoc_driver.dir/src/replay.cpp.o"
+  "CMakeFiles/psoc_driver.dir/src/replay.cpp.o.d"
+  "CMakeFiles/psoc_driver.dir/src/sample_unpack.cpp.o"
+  "CMakeFiles/psoc_driver.dir/src/sample_unpack.cpp.o.d"
+  "CMakeFiles/psoc_driver.dir/src/transfer_session.cpp.o"
+  "CMakeFiles/psoc_driver.dir/src/transfer_session.cpp.o.d"
+  "CMakeFiles/psoc_driver.dir/src/waveform_summary.cpp.o"
+  "CMakeFiles/psoc_driver.dir/src/waveform_summary.cpp.o.d"
+  "CMakeFiles/psoc_driver.dir/src/worker_pool.cpp.o"
+  "CMakeFiles/psoc_driver.dir/src/worker_pool.cpp.o.d"
+  "libpsoc_driver.a"
+  "libpsoc_driver.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/psoc_driver.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,13 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/psoc_driver_bench.dir/bench/driver_bench.cpp.o"
+  "CMakeFiles/psoc_driver_bench.dir/bench/driver_bench.cpp.o.d"
+  "CMakeFiles/psoc_driver_bench.dir/root/repo/app_waveform.c.o"
+  "CMakeFiles/psoc_driver_bench.dir/root/repo/app_waveform.c.o.d"
+  "psoc_driver_bench"
+  "psoc_driver_bench.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang C CXX)
+  include(CMakeFiles/psoc_driver_bench.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,21 @@
+
+# Consider dependencies only in project.
+set(CMAKE_DEPENDS_IN_PROJECT_ONLY OFF)
+
+# The set of languages for which implicit dependencies are needed:
+set(CMAKE_DEPENDS_LANGUAGES
+  )
+
+# The set of dependency files which are needed:
+set(CMAKE_DEPENDS_DEPENDENCY_FILES
+  "/root/repo/app_waveform.c" "CMakeFiles/psoc_transfer_bench.dir/root/repo/app_waveform.c.o" "gcc" "CMakeFiles/psoc_transfer_bench.dir/root/repo/app_waveform.c.o.d"
+  "/root/repo/shared_driver/bench/transfer_bench.cpp" "CMakeFiles/psoc_transfer_bench.dir/bench/transfer_bench.cpp.o" "gcc" "CMakeFiles/psoc_transfer_bench.dir/bench/transfer_bench.cpp.o.d"
+  )
+
+# Targets to which this target links.
+set(CMAKE_TARGET_LINKED_INFO_FILES
+  "/root/repo/shared_driver/_rel/CMakeFiles/psoc_driver.dir/DependInfo.cmake"
+  )
+
+# Fortran module output directory.
+set(CMAKE_Fortran_TARGET_MODULE_DIR "")
@@ -0,0 +1,13 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/psoc_transfer_bench.dir/bench/transfer_bench.cpp.o"
+  "CMakeFiles/psoc_transfer_bench.dir/bench/transfer_bench.cpp.o.d"
+  "CMakeFiles/psoc_transfer_bench.dir/root/repo/app_waveform.c.o"
+  "CMakeFiles/psoc_transfer_bench.dir/root/repo/app_waveform.c.o.d"
+  "psoc_transfer_bench"
+  "psoc_transfer_bench.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang C CXX)
+  include(CMakeFiles/psoc_transfer_bench.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
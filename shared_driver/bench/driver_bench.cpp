@@ -0,0 +1,499 @@
+// Kernel microbenchmarks.
+//
+// Times the driver's per-block kernels one at a time, for every backend the
+// CPU supports: CRC32 (crc32.h), 24-bit unpack and the min/max envelope
+// (sample_unpack.h), the waveform summary (waveform_summary.h), header
+// parsing and the two decompressors (compression.h). Inputs are the reference
+// waveform in static_waveform_data.h and a set of seeded noise blocks, cycled
+// so that branch predictors cannot learn a single buffer.
+//
+// Output follows Google Benchmark: time per call, calls timed, throughput and
+// cycles per byte. Throughput counts the packed 24-bit sample bytes (7128 per
+// block) for every kernel but the header parse, decompressors included, so
+// rows compare directly. Cycles are TSC ticks on x86; pass --cpu-ghz to
+// convert from time instead (the only option on other CPUs).
+//
+//   psoc_driver_bench [--filter TEXT] [--min-time S] [--repetitions N]
+//                     [--noise-blocks N] [--seed N] [--cpu-ghz F]
+
+extern "C" {
+#include "app_waveform.h"
+}
+#include "static_waveform_data.h"
+#include "psoc_driver/psoc_driver.h"
+#include <zlib.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define PSOC_BENCH_TSC 1
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#endif
+
+// Chunk payload size at the default 247-byte MTU, for the streamed inflater
+#define STREAM_PIECE_SIZE (247 - 3 - CHUNK_HEADER_SIZE)
+
+// Envelope columns of a typical plot
+#define ENVELOPE_WIDTH 800
+
+struct bench_options {
+    std::string filter;         // run only benchmarks whose name contains this
+    double min_time;            // seconds per repetition
+    uint32_t repetitions;       // best repetition is reported
+    uint32_t noise_blocks;
+    uint32_t seed;
+    double cpu_ghz;             // 0 = TSC ticks where available
+};
+
+// One input block in every form the kernels consume
+struct bench_block {
+    std::vector<uint8_t> packed;        // 24-bit little-endian samples
+    std::vector<int32_t> samples;       // the same, sign-extended
+    std::vector<uint8_t> header;        // WAVEFORM_HEADER_SIZE bytes as sent
+    std::vector<uint8_t> zlib_delta;    // BLOCK_CODEC_ZLIB_DELTA payload
+    std::vector<uint8_t> rice;          // BLOCK_CODEC_RICE payload
+    bool zlib_exact;                    // zlib_delta decodes back to samples
+};
+
+struct bench_set {
+    const char* name;
+    std::vector<bench_block> blocks;
+};
+
+// Keeps results alive so the timed calls are not optimized away
+static volatile uint32_t sink;
+
+static uint64_t read_cycles(void) {
+#ifdef PSOC_BENCH_TSC
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+static int32_t sign_extend_24(const uint8_t* p) {
+    int32_t sample = p[0] | (p[1] << 8) | (p[2] << 16);
+    return (sample & 0x800000) ? (sample | ~0xFFFFFF) : sample;
+}
+
+static void put_u32(uint8_t* p, uint32_t value) {
+    p[0] = (uint8_t)value;
+    p[1] = (uint8_t)(value >> 8);
+    p[2] = (uint8_t)(value >> 16);
+    p[3] = (uint8_t)(value >> 24);
+}
+
+// Header as app_data_transfer.c sends it (see parse_waveform_header)
+static std::vector<uint8_t> build_header(uint32_t block_number, uint32_t crc) {
+    std::vector<uint8_t> header(WAVEFORM_HEADER_SIZE, 0);
+    put_u32(&header[0], block_number);
+    put_u32(&header[4], block_number * 100);
+    put_u32(&header[8], 50000000);
+    header[12] = (uint8_t)SAMPLES_PER_WAVEFORM;
+    header[13] = (uint8_t)(SAMPLES_PER_WAVEFORM >> 8);
+    put_u32(&header[18], 5000000);
+    header[28] = 40;
+    put_u32(&header[30], crc);
+    return header;
+}
+
+// zlib of 16-bit deltas, as generate_compressed_waveform.py builds the static blob
+static std::vector<uint8_t> encode_zlib_delta(const std::vector<int32_t>& samples) {
+    std::vector<uint8_t> deltas(samples.size() * 2);
+    int32_t prev = 0;
+    for (size_t i = 0; i < samples.size(); i++) {
+        int16_t delta = (int16_t)(samples[i] - prev);
+        prev = samples[i];
+        deltas[i * 2] = (uint8_t)delta;
+        deltas[i * 2 + 1] = (uint8_t)((uint16_t)delta >> 8);
+    }
+
+    uLongf size = compressBound((uLong)deltas.size());
+    std::vector<uint8_t> out(size);
+    if (compress(out.data(), &size, deltas.data(), (uLong)deltas.size()) != Z_OK) {
+        out.clear();
+        return out;
+    }
+    out.resize(size);
+    return out;
+}
+
+static std::vector<uint8_t> encode_rice(const std::vector<uint8_t>& packed) {
+    waveform_block_header_t header;
+    memset(&header, 0, sizeof(header));
+    header.sample_count = WAVEFORM_SAMPLES_PER_BLOCK;
+
+    std::vector<uint8_t> out(WAVEFORM_RAW_DATA_SIZE * 2);
+    uint32_t size = 0;
+    if (!app_waveform_compress(&header, packed.data(), out.data(), &size, (uint32_t)out.size())) {
+        size = 0;
+    }
+    out.resize(size);
+    return out;
+}
+
+static bench_block make_block(uint32_t block_number, const std::vector<uint8_t>& packed) {
+    bench_block block;
+    block.packed = packed;
+    block.samples.resize(SAMPLES_PER_WAVEFORM);
+    for (size_t i = 0; i < SAMPLES_PER_WAVEFORM; i++) {
+        block.samples[i] = sign_extend_24(&packed[i * 3]);
+    }
+    block.header = build_header(block_number, calculate_crc32_samples(block.samples.data(), SAMPLES_PER_WAVEFORM));
+    block.zlib_delta = encode_zlib_delta(block.samples);
+    block.zlib_exact = true;
+    block.rice = encode_rice(packed);
+    return block;
+}
+
+static bench_set make_static_set(void) {
+    bench_set set;
+    set.name = "static";
+    std::vector<uint8_t> packed(uncompressed_waveform_data, uncompressed_waveform_data + UNCOMPRESSED_WAVEFORM_DATA_SIZE);
+    set.blocks.push_back(make_block(0, packed));
+    // The blob the firmware's legacy path sends, rather than a re-encoding of it.
+    // Its generator clamps deltas to 16 bits, so it only approximates the samples.
+    set.blocks[0].zlib_delta.assign(compressed_waveform_data, compressed_waveform_data + COMPRESSED_WAVEFORM_DATA_SIZE);
+    set.blocks[0].zlib_exact = false;
+    return set;
+}
+
+// Gaussian noise around a slow ripple, sized to fit 16-bit deltas like real captures
+static bench_set make_noise_set(const bench_options& options) {
+    bench_set set;
+    set.name = "noise";
+    std::mt19937 rng(options.seed);
+    std::normal_distribution<double> noise(0.0, 1500.0);
+    std::uniform_real_distribution<double> phase(0.0, 6.283185307);
+
+    std::vector<uint8_t> packed(WAVEFORM_RAW_DATA_SIZE);
+    for (uint32_t b = 0; b < options.noise_blocks; b++) {
+        double offset = phase(rng);
+        for (size_t i = 0; i < SAMPLES_PER_WAVEFORM; i++) {
+            double value = 20000.0 * sin(offset + i * 0.01) + noise(rng);
+            int32_t sample = (int32_t)value;
+            packed[i * 3] = (uint8_t)sample;
+            packed[i * 3 + 1] = (uint8_t)(sample >> 8);
+            packed[i * 3 + 2] = (uint8_t)(sample >> 16);
+        }
+        set.blocks.push_back(make_block(b, packed));
+    }
+    return set;
+}
+
+// The decoders must reproduce the samples, or their timings mean nothing
+static bool check_set(const bench_set& set) {
+    std::vector<int32_t> decoded(SAMPLES_PER_WAVEFORM);
+    for (size_t b = 0; b < set.blocks.size(); b++) {
+        const bench_block& block = set.blocks[b];
+        size_t bytes = SAMPLES_PER_WAVEFORM * sizeof(int32_t);
+        if (block.zlib_delta.empty() || block.rice.empty()) {
+            fprintf(stderr, "%s block %u: encoding failed\n", set.name, (unsigned)b);
+            return false;
+        }
+        if (!decompress_waveform_zlib_delta(block.zlib_delta.data(), block.zlib_delta.size(), decoded.data()) ||
+            (block.zlib_exact && memcmp(decoded.data(), block.samples.data(), bytes) != 0)) {
+            fprintf(stderr, "%s block %u: zlib/delta round trip failed\n", set.name, (unsigned)b);
+            return false;
+        }
+        if (!decompress_waveform_rice(block.rice.data(), block.rice.size(), decoded.data()) ||
+            memcmp(decoded.data(), block.samples.data(), bytes) != 0) {
+            fprintf(stderr, "%s block %u: rice round trip failed\n", set.name, (unsigned)b);
+            return false;
+        }
+
+        // So must every envelope backend
+        for (int u = UNPACK_BACKEND_SCALAR; u <= UNPACK_BACKEND_NEON; u++) {
+            if (!unpack_set_backend((unpack_backend_t)u)) {
+                continue;
+            }
+            int32_t lo[ENVELOPE_WIDTH], hi[ENVELOPE_WIDTH];
+            samples_min_max_columns(block.samples.data(), SAMPLES_PER_WAVEFORM, ENVELOPE_WIDTH, lo, hi);
+            for (size_t c = 0; c < ENVELOPE_WIDTH; c++) {
+                size_t end = (c + 1) * SAMPLES_PER_WAVEFORM / ENVELOPE_WIDTH;
+                int32_t want_lo = block.samples[c * SAMPLES_PER_WAVEFORM / ENVELOPE_WIDTH], want_hi = want_lo;
+                for (size_t i = c * SAMPLES_PER_WAVEFORM / ENVELOPE_WIDTH; i < end; i++) {
+                    want_lo = std::min(want_lo, block.samples[i]);
+                    want_hi = std::max(want_hi, block.samples[i]);
+                }
+                if (lo[c] != want_lo || hi[c] != want_hi) {
+                    fprintf(stderr, "%s block %u: %s envelope column %u wrong\n", set.name, (unsigned)b,
+                            unpack_backend_name((unpack_backend_t)u), (unsigned)c);
+                    unpack_set_backend(UNPACK_BACKEND_AUTO);
+                    return false;
+                }
+            }
+        }
+        unpack_set_backend(UNPACK_BACKEND_AUTO);
+    }
+    return true;
+}
+
+struct bench_result {
+    uint64_t iterations;
+    double ns_per_call;
+    double cycles_per_call;
+};
+
+// Double the iteration count until one run lasts min_time; keep the best repetition
+static bench_result run_benchmark(const std::function<void(size_t)>& body, const bench_options& options) {
+    bench_result best = { 0, 0.0, 0.0 };
+    for (uint32_t r = 0; r < options.repetitions; r++) {
+        uint64_t iterations = 1;
+        for (;;) {
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            uint64_t cycles_start = read_cycles();
+            for (uint64_t i = 0; i < iterations; i++) {
+                body((size_t)i);
+            }
+            uint64_t cycles = read_cycles() - cycles_start;
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            if (seconds >= options.min_time || iterations >= (1ull << 40)) {
+                double ns = seconds * 1e9 / iterations;
+                if (best.iterations == 0 || ns < best.ns_per_call) {
+                    best.iterations = iterations;
+                    best.ns_per_call = ns;
+                    best.cycles_per_call = (double)cycles / iterations;
+                }
+                break;
+            }
+            // Aim straight for the target once a run is long enough to extrapolate
+            iterations = (seconds > options.min_time / 100)
+                ? (uint64_t)(iterations * options.min_time * 1.2 / seconds) + 1
+                : iterations * 10;
+        }
+    }
+    return best;
+}
+
+static void report(const std::string& name, size_t bytes_per_call, const bench_result& result,
+                   const bench_options& options) {
+    double bytes_per_second = bytes_per_call * 1e9 / result.ns_per_call;
+    double cycles = result.cycles_per_call;
+    if (options.cpu_ghz > 0) {
+        cycles = result.ns_per_call * options.cpu_ghz;
+    }
+
+    char throughput[32];
+    if (bytes_per_second >= 1e9) {
+        snprintf(throughput, sizeof(throughput), "%.2f GB/s", bytes_per_second / 1e9);
+    } else {
+        snprintf(throughput, sizeof(throughput), "%.1f MB/s", bytes_per_second / 1e6);
+    }
+
+    if (cycles > 0) {
+        printf("%-44s %10.0f ns %12llu %12s %9.3f\n", name.c_str(), result.ns_per_call,
+               (unsigned long long)result.iterations, throughput, cycles / bytes_per_call);
+    } else {
+        printf("%-44s %10.0f ns %12llu %12s %9s\n", name.c_str(), result.ns_per_call,
+               (unsigned long long)result.iterations, throughput, "-");
+    }
+    fflush(stdout);
+}
+
+static void run(const std::string& name, size_t bytes_per_call, const std::function<void(size_t)>& body,
+                const bench_options& options) {
+    if (!options.filter.empty() && name.find(options.filter) == std::string::npos) {
+        return;
+    }
+    report(name, bytes_per_call, run_benchmark(body, options), options);
+}
+
+static void run_crc_benchmarks(const bench_set& set, const bench_options& options) {
+    const std::vector<bench_block>& blocks = set.blocks;
+    std::vector<int32_t> out(SAMPLES_PER_WAVEFORM);
+
+    for (int b = CRC32_BACKEND_BITWISE; b <= CRC32_BACKEND_HARDWARE; b++) {
+        crc32_backend_t backend = (crc32_backend_t)b;
+        if (!crc32_set_backend(backend)) {
+            continue;
+        }
+        std::string suffix = std::string("/") + set.name + "/" + crc32_backend_name(backend);
+
+        run("calculate_crc32_data" + suffix, WAVEFORM_RAW_DATA_SIZE, [&](size_t i) {
+            const bench_block& block = blocks[i % blocks.size()];
+            sink = calculate_crc32_data(block.packed.data(), block.packed.size());
+        }, options);
+
+        run("calculate_crc32_samples" + suffix, WAVEFORM_RAW_DATA_SIZE, [&](size_t i) {
+            const bench_block& block = blocks[i % blocks.size()];
+            sink = calculate_crc32_samples(block.samples.data(), SAMPLES_PER_WAVEFORM);
+        }, options);
+
+        run("calculate_crc32_unpack_24bit" + suffix, WAVEFORM_RAW_DATA_SIZE, [&](size_t i) {
+            const bench_block& block = blocks[i % blocks.size()];
+            sink = calculate_crc32_unpack_24bit(block.packed.data(), SAMPLES_PER_WAVEFORM, out.data());
+        }, options);
+    }
+    crc32_set_backend(CRC32_BACKEND_AUTO);
+}
+
+static void run_unpack_benchmarks(const bench_set& set, const bench_options& options) {
+    const std::vector<bench_block>& blocks = set.blocks;
+    std::vector<int32_t> out(SAMPLES_PER_WAVEFORM);
+    std::vector<float> out_float(SAMPLES_PER_WAVEFORM);
+    std::vector<int32_t> envelope(2 * ENVELOPE_WIDTH);
+    std::vector<waveform_data_t> waveforms(blocks.size());
+    for (size_t i = 0; i < blocks.size(); i++) {
+        parse_waveform_header(blocks[i].header.data(), &waveforms[i].header);
+        memcpy(waveforms[i].samples, blocks[i].samples.data(), SAMPLES_PER_WAVEFORM * sizeof(int32_t));
+    }
+    waveform_summary_config_t config = { ENVELOPE_WIDTH, 0, 0 };
+
+    for (int b = UNPACK_BACKEND_SCALAR; b <= UNPACK_BACKEND_NEON; b++) {
+        unpack_backend_t backend = (unpack_backend_t)b;
+        if (!unpack_set_backend(backend)) {
+            continue;
+        }
+        std::string suffix = std::string("/") + set.name + "/" + unpack_backend_name(backend);
+
+        run("unpack_24bit_samples" + suffix, WAVEFORM_RAW_DATA_SIZE, [&](size_t i) {
+            const bench_block& block = blocks[i % blocks.size()];
+            unpack_24bit_samples(block.packed.data(), SAMPLES_PER_WAVEFORM, out.data());
+            sink = (uint32_t)out[i % SAMPLES_PER_WAVEFORM];
+        }, options);
+
+        run("unpack_24bit_samples_float" + suffix, WAVEFORM_RAW_DATA_SIZE, [&](size_t i) {
+            const bench_block& block = blocks[i % blocks.size()];
+            unpack_24bit_samples_float(block.packed.data(), SAMPLES_PER_WAVEFORM, 1.0f / 8388608.0f,
+                                       out_float.data());
+            sink = (uint32_t)(out_float[i % SAMPLES_PER_WAVEFORM] * 1e6f);
+        }, options);
+
+        run("samples_min_max_columns" + suffix, WAVEFORM_RAW_DATA_SIZE, [&](size_t i) {
+            const bench_block& block = blocks[i % blocks.size()];
+            samples_min_max_columns(block.samples.data(), SAMPLES_PER_WAVEFORM, ENVELOPE_WIDTH, envelope.data(),
+                                    envelope.data() + ENVELOPE_WIDTH);
+            sink = (uint32_t)envelope[i % envelope.size()];
+        }, options);
+
+        run("waveform_summarize" + suffix, WAVEFORM_RAW_DATA_SIZE, [&](size_t i) {
+            waveform_summary_t summary;
+            waveform_summarize(&waveforms[i % waveforms.size()], &config, envelope.data(),
+                               envelope.data() + ENVELOPE_WIDTH, &summary);
+            sink = summary.echo_count;
+        }, options);
+    }
+    unpack_set_backend(UNPACK_BACKEND_AUTO);
+}
+
+static void run_decode_benchmarks(const bench_set& set, const bench_options& options) {
+    const std::vector<bench_block>& blocks = set.blocks;
+    std::vector<int32_t> out(SAMPLES_PER_WAVEFORM);
+    std::string suffix = std::string("/") + set.name;
+
+    run("parse_waveform_header" + suffix, WAVEFORM_HEADER_SIZE, [&](size_t i) {
+        waveform_header_t header;
+        parse_waveform_header(blocks[i % blocks.size()].header.data(), &header);
+        sink = header.crc32;
+    }, options);
+
+    run("decompress_waveform/zlib_delta" + suffix, WAVEFORM_RAW_DATA_SIZE, [&](size_t i) {
+        const bench_block& block = blocks[i % blocks.size()];
+        sink = decompress_waveform(block.zlib_delta.data(), block.zlib_delta.size(), out.data());
+    }, options);
+
+    run("decompress_waveform/rice" + suffix, WAVEFORM_RAW_DATA_SIZE, [&](size_t i) {
+        const bench_block& block = blocks[i % blocks.size()];
+        sink = decompress_waveform(block.rice.data(), block.rice.size(), out.data());
+    }, options);
+
+    // The inline receive path: one inflater reused across blocks, fed chunk by chunk
+    delta_inflater_t* inflater = delta_inflater_create();
+    if (inflater) {
+        run("delta_inflater_feed" + suffix, WAVEFORM_RAW_DATA_SIZE, [&](size_t i) {
+            const bench_block& block = blocks[i % blocks.size()];
+            delta_inflater_reset(inflater);
+            for (size_t offset = 0; offset < block.zlib_delta.size(); offset += STREAM_PIECE_SIZE) {
+                size_t length = block.zlib_delta.size() - offset;
+                delta_inflater_feed(inflater, block.zlib_delta.data() + offset,
+                                    length < STREAM_PIECE_SIZE ? length : STREAM_PIECE_SIZE);
+            }
+            sink = delta_inflater_finish(inflater, out.data());
+        }, options);
+        delta_inflater_destroy(inflater);
+    }
+}
+
+static void usage(void) {
+    fprintf(stderr,
+            "usage: psoc_driver_bench [--filter TEXT] [--min-time S] [--repetitions N]\n"
+            "                         [--noise-blocks N] [--seed N] [--cpu-ghz F]\n");
+}
+
+int main(int argc, char** argv) {
+    bench_options options;
+    options.min_time = 0.2;
+    options.repetitions = 3;
+    options.noise_blocks = 16;
+    options.seed = 1;
+    options.cpu_ghz = 0.0;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            usage();
+            return 1;
+        }
+        const char* value = argv[++i];
+        if (arg == "--filter") {
+            options.filter = value;
+        } else if (arg == "--min-time") {
+            options.min_time = atof(value);
+        } else if (arg == "--repetitions") {
+            options.repetitions = (uint32_t)strtoul(value, nullptr, 10);
+        } else if (arg == "--noise-blocks") {
+            options.noise_blocks = (uint32_t)strtoul(value, nullptr, 10);
+        } else if (arg == "--seed") {
+            options.seed = (uint32_t)strtoul(value, nullptr, 10);
+        } else if (arg == "--cpu-ghz") {
+            options.cpu_ghz = atof(value);
+        } else {
+            usage();
+            return 1;
+        }
+    }
+    if (options.min_time <= 0 || options.repetitions == 0 || options.noise_blocks == 0) {
+        usage();
+        return 1;
+    }
+
+    psoc_driver_init();
+    app_waveform_init();
+
+    std::vector<bench_set> sets;
+    sets.push_back(make_static_set());
+    sets.push_back(make_noise_set(options));
+    for (size_t s = 0; s < sets.size(); s++) {
+        if (!check_set(sets[s])) {
+            return 1;
+        }
+    }
+
+    printf("psoc_driver %s, default CRC32 %s, default unpack %s, %u noise blocks\n", psoc_driver_version(),
+           crc32_backend_name(crc32_get_backend()), unpack_backend_name(unpack_get_backend()),
+           options.noise_blocks);
+    printf("%-44s %13s %12s %12s %9s\n", "Benchmark", "Time", "Iterations", "Bytes/s",
+           options.cpu_ghz > 0 ? "Cycles/B" : "TSC/B");
+    for (size_t s = 0; s < sets.size(); s++) {
+        run_crc_benchmarks(sets[s], options);
+        run_unpack_benchmarks(sets[s], options);
+        run_decode_benchmarks(sets[s], options);
+    }
+
+    psoc_driver_cleanup();
+    return 0;
+}
@@ -0,0 +1,740 @@
+// End-to-end receive path benchmark.
+//
+// Frames waveform blocks exactly as the firmware does (send_chunk() in
+// app_data_transfer.c, waveforms from app_waveform.c), pushes them through a
+// simulated link with optional loss, reordering and duplication, and feeds
+// them to a transfer session. Reports delivery rate, CPU per chunk,
+// allocations per block and peak RSS for every codec and delivery mode.
+//
+//   psoc_transfer_bench [--blocks N] [--codec raw|rice|zlib|all]
+//                       [--mode inline|pool|ring|lazy|replay|all] [--workers N] [--mtu N]
+//                       [--loss P] [--reorder P] [--dup P] [--retransmit-delay N]
+//                       [--rate-kbps N] [--seed N] [--zero-copy] [--packed]
+//                       [--archive PATH] [--summary WIDTH] [--prewarm]
+//
+// --packed frames blocks in packed records (wire_format.h), the last chunk of
+// a block sharing its notification with the first of the next; compare the
+// sent column against a run without it.
+//
+// Ring mode reads the ring from the feeding thread once per block, like a UI
+// frame; run it paced (--rate-kbps) or drops only measure thread scheduling.
+//
+// --summary adds the summary stage (waveform_summary.h) with an envelope of
+// WIDTH columns to every live session, so its cost shows up in ns/chunk.
+//
+// first_us is the time from transfer_session_start() to the first delivered
+// waveform (time to first block). --prewarm calls transfer_session_prewarm()
+// before starting, as an app does while it scans and connects.
+//
+// Lazy mode delivers blocks undecoded on the feeding thread and reads only
+// their headers, like a metadata logger.
+//
+// Replay mode writes the arrivals to an in-memory notification log (replay.h)
+// and decodes it offline on --workers threads; blocks/s is the batch rate.
+
+extern "C" {
+#include "app_waveform.h"
+}
+#include "psoc_driver/psoc_driver.h"
+#include <zlib.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <new>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#include <time.h>
+#endif
+
+// ATT notification header; the rest of the MTU is chunk header + payload
+#define ATT_NOTIFICATION_OVERHEAD 3
+
+// Every operator new in the process (driver included) is counted
+static std::atomic<uint64_t> allocation_count(0);
+
+void* operator new(std::size_t size) {
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    void* memory = std::malloc(size ? size : 1);
+    if (!memory) {
+        throw std::bad_alloc();
+    }
+    return memory;
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    return std::malloc(size ? size : 1);
+}
+
+void operator delete(void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, const std::nothrow_t&) noexcept {
+    std::free(memory);
+}
+
+enum bench_codec { CODEC_RAW, CODEC_RICE, CODEC_ZLIB, CODEC_COUNT };
+enum bench_mode { MODE_INLINE, MODE_POOL, MODE_RING, MODE_LAZY, MODE_REPLAY, MODE_COUNT };
+
+static const char* const codec_names[CODEC_COUNT] = { "raw", "rice", "zlib" };
+static const char* const mode_names[MODE_COUNT] = { "inline", "pool", "ring", "lazy", "replay" };
+
+struct bench_options {
+    uint32_t blocks;
+    int codec;                  // CODEC_COUNT = all
+    int mode;                   // MODE_COUNT = all
+    uint32_t workers;           // pool threads, or replay threads
+    uint32_t mtu;
+    double loss;
+    double reorder;
+    double dup;
+    uint32_t retransmit_delay;  // Packets between a loss and its resend
+    uint32_t rate_kbps;         // 0 = as fast as possible
+    uint32_t seed;
+    bool zero_copy;
+    bool packed;                // packed records instead of chunk headers
+    const char* archive;        // capture archive path, NULL = no archiving
+    uint32_t summary_width;     // envelope columns of the summary stage, 0 = no summaries
+    bool prewarm;               // transfer_session_prewarm() before starting
+};
+
+// Smallest first chunk the firmware packs behind the previous block
+// (PACKED_MIN_HEAD_SIZE in app_data_transfer.h)
+static const uint32_t PACKED_MIN_HEAD_SIZE = 16;
+
+// Framed notifications of one block, as they leave send_chunk(). With packed
+// framing the notification carrying a block's last chunk may also carry the
+// next block's first, which then starts its own list at chunk 1.
+struct framed_block {
+    std::vector<std::vector<uint8_t>> chunks;
+    bool packs_next;            // last notification also carries the next block's chunk 0
+};
+
+struct packet_ref {
+    uint32_t block;
+    uint32_t chunk;
+};
+
+struct link_counters {
+    uint64_t sent;
+    uint64_t lost;
+    uint64_t duplicated;
+    uint64_t reordered;
+};
+
+static std::atomic<uint32_t> delivered(0);
+static std::atomic<int64_t> first_delivery_ns(0);  // steady_clock time of the first delivery, 0 = none yet
+
+static void count_delivery(void) {
+    if (delivered.fetch_add(1, std::memory_order_relaxed) == 0) {
+        first_delivery_ns.store(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+}
+
+static double first_delivery_us(std::chrono::steady_clock::time_point start) {
+    int64_t first = first_delivery_ns.load();
+    if (first == 0) {
+        return 0.0;
+    }
+    return (first - std::chrono::duration_cast<std::chrono::nanoseconds>(start.time_since_epoch()).count()) / 1e3;
+}
+
+static void on_waveform(const waveform_data_t* waveform, bool is_compressed, void* user_data) {
+    (void)waveform;
+    (void)is_compressed;
+    (void)user_data;
+    count_delivery();
+}
+
+// A metadata logger: headers only, samples never decoded
+static void on_lazy_waveform(const waveform_handle_t* handle, void* user_data) {
+    (void)handle;
+    (void)user_data;
+    count_delivery();
+}
+
+static std::atomic<uint32_t> summaries(0);
+static std::atomic<uint32_t> echoes(0);
+
+static void on_summary(const waveform_summary_t* summary, void* user_data) {
+    (void)user_data;
+    summaries.fetch_add(1, std::memory_order_relaxed);
+    echoes.fetch_add(summary->echo_count, std::memory_order_relaxed);
+}
+
+static uint64_t process_cpu_ns(void) {
+#ifdef _WIN32
+    FILETIME creation, exit_time, kernel, user;
+    GetProcessTimes(GetCurrentProcess(), &creation, &exit_time, &kernel, &user);
+    uint64_t k = ((uint64_t)kernel.dwHighDateTime << 32) | kernel.dwLowDateTime;
+    uint64_t u = ((uint64_t)user.dwHighDateTime << 32) | user.dwLowDateTime;
+    return (k + u) * 100;
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &now);
+    return (uint64_t)now.tv_sec * 1000000000ull + (uint64_t)now.tv_nsec;
+#endif
+}
+
+static uint64_t peak_rss_kb(void) {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+    return counters.PeakWorkingSetSize / 1024;
+#else
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return (uint64_t)usage.ru_maxrss / 1024;  // bytes on macOS
+#else
+    return (uint64_t)usage.ru_maxrss;         // kilobytes on Linux
+#endif
+#endif
+}
+
+// zlib of 16-bit deltas, the legacy benchmark codec. Deltas are truncated to
+// 16 bits, so the CRC is taken over the samples the decoder will rebuild.
+static uint32_t encode_zlib_delta(const uint8_t* raw, uint8_t* out, uint32_t capacity,
+                                  waveform_block_header_t* header) {
+    std::vector<int32_t> rebuilt(WAVEFORM_SAMPLES_PER_BLOCK);
+    std::vector<uint8_t> deltas(WAVEFORM_SAMPLES_PER_BLOCK * 2);
+    int32_t prev = 0;
+    for (uint32_t i = 0; i < WAVEFORM_SAMPLES_PER_BLOCK; i++) {
+        int32_t sample = raw[i * 3] | (raw[i * 3 + 1] << 8) | (raw[i * 3 + 2] << 16);
+        if (sample & 0x800000) {
+            sample |= ~0xFFFFFF;
+        }
+        int16_t delta = (int16_t)(sample - prev);
+        prev += delta;
+        rebuilt[i] = prev;
+        deltas[i * 2] = (uint8_t)delta;
+        deltas[i * 2 + 1] = (uint8_t)((uint16_t)delta >> 8);
+    }
+
+    uLongf size = capacity;
+    if (compress(out, &size, deltas.data(), (uLong)deltas.size()) != Z_OK) {
+        return 0;
+    }
+    header->crc32 = calculate_crc32_samples(rebuilt.data(), rebuilt.size());
+    return (uint32_t)size;
+}
+
+// Append one packed record (header, length if more follows, payload)
+static void put_packed_record(std::vector<uint8_t>* packet, uint32_t block_number, uint32_t chunk_number,
+                              uint32_t total_chunks, uint8_t codec, const uint8_t* payload, uint32_t offset,
+                              uint32_t size, bool more) {
+    packed_record_header_t record;
+    record.block_word = (uint16_t)(PACKED_RECORD_MARKER | (codec << PACKED_RECORD_CODEC_SHIFT) | block_number);
+    record.chunk_word = (uint16_t)(chunk_number | (more ? PACKED_RECORD_MORE : 0));
+    record.total_chunks = (uint16_t)total_chunks;
+    record.chunk_offset = (uint16_t)offset;
+
+    const uint8_t* bytes = (const uint8_t*)&record;
+    packet->insert(packet->end(), bytes, bytes + PACKED_RECORD_HEADER_SIZE);
+    if (more) {
+        packet->push_back((uint8_t)size);
+        packet->push_back((uint8_t)(size >> 8));
+    }
+    packet->insert(packet->end(), payload + offset, payload + offset + size);
+}
+
+// Packed framing as the firmware cuts it (cut_block() and pack_next_block() in
+// app_data_transfer.c): chunk 0 of a block fills the room its predecessor's
+// last chunk leaves, if there is enough of it
+static void frame_packed(const std::vector<std::vector<uint8_t>>& encoded, const std::vector<uint8_t>& codecs,
+                         const bench_options& options, std::vector<framed_block>* blocks) {
+    uint32_t notification_size = options.mtu - ATT_NOTIFICATION_OVERHEAD;
+    uint32_t stride = notification_size - PACKED_RECORD_HEADER_SIZE;
+    uint32_t head = stride;    // Chunk 0 of the block being framed
+    bool head_packed = false;  // ... already went out with the previous block
+
+    for (uint32_t b = 0; b < encoded.size(); b++) {
+        uint32_t block_size = (uint32_t)encoded[b].size();
+        head = std::min(head, block_size);
+        uint32_t total_chunks = 1 + (block_size - head + stride - 1) / stride;
+
+        uint32_t last = total_chunks - 1;
+        uint32_t tail_offset = last == 0 ? 0 : head + (last - 1) * stride;
+        uint32_t tail_size = block_size - tail_offset;
+        uint32_t used = PACKED_RECORD_HEADER_SIZE + PACKED_RECORD_LENGTH_SIZE + tail_size + PACKED_RECORD_HEADER_SIZE;
+        uint32_t next_head = stride;
+        if (b + 1 < encoded.size() && used + PACKED_MIN_HEAD_SIZE <= notification_size) {
+            next_head = notification_size - used;
+        }
+        bool pack_next = next_head != stride;
+
+        std::vector<std::vector<uint8_t>>& chunks = (*blocks)[b].chunks;
+        for (uint32_t c = head_packed ? 1 : 0; c <= last; c++) {
+            uint32_t offset = c == 0 ? 0 : head + (c - 1) * stride;
+            uint32_t size = c == last ? tail_size : (c == 0 ? head : stride);
+            bool more = c == last && pack_next;
+
+            chunks.push_back(std::vector<uint8_t>());
+            put_packed_record(&chunks.back(), b, c, total_chunks, codecs[b], encoded[b].data(), offset, size, more);
+            if (more) {
+                const std::vector<uint8_t>& next = encoded[b + 1];
+                uint32_t next_size = std::min(next_head, (uint32_t)next.size());
+                uint32_t next_total = 1 + ((uint32_t)next.size() - next_size + stride - 1) / stride;
+                put_packed_record(&chunks.back(), b + 1, 0, next_total, codecs[b + 1], next.data(), 0, next_size,
+                                  false);
+            }
+        }
+        (*blocks)[b].packs_next = pack_next;
+        head = next_head;
+        head_packed = pack_next;
+    }
+}
+
+// Generate every block once per codec; framing is not part of the measurement
+static std::vector<framed_block> build_blocks(int codec, const bench_options& options, uint32_t* compressed_blocks) {
+    std::vector<framed_block> blocks(options.blocks);
+    std::vector<std::vector<uint8_t>> encoded(options.blocks);
+    std::vector<uint8_t> codecs(options.blocks);
+    std::vector<uint8_t> raw(WAVEFORM_RAW_DATA_SIZE);
+    std::vector<uint8_t> block(BLOCK_SIZE);
+    *compressed_blocks = 0;
+
+    for (uint32_t b = 0; b < options.blocks; b++) {
+        waveform_block_header_t header;
+        app_waveform_generate(b, &header, raw.data());
+
+        // Same fallback as the firmware: incompressible blocks go out raw
+        uint8_t* payload = block.data() + sizeof(header);
+        uint32_t capacity = WAVEFORM_RAW_DATA_SIZE - 1;
+        uint32_t payload_bytes = 0;
+        uint8_t flags = BLOCK_CODEC_RAW;
+        if (codec == CODEC_RICE && app_waveform_compress(&header, raw.data(), payload, &payload_bytes, capacity)) {
+            flags = BLOCK_CODEC_RICE;
+        } else if (codec == CODEC_ZLIB &&
+                   (payload_bytes = encode_zlib_delta(raw.data(), payload, capacity, &header)) > 0) {
+            flags = BLOCK_CODEC_ZLIB_DELTA;
+        } else {
+            app_waveform_generate(b, &header, raw.data());  // Restore the raw CRC
+            memcpy(payload, raw.data(), raw.size());
+            payload_bytes = (uint32_t)raw.size();
+        }
+        if (flags != BLOCK_CODEC_RAW) {
+            (*compressed_blocks)++;
+        }
+        memcpy(block.data(), &header, sizeof(header));
+        encoded[b].assign(block.begin(), block.begin() + sizeof(header) + payload_bytes);
+        codecs[b] = flags;
+    }
+
+    if (options.packed) {
+        frame_packed(encoded, codecs, options, &blocks);
+        return blocks;
+    }
+
+    uint32_t payload_size = options.mtu - ATT_NOTIFICATION_OVERHEAD - CHUNK_HEADER_SIZE;
+    for (uint32_t b = 0; b < options.blocks; b++) {
+        uint32_t block_size = (uint32_t)encoded[b].size();
+        uint32_t total_chunks = (block_size + payload_size - 1) / payload_size;
+        blocks[b].chunks.resize(total_chunks);
+        for (uint32_t c = 0; c < total_chunks; c++) {
+            uint32_t offset = c * payload_size;
+            uint32_t size = std::min(payload_size, block_size - offset);
+
+            chunk_header_t chunk;
+            chunk.block_number = (uint16_t)b;
+            chunk.chunk_number = (uint16_t)c;
+            chunk.chunk_size = (uint16_t)size;
+            chunk.total_chunks = (uint16_t)total_chunks;
+            chunk.block_size_total = (uint16_t)block_size;
+            chunk.flags = codecs[b];
+            chunk.reserved = 0;
+
+            std::vector<uint8_t>& packet = blocks[b].chunks[c];
+            packet.resize(CHUNK_HEADER_SIZE + size);
+            memcpy(packet.data(), &chunk, CHUNK_HEADER_SIZE);
+            memcpy(packet.data() + CHUNK_HEADER_SIZE, encoded[b].data() + offset, size);
+        }
+    }
+    return blocks;
+}
+
+// Arrival order at the phone. A lost packet is resent retransmit_delay packets
+// later (standing in for the SACK round trip), or sooner if the send window
+// would otherwise move past its block, and may be lost again.
+static std::vector<packet_ref> simulate_link(const std::vector<framed_block>& blocks, const bench_options& options,
+                                             link_counters* counters) {
+    std::mt19937 rng(options.seed);
+    std::uniform_real_distribution<double> chance(0.0, 1.0);
+    std::deque<std::pair<uint64_t, packet_ref>> resends;
+    std::vector<packet_ref> arrivals;
+    memset(counters, 0, sizeof(*counters));
+
+    std::vector<packet_ref> sends;
+    for (uint32_t b = 0; b < blocks.size(); b++) {
+        for (uint32_t c = 0; c < blocks[b].chunks.size(); c++) {
+            packet_ref ref = { b, c };
+            sends.push_back(ref);
+        }
+    }
+
+    size_t next = 0;
+    bool held = false;
+    packet_ref held_packet = { 0, 0 };
+    while (next < sends.size() || !resends.empty()) {
+        // The sender cannot run more than SEND_WINDOW_BLOCKS past a block it still
+        // owes, counting a packed next-block chunk
+        uint32_t next_block = 0;
+        if (next < sends.size()) {
+            const framed_block& block = blocks[sends[next].block];
+            bool carries_next = block.packs_next && sends[next].chunk + 1 == block.chunks.size();
+            next_block = sends[next].block + (carries_next ? 1 : 0);
+        }
+        if (held && next < sends.size() && next_block >= held_packet.block + SEND_WINDOW_BLOCKS) {
+            arrivals.push_back(held_packet);
+            held = false;
+        }
+        bool window_full = false;
+        if (next < sends.size()) {
+            for (size_t i = 0; i < resends.size(); i++) {
+                if (next_block >= resends[i].second.block + SEND_WINDOW_BLOCKS) {
+                    window_full = true;
+                    break;
+                }
+            }
+        }
+
+        packet_ref packet;
+        if (!resends.empty() && (resends.front().first <= counters->sent || window_full || next == sends.size())) {
+            packet = resends.front().second;
+            resends.pop_front();
+        } else {
+            packet = sends[next++];
+        }
+        counters->sent++;
+
+        if (chance(rng) < options.loss) {
+            counters->lost++;
+            resends.push_back(std::make_pair(counters->sent + options.retransmit_delay, packet));
+            continue;
+        }
+        if (!held && chance(rng) < options.reorder) {
+            counters->reordered++;
+            held = true;
+            held_packet = packet;  // Arrives after the next one
+            continue;
+        }
+        arrivals.push_back(packet);
+        if (chance(rng) < options.dup) {
+            counters->duplicated++;
+            arrivals.push_back(packet);
+        }
+        if (held) {
+            arrivals.push_back(held_packet);
+            held = false;
+        }
+    }
+    if (held) {
+        arrivals.push_back(held_packet);
+    }
+    return arrivals;
+}
+
+static void drain_ring(transfer_session_t* session) {
+    bool is_compressed;
+    while (transfer_session_acquire_waveform(session, &is_compressed)) {
+        transfer_session_release_waveform(session);
+        count_delivery();
+    }
+}
+
+static void feed_chunk(transfer_session_t* session, const std::vector<uint8_t>& packet, bool zero_copy) {
+    if (!zero_copy) {
+        transfer_session_process_chunk(session, packet.data(), packet.size());
+        return;
+    }
+    size_t payload_size;
+    uint8_t* dest = transfer_session_begin_chunk(session, packet.data(), packet.size(), &payload_size);
+    if (dest) {
+        memcpy(dest, packet.data() + CHUNK_HEADER_SIZE, payload_size);
+        transfer_session_commit_chunk(session);
+    }
+}
+
+static void print_row(int codec, int mode, const bench_options& options, uint32_t compressed_blocks,
+                      uint32_t received, double seconds, double first_us, uint64_t cpu_ns, size_t chunks,
+                      uint64_t allocations, const link_counters& link) {
+    printf("%-5s %-6s %6u %6u %5u %8.0f %8.1f %9.0f %8.3f %9llu  %llu/%llu/%llu/%llu\n",
+           codec_names[codec], mode_names[mode], options.blocks, compressed_blocks,
+           received, received / seconds, first_us,
+           chunks == 0 ? 0.0 : (double)cpu_ns / chunks,
+           options.blocks ? (double)allocations / options.blocks : 0.0,
+           (unsigned long long)peak_rss_kb(),
+           (unsigned long long)link.sent, (unsigned long long)link.lost,
+           (unsigned long long)link.reordered, (unsigned long long)link.duplicated);
+}
+
+// Record the arrivals as a notification log, then decode it in one batch
+static void run_replay_case(int codec, const bench_options& options, const std::vector<framed_block>& blocks,
+                            const std::vector<packet_ref>& arrivals, uint32_t compressed_blocks,
+                            const link_counters& link) {
+    std::vector<uint8_t> log;
+    for (size_t i = 0; i < arrivals.size(); i++) {
+        const std::vector<uint8_t>& packet = blocks[arrivals[i].block].chunks[arrivals[i].chunk];
+        log.push_back((uint8_t)packet.size());
+        log.push_back((uint8_t)(packet.size() >> 8));
+        log.insert(log.end(), packet.begin(), packet.end());
+    }
+
+    replay_options_t replay_options = { options.workers, nullptr };
+    if (options.archive) {
+        replay_options.archive = capture_writer_open(options.archive);
+    }
+
+    delivered.store(0);
+    first_delivery_ns.store(0);
+    uint64_t allocations_before = allocation_count.load();
+    uint64_t cpu_before = process_cpu_ns();
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    replay_stats_t stats;
+    replay_notification_log(log.data(), log.size(), &replay_options, on_waveform, nullptr, &stats);
+    uint64_t cpu_ns = process_cpu_ns() - cpu_before;
+    uint64_t allocations = allocation_count.load() - allocations_before;
+    capture_writer_close(replay_options.archive);
+
+    print_row(codec, MODE_REPLAY, options, compressed_blocks, delivered.load(), stats.elapsed_seconds,
+              first_delivery_us(start), cpu_ns, arrivals.size(), allocations, link);
+}
+
+static void run_case(int codec, int mode, const bench_options& options) {
+    uint32_t compressed_blocks;
+    std::vector<framed_block> blocks = build_blocks(codec, options, &compressed_blocks);
+    link_counters link;
+    std::vector<packet_ref> arrivals = simulate_link(blocks, options, &link);
+    if (mode == MODE_REPLAY) {
+        run_replay_case(codec, options, blocks, arrivals, compressed_blocks, link);
+        return;
+    }
+
+    psoc_driver_config_t config = { mode == MODE_INLINE || mode == MODE_LAZY ? 0u : options.workers };
+    psoc_driver_init_with_config(&config);
+
+    delivered.store(0);
+    first_delivery_ns.store(0);
+    transfer_session_t* session = transfer_session_create();
+    if (mode == MODE_RING) {
+        transfer_session_set_waveform_ring(session, 8);
+    } else if (mode == MODE_LAZY) {
+        transfer_session_set_lazy_waveform_callback(session, on_lazy_waveform, nullptr);
+    } else {
+        transfer_session_set_waveform_callback(session, on_waveform, nullptr);
+    }
+
+    if (options.summary_width > 0) {
+        waveform_summary_config_t summary_config = { (uint16_t)options.summary_width, 0, 0 };
+        transfer_session_set_summary_callback(session, on_summary, &summary_config, nullptr);
+    }
+    summaries.store(0);
+    echoes.store(0);
+
+    capture_writer_t* archive = nullptr;
+    if (options.archive) {
+        archive = capture_writer_open(options.archive);
+        transfer_session_set_archive(session, archive);
+    }
+    if (options.prewarm) {
+        transfer_session_prewarm(session);
+    }
+
+    uint64_t cpu_before = process_cpu_ns();
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    transfer_session_start(session);
+    uint64_t allocations_before = allocation_count.load();  // Setup done by start is not per block
+    uint64_t bytes_fed = 0;
+    for (size_t i = 0; i < arrivals.size(); i++) {
+        const std::vector<uint8_t>& packet = blocks[arrivals[i].block].chunks[arrivals[i].chunk];
+        feed_chunk(session, packet, options.zero_copy);
+        bytes_fed += packet.size();
+
+        if (mode == MODE_RING && arrivals[i].chunk == 0) {
+            drain_ring(session);  // About once per block, like a UI frame
+        }
+        if (options.rate_kbps > 0) {
+            std::chrono::steady_clock::time_point due =
+                start + std::chrono::microseconds(bytes_fed * 8000 / options.rate_kbps);
+            std::this_thread::sleep_until(due);
+        }
+    }
+
+    if (mode == MODE_RING) {
+        // Keep reading until every completed block is accounted for, so only the
+        // backlog behind a slow reader shows up as drops (give up after 1 s idle)
+        transfer_stats_t stats;
+        transfer_session_get_stats(session, &stats);
+        std::chrono::steady_clock::time_point idle_since = std::chrono::steady_clock::now();
+        uint32_t last = 0;
+        for (;;) {
+            drain_ring(session);
+            uint32_t accounted = delivered.load() + transfer_session_get_dropped_waveforms(session);
+            if (accounted >= stats.blocks_received) {
+                break;
+            }
+            if (accounted != last) {
+                last = accounted;
+                idle_since = std::chrono::steady_clock::now();
+            } else if (std::chrono::steady_clock::now() - idle_since > std::chrono::seconds(1)) {
+                break;  // Decode failures never reach the ring
+            }
+            std::this_thread::yield();
+        }
+    }
+    uint32_t dropped = transfer_session_get_dropped_waveforms(session);
+    transfer_session_destroy(session);  // Waits for blocks still being decoded
+    capture_writer_close(archive);
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    uint64_t cpu_ns = process_cpu_ns() - cpu_before;
+    uint64_t allocations = allocation_count.load() - allocations_before;
+    psoc_driver_cleanup();
+
+    print_row(codec, mode, options, compressed_blocks, delivered.load(), seconds, first_delivery_us(start), cpu_ns,
+              arrivals.size(), allocations, link);
+    if (dropped > 0) {
+        printf("      ring dropped %u waveforms\n", dropped);
+    }
+    if (options.summary_width > 0) {
+        printf("      summarized %u waveforms, %u echoes\n", summaries.load(), echoes.load());
+    }
+}
+
+static int parse_choice(const char* value, const char* const* names, int count) {
+    if (strcmp(value, "all") == 0) {
+        return count;
+    }
+    for (int i = 0; i < count; i++) {
+        if (strcmp(value, names[i]) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void usage(void) {
+    fprintf(stderr,
+            "usage: psoc_transfer_bench [--blocks N] [--codec raw|rice|zlib|all]\n"
+            "                           [--mode inline|pool|ring|lazy|replay|all] [--workers N] [--mtu N]\n"
+            "                           [--loss P] [--reorder P] [--dup P] [--retransmit-delay N]\n"
+            "                           [--rate-kbps N] [--seed N] [--zero-copy] [--packed] [--archive PATH]\n"
+            "                           [--summary WIDTH] [--prewarm]\n"
+            "--packed and --zero-copy are exclusive: packed notifications go through process_chunk\n");
+}
+
+int main(int argc, char** argv) {
+    bench_options options;
+    options.blocks = TOTAL_BLOCKS;
+    options.codec = CODEC_COUNT;
+    options.mode = MODE_COUNT;
+    options.workers = 2;
+    options.mtu = 247;
+    options.loss = 0.0;
+    options.reorder = 0.0;
+    options.dup = 0.0;
+    options.retransmit_delay = 64;
+    options.rate_kbps = 0;
+    options.seed = 1;
+    options.zero_copy = false;
+    options.packed = false;
+    options.archive = nullptr;
+    options.summary_width = 0;
+    options.prewarm = false;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--zero-copy") {
+            options.zero_copy = true;
+            continue;
+        }
+        if (arg == "--packed") {
+            options.packed = true;
+            continue;
+        }
+        if (arg == "--prewarm") {
+            options.prewarm = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            usage();
+            return 1;
+        }
+        const char* value = argv[++i];
+        if (arg == "--blocks") {
+            options.blocks = (uint32_t)strtoul(value, nullptr, 10);
+        } else if (arg == "--codec") {
+            options.codec = parse_choice(value, codec_names, CODEC_COUNT);
+        } else if (arg == "--mode") {
+            options.mode = parse_choice(value, mode_names, MODE_COUNT);
+        } else if (arg == "--workers") {
+            options.workers = (uint32_t)strtoul(value, nullptr, 10);
+        } else if (arg == "--mtu") {
+            options.mtu = (uint32_t)strtoul(value, nullptr, 10);
+        } else if (arg == "--loss") {
+            options.loss = atof(value);
+        } else if (arg == "--reorder") {
+            options.reorder = atof(value);
+        } else if (arg == "--dup") {
+            options.dup = atof(value);
+        } else if (arg == "--retransmit-delay") {
+            options.retransmit_delay = (uint32_t)strtoul(value, nullptr, 10);
+        } else if (arg == "--rate-kbps") {
+            options.rate_kbps = (uint32_t)strtoul(value, nullptr, 10);
+        } else if (arg == "--seed") {
+            options.seed = (uint32_t)strtoul(value, nullptr, 10);
+        } else if (arg == "--archive") {
+            options.archive = value;
+        } else if (arg == "--summary") {
+            options.summary_width = (uint32_t)strtoul(value, nullptr, 10);
+        } else {
+            usage();
+            return 1;
+        }
+    }
+
+    uint32_t min_mtu = ATT_NOTIFICATION_OVERHEAD + CHUNK_HEADER_SIZE + 8;
+    if (options.codec < 0 || options.mode < 0 || options.blocks == 0 || options.blocks > TOTAL_BLOCKS ||
+        options.mtu < min_mtu || options.mtu > 512 || options.workers == 0 || options.loss >= 1.0 ||
+        options.summary_width > SAMPLES_PER_WAVEFORM ||
+        (options.packed && options.zero_copy)) {
+        usage();
+        return 1;
+    }
+
+    printf("%u blocks, MTU %u, loss %.3f, reorder %.3f, dup %.3f, %s ingest, %s framing, %u workers, %s%s\n",
+           options.blocks, options.mtu, options.loss, options.reorder, options.dup,
+           options.zero_copy ? "zero-copy" : "process_chunk", options.packed ? "packed" : "chunk header",
+           options.workers,
+           options.rate_kbps ? "paced" : "unpaced", options.prewarm ? ", prewarmed" : "");
+    printf("codec mode   blocks  compr   ok   blocks/s first_us  ns/chunk allocs/blk rss_kb  sent/lost/reord/dup\n");
+
+    app_waveform_init();
+    for (int codec = 0; codec < CODEC_COUNT; codec++) {
+        if (options.codec != CODEC_COUNT && options.codec != codec) {
+            continue;
+        }
+        for (int mode = 0; mode < MODE_COUNT; mode++) {
+            if (options.mode != MODE_COUNT && options.mode != mode) {
+                continue;
+            }
+            run_case(codec, mode, options);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,170 @@
+#ifndef PSOC_CAPTURE_ARCHIVE_H
+#define PSOC_CAPTURE_ARCHIVE_H
+
+#include "data_types.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Capture archive: an append-only file of received blocks, stored exactly as
+// they arrived (the WAVEFORM_HEADER_SIZE-byte waveform header followed by raw
+// 24-bit samples or the compressed payload). Closing the writer appends a
+// block index and a footer with the CRC32 of every block.
+//
+//   file header   CAPTURE_FILE_HEADER_SIZE bytes, starts with CAPTURE_FILE_MAGIC
+//   records       CAPTURE_RECORD_HEADER_SIZE bytes + block, padded to 8 bytes
+//   index         CAPTURE_INDEX_ENTRY_SIZE bytes per block, in block order
+//   CRC footer    CRC32 of each block's bytes, in index order
+//   trailer       CAPTURE_TRAILER_SIZE bytes, ends with CAPTURE_TRAILER_MAGIC
+//
+// Integers are little-endian. An archive whose writer never closed it has no
+// trailer; the reader then rebuilds the index by scanning the records.
+#define CAPTURE_FILE_MAGIC "PSOCCAP1"
+#define CAPTURE_TRAILER_MAGIC "PSOCEND1"
+#define CAPTURE_RECORD_MAGIC 0x314B4C42u  // "BLK1"
+#define CAPTURE_ARCHIVE_VERSION 1
+#define CAPTURE_FILE_HEADER_SIZE 32
+#define CAPTURE_RECORD_HEADER_SIZE 16
+#define CAPTURE_INDEX_ENTRY_SIZE 24
+#define CAPTURE_TRAILER_SIZE 32
+
+// Opaque handles
+typedef struct capture_writer capture_writer_t;
+typedef struct capture_archive capture_archive_t;
+
+// One archived block. Pointers refer to the mapped file and stay valid until
+// capture_archive_close().
+typedef struct {
+    uint16_t block_number;
+    uint8_t codec;                 // BLOCK_CODEC_* from the chunk flags
+    uint32_t timestamp_ms;         // from the waveform header
+    const uint8_t* data;           // block as received: waveform header, then payload
+    size_t size;
+    const uint8_t* payload;        // data + WAVEFORM_HEADER_SIZE
+    size_t payload_size;
+} capture_block_view_t;
+
+/**
+ * Create an archive, replacing any file at path
+ * Starts a background thread that writes appended blocks in batches.
+ * @param path File path
+ * @return Pointer to new writer, or NULL if the file could not be created
+ */
+capture_writer_t* capture_writer_open(const char* path);
+
+/**
+ * Queue a block for writing
+ * Only copies the block; the CRC and the file write happen on the writer thread.
+ * A block number archived twice keeps its last copy.
+ * @param writer Archive writer
+ * @param block Block as reassembled (waveform header, then payload)
+ * @param size Block size in bytes (at least WAVEFORM_HEADER_SIZE)
+ * @param codec BLOCK_CODEC_* of the block
+ * @return false if the block is malformed or an earlier write failed
+ */
+bool capture_writer_append(capture_writer_t* writer, const uint8_t* block, size_t size, uint8_t codec);
+
+/**
+ * Wait until every block appended so far has been written to the file
+ * @param writer Archive writer
+ * @return false if a write failed
+ */
+bool capture_writer_flush(capture_writer_t* writer);
+
+/**
+ * Get the number of blocks appended so far
+ * @param writer Archive writer
+ * @return Block count, duplicates included
+ */
+uint32_t capture_writer_block_count(const capture_writer_t* writer);
+
+/**
+ * Write the remaining blocks, the index and the CRC footer, then free the writer
+ * Detach the writer from any session (transfer_session_set_archive) first.
+ * @param writer Archive writer (may be NULL)
+ * @return true if the whole archive was written successfully
+ */
+bool capture_writer_close(capture_writer_t* writer);
+
+/**
+ * Map an archive for reading
+ * @param path File path
+ * @return Pointer to archive, or NULL if the file is missing or not an archive
+ */
+capture_archive_t* capture_archive_open(const char* path);
+
+/**
+ * Unmap an archive; views taken from it become invalid
+ * @param archive Archive (may be NULL)
+ */
+void capture_archive_close(capture_archive_t* archive);
+
+/**
+ * Check whether the archive was closed by its writer
+ * @param archive Archive
+ * @return true if the index and CRC footer were read from the file, false if
+ *         they were rebuilt from the records (CRCs then come from the records)
+ */
+bool capture_archive_is_complete(const capture_archive_t* archive);
+
+/**
+ * Get the number of distinct blocks in the archive
+ * @param archive Archive
+ * @return Block count
+ */
+uint32_t capture_archive_block_count(const capture_archive_t* archive);
+
+/**
+ * Get a block by position (0 to block count - 1, in block number order)
+ * @param archive Archive
+ * @param index Position
+ * @param view View to fill
+ * @return true on success, false if index is out of range
+ */
+bool capture_archive_get_block_at(const capture_archive_t* archive, uint32_t index, capture_block_view_t* view);
+
+/**
+ * Get a block by block number
+ * @param archive Archive
+ * @param block_number Block number
+ * @param view View to fill
+ * @return true if the block is in the archive
+ */
+bool capture_archive_get_block(const capture_archive_t* archive, uint16_t block_number, capture_block_view_t* view);
+
+/**
+ * Find the blocks captured in a time range
+ * @param archive Archive
+ * @param start_ms First timestamp to include
+ * @param end_ms Last timestamp to include
+ * @param indices Filled with the positions of matching blocks, in block order (may be NULL)
+ * @param capacity Entries available in indices
+ * @return Number of matching blocks, which may exceed capacity
+ */
+size_t capture_archive_find_time_range(const capture_archive_t* archive, uint32_t start_ms, uint32_t end_ms,
+                                       uint32_t* indices, size_t capacity);
+
+/**
+ * Check every block against its CRC in the footer
+ * @param archive Archive
+ * @return Number of blocks whose bytes no longer match (0 if the archive is intact)
+ */
+uint32_t capture_archive_verify(const capture_archive_t* archive);
+
+/**
+ * Decode an archived block the way a transfer session delivers it
+ * @param view Block view
+ * @param waveform Waveform to fill
+ * @return true if the block decoded and its sample CRC matches the header
+ */
+bool capture_archive_decode(const capture_block_view_t* view, waveform_data_t* waveform);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PSOC_CAPTURE_ARCHIVE_H
@@ -9,8 +9,19 @@
 extern "C" {
 #endif
 
+// Rice stream produced by the firmware's app_waveform_compress (see app_waveform.h):
+// tag byte, 16-bit sample count, then per partition a 2-bit predictor order,
+// a 5-bit Rice parameter and the Rice-coded zigzag residuals (MSB first)
+#define CODEC_RICE_TAG 0x01            // First byte; a zlib stream never starts with it
+#define CODEC_RICE_PARTITION 32        // Samples per partition
+#define CODEC_RICE_MAX_K 24            // Largest Rice parameter
+#define CODEC_RICE_ESCAPE 16           // Quotient that switches to a raw residual
+#define CODEC_RICE_ESCAPE_BITS 27      // Width of a raw residual
+
 /**
- * Decompress waveform data using zlib and delta decoding
+ * Decompress waveform data
+ * Accepts the lossless Rice stream (first byte CODEC_RICE_TAG) or the legacy
+ * zlib stream of 16-bit deltas.
  * @param compressed_data Pointer to compressed data
  * @param compressed_size Size of compressed data in bytes
  * @param samples Output buffer for decompressed samples (must hold 2376 int32_t values)
@@ -18,6 +29,65 @@ extern "C" {
  */
 bool decompress_waveform(const uint8_t* compressed_data, size_t compressed_size, int32_t* samples);
 
+/**
+ * Decompress a Rice stream (BLOCK_CODEC_RICE)
+ * @param compressed_data Pointer to compressed data
+ * @param compressed_size Size of compressed data in bytes
+ * @param samples Output buffer for decompressed samples (must hold 2376 int32_t values)
+ * @return true on success, false on failure
+ */
+bool decompress_waveform_rice(const uint8_t* compressed_data, size_t compressed_size, int32_t* samples);
+
+/**
+ * Decompress a zlib stream of 16-bit deltas (BLOCK_CODEC_ZLIB_DELTA)
+ * @param compressed_data Pointer to compressed data
+ * @param compressed_size Size of compressed data in bytes
+ * @param samples Output buffer for decompressed samples (must hold 2376 int32_t values)
+ * @return true on success, false on failure
+ */
+bool decompress_waveform_zlib_delta(const uint8_t* compressed_data, size_t compressed_size, int32_t* samples);
+
+// Incremental decoder for BLOCK_CODEC_ZLIB_DELTA streams. Keeps one z_stream
+// alive across blocks and delta-decodes each small inflate output piece while
+// it is still in cache, so a block can be decoded as its chunks arrive.
+typedef struct delta_inflater delta_inflater_t;
+
+/**
+ * Create a decoder, ready for a first block
+ * @return Pointer to new decoder, or NULL if zlib could not be initialized
+ */
+delta_inflater_t* delta_inflater_create(void);
+
+/**
+ * Destroy a decoder and free its zlib state
+ * @param inflater Decoder to destroy (may be NULL)
+ */
+void delta_inflater_destroy(delta_inflater_t* inflater);
+
+/**
+ * Discard any partial block and start a new one (inflateReset, no reallocation)
+ * @param inflater Decoder
+ */
+void delta_inflater_reset(delta_inflater_t* inflater);
+
+/**
+ * Decode the next bytes of the compressed stream
+ * Bytes must be fed in stream order; any split between calls is fine.
+ * @param inflater Decoder
+ * @param data Next compressed bytes
+ * @param length Number of bytes
+ * @return false once the stream is known to be corrupt
+ */
+bool delta_inflater_feed(delta_inflater_t* inflater, const uint8_t* data, size_t length);
+
+/**
+ * Finish the current block
+ * @param inflater Decoder
+ * @param samples Output buffer for decompressed samples (must hold 2376 int32_t values)
+ * @return true if the stream ended after exactly 2376 samples, false otherwise
+ */
+bool delta_inflater_finish(delta_inflater_t* inflater, int32_t* samples);
+
 #ifdef __cplusplus
 }
 #endif
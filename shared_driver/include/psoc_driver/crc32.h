@@ -3,11 +3,57 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include <stdbool.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+// CRC32 implementations selectable at runtime
+typedef enum {
+    CRC32_BACKEND_AUTO = 0,       // Fastest backend available on this CPU
+    CRC32_BACKEND_BITWISE,        // Reference bit-at-a-time loop
+    CRC32_BACKEND_TABLE,          // 256-entry table, one byte per step
+    CRC32_BACKEND_SLICE8,         // Slice-by-8, eight bytes per step
+    CRC32_BACKEND_HARDWARE        // PCLMULQDQ folding (x86) or ARMv8 CRC32 instructions
+} crc32_backend_t;
+
+/**
+ * Select the CRC32 backend used by all functions in this header
+ * @param backend Backend to use (CRC32_BACKEND_AUTO picks the fastest available)
+ * @return true on success, false if the backend is not supported on this CPU
+ */
+bool crc32_set_backend(crc32_backend_t backend);
+
+/**
+ * Get the CRC32 backend currently in use (never CRC32_BACKEND_AUTO)
+ * @return Active backend
+ */
+crc32_backend_t crc32_get_backend(void);
+
+/**
+ * Check whether a backend can run on this CPU
+ * @param backend Backend to check
+ * @return true if supported
+ */
+bool crc32_backend_supported(crc32_backend_t backend);
+
+/**
+ * Get a printable name for a backend
+ * @param backend Backend
+ * @return Name string (e.g., "slice8")
+ */
+const char* crc32_backend_name(crc32_backend_t backend);
+
+/**
+ * Continue a CRC32 over more data (zlib-compatible running value)
+ * @param crc CRC32 of the preceding data (0 for the first call)
+ * @param data Pointer to data buffer
+ * @param length Length of data in bytes
+ * @return CRC32 of all data so far
+ */
+uint32_t crc32_update(uint32_t crc, const uint8_t* data, size_t length);
+
 /**
  * Calculate CRC32 for 24-bit packed samples
  * @param samples Array of 32-bit sign-extended samples
@@ -24,6 +70,17 @@ uint32_t calculate_crc32_samples(const int32_t* samples, size_t count);
  */
 uint32_t calculate_crc32_data(const uint8_t* data, size_t length);
 
+/**
+ * Unpack 24-bit little-endian samples and calculate their CRC32 in one pass
+ * The packed buffer is processed in L1-sized pieces, so each byte is read
+ * from memory once for both the CRC and the unpack.
+ * @param packed Packed sample data (count * 3 bytes)
+ * @param count Number of samples
+ * @param samples Output buffer for sign-extended samples
+ * @return CRC32 of the packed data
+ */
+uint32_t calculate_crc32_unpack_24bit(const uint8_t* packed, size_t count, int32_t* samples);
+
 #ifdef __cplusplus
 }
 #endif
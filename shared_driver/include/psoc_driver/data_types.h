@@ -1,38 +1,85 @@
 #ifndef PSOC_DATA_TYPES_H
 #define PSOC_DATA_TYPES_H
 
+#include "wire_format.h"
 #include <stdint.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-// Waveform header structure (matches PSoC firmware layout)
+// Waveform header structure, exactly as sent (see wire_format.h)
 typedef struct __attribute__((packed)) {
     uint32_t block_number;
     uint32_t timestamp_ms;
     uint32_t sample_rate_hz;
     uint16_t sample_count;
-    uint16_t reserved1;           // padding/alignment
+    uint16_t bits_per_sample;
     uint16_t trigger_sample;
     uint32_t pulse_freq_hz;
-    uint32_t reserved2;           // padding/alignment
+    uint8_t  pulse_cycles;
+    uint8_t  pulse_voltage;
+    uint16_t sensor_id;
     int16_t  temperature_cx10;
     uint8_t  gain_db;
-    uint8_t  reserved3;           // padding/alignment
+    uint8_t  status_flags;
     uint32_t crc32;
-    uint16_t reserved4;           // padding to 38 bytes
+    uint16_t reserved[2];
 } waveform_header_t;
 
+PSOC_WIRE_CHECK_SIZE(waveform_header_t, WAVEFORM_HEADER_SIZE);
+PSOC_WIRE_CHECK_FIELD(waveform_header_t, block_number, WAVEFORM_HDR_BLOCK_NUMBER);
+PSOC_WIRE_CHECK_FIELD(waveform_header_t, timestamp_ms, WAVEFORM_HDR_TIMESTAMP_MS);
+PSOC_WIRE_CHECK_FIELD(waveform_header_t, sample_rate_hz, WAVEFORM_HDR_SAMPLE_RATE_HZ);
+PSOC_WIRE_CHECK_FIELD(waveform_header_t, sample_count, WAVEFORM_HDR_SAMPLE_COUNT);
+PSOC_WIRE_CHECK_FIELD(waveform_header_t, bits_per_sample, WAVEFORM_HDR_BITS_PER_SAMPLE);
+PSOC_WIRE_CHECK_FIELD(waveform_header_t, trigger_sample, WAVEFORM_HDR_TRIGGER_SAMPLE);
+PSOC_WIRE_CHECK_FIELD(waveform_header_t, pulse_freq_hz, WAVEFORM_HDR_PULSE_FREQ_HZ);
+PSOC_WIRE_CHECK_FIELD(waveform_header_t, pulse_cycles, WAVEFORM_HDR_PULSE_CYCLES);
+PSOC_WIRE_CHECK_FIELD(waveform_header_t, pulse_voltage, WAVEFORM_HDR_PULSE_VOLTAGE);
+PSOC_WIRE_CHECK_FIELD(waveform_header_t, sensor_id, WAVEFORM_HDR_SENSOR_ID);
+PSOC_WIRE_CHECK_FIELD(waveform_header_t, temperature_cx10, WAVEFORM_HDR_TEMPERATURE_CX10);
+PSOC_WIRE_CHECK_FIELD(waveform_header_t, gain_db, WAVEFORM_HDR_GAIN_DB);
+PSOC_WIRE_CHECK_FIELD(waveform_header_t, status_flags, WAVEFORM_HDR_STATUS_FLAGS);
+PSOC_WIRE_CHECK_FIELD(waveform_header_t, crc32, WAVEFORM_HDR_CRC32);
+PSOC_WIRE_CHECK_FIELD(waveform_header_t, reserved, WAVEFORM_HDR_RESERVED);
+
 // Chunk header structure (for BLE transfer)
 typedef struct __attribute__((packed)) {
     uint16_t block_number;
     uint16_t chunk_number;
     uint16_t chunk_size;
     uint16_t total_chunks;
-    uint32_t reserved;            // future use
+    uint16_t block_size_total;    // size of the whole block as sent
+    uint8_t  flags;               // codec in the low bits (CHUNK_FLAGS_CODEC_MASK)
+    uint8_t  reserved;            // future use
 } chunk_header_t;
 
+PSOC_WIRE_CHECK_SIZE(chunk_header_t, CHUNK_HEADER_SIZE);
+PSOC_WIRE_CHECK_FIELD(chunk_header_t, block_number, CHUNK_HDR_BLOCK_NUMBER);
+PSOC_WIRE_CHECK_FIELD(chunk_header_t, chunk_number, CHUNK_HDR_CHUNK_NUMBER);
+PSOC_WIRE_CHECK_FIELD(chunk_header_t, chunk_size, CHUNK_HDR_CHUNK_SIZE);
+PSOC_WIRE_CHECK_FIELD(chunk_header_t, total_chunks, CHUNK_HDR_TOTAL_CHUNKS);
+PSOC_WIRE_CHECK_FIELD(chunk_header_t, block_size_total, CHUNK_HDR_BLOCK_SIZE_TOTAL);
+PSOC_WIRE_CHECK_FIELD(chunk_header_t, flags, CHUNK_HDR_FLAGS);
+PSOC_WIRE_CHECK_FIELD(chunk_header_t, reserved, CHUNK_HDR_RESERVED);
+
+// Record header of the packed framing (see wire_format.h)
+typedef struct __attribute__((packed)) {
+    uint16_t block_word;          // PACKED_RECORD_MARKER | codec << PACKED_RECORD_CODEC_SHIFT | block number
+    uint16_t chunk_word;          // PACKED_RECORD_MORE if another record follows | chunk number
+    uint16_t total_chunks;
+    uint16_t chunk_offset;        // byte offset of the payload in its block
+} packed_record_header_t;
+
+PSOC_WIRE_CHECK_SIZE(packed_record_header_t, PACKED_RECORD_HEADER_SIZE);
+PSOC_WIRE_CHECK_FIELD(packed_record_header_t, block_word, PACKED_HDR_BLOCK_WORD);
+PSOC_WIRE_CHECK_FIELD(packed_record_header_t, chunk_word, PACKED_HDR_CHUNK_WORD);
+PSOC_WIRE_CHECK_FIELD(packed_record_header_t, total_chunks, PACKED_HDR_TOTAL_CHUNKS);
+PSOC_WIRE_CHECK_FIELD(packed_record_header_t, chunk_offset, PACKED_HDR_CHUNK_OFFSET);
+
+// sack_entry_t, sack_msg_t and resume_msg_t come from wire_format.h
+
 // Waveform data (header + samples)
 typedef struct {
     waveform_header_t header;
@@ -45,9 +92,12 @@ typedef struct {
     uint32_t total_blocks;
     uint32_t total_bytes_received;
     uint32_t total_chunks_received;
-    double   throughput_kbps;
+    double   throughput_kbps;          // average since start
     double   progress_percent;
     double   elapsed_seconds;
+    double   ewma_throughput_kbps;     // smoothed over the last few seconds
+    double   instant_throughput_kbps;  // since the previous block
+    double   eta_seconds;              // remaining blocks at the smoothed rate (0 until known)
 } transfer_stats_t;
 
 #ifdef __cplusplus
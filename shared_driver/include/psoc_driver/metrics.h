@@ -0,0 +1,69 @@
+#ifndef PSOC_METRICS_H
+#define PSOC_METRICS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Latency histograms are log-linear (HDR style): each power of two is split into
+// METRICS_SUB_BUCKETS equal buckets, so every bucket is within 25% of its value.
+// Values are nanoseconds; bucket i < 4 holds exactly i ns.
+#define METRICS_SUB_BUCKETS 4
+#define METRICS_HISTOGRAM_BUCKETS 160  // up to about 36 minutes; larger values land in the last bucket
+
+// Connection events are inferred from arrival gaps: notifications closer than
+// this belong to the same event (the shortest BLE connection interval is 7.5 ms)
+#define METRICS_EVENT_GAP_NS 2000000
+#define METRICS_MAX_CHUNKS_PER_EVENT 16
+
+// Stages timed by a transfer session (see transfer_session_get_metrics)
+typedef enum {
+    METRICS_STAGE_CHUNK_INGEST = 0,   // begin/commit of one chunk, excluding block completion
+    METRICS_STAGE_BLOCK_ASSEMBLY,     // first chunk of a block arriving to its last
+    METRICS_STAGE_DECODE,             // decompression, or unpack + CRC in one pass for raw blocks
+    METRICS_STAGE_CRC,                // CRC of decompressed samples
+    METRICS_STAGE_CALLBACK,           // waveform callback, or publishing to the waveform ring
+    METRICS_STAGE_CHUNK_INTERVAL,     // gap between consecutive chunk arrivals
+    METRICS_STAGE_COUNT
+} metrics_stage_t;
+
+typedef struct {
+    uint64_t count;
+    uint64_t sum_ns;
+    uint64_t min_ns;
+    uint64_t max_ns;
+    uint32_t buckets[METRICS_HISTOGRAM_BUCKETS];
+} latency_histogram_t;
+
+typedef struct {
+    latency_histogram_t stages[METRICS_STAGE_COUNT];
+    uint64_t jitter_ns;                // smoothed inter-arrival variation (RFC 3550 estimator)
+    uint32_t chunks_per_event[METRICS_MAX_CHUNKS_PER_EVENT + 1];  // [n] = events with n chunks (last: n or more)
+    uint32_t out_of_order_chunks;      // filled a gap below the highest chunk seen (retransmissions)
+    uint32_t duplicate_chunks;         // already received or already delivered
+} transfer_metrics_t;
+
+/**
+ * Get the smallest value that falls in a histogram bucket
+ * @param bucket Bucket index (< METRICS_HISTOGRAM_BUCKETS)
+ * @return Lower bound in nanoseconds
+ */
+uint64_t metrics_bucket_lower_bound_ns(uint32_t bucket);
+
+/**
+ * Estimate a percentile of one stage's latency
+ * @param metrics Metrics from transfer_session_get_metrics()
+ * @param stage Stage
+ * @param percentile Percentile in [0, 100]
+ * @return Upper bound of the bucket holding the percentile, in nanoseconds (0 if empty)
+ */
+uint64_t metrics_percentile_ns(const transfer_metrics_t* metrics, metrics_stage_t stage, double percentile);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PSOC_METRICS_H
@@ -1,6 +1,7 @@
 #ifndef PSOC_PROTOCOL_H
 #define PSOC_PROTOCOL_H
 
+#include "wire_format.h"
 #include <stdint.h>
 
 #ifdef __cplusplus
@@ -11,6 +12,7 @@ extern "C" {
 #define SERVICE_UUID "A1B2C3D4-E5F6-4A5B-8C9D-0E1F2A3B4C5D"
 #define DATA_BLOCK_UUID "A1B2C3D5-E5F6-4A5B-8C9D-0E1F2A3B4C5D"
 #define CONTROL_UUID "A1B2C3D6-E5F6-4A5B-8C9D-0E1F2A3B4C5D"
+#define TELEMETRY_UUID "A1B2C3D7-E5F6-4A5B-8C9D-0E1F2A3B4C5D"  // Read: firmware send/credit summary; write 0x00 reset, 0x01 dump to console
 
 // Device identification
 #define DEVICE_NAME "Inductosense Temp"
@@ -24,11 +26,16 @@ extern "C" {
 #define CMD_START 0x01
 #define CMD_STOP  0x02
 #define CMD_ACK   0x03
+#define CMD_RESUME 0x04  // Resume after reconnecting (resume_msg_t)
+#define CMD_SACK  0x06
 
 // Waveform constants
 #define SAMPLES_PER_WAVEFORM 2376
 #define BYTES_PER_SAMPLE 3
-#define WAVEFORM_HEADER_SIZE 38
+#define RAW_BLOCK_SIZE (WAVEFORM_HEADER_SIZE + SAMPLES_PER_WAVEFORM * BYTES_PER_SAMPLE)  // uncompressed block as sent
+
+// Header sizes, block codecs, start flags and the SACK and resume window
+// constants come from wire_format.h
 
 #ifdef __cplusplus
 }
@@ -12,8 +12,13 @@
 #include "protocol.h"
 #include "data_types.h"
 #include "crc32.h"
+#include "sample_unpack.h"
+#include "waveform_summary.h"
 #include "compression.h"
+#include "metrics.h"
+#include "capture_archive.h"
 #include "transfer_session.h"
+#include "replay.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -25,16 +30,40 @@ extern "C" {
  */
 const char* psoc_driver_version(void);
 
+// Library configuration for psoc_driver_init_with_config()
+typedef struct {
+    // Threads that validate, decode and deliver completed blocks for all
+    // sessions. 0 keeps everything on the thread that feeds chunks in;
+    // PSOC_DRIVER_WORKERS_AUTO uses one per CPU core minus one (at least 1).
+    uint32_t worker_threads;
+} psoc_driver_config_t;
+
+#define PSOC_DRIVER_WORKERS_AUTO 0xFFFFFFFFu
+
 /**
  * Initialize the driver library
- * Must be called before using any other driver functions
+ * Must be called before using any other driver functions.
+ * Same as psoc_driver_init_with_config() with worker_threads = 0.
  * @return true on success, false on failure
  */
 bool psoc_driver_init(void);
 
+/**
+ * Initialize the driver library with a worker pool
+ * With workers, a session's chunk ingest only reassembles and acknowledges;
+ * each completed block is queued to the pool, which checks and decodes it and
+ * runs the waveform, progress and completion callbacks. Callbacks of one
+ * session run in block order and never concurrently; different sessions run
+ * in parallel. Sessions pick the mode up in transfer_session_start().
+ * @param config Configuration (NULL for the defaults of psoc_driver_init())
+ * @return true on success, false on failure
+ */
+bool psoc_driver_init_with_config(const psoc_driver_config_t* config);
+
 /**
  * Cleanup the driver library
- * Should be called when done using the driver
+ * Should be called when done using the driver, after every session has been
+ * destroyed. Waits for queued blocks to be delivered, then stops the workers.
  */
 void psoc_driver_cleanup(void);
 
@@ -0,0 +1,87 @@
+#ifndef PSOC_REPLAY_H
+#define PSOC_REPLAY_H
+
+#include "data_types.h"
+#include "capture_archive.h"
+#include "transfer_session.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Offline decoding of recorded notification logs, using every core.
+//
+// A notification log holds the data notifications of one transfer in the
+// order they arrived, each as a 2-byte little-endian length followed by the
+// notification exactly as it would be passed to transfer_session_process_chunk()
+// (chunk header or packed records). There is no file header; a log cut short
+// by a crash simply ends part way through its last notification.
+//
+// Replay splits the log by block number, then reassembles and decodes blocks
+// in parallel. Reassembly follows the session's rules for each block (the
+// first complete copy wins, a copy in another layout starts the block over),
+// but blocks no longer compete for the session's few reassembly slots, so a
+// log that a live session fed with gaps still yields every block it holds.
+#define REPLAY_LOG_LENGTH_SIZE 2
+
+// Use one thread per CPU core, the calling thread included
+#define REPLAY_THREADS_AUTO 0
+
+typedef struct {
+    // Threads that reassemble and decode, the calling thread included.
+    // Replay runs on its own threads, not the worker pool, so a long replay
+    // does not hold up the delivery of live sessions.
+    uint32_t threads;
+
+    // Append every complete block here, in block order (NULL for none). The
+    // writer is not closed.
+    capture_writer_t* archive;
+} replay_options_t;
+
+typedef struct {
+    uint32_t notifications;          // notifications read from the log
+    uint32_t malformed_notifications; // notifications with a chunk that failed to parse
+    uint32_t blocks_seen;            // distinct block numbers with at least one chunk
+    uint32_t blocks_complete;        // blocks reassembled in full
+    uint32_t blocks_decoded;         // complete blocks that decoded and matched their CRC
+    bool truncated;                  // the log ends part way through a notification
+    double elapsed_seconds;
+} replay_stats_t;
+
+/**
+ * Reassemble and decode a notification log held in memory
+ * The waveform callback runs on the calling thread, once per decoded block, in
+ * block number order. With no callback, blocks are only reassembled (and
+ * archived), not decoded.
+ * @param log Notification log
+ * @param size Log size in bytes
+ * @param options Options (NULL for REPLAY_THREADS_AUTO and no archive)
+ * @param callback Waveform callback (may be NULL)
+ * @param user_data User data to pass to callback
+ * @param stats Receives what was found in the log (may be NULL)
+ * @return false if the archive could not be written or memory ran out
+ */
+bool replay_notification_log(const uint8_t* log, size_t size, const replay_options_t* options,
+                             waveform_callback_t callback, void* user_data, replay_stats_t* stats);
+
+/**
+ * Memory-map a notification log file and replay it
+ * Same as replay_notification_log(); pages are read as the log is split.
+ * @param path File path
+ * @param options Options (NULL for REPLAY_THREADS_AUTO and no archive)
+ * @param callback Waveform callback (may be NULL)
+ * @param user_data User data to pass to callback
+ * @param stats Receives what was found in the log (may be NULL)
+ * @return false if the file could not be mapped, the archive written or memory ran out
+ */
+bool replay_notification_file(const char* path, const replay_options_t* options,
+                              waveform_callback_t callback, void* user_data, replay_stats_t* stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PSOC_REPLAY_H
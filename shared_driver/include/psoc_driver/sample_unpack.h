@@ -0,0 +1,105 @@
+#ifndef PSOC_SAMPLE_UNPACK_H
+#define PSOC_SAMPLE_UNPACK_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Sample unpack kernels selectable at runtime
+typedef enum {
+    UNPACK_BACKEND_AUTO = 0,      // Fastest kernel available on this CPU
+    UNPACK_BACKEND_SCALAR,        // Portable C++ loop
+    UNPACK_BACKEND_SSSE3,         // x86 PSHUFB, 8 samples per step
+    UNPACK_BACKEND_AVX2,          // x86 VPSHUFB, 16 samples per step
+    UNPACK_BACKEND_NEON           // ARM TBL, 8 samples per step
+} unpack_backend_t;
+
+/**
+ * Select the kernel used by all functions in this header
+ * @param backend Kernel to use (UNPACK_BACKEND_AUTO picks the fastest available)
+ * @return true on success, false if the kernel is not supported on this CPU
+ */
+bool unpack_set_backend(unpack_backend_t backend);
+
+/**
+ * Get the kernel currently in use (never UNPACK_BACKEND_AUTO)
+ * @return Active kernel
+ */
+unpack_backend_t unpack_get_backend(void);
+
+/**
+ * Check whether a kernel can run on this CPU
+ * @param backend Kernel to check
+ * @return true if supported
+ */
+bool unpack_backend_supported(unpack_backend_t backend);
+
+/**
+ * Get a printable name for a kernel
+ * @param backend Kernel
+ * @return Name string (e.g., "avx2")
+ */
+const char* unpack_backend_name(unpack_backend_t backend);
+
+/**
+ * Unpack 24-bit little-endian samples and sign-extend them to 32 bits
+ * @param packed Packed sample data (count * 3 bytes)
+ * @param count Number of samples
+ * @param samples Output buffer for count samples
+ */
+void unpack_24bit_samples(const uint8_t* packed, size_t count, int32_t* samples);
+
+/**
+ * Unpack 24-bit little-endian samples straight to scaled floats
+ * Produces plot-ready values without an intermediate int32 buffer.
+ * @param packed Packed sample data (count * 3 bytes)
+ * @param count Number of samples
+ * @param scale Factor applied to each sign-extended sample (e.g., 1.0f / 8388608.0f)
+ * @param out Output buffer for count floats
+ */
+void unpack_24bit_samples_float(const uint8_t* packed, size_t count, float scale, float* out);
+
+/**
+ * Convert already-unpacked samples to scaled floats
+ * @param samples Sign-extended samples (e.g., waveform_data_t::samples)
+ * @param count Number of samples
+ * @param scale Factor applied to each sample
+ * @param out Output buffer for count floats
+ */
+void convert_samples_to_float(const int32_t* samples, size_t count, float scale, float* out);
+
+/**
+ * Unpack many blocks in one call (e.g., replaying an archived capture)
+ * @param packed Packed samples of the first block
+ * @param packed_stride Byte distance between the packed samples of consecutive blocks
+ *                      (samples_per_block * 3 for a dense buffer, larger to skip headers)
+ * @param block_count Number of blocks
+ * @param samples_per_block Samples in each block
+ * @param samples Output buffer for block_count * samples_per_block samples, block after block
+ */
+void unpack_24bit_samples_batch(const uint8_t* packed, size_t packed_stride, size_t block_count,
+                                size_t samples_per_block, int32_t* samples);
+
+/**
+ * Find the smallest and largest sample in each of a number of equal columns
+ * Column c covers samples c * count / columns up to (c + 1) * count / columns,
+ * so every column holds at least one sample. This is the envelope kernel
+ * behind waveform_summary.h.
+ * @param samples Sign-extended samples
+ * @param count Number of samples
+ * @param columns Number of columns (1 to count)
+ * @param min_out Output buffer for columns minimums
+ * @param max_out Output buffer for columns maximums
+ */
+void samples_min_max_columns(const int32_t* samples, size_t count, size_t columns, int32_t* min_out,
+                             int32_t* max_out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PSOC_SAMPLE_UNPACK_H
@@ -3,6 +3,9 @@
 
 #include "data_types.h"
 #include "protocol.h"
+#include "metrics.h"
+#include "capture_archive.h"
+#include "waveform_summary.h"
 #include <stdint.h>
 #include <stdbool.h>
 #include <stddef.h>
@@ -14,20 +17,42 @@ extern "C" {
 // Opaque handle for transfer session
 typedef struct transfer_session transfer_session_t;
 
+// Largest waveform ring (entries of about 9.5 KB each)
+#define WAVEFORM_RING_MAX_CAPACITY 64
+
 // Callback types
 typedef void (*waveform_callback_t)(const waveform_data_t* waveform, bool is_compressed, void* user_data);
 typedef void (*progress_callback_t)(const transfer_stats_t* stats, void* user_data);
 typedef void (*completion_callback_t)(const transfer_stats_t* final_stats, void* user_data);
 typedef void (*ack_callback_t)(uint16_t block_number, void* user_data);
+typedef void (*sack_callback_t)(const uint8_t* message, size_t length, void* user_data);
+typedef void (*summary_callback_t)(const waveform_summary_t* summary, void* user_data);
+
+// A completed block handed over before its samples are decoded
+typedef struct {
+    waveform_header_t header;      // parsed from the block; crc32 not yet checked against the samples
+    bool is_compressed;
+    capture_block_view_t block;    // the block as received, still encoded; valid only during the callback
+} waveform_handle_t;
+
+typedef void (*lazy_waveform_callback_t)(const waveform_handle_t* handle, void* user_data);
 
 /**
  * Create a new transfer session
+ * All reassembly memory is allocated here and reused for the whole transfer;
+ * completed blocks are handed to the waveform callback and not retained, so a
+ * session has a fixed footprint (about 30 KB) regardless of transfer length.
+ * Sessions that decode inline also give each slot a delta_inflater_t (about
+ * 50 KB with the zlib window) at transfer_session_start, so legacy zlib/delta
+ * blocks decode as chunks arrive without allocating on the ingest path.
  * @return Pointer to new session, or NULL on failure
  */
 transfer_session_t* transfer_session_create(void);
 
 /**
  * Destroy a transfer session and free resources
+ * With a worker pool, first waits for queued blocks to be delivered, so it
+ * must not be called from one of the session's own callbacks.
  * @param session Session to destroy
  */
 void transfer_session_destroy(transfer_session_t* session);
@@ -40,6 +65,104 @@ void transfer_session_destroy(transfer_session_t* session);
  */
 void transfer_session_set_waveform_callback(transfer_session_t* session, waveform_callback_t callback, void* user_data);
 
+/**
+ * Deliver completed blocks undecoded, for consumers that mostly need the header
+ * The callback gets the parsed header and the encoded block; samples are only
+ * decoded and CRC-checked when it calls waveform_handle_decode(). zlib/delta
+ * blocks are no longer inflated as their chunks arrive. While set, it replaces
+ * the waveform callback, the waveform ring and the summary stage, which all
+ * need decoded samples. Runs on the same thread, in the same order, as the
+ * waveform callback would. Call before transfer_session_start().
+ * @param session Transfer session
+ * @param callback Callback function (NULL goes back to decoding every block)
+ * @param user_data User data to pass to callback
+ */
+void transfer_session_set_lazy_waveform_callback(transfer_session_t* session, lazy_waveform_callback_t callback,
+                                                 void* user_data);
+
+/**
+ * Decode the samples of a lazily delivered block and check its CRC
+ * Call from the lazy waveform callback, while the block is still valid.
+ * @param handle Handle passed to the callback
+ * @param waveform Waveform to fill (header included)
+ * @return true if the block decoded and its sample CRC matches the header
+ */
+bool waveform_handle_decode(const waveform_handle_t* handle, waveform_data_t* waveform);
+
+/**
+ * Deliver waveforms through a preallocated ring instead of the waveform callback
+ * Completed blocks are decoded straight into the next free entry, which the
+ * application then reads in place (e.g. once per UI frame) with
+ * transfer_session_acquire_waveform() / transfer_session_release_waveform().
+ * When every entry is still unread, new waveforms are dropped rather than
+ * queued; the transfer itself is unaffected. Single consumer: acquire and
+ * release must be called from one thread at a time.
+ * Call before transfer_session_start(); the ring is emptied.
+ * @param session Transfer session
+ * @param capacity Number of entries, rounded up to a power of two (0 goes back to the callback)
+ * @return true on success, false if capacity exceeds WAVEFORM_RING_MAX_CAPACITY
+ */
+bool transfer_session_set_waveform_ring(transfer_session_t* session, uint32_t capacity);
+
+/**
+ * Get the oldest unread waveform from the ring without copying it
+ * The pointer stays valid until transfer_session_release_waveform().
+ * Calling again without releasing returns the same waveform.
+ * @param session Transfer session
+ * @param is_compressed Receives whether the block was compressed (may be NULL)
+ * @return Waveform, or NULL if the ring is empty or not enabled
+ */
+const waveform_data_t* transfer_session_acquire_waveform(transfer_session_t* session, bool* is_compressed);
+
+/**
+ * Skip to the newest unread waveform in the ring
+ * Releases every older entry (including one already acquired), then acquires
+ * the newest; what a display polling at frame rate wants.
+ * @param session Transfer session
+ * @param is_compressed Receives whether the block was compressed (may be NULL)
+ * @return Waveform, or NULL if the ring is empty or not enabled
+ */
+const waveform_data_t* transfer_session_acquire_latest_waveform(transfer_session_t* session, bool* is_compressed);
+
+/**
+ * Hand the acquired waveform's entry back to the session
+ * Does nothing if the ring is empty.
+ * @param session Transfer session
+ */
+void transfer_session_release_waveform(transfer_session_t* session);
+
+/**
+ * Get the number of waveforms dropped because the ring was full
+ * @param session Transfer session
+ * @return Drop count since the ring was set
+ */
+uint32_t transfer_session_get_dropped_waveforms(const transfer_session_t* session);
+
+/**
+ * Summarize every decoded waveform before it is delivered
+ * The summary callback runs just before the waveform callback (or the ring
+ * publish), on the same thread, with an envelope of config->envelope_width
+ * columns and the echoes found. A UI can redraw from the summary alone and read
+ * summary->waveform only when it wants the full samples. Call before
+ * transfer_session_start().
+ * @param session Transfer session
+ * @param callback Callback function (NULL turns summaries off)
+ * @param config Envelope width and echo detection (NULL for no envelope and default detection)
+ * @param user_data User data to pass to callback
+ */
+void transfer_session_set_summary_callback(transfer_session_t* session, summary_callback_t callback,
+                                           const waveform_summary_config_t* config, void* user_data);
+
+/**
+ * Archive every completed block as it was received
+ * The block is queued to the writer on the thread that feeds chunks in, before
+ * it is decoded, so waveform ring drops and decode failures do not leave holes.
+ * The writer must outlive the session, or be detached with NULL first.
+ * @param session Transfer session
+ * @param writer Archive writer (NULL stops archiving)
+ */
+void transfer_session_set_archive(transfer_session_t* session, capture_writer_t* writer);
+
 /**
  * Set progress callback (called periodically during transfer)
  * @param session Transfer session
@@ -48,6 +171,19 @@ void transfer_session_set_waveform_callback(transfer_session_t* session, wavefor
  */
 void transfer_session_set_progress_callback(transfer_session_t* session, progress_callback_t callback, void* user_data);
 
+/**
+ * Limit how often the progress callback fires
+ * A report is due once min_interval_ms has passed or min_blocks blocks have
+ * completed since the previous one, whichever comes first (0 disables that
+ * limit). The last block is always reported. The default (0, 0) reports every
+ * block. A UI can instead poll transfer_session_get_stats() at its own rate.
+ * @param session Transfer session
+ * @param min_interval_ms Minimum time between reports
+ * @param min_blocks Minimum blocks between reports
+ */
+void transfer_session_set_progress_interval(transfer_session_t* session, uint32_t min_interval_ms,
+                                           uint32_t min_blocks);
+
 /**
  * Set completion callback (called when transfer completes)
  * @param session Transfer session
@@ -64,8 +200,38 @@ void transfer_session_set_completion_callback(transfer_session_t* session, compl
  */
 void transfer_session_set_ack_callback(transfer_session_t* session, ack_callback_t callback, void* user_data);
 
+/**
+ * Set selective ACK callback (called with a sack_msg_t to write to the control characteristic)
+ * Fired when a block completes and whenever missing chunks are detected, and
+ * with the resume_msg_t messages of transfer_session_resume(). Once set,
+ * the firmware keeps SEND_WINDOW_BLOCKS in flight and retransmits only what is
+ * reported missing; the ACK callback is no longer called.
+ * @param session Transfer session
+ * @param callback Callback function (NULL to go back to ACK every ACK_INTERVAL blocks)
+ * @param user_data User data to pass to callback
+ */
+void transfer_session_set_sack_callback(transfer_session_t* session, sack_callback_t callback, void* user_data);
+
+/**
+ * Prepare a session for its first block ahead of the transfer
+ * Call after setting callbacks and delivery options, while the app scans and
+ * connects: allocates the worker pool jobs for a full send window and has a
+ * worker run the session once, or creates the zlib inflaters of blocks decoded
+ * inline, and runs the decode kernels once, so the first blocks are delivered
+ * without allocating, waiting for a thread or running cold code. Optional;
+ * transfer_session_start() keeps what it prepared. Not thread-safe with chunk
+ * ingest.
+ * @param session Transfer session
+ */
+void transfer_session_prewarm(transfer_session_t* session);
+
 /**
  * Start a new transfer session
+ * Picks up the delivery mode from psoc_driver_init_with_config(): with workers,
+ * the waveform, progress and completion callbacks run on a pool thread (in
+ * block order, one at a time per session); ACK and SACK callbacks always run
+ * on the thread that feeds chunks in. Inline sessions create their zlib
+ * inflaters here unless transfer_session_prewarm() already did.
  * @param session Transfer session
  */
 void transfer_session_start(transfer_session_t* session);
@@ -77,21 +243,96 @@ void transfer_session_start(transfer_session_t* session);
 void transfer_session_stop(transfer_session_t* session);
 
 /**
- * Process a received data chunk
+ * Continue the transfer after the link dropped and reconnected
+ * Unlike transfer_session_start(), keeps every received block and partly
+ * reassembled one, then passes the resume messages from
+ * transfer_session_build_resume() to the SACK callback, one call each. Write
+ * them once notifications are enabled again; the firmware then sends only what
+ * is missing. Call on the thread that feeds chunks in.
+ * @param session Transfer session
+ */
+void transfer_session_resume(transfer_session_t* session);
+
+/**
+ * Process a received data notification
+ * Accepts both framings: one chunk behind a chunk_header_t, or one or more
+ * packed records (wire_format.h) when the start command asked for them.
  * @param session Transfer session
- * @param data Pointer to chunk data
- * @param length Length of chunk data
- * @return true if chunk was processed successfully, false otherwise
+ * @param data Pointer to the notification
+ * @param length Length of the notification
+ * @return true if every chunk in it was processed successfully, false otherwise
  */
 bool transfer_session_process_chunk(transfer_session_t* session, const uint8_t* data, size_t length);
 
+/**
+ * Reserve the final location of a chunk payload in the reassembly buffer
+ * Zero-copy alternative to transfer_session_process_chunk(): the platform layer
+ * passes the notification header here, copies the payload straight from the BLE
+ * stack to the returned pointer, then calls transfer_session_commit_chunk().
+ * Only one chunk can be pending at a time. Chunk headers only: packed
+ * notifications can hold several chunks and go through
+ * transfer_session_process_chunk().
+ * @param session Transfer session
+ * @param header Start of the notification (at least CHUNK_HEADER_SIZE bytes)
+ * @param length Total notification length (header + payload)
+ * @param payload_size Receives the number of payload bytes to write (may be NULL)
+ * @return Destination for the payload, or NULL if nothing should be written
+ *         (malformed chunk, packed notification, duplicate, or chunk of an
+ *         already delivered block)
+ */
+uint8_t* transfer_session_begin_chunk(transfer_session_t* session, const uint8_t* header, size_t length,
+                                      size_t* payload_size);
+
+/**
+ * Commit the chunk reserved by transfer_session_begin_chunk()
+ * May invoke the waveform, ACK, progress and completion callbacks.
+ * Does nothing if no chunk is pending.
+ * @param session Transfer session
+ */
+void transfer_session_commit_chunk(transfer_session_t* session);
+
+/**
+ * Build a selective ACK from the current reassembly state
+ * Useful for re-sending the last SACK from a timer if the link goes quiet.
+ * @param session Transfer session
+ * @param buffer Output buffer (at least sizeof(sack_msg_t) bytes)
+ * @param capacity Size of buffer in bytes
+ * @return Message length, or 0 if buffer is too small
+ */
+size_t transfer_session_build_sack(const transfer_session_t* session, uint8_t* buffer, size_t capacity);
+
+/**
+ * Build the resume messages describing what has been received so far
+ * One resume_msg_t per partly received block (at least one message). For
+ * applications without a SACK callback; write each message separately.
+ * @param session Transfer session
+ * @param buffer Output buffer (at least RESUME_MAX_MESSAGES * sizeof(resume_msg_t) bytes)
+ * @param capacity Size of buffer in bytes
+ * @return Total length of the messages, or 0 if buffer is too small
+ */
+size_t transfer_session_build_resume(const transfer_session_t* session, uint8_t* buffer, size_t capacity);
+
 /**
  * Get current transfer statistics
+ * Stats are kept incrementally and published after every completed block; this
+ * copies the latest snapshot and is safe to call from any thread without locking.
  * @param session Transfer session
  * @param stats Pointer to stats structure to fill
  */
 void transfer_session_get_stats(const transfer_session_t* session, transfer_stats_t* stats);
 
+/**
+ * Get per-stage latency histograms and link counters
+ * Only collected when the library is built with -DPSOC_DRIVER_METRICS=ON.
+ * Lock-free; callable from any thread. Reset by transfer_session_start().
+ * With inline delivery, chunk ingest includes the incremental inflate of
+ * zlib/delta blocks.
+ * @param session Transfer session
+ * @param metrics Metrics structure to fill
+ * @return true if metrics are compiled in, false otherwise (metrics zeroed)
+ */
+bool transfer_session_get_metrics(const transfer_session_t* session, transfer_metrics_t* metrics);
+
 /**
  * Check if transfer is active
  * @param session Transfer session
@@ -99,6 +340,13 @@ void transfer_session_get_stats(const transfer_session_t* session, transfer_stat
  */
 bool transfer_session_is_active(const transfer_session_t* session);
 
+/**
+ * Parse the little-endian waveform header at the start of a block
+ * @param data Block data (at least WAVEFORM_HEADER_SIZE bytes)
+ * @param header Header structure to fill
+ */
+void parse_waveform_header(const uint8_t* data, waveform_header_t* header);
+
 #ifdef __cplusplus
 }
 #endif
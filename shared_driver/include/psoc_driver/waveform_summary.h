@@ -0,0 +1,74 @@
+#ifndef PSOC_WAVEFORM_SUMMARY_H
+#define PSOC_WAVEFORM_SUMMARY_H
+
+#include "data_types.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// A display-sized digest of one waveform: a min/max envelope at the width the
+// UI draws, the overall range and the echoes found in it. Computed with the
+// SIMD kernels of sample_unpack.h, so a host can redraw from the summary and
+// only touch the full samples when it needs them.
+
+// Most echoes reported per waveform (the strongest are kept)
+#define WAVEFORM_SUMMARY_MAX_ECHOES 8
+
+// Defaults for the zero fields of waveform_summary_config_t
+#define WAVEFORM_SUMMARY_DEFAULT_THRESHOLD 131072   // 1/64 of 24-bit full scale
+#define WAVEFORM_SUMMARY_DEFAULT_MIN_GAP   32       // samples below threshold that end an echo
+
+typedef struct {
+    uint16_t envelope_width;   // envelope columns (0 for none; at most the sample count)
+    int32_t  echo_threshold;   // |sample| an echo must exceed (0 for the default)
+    uint16_t echo_min_gap;     // samples below threshold that separate two echoes (0 for the default)
+} waveform_summary_config_t;
+
+typedef struct {
+    uint16_t sample_index;     // sample of the largest |amplitude|
+    uint16_t start_sample;     // first sample above threshold
+    uint16_t end_sample;       // last sample above threshold
+    int32_t  amplitude;        // signed sample at sample_index
+    float    time_us;          // sample_index at the header's sample rate, from the first sample
+} waveform_echo_t;
+
+typedef struct {
+    waveform_header_t header;
+    bool is_compressed;
+    int32_t min_sample;
+    int32_t max_sample;
+
+    // Echoes in time order
+    uint32_t echo_count;
+    waveform_echo_t echoes[WAVEFORM_SUMMARY_MAX_ECHOES];
+
+    // Column c covers samples c * count / width up to (c + 1) * count / width
+    uint16_t envelope_width;
+    const int32_t* envelope_min;
+    const int32_t* envelope_max;
+
+    // Full samples; valid only while the callback runs
+    const waveform_data_t* waveform;
+} waveform_summary_t;
+
+/**
+ * Summarize a decoded waveform
+ * @param waveform Waveform (header.sample_count samples are used)
+ * @param config Envelope width and echo detection (NULL for no envelope and default detection)
+ * @param envelope_min Buffer for config->envelope_width column minimums (may be NULL with no envelope)
+ * @param envelope_max Buffer for config->envelope_width column maximums (may be NULL with no envelope)
+ * @param summary Output summary; its envelope points at the given buffers and
+ *                its is_compressed is left false
+ */
+void waveform_summarize(const waveform_data_t* waveform, const waveform_summary_config_t* config,
+                        int32_t* envelope_min, int32_t* envelope_max, waveform_summary_t* summary);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PSOC_WAVEFORM_SUMMARY_H
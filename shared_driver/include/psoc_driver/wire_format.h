@@ -0,0 +1,173 @@
+#ifndef PSOC_WIRE_FORMAT_H
+#define PSOC_WIRE_FORMAT_H
+
+// Wire layout of the waveform, chunk and packed record headers and of the SACK
+// and resume control messages. This is the one definition of the format: the
+// firmware (app_waveform.h, app_data_transfer.h) and the driver (data_types.h)
+// check their header structs against these offsets at compile time with
+// PSOC_WIRE_CHECK_FIELD, and both use the control message structs defined
+// here. Integers are little-endian.
+//
+// Bump PSOC_PROTOCOL_VERSION whenever an offset or size below changes.
+// Version 2 added the packed framing; version 1 chunk headers are unchanged
+// and still what the firmware sends unless the host asks for packing.
+#define PSOC_PROTOCOL_VERSION 2
+
+#include <stdint.h>
+
+// Waveform header, at the start of every block
+#define WAVEFORM_HEADER_SIZE 38
+#define WAVEFORM_HDR_BLOCK_NUMBER 0        // uint32_t
+#define WAVEFORM_HDR_TIMESTAMP_MS 4        // uint32_t
+#define WAVEFORM_HDR_SAMPLE_RATE_HZ 8      // uint32_t
+#define WAVEFORM_HDR_SAMPLE_COUNT 12       // uint16_t
+#define WAVEFORM_HDR_BITS_PER_SAMPLE 14    // uint16_t
+#define WAVEFORM_HDR_TRIGGER_SAMPLE 16     // uint16_t
+#define WAVEFORM_HDR_PULSE_FREQ_HZ 18      // uint32_t
+#define WAVEFORM_HDR_PULSE_CYCLES 22       // uint8_t
+#define WAVEFORM_HDR_PULSE_VOLTAGE 23      // uint8_t
+#define WAVEFORM_HDR_SENSOR_ID 24          // uint16_t
+#define WAVEFORM_HDR_TEMPERATURE_CX10 26   // int16_t
+#define WAVEFORM_HDR_GAIN_DB 28            // uint8_t
+#define WAVEFORM_HDR_STATUS_FLAGS 29       // uint8_t
+#define WAVEFORM_HDR_CRC32 30              // uint32_t, CRC32 of the raw 24-bit samples
+#define WAVEFORM_HDR_RESERVED 34           // 2 x uint16_t
+
+// Block codec, carried in the low bits of the chunk header flags and in the
+// codec field of a packed record's block word
+#define CHUNK_FLAGS_CODEC_MASK 0x0F
+#define BLOCK_CODEC_RAW 0x00               // 24-bit samples as captured
+#define BLOCK_CODEC_ZLIB_DELTA 0x01        // zlib of 16-bit deltas (precomputed benchmark waveform)
+#define BLOCK_CODEC_RICE 0x02              // prediction + Rice, encoded on-device
+
+// Chunk header, at the start of every notification
+#define CHUNK_HEADER_SIZE 12
+#define CHUNK_HDR_BLOCK_NUMBER 0           // uint16_t
+#define CHUNK_HDR_CHUNK_NUMBER 2           // uint16_t
+#define CHUNK_HDR_CHUNK_SIZE 4             // uint16_t, payload bytes in this chunk
+#define CHUNK_HDR_TOTAL_CHUNKS 6           // uint16_t
+#define CHUNK_HDR_BLOCK_SIZE_TOTAL 8       // uint16_t, size of the whole block as sent
+#define CHUNK_HDR_FLAGS 10                 // uint8_t, codec in the low bits
+#define CHUNK_HDR_RESERVED 11              // uint8_t
+
+// Packed framing (version 2, requested in the start command). A notification
+// holds one or more records, each a packed record header and its payload, so
+// the last chunk of one block and the first chunk of the next can share a
+// notification. Records carry their byte offset in the block, which lets the
+// first chunk of a block be shorter than the rest. A record flagged MORE is
+// followed by a uint16_t payload length and then another record; the last
+// record's payload runs to the end of the notification.
+#define PACKED_RECORD_HEADER_SIZE 8
+#define PACKED_HDR_BLOCK_WORD 0            // uint16_t: PACKED_RECORD_MARKER | codec << 11 | block number
+#define PACKED_HDR_CHUNK_WORD 2            // uint16_t: PACKED_RECORD_MORE | chunk number
+#define PACKED_HDR_TOTAL_CHUNKS 4          // uint16_t
+#define PACKED_HDR_CHUNK_OFFSET 6          // uint16_t, byte offset of the payload in its block
+#define PACKED_RECORD_LENGTH_SIZE 2        // uint16_t payload length after a MORE header
+
+#define PACKED_RECORD_MARKER 0x8000        // never set in a chunk header: block numbers stay below 2048
+#define PACKED_RECORD_CODEC_SHIFT 11
+#define PACKED_RECORD_CODEC_MASK 0x0F
+#define PACKED_RECORD_BLOCK_MASK 0x07FF
+#define PACKED_RECORD_MORE 0x8000
+#define PACKED_RECORD_CHUNK_MASK 0x7FFF
+
+// Optional flags byte after the start command's timestamp. Firmware that
+// predates it reads 7 bytes and ignores the rest.
+#define START_FLAGS_OFFSET 7
+#define START_FLAG_PACKED_FRAMING 0x01     // send packed records instead of chunk headers
+
+// Selective ACK window
+#define SEND_WINDOW_BLOCKS 4               // blocks the firmware keeps in flight once SACK is in use
+#define SACK_MAX_ENTRIES 2                 // missing-chunk entries per SACK message
+#define SACK_CHUNKS_PER_ENTRY 32           // chunks covered by one entry's bitmap
+
+// Resume after a disconnect
+#define RESUME_BLOCKS_PER_MESSAGE 32       // blocks after the cumulative block in received_blocks
+#define RESUME_MAX_MESSAGES SEND_WINDOW_BLOCKS  // one message per partly received block
+
+// Missing chunks of one block, in SACK and resume messages
+#define SACK_ENTRY_SIZE 8
+#define SACK_ENTRY_BLOCK_NUMBER 0          // uint16_t
+#define SACK_ENTRY_FIRST_CHUNK 2           // uint16_t, chunk number of bit 0
+#define SACK_ENTRY_MISSING_CHUNKS 4        // uint32_t, bit i set = chunk first_chunk + i not received
+
+// Selective ACK control message (fits the control characteristic)
+#define SACK_MSG_SIZE 20
+#define SACK_MSG_COMMAND 0                 // uint8_t
+#define SACK_MSG_CUMULATIVE_BLOCK 1        // uint16_t, every block before this one has been received
+#define SACK_MSG_ENTRY_COUNT 3             // uint8_t, valid entries, oldest block first
+#define SACK_MSG_ENTRIES 4                 // SACK_MAX_ENTRIES entries
+
+// Resume control message: what the receiver already has. A resume takes one
+// message per partly received block; all but the entry are the same in each.
+// Chunks past the entry's bitmap window count as missing.
+#define RESUME_MSG_SIZE 20
+#define RESUME_MSG_COMMAND 0               // uint8_t
+#define RESUME_MSG_CUMULATIVE_BLOCK 1      // uint16_t, every block before this one has been received
+#define RESUME_MSG_RECEIVED_BLOCKS 3       // uint32_t, bit i set = block cumulative_block + 1 + i received
+#define RESUME_MSG_CHUNK_SIZE 7            // uint16_t, payload size of the entry block's chunks (all but the last)
+#define RESUME_MSG_TOTAL_CHUNKS 9          // uint16_t, chunk count of the entry block
+#define RESUME_MSG_ENTRY_COUNT 11          // uint8_t, 1 if the entry describes a partly received block
+#define RESUME_MSG_ENTRY 12                // sack entry, chunks of that block still missing
+
+// Compile-time check of a struct against the layout above, e.g.
+//   PSOC_WIRE_CHECK_FIELD(chunk_header_t, flags, CHUNK_HDR_FLAGS);
+#ifdef __cplusplus
+#include <cstddef>
+#define PSOC_WIRE_CHECK(condition, message) static_assert(condition, message)
+#else
+#include <stddef.h>
+#define PSOC_WIRE_CHECK(condition, message) _Static_assert(condition, message)
+#endif
+
+#define PSOC_WIRE_CHECK_FIELD(type, field, offset) \
+    PSOC_WIRE_CHECK(offsetof(type, field) == (offset), #type "." #field " is not at its wire offset")
+
+#define PSOC_WIRE_CHECK_SIZE(type, size) \
+    PSOC_WIRE_CHECK(sizeof(type) == (size), #type " does not match its wire size")
+
+// Control messages, shared by both sides (layouts above)
+typedef struct __attribute__((packed)) {
+    uint16_t block_number;
+    uint16_t first_chunk;
+    uint32_t missing_chunks;
+} sack_entry_t;
+
+typedef struct __attribute__((packed)) {
+    uint8_t  command;
+    uint16_t cumulative_block;
+    uint8_t  entry_count;
+    sack_entry_t entries[SACK_MAX_ENTRIES];
+} sack_msg_t;
+
+typedef struct __attribute__((packed)) {
+    uint8_t  command;
+    uint16_t cumulative_block;
+    uint32_t received_blocks;
+    uint16_t chunk_size;
+    uint16_t total_chunks;
+    uint8_t  entry_count;
+    sack_entry_t entry;
+} resume_msg_t;
+
+PSOC_WIRE_CHECK_SIZE(sack_entry_t, SACK_ENTRY_SIZE);
+PSOC_WIRE_CHECK_FIELD(sack_entry_t, block_number, SACK_ENTRY_BLOCK_NUMBER);
+PSOC_WIRE_CHECK_FIELD(sack_entry_t, first_chunk, SACK_ENTRY_FIRST_CHUNK);
+PSOC_WIRE_CHECK_FIELD(sack_entry_t, missing_chunks, SACK_ENTRY_MISSING_CHUNKS);
+
+PSOC_WIRE_CHECK_SIZE(sack_msg_t, SACK_MSG_SIZE);
+PSOC_WIRE_CHECK_FIELD(sack_msg_t, command, SACK_MSG_COMMAND);
+PSOC_WIRE_CHECK_FIELD(sack_msg_t, cumulative_block, SACK_MSG_CUMULATIVE_BLOCK);
+PSOC_WIRE_CHECK_FIELD(sack_msg_t, entry_count, SACK_MSG_ENTRY_COUNT);
+PSOC_WIRE_CHECK_FIELD(sack_msg_t, entries, SACK_MSG_ENTRIES);
+
+PSOC_WIRE_CHECK_SIZE(resume_msg_t, RESUME_MSG_SIZE);
+PSOC_WIRE_CHECK_FIELD(resume_msg_t, command, RESUME_MSG_COMMAND);
+PSOC_WIRE_CHECK_FIELD(resume_msg_t, cumulative_block, RESUME_MSG_CUMULATIVE_BLOCK);
+PSOC_WIRE_CHECK_FIELD(resume_msg_t, received_blocks, RESUME_MSG_RECEIVED_BLOCKS);
+PSOC_WIRE_CHECK_FIELD(resume_msg_t, chunk_size, RESUME_MSG_CHUNK_SIZE);
+PSOC_WIRE_CHECK_FIELD(resume_msg_t, total_chunks, RESUME_MSG_TOTAL_CHUNKS);
+PSOC_WIRE_CHECK_FIELD(resume_msg_t, entry_count, RESUME_MSG_ENTRY_COUNT);
+PSOC_WIRE_CHECK_FIELD(resume_msg_t, entry, RESUME_MSG_ENTRY);
+
+#endif // PSOC_WIRE_FORMAT_H
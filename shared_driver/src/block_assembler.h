@@ -0,0 +1,78 @@
+#ifndef PSOC_BLOCK_ASSEMBLER_H
+#define PSOC_BLOCK_ASSEMBLER_H
+
+// Internal: the chunk parsing and reassembly of transfer sessions, for code
+// that sees chunks outside a live session (replay.cpp). Implemented in
+// transfer_session.cpp so both use the same framing and layout checks.
+
+#include <stdint.h>
+#include <stddef.h>
+
+// One chunk as its header describes it, in either framing
+struct chunk_record {
+    uint16_t block_number;
+    uint16_t chunk_number;
+    uint16_t chunk_size;
+    uint16_t total_chunks;
+    uint16_t chunk_offset;        // packed records only
+    uint8_t codec;
+    bool packed;
+};
+
+// Called for each chunk of a notification; return false to stop
+typedef bool (*chunk_visitor_t)(void* context, const chunk_record& record, const uint8_t* payload);
+
+/**
+ * Parse a data notification in either framing and visit its chunks in order
+ * @param data Notification
+ * @param length Notification length
+ * @param visit Called with each chunk and its payload (chunk_size bytes)
+ * @param context Passed to visit
+ * @return true if every chunk parsed and visit accepted it; chunks before a
+ *         malformed packed record have been visited
+ */
+bool visit_notification_chunks(const uint8_t* data, size_t length, chunk_visitor_t visit, void* context);
+
+// Reassembles one block at a time, with no acknowledgements, statistics or decoding
+struct block_assembler;
+
+/**
+ * Create an assembler (one reassembly slot, about 7.5 KB)
+ * @return Assembler, or NULL on allocation failure
+ */
+block_assembler* block_assembler_create(void);
+
+/**
+ * Free an assembler
+ * @param assembler Assembler (may be NULL)
+ */
+void block_assembler_destroy(block_assembler* assembler);
+
+/**
+ * Forget the block being assembled
+ * @param assembler Assembler
+ */
+void block_assembler_reset(block_assembler* assembler);
+
+/**
+ * Add a chunk of the block being assembled
+ * As in a session, a chunk in another codec, framing or layout than those
+ * already added starts the block over; duplicates and malformed chunks are
+ * ignored. Chunks added after the block is complete are ignored too.
+ * @param assembler Assembler
+ * @param record Chunk, all of the same block number since the last reset
+ * @param payload Chunk payload (record.chunk_size bytes)
+ * @return true if the block is complete
+ */
+bool block_assembler_add(block_assembler* assembler, const chunk_record& record, const uint8_t* payload);
+
+/**
+ * Get the completed block
+ * @param assembler Assembler
+ * @param size Receives the block size
+ * @param codec Receives the BLOCK_CODEC_* of the block
+ * @return Block (waveform header, then payload), or NULL if it is not complete
+ */
+const uint8_t* block_assembler_block(const block_assembler* assembler, size_t* size, uint8_t* codec);
+
+#endif // PSOC_BLOCK_ASSEMBLER_H
@@ -0,0 +1,504 @@
+#include "psoc_driver/capture_archive.h"
+#include "psoc_driver/compression.h"
+#include "psoc_driver/crc32.h"
+#include "psoc_driver/protocol.h"
+#include "psoc_driver/transfer_session.h"
+#include "mapped_file.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+
+// The writer thread wakes for a batch this large, or this often while blocks are pending
+static const size_t CAPTURE_BATCH_BYTES = 256 * 1024;
+static const unsigned CAPTURE_BATCH_INTERVAL_MS = 100;
+
+static const uint8_t record_padding[8] = { 0 };
+
+namespace {
+
+// Where an archived block lives; one CAPTURE_INDEX_ENTRY_SIZE entry on disk
+struct index_entry {
+    uint16_t block_number;
+    uint8_t codec;
+    uint32_t size;
+    uint64_t offset;          // of the block data, just past its record header
+    uint32_t timestamp_ms;
+    uint32_t crc;             // CRC32 of the block data
+};
+
+}
+
+struct capture_writer {
+    FILE* file;
+    std::thread thread;
+
+    mutable std::mutex lock;
+    std::condition_variable wake;      // the writer thread: a batch is ready, a flush or close is requested
+    std::condition_variable written;   // capture_writer_flush(): a batch reached the file
+    std::vector<uint8_t> pending;      // records appended since the last batch was taken
+    std::vector<index_entry> entries;  // every record in append order; CRCs are filled in by the thread
+    uint64_t end_offset;               // file offset just past the last appended record
+    uint64_t written_offset;           // file offset up to which records are on disk
+    bool flush_requested;
+    bool closing;
+    bool failed;
+};
+
+struct capture_archive {
+    mapped_file file;
+    const uint8_t* map;               // file.data
+    size_t size;                      // file.size
+    bool complete;
+    std::vector<index_entry> entries;  // one per block number, in block order
+};
+
+static void put_u16(uint8_t* p, uint16_t value) {
+    p[0] = (uint8_t)value;
+    p[1] = (uint8_t)(value >> 8);
+}
+
+static void put_u32(uint8_t* p, uint32_t value) {
+    put_u16(p, (uint16_t)value);
+    put_u16(p + 2, (uint16_t)(value >> 16));
+}
+
+static void put_u64(uint8_t* p, uint64_t value) {
+    put_u32(p, (uint32_t)value);
+    put_u32(p + 4, (uint32_t)(value >> 32));
+}
+
+static uint16_t get_u16(const uint8_t* p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t get_u32(const uint8_t* p) {
+    return get_u16(p) | ((uint32_t)get_u16(p + 2) << 16);
+}
+
+static uint64_t get_u64(const uint8_t* p) {
+    return get_u32(p) | ((uint64_t)get_u32(p + 4) << 32);
+}
+
+static size_t record_padding_size(size_t block_size) {
+    return (8 - (CAPTURE_RECORD_HEADER_SIZE + block_size) % 8) % 8;
+}
+
+// Sort by block number; of several copies of a block the last appended wins
+static void sort_entries(std::vector<index_entry>* entries) {
+    std::stable_sort(entries->begin(), entries->end(), [](const index_entry& a, const index_entry& b) {
+        return a.block_number < b.block_number;
+    });
+
+    size_t kept = 0;
+    for (size_t i = 0; i < entries->size(); i++) {
+        if (i + 1 < entries->size() && (*entries)[i + 1].block_number == (*entries)[i].block_number) {
+            continue;
+        }
+        (*entries)[kept++] = (*entries)[i];
+    }
+    entries->resize(kept);
+}
+
+/* ---- Writer ---- */
+
+// Stamp the CRC into each record header of a batch and remember it for the index
+static void seal_batch(capture_writer_t* writer, std::vector<uint8_t>* batch, size_t first_entry,
+                       std::vector<uint32_t>* crcs) {
+    crcs->clear();
+    for (size_t offset = 0; offset < batch->size();) {
+        uint8_t* record = batch->data() + offset;
+        uint32_t size = get_u32(record + 8);
+        uint32_t crc = calculate_crc32_data(record + CAPTURE_RECORD_HEADER_SIZE, size);
+        put_u32(record + 12, crc);
+        crcs->push_back(crc);
+        offset += CAPTURE_RECORD_HEADER_SIZE + size + record_padding_size(size);
+    }
+
+    std::lock_guard<std::mutex> guard(writer->lock);
+    for (size_t i = 0; i < crcs->size(); i++) {
+        writer->entries[first_entry + i].crc = (*crcs)[i];
+    }
+}
+
+static void writer_thread(capture_writer_t* writer) {
+    std::vector<uint8_t> batch;
+    std::vector<uint32_t> crcs;
+    size_t written_entries = 0;
+    batch.reserve(CAPTURE_BATCH_BYTES * 2);
+    std::unique_lock<std::mutex> guard(writer->lock);
+
+    for (;;) {
+        writer->wake.wait_for(guard, std::chrono::milliseconds(CAPTURE_BATCH_INTERVAL_MS), [writer] {
+            return writer->pending.size() >= CAPTURE_BATCH_BYTES || writer->flush_requested || writer->closing;
+        });
+        if (writer->pending.empty()) {
+            writer->flush_requested = false;
+            writer->written.notify_all();
+            if (writer->closing) {
+                return;
+            }
+            continue;
+        }
+
+        // Take the batch; appends go on into the other (already reserved) buffer
+        batch.swap(writer->pending);
+        writer->pending.clear();
+        size_t first_entry = written_entries;
+        written_entries = writer->entries.size();
+        uint64_t batch_end = writer->end_offset;
+        writer->flush_requested = false;
+        guard.unlock();
+
+        seal_batch(writer, &batch, first_entry, &crcs);
+        bool ok = fwrite(batch.data(), 1, batch.size(), writer->file) == batch.size() &&
+                  fflush(writer->file) == 0;
+
+        guard.lock();
+        if (!ok) {
+            writer->failed = true;
+        }
+        writer->written_offset = batch_end;
+        writer->written.notify_all();
+    }
+}
+
+capture_writer_t* capture_writer_open(const char* path) {
+    FILE* file = fopen(path, "wb");
+    if (!file) {
+        return nullptr;
+    }
+
+    uint8_t header[CAPTURE_FILE_HEADER_SIZE] = { 0 };
+    memcpy(header, CAPTURE_FILE_MAGIC, 8);
+    put_u16(header + 8, CAPTURE_ARCHIVE_VERSION);
+    put_u16(header + 10, WAVEFORM_HEADER_SIZE);
+    put_u16(header + 12, SAMPLES_PER_WAVEFORM);
+    uint64_t created_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    put_u64(header + 16, created_ms);
+    if (fwrite(header, 1, sizeof(header), file) != sizeof(header)) {
+        fclose(file);
+        return nullptr;
+    }
+
+    capture_writer_t* writer = new (std::nothrow) capture_writer_t();
+    if (!writer) {
+        fclose(file);
+        return nullptr;
+    }
+    writer->file = file;
+    writer->pending.reserve(CAPTURE_BATCH_BYTES * 2);
+    writer->entries.reserve(TOTAL_BLOCKS);
+    writer->end_offset = CAPTURE_FILE_HEADER_SIZE;
+    writer->written_offset = CAPTURE_FILE_HEADER_SIZE;
+    writer->flush_requested = false;
+    writer->closing = false;
+    writer->failed = false;
+    try {
+        writer->thread = std::thread(writer_thread, writer);
+    } catch (const std::system_error&) {
+        fclose(file);
+        delete writer;
+        return nullptr;
+    }
+    return writer;
+}
+
+bool capture_writer_append(capture_writer_t* writer, const uint8_t* block, size_t size, uint8_t codec) {
+    if (size < WAVEFORM_HEADER_SIZE || size > BLOCK_SIZE) {
+        return false;
+    }
+
+    uint8_t record[CAPTURE_RECORD_HEADER_SIZE];
+    put_u32(record, CAPTURE_RECORD_MAGIC);
+    put_u16(record + 4, (uint16_t)get_u32(block));
+    record[6] = codec;
+    record[7] = 0;
+    put_u32(record + 8, (uint32_t)size);
+    put_u32(record + 12, 0);  // CRC, stamped by the writer thread
+    size_t padding = record_padding_size(size);
+
+    index_entry entry;
+    entry.block_number = get_u16(record + 4);
+    entry.codec = codec;
+    entry.size = (uint32_t)size;
+    entry.timestamp_ms = get_u32(block + 4);
+    entry.crc = 0;
+
+    std::lock_guard<std::mutex> guard(writer->lock);
+    if (writer->failed) {
+        return false;
+    }
+    entry.offset = writer->end_offset + CAPTURE_RECORD_HEADER_SIZE;
+    writer->pending.insert(writer->pending.end(), record, record + sizeof(record));
+    writer->pending.insert(writer->pending.end(), block, block + size);
+    writer->pending.insert(writer->pending.end(), record_padding, record_padding + padding);
+    writer->entries.push_back(entry);
+    writer->end_offset += CAPTURE_RECORD_HEADER_SIZE + size + padding;
+
+    if (writer->pending.size() >= CAPTURE_BATCH_BYTES) {
+        writer->wake.notify_one();
+    }
+    return true;
+}
+
+bool capture_writer_flush(capture_writer_t* writer) {
+    std::unique_lock<std::mutex> guard(writer->lock);
+    uint64_t target = writer->end_offset;
+    writer->flush_requested = true;
+    writer->wake.notify_one();
+    writer->written.wait(guard, [writer, target] {
+        return writer->written_offset >= target || writer->failed;
+    });
+    return !writer->failed;
+}
+
+uint32_t capture_writer_block_count(const capture_writer_t* writer) {
+    std::lock_guard<std::mutex> guard(writer->lock);
+    return (uint32_t)writer->entries.size();
+}
+
+bool capture_writer_close(capture_writer_t* writer) {
+    if (!writer) {
+        return true;
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(writer->lock);
+        writer->closing = true;
+        writer->wake.notify_one();
+    }
+    writer->thread.join();
+
+    // Index and CRC footer, then the trailer that marks the archive complete
+    std::vector<index_entry> entries = writer->entries;
+    sort_entries(&entries);
+
+    std::vector<uint8_t> tail(entries.size() * (CAPTURE_INDEX_ENTRY_SIZE + 4) + CAPTURE_TRAILER_SIZE, 0);
+    uint8_t* p = tail.data();
+    for (size_t i = 0; i < entries.size(); i++, p += CAPTURE_INDEX_ENTRY_SIZE) {
+        put_u16(p, entries[i].block_number);
+        p[2] = entries[i].codec;
+        put_u32(p + 4, entries[i].size);
+        put_u64(p + 8, entries[i].offset);
+        put_u32(p + 16, entries[i].timestamp_ms);
+    }
+    for (size_t i = 0; i < entries.size(); i++, p += 4) {
+        put_u32(p, entries[i].crc);
+    }
+    put_u64(p, writer->end_offset);
+    put_u32(p + 8, (uint32_t)entries.size());
+    put_u32(p + 12, calculate_crc32_data(tail.data(), (size_t)(p - tail.data())));
+    memcpy(p + 24, CAPTURE_TRAILER_MAGIC, 8);
+
+    bool ok = !writer->failed && fwrite(tail.data(), 1, tail.size(), writer->file) == tail.size();
+    ok = (fclose(writer->file) == 0) && ok;
+    delete writer;
+    return ok;
+}
+
+/* ---- Reader ---- */
+
+// Index and CRC footer written by capture_writer_close(), if the trailer is intact
+static bool read_index(capture_archive_t* archive) {
+    if (archive->size < CAPTURE_FILE_HEADER_SIZE + CAPTURE_TRAILER_SIZE) {
+        return false;
+    }
+    const uint8_t* trailer = archive->map + archive->size - CAPTURE_TRAILER_SIZE;
+    if (memcmp(trailer + 24, CAPTURE_TRAILER_MAGIC, 8) != 0) {
+        return false;
+    }
+
+    uint64_t index_offset = get_u64(trailer);
+    uint64_t count = get_u32(trailer + 8);
+    uint64_t index_bytes = count * (CAPTURE_INDEX_ENTRY_SIZE + 4);
+    if (index_offset < CAPTURE_FILE_HEADER_SIZE || index_offset > archive->size - CAPTURE_TRAILER_SIZE ||
+        index_bytes != archive->size - CAPTURE_TRAILER_SIZE - index_offset) {
+        return false;
+    }
+    const uint8_t* index = archive->map + index_offset;
+    if (calculate_crc32_data(index, (size_t)index_bytes) != get_u32(trailer + 12)) {
+        return false;
+    }
+
+    const uint8_t* crcs = index + count * CAPTURE_INDEX_ENTRY_SIZE;
+    archive->entries.resize((size_t)count);
+    for (size_t i = 0; i < count; i++) {
+        const uint8_t* p = index + i * CAPTURE_INDEX_ENTRY_SIZE;
+        index_entry& entry = archive->entries[i];
+        entry.block_number = get_u16(p);
+        entry.codec = p[2];
+        entry.size = get_u32(p + 4);
+        entry.offset = get_u64(p + 8);
+        entry.timestamp_ms = get_u32(p + 16);
+        entry.crc = get_u32(crcs + i * 4);
+        if (entry.size < WAVEFORM_HEADER_SIZE || entry.offset < CAPTURE_FILE_HEADER_SIZE ||
+            entry.offset > index_offset || entry.size > index_offset - entry.offset) {
+            archive->entries.clear();
+            return false;
+        }
+    }
+    return true;
+}
+
+// Rebuild the index of an archive that was never closed from its record headers.
+// Stops at the first record that is not whole (a write cut short).
+static void scan_records(capture_archive_t* archive) {
+    archive->entries.clear();
+    size_t offset = CAPTURE_FILE_HEADER_SIZE;
+    while (archive->size - offset >= CAPTURE_RECORD_HEADER_SIZE) {
+        const uint8_t* record = archive->map + offset;
+        uint32_t size = get_u32(record + 8);
+        if (get_u32(record) != CAPTURE_RECORD_MAGIC || size < WAVEFORM_HEADER_SIZE || size > BLOCK_SIZE ||
+            archive->size - offset - CAPTURE_RECORD_HEADER_SIZE < size) {
+            break;
+        }
+
+        index_entry entry;
+        entry.block_number = get_u16(record + 4);
+        entry.codec = record[6];
+        entry.size = size;
+        entry.offset = offset + CAPTURE_RECORD_HEADER_SIZE;
+        entry.timestamp_ms = get_u32(record + CAPTURE_RECORD_HEADER_SIZE + 4);
+        entry.crc = get_u32(record + 12);
+        archive->entries.push_back(entry);
+
+        offset += CAPTURE_RECORD_HEADER_SIZE + size + record_padding_size(size);
+        if (offset > archive->size) {
+            break;
+        }
+    }
+    sort_entries(&archive->entries);
+}
+
+capture_archive_t* capture_archive_open(const char* path) {
+    capture_archive_t* archive = new (std::nothrow) capture_archive_t();
+    if (!archive) {
+        return nullptr;
+    }
+    if (!mapped_file_open(&archive->file, path)) {
+        delete archive;
+        return nullptr;
+    }
+    archive->map = archive->file.data;
+    archive->size = archive->file.size;
+    if (archive->size < CAPTURE_FILE_HEADER_SIZE || memcmp(archive->map, CAPTURE_FILE_MAGIC, 8) != 0 || get_u16(archive->map + 8) != CAPTURE_ARCHIVE_VERSION ||
+        get_u16(archive->map + 10) != WAVEFORM_HEADER_SIZE) {
+        capture_archive_close(archive);
+        return nullptr;
+    }
+
+    archive->complete = read_index(archive);
+    if (!archive->complete) {
+        scan_records(archive);
+    }
+    return archive;
+}
+
+void capture_archive_close(capture_archive_t* archive) {
+    if (archive) {
+        mapped_file_close(&archive->file);
+        delete archive;
+    }
+}
+
+bool capture_archive_is_complete(const capture_archive_t* archive) {
+    return archive->complete;
+}
+
+uint32_t capture_archive_block_count(const capture_archive_t* archive) {
+    return (uint32_t)archive->entries.size();
+}
+
+bool capture_archive_get_block_at(const capture_archive_t* archive, uint32_t index, capture_block_view_t* view) {
+    if (index >= archive->entries.size()) {
+        return false;
+    }
+    const index_entry& entry = archive->entries[index];
+    view->block_number = entry.block_number;
+    view->codec = entry.codec;
+    view->timestamp_ms = entry.timestamp_ms;
+    view->data = archive->map + entry.offset;
+    view->size = entry.size;
+    view->payload = view->data + WAVEFORM_HEADER_SIZE;
+    view->payload_size = entry.size - WAVEFORM_HEADER_SIZE;
+    return true;
+}
+
+bool capture_archive_get_block(const capture_archive_t* archive, uint16_t block_number, capture_block_view_t* view) {
+    std::vector<index_entry>::const_iterator it = std::lower_bound(
+        archive->entries.begin(), archive->entries.end(), block_number,
+        [](const index_entry& entry, uint16_t number) { return entry.block_number < number; });
+    if (it == archive->entries.end() || it->block_number != block_number) {
+        return false;
+    }
+    return capture_archive_get_block_at(archive, (uint32_t)(it - archive->entries.begin()), view);
+}
+
+size_t capture_archive_find_time_range(const capture_archive_t* archive, uint32_t start_ms, uint32_t end_ms,
+                                       uint32_t* indices, size_t capacity) {
+    // Blocks are indexed by number; timestamps need not follow it, so scan them all
+    size_t found = 0;
+    for (size_t i = 0; i < archive->entries.size(); i++) {
+        uint32_t timestamp = archive->entries[i].timestamp_ms;
+        if (timestamp < start_ms || timestamp > end_ms) {
+            continue;
+        }
+        if (indices && found < capacity) {
+            indices[found] = (uint32_t)i;
+        }
+        found++;
+    }
+    return found;
+}
+
+uint32_t capture_archive_verify(const capture_archive_t* archive) {
+    uint32_t bad = 0;
+    for (size_t i = 0; i < archive->entries.size(); i++) {
+        const index_entry& entry = archive->entries[i];
+        if (calculate_crc32_data(archive->map + entry.offset, entry.size) != entry.crc) {
+            bad++;
+        }
+    }
+    return bad;
+}
+
+bool capture_archive_decode(const capture_block_view_t* view, waveform_data_t* waveform) {
+    if (view->size < WAVEFORM_HEADER_SIZE) {
+        return false;
+    }
+    parse_waveform_header(view->data, &waveform->header);
+
+    uint32_t crc;
+    switch (view->codec) {
+        case BLOCK_CODEC_RAW:
+            if (view->payload_size < SAMPLES_PER_WAVEFORM * 3) {
+                return false;
+            }
+            crc = calculate_crc32_unpack_24bit(view->payload, SAMPLES_PER_WAVEFORM, waveform->samples);
+            break;
+        case BLOCK_CODEC_ZLIB_DELTA:
+            if (!decompress_waveform_zlib_delta(view->payload, view->payload_size, waveform->samples)) {
+                return false;
+            }
+            crc = calculate_crc32_samples(waveform->samples, SAMPLES_PER_WAVEFORM);
+            break;
+        case BLOCK_CODEC_RICE:
+            if (!decompress_waveform_rice(view->payload, view->payload_size, waveform->samples)) {
+                return false;
+            }
+            crc = calculate_crc32_samples(waveform->samples, SAMPLES_PER_WAVEFORM);
+            break;
+        default:
+            return false;
+    }
+    return crc == waveform->header.crc32;
+}
@@ -1,36 +1,222 @@
 #include "psoc_driver/compression.h"
+#include "psoc_driver/protocol.h"
 #include <zlib.h>
 #include <cstring>
 
-bool decompress_waveform(const uint8_t* compressed_data, size_t compressed_size, int32_t* samples) {
-    // Expected size: 2376 samples * 2 bytes (int16 delta-encoded) = 4752 bytes
-    const size_t expected_decompressed_size = 2376 * 2;
-    uint8_t decompressed_buffer[expected_decompressed_size];
-
-    // Decompress using zlib
-    uLongf decompressed_size = expected_decompressed_size;
-    int result = uncompress(
-        decompressed_buffer,
-        &decompressed_size,
-        compressed_data,
-        compressed_size
-    );
-
-    if (result != Z_OK || decompressed_size != expected_decompressed_size) {
+// MSB-first bit reader; reads past the end return zeros and set overrun
+struct bit_reader {
+    const uint8_t* data;
+    size_t size;
+    size_t position;
+    uint64_t accumulator;
+    unsigned bit_count;
+    bool overrun;
+};
+
+static inline uint32_t get_bits(bit_reader* reader, unsigned count) {
+    while (reader->bit_count < count) {
+        uint64_t byte = 0;
+        if (reader->position < reader->size) {
+            byte = reader->data[reader->position];
+        } else {
+            reader->overrun = true;
+        }
+        reader->position++;
+        reader->accumulator = (reader->accumulator << 8) | byte;
+        reader->bit_count += 8;
+    }
+    reader->bit_count -= count;
+    return (uint32_t)(reader->accumulator >> reader->bit_count) & ((1u << count) - 1);
+}
+
+// Count leading one-bits (up to limit) and consume the terminating zero
+static inline uint32_t get_unary(bit_reader* reader, uint32_t limit) {
+    uint32_t quotient = 0;
+    while (quotient < limit && get_bits(reader, 1)) {
+        quotient++;
+    }
+    return quotient;
+}
+
+bool decompress_waveform_rice(const uint8_t* data, size_t size, int32_t* samples) {
+    if (size < 3 || data[0] != CODEC_RICE_TAG || (size_t)(data[1] | (data[2] << 8)) != SAMPLES_PER_WAVEFORM) {
         return false;
     }
 
-    // Delta decode: convert 16-bit deltas back to full 24-bit samples
-    int32_t prev_sample = 0;
-    for (size_t i = 0; i < 2376; i++) {
-        // Read 16-bit delta (little-endian)
-        int16_t delta;
-        memcpy(&delta, &decompressed_buffer[i * 2], sizeof(int16_t));
+    bit_reader reader = { data, size, 3, 0, 0, false };
+    uint32_t prev1 = 0;
+    uint32_t prev2 = 0;
+
+    for (size_t start = 0; start < SAMPLES_PER_WAVEFORM; start += CODEC_RICE_PARTITION) {
+        size_t count = SAMPLES_PER_WAVEFORM - start;
+        if (count > CODEC_RICE_PARTITION) {
+            count = CODEC_RICE_PARTITION;
+        }
+
+        uint32_t order = get_bits(&reader, 2);
+        uint32_t k = get_bits(&reader, 5);
+        if (order > 2 || k > CODEC_RICE_MAX_K) {
+            return false;
+        }
+
+        for (size_t i = 0; i < count; i++) {
+            uint32_t mapped;
+            uint32_t quotient = get_unary(&reader, CODEC_RICE_ESCAPE);
+            if (quotient == CODEC_RICE_ESCAPE) {
+                mapped = get_bits(&reader, CODEC_RICE_ESCAPE_BITS);
+            } else {
+                mapped = (quotient << k) | (k ? get_bits(&reader, k) : 0);
+            }
+
+            // Unsigned arithmetic wrapped to 24 bits: a corrupt stream cannot overflow
+            uint32_t prediction = order == 0 ? 0 : order == 1 ? prev1 : 2 * prev1 - prev2;
+            uint32_t residual = (mapped >> 1) ^ (0u - (mapped & 1));
+            uint32_t sample = (prediction + residual) & 0xFFFFFF;
+            samples[start + i] = (int32_t)(sample ^ 0x800000) - 0x800000;
+
+            prev2 = prev1;
+            prev1 = (uint32_t)samples[start + i];
+        }
+    }
+
+    return !reader.overrun;
+}
+
+// Inflate output is handed to the delta decoder in pieces this size, small
+// enough to still be in L1 when the decoder reads it back
+static const size_t INFLATE_PIECE_SIZE = 512;
+
+struct delta_inflater {
+    z_stream stream;
+    int status;                   // Z_OK while decoding, Z_STREAM_END when done, else the zlib error
+    size_t sample_count;
+    int32_t prev_sample;
+    bool has_odd_byte;            // low byte of a delta split across two pieces
+    uint8_t odd_byte;
+    uint8_t piece[INFLATE_PIECE_SIZE];
+    int32_t samples[SAMPLES_PER_WAVEFORM];
+};
+
+// Delta decode: convert 16-bit little-endian deltas back to full 24-bit samples
+static bool delta_decode_piece(delta_inflater* inflater, const uint8_t* bytes, size_t count) {
+    size_t i = 0;
+    size_t pairs = (count + (inflater->has_odd_byte ? 1 : 0)) / 2;
+    if (inflater->sample_count + pairs > SAMPLES_PER_WAVEFORM) {
+        return false;  // More output than one waveform
+    }
+
+    int32_t prev_sample = inflater->prev_sample;
+    int32_t* out = inflater->samples + inflater->sample_count;
+    if (inflater->has_odd_byte && count > 0) {
+        prev_sample += (int16_t)(inflater->odd_byte | (bytes[0] << 8));
+        *out++ = prev_sample;
+        inflater->has_odd_byte = false;
+        i = 1;
+    }
+    for (; i + 1 < count; i += 2) {
+        prev_sample += (int16_t)(bytes[i] | (bytes[i + 1] << 8));
+        *out++ = prev_sample;
+    }
+    if (i < count) {
+        inflater->odd_byte = bytes[i];
+        inflater->has_odd_byte = true;
+    }
+
+    inflater->prev_sample = prev_sample;
+    inflater->sample_count += pairs;
+    return true;
+}
+
+delta_inflater_t* delta_inflater_create(void) {
+    delta_inflater_t* inflater = new delta_inflater_t();
+    memset(&inflater->stream, 0, sizeof(inflater->stream));
+    if (inflateInit(&inflater->stream) != Z_OK) {
+        delete inflater;
+        return nullptr;
+    }
+    delta_inflater_reset(inflater);
+    return inflater;
+}
+
+void delta_inflater_destroy(delta_inflater_t* inflater) {
+    if (inflater) {
+        inflateEnd(&inflater->stream);
+        delete inflater;
+    }
+}
 
-        // Reconstruct sample
-        prev_sample += (int32_t)delta;
-        samples[i] = prev_sample;
+void delta_inflater_reset(delta_inflater_t* inflater) {
+    inflateReset(&inflater->stream);
+    inflater->status = Z_OK;
+    inflater->sample_count = 0;
+    inflater->prev_sample = 0;
+    inflater->has_odd_byte = false;
+}
+
+bool delta_inflater_feed(delta_inflater_t* inflater, const uint8_t* data, size_t length) {
+    if (inflater->status != Z_OK) {
+        return inflater->status == Z_STREAM_END;  // Bytes after the end of the stream are ignored
     }
 
+    z_stream* stream = &inflater->stream;
+    stream->next_in = const_cast<Bytef*>(data);
+    stream->avail_in = (uInt)length;
+
+    // Keep going while there is input left or the last piece came out full
+    do {
+        stream->next_out = inflater->piece;
+        stream->avail_out = (uInt)INFLATE_PIECE_SIZE;
+        int result = inflate(stream, Z_NO_FLUSH);
+
+        size_t produced = INFLATE_PIECE_SIZE - stream->avail_out;
+        if (!delta_decode_piece(inflater, inflater->piece, produced)) {
+            inflater->status = Z_DATA_ERROR;
+            break;
+        }
+        if (result != Z_OK) {
+            if (result != Z_BUF_ERROR) {
+                inflater->status = result;  // Z_STREAM_END or a real error
+            }
+            break;
+        }
+    } while (stream->avail_in > 0 || stream->avail_out == 0);
+
+    stream->next_in = nullptr;
+    stream->avail_in = 0;
+    return inflater->status == Z_OK || inflater->status == Z_STREAM_END;
+}
+
+bool delta_inflater_finish(delta_inflater_t* inflater, int32_t* samples) {
+    if (inflater->status != Z_STREAM_END || inflater->sample_count != SAMPLES_PER_WAVEFORM ||
+        inflater->has_odd_byte) {
+        return false;
+    }
+    memcpy(samples, inflater->samples, sizeof(inflater->samples));
     return true;
 }
+
+// One decoder per thread so the one-shot API does not pay for inflateInit on every block
+struct thread_inflater {
+    delta_inflater_t* inflater;
+    thread_inflater() : inflater(delta_inflater_create()) {}
+    ~thread_inflater() { delta_inflater_destroy(inflater); }
+};
+
+bool decompress_waveform_zlib_delta(const uint8_t* compressed_data, size_t compressed_size, int32_t* samples) {
+    static thread_local thread_inflater context;
+    delta_inflater_t* inflater = context.inflater;
+    if (!inflater) {
+        return false;
+    }
+
+    delta_inflater_reset(inflater);
+    delta_inflater_feed(inflater, compressed_data, compressed_size);
+    return delta_inflater_finish(inflater, samples);
+}
+
+bool decompress_waveform(const uint8_t* compressed_data, size_t compressed_size, int32_t* samples) {
+    if (compressed_size > 0 && compressed_data[0] == CODEC_RICE_TAG) {
+        return decompress_waveform_rice(compressed_data, compressed_size, samples);
+    }
+    return decompress_waveform_zlib_delta(compressed_data, compressed_size, samples);
+}
@@ -1,45 +1,364 @@
 #include "psoc_driver/crc32.h"
+#include "psoc_driver/crc32_table.h"
+#include "psoc_driver/sample_unpack.h"
+#include <atomic>
+#include <cstring>
 
-uint32_t calculate_crc32_samples(const int32_t* samples, size_t count) {
-    uint32_t crc = 0xFFFFFFFF;
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define PSOC_CRC32_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define PSOC_TARGET_PCLMUL
+#else
+#define PSOC_TARGET_PCLMUL __attribute__((target("pclmul,sse4.1")))
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define PSOC_CRC32_ARM64 1
+#include <arm_acle.h>
+#if defined(__linux__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+#if defined(__clang__)
+#define PSOC_TARGET_CRC __attribute__((target("crc")))
+#elif defined(__GNUC__)
+#define PSOC_TARGET_CRC __attribute__((target("+crc")))
+#else
+#define PSOC_TARGET_CRC
+#endif
+#endif
+
+// All update functions work on the raw (pre/post-inverted) CRC register
+typedef uint32_t (*crc32_update_fn)(uint32_t crc, const uint8_t* data, size_t length);
+
+// Samples packed per step when hashing int32_t samples or unpacking (768 bytes stays in L1)
+static const size_t SAMPLES_PER_PIECE = 256;
+
+namespace {
+
+// Slice-by-8 tables; table[0] is the shared byte table
+struct slice8_tables {
+    uint32_t table[8][256];
 
-    // Calculate CRC on packed 24-bit format
-    for (size_t i = 0; i < count; i++) {
-        int32_t sample = samples[i];
-        uint8_t bytes[3] = {
-            (uint8_t)(sample & 0xFF),
-            (uint8_t)((sample >> 8) & 0xFF),
-            (uint8_t)((sample >> 16) & 0xFF)
-        };
-
-        for (int j = 0; j < 3; j++) {
-            crc ^= bytes[j];
-            for (int k = 0; k < 8; k++) {
-                if (crc & 1) {
-                    crc = (crc >> 1) ^ 0xEDB88320;
-                } else {
-                    crc >>= 1;
-                }
+    slice8_tables() {
+        memcpy(table[0], crc32_lookup_table, sizeof(table[0]));
+        for (int i = 0; i < 256; i++) {
+            uint32_t crc = table[0][i];
+            for (int k = 1; k < 8; k++) {
+                crc = (crc >> 8) ^ table[0][crc & 0xFF];
+                table[k][i] = crc;
             }
         }
     }
+};
 
-    return ~crc;
-}
+const slice8_tables slice8;
 
-uint32_t calculate_crc32_data(const uint8_t* data, size_t length) {
-    uint32_t crc = 0xFFFFFFFF;
+} // namespace
 
+static uint32_t crc32_update_bitwise(uint32_t crc, const uint8_t* data, size_t length) {
     for (size_t i = 0; i < length; i++) {
         crc ^= data[i];
         for (int k = 0; k < 8; k++) {
             if (crc & 1) {
-                crc = (crc >> 1) ^ 0xEDB88320;
+                crc = (crc >> 1) ^ CRC32_POLYNOMIAL_REFLECTED;
             } else {
                 crc >>= 1;
             }
         }
     }
+    return crc;
+}
+
+static uint32_t crc32_update_table(uint32_t crc, const uint8_t* data, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        crc = (crc >> 8) ^ crc32_lookup_table[(crc ^ data[i]) & 0xFF];
+    }
+    return crc;
+}
+
+// Assumes a little-endian host (x86, ARM)
+static uint32_t crc32_update_slice8(uint32_t crc, const uint8_t* data, size_t length) {
+    const uint32_t (*t)[256] = slice8.table;
+
+    while (length >= 8) {
+        uint32_t lo, hi;
+        memcpy(&lo, data, 4);
+        memcpy(&hi, data + 4, 4);
+        lo ^= crc;
+        crc = t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF] ^ t[5][(lo >> 16) & 0xFF] ^ t[4][lo >> 24] ^
+              t[3][hi & 0xFF] ^ t[2][(hi >> 8) & 0xFF] ^ t[1][(hi >> 16) & 0xFF] ^ t[0][hi >> 24];
+        data += 8;
+        length -= 8;
+    }
+
+    return crc32_update_table(crc, data, length);
+}
+
+#if defined(PSOC_CRC32_X86)
+
+// Carry-less multiply folding, after Intel's "Fast CRC Computation for Generic
+// Polynomials Using PCLMULQDQ". Requires length >= 64 and a multiple of 16.
+PSOC_TARGET_PCLMUL
+static uint32_t crc32_fold_pclmul(uint32_t crc, const uint8_t* data, size_t length) {
+    alignas(16) static const uint64_t k1k2[] = { 0x0154442bd4ULL, 0x01c6e41596ULL };
+    alignas(16) static const uint64_t k3k4[] = { 0x01751997d0ULL, 0x00ccaa009eULL };
+    alignas(16) static const uint64_t k5k0[] = { 0x0163cd6124ULL, 0x0000000000ULL };
+    alignas(16) static const uint64_t poly[] = { 0x01db710641ULL, 0x01f7011641ULL };
+
+    __m128i x0, x1, x2, x3, x4, x5, x6, x7, x8;
+
+    x1 = _mm_loadu_si128((const __m128i*)(data + 0x00));
+    x2 = _mm_loadu_si128((const __m128i*)(data + 0x10));
+    x3 = _mm_loadu_si128((const __m128i*)(data + 0x20));
+    x4 = _mm_loadu_si128((const __m128i*)(data + 0x30));
+    x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128((int)crc));
+    x0 = _mm_load_si128((const __m128i*)k1k2);
+    data += 64;
+    length -= 64;
+
+    // Fold four 128-bit lanes in parallel
+    while (length >= 64) {
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+        x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+        x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+        x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+        x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), _mm_loadu_si128((const __m128i*)(data + 0x00)));
+        x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), _mm_loadu_si128((const __m128i*)(data + 0x10)));
+        x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), _mm_loadu_si128((const __m128i*)(data + 0x20)));
+        x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), _mm_loadu_si128((const __m128i*)(data + 0x30)));
+        data += 64;
+        length -= 64;
+    }
+
+    // Fold the four lanes into one
+    x0 = _mm_load_si128((const __m128i*)k3k4);
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+    // Remaining 16-byte blocks
+    while (length >= 16) {
+        x2 = _mm_loadu_si128((const __m128i*)data);
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+        data += 16;
+        length -= 16;
+    }
+
+    // Fold 128 bits to 64 bits
+    x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+    x3 = _mm_setr_epi32(~0, 0, ~0, 0);
+    x1 = _mm_srli_si128(x1, 8);
+    x1 = _mm_xor_si128(x1, x2);
+    x0 = _mm_loadl_epi64((const __m128i*)k5k0);
+    x2 = _mm_srli_si128(x1, 4);
+    x1 = _mm_and_si128(x1, x3);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    // Barrett reduction to 32 bits
+    x0 = _mm_load_si128((const __m128i*)poly);
+    x2 = _mm_and_si128(x1, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x10);
+    x2 = _mm_and_si128(x2, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    return (uint32_t)_mm_extract_epi32(x1, 1);
+}
+
+static uint32_t crc32_update_hardware(uint32_t crc, const uint8_t* data, size_t length) {
+    if (length >= 64) {
+        size_t folded = length & ~(size_t)15;
+        crc = crc32_fold_pclmul(crc, data, folded);
+        data += folded;
+        length -= folded;
+    }
+    return crc32_update_slice8(crc, data, length);
+}
+
+static bool hardware_crc_available(void) {
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 1);
+    return (info[2] & (1 << 1)) && (info[2] & (1 << 19));  // PCLMULQDQ, SSE4.1
+#else
+    return __builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1");
+#endif
+}
+
+#elif defined(PSOC_CRC32_ARM64)
+
+PSOC_TARGET_CRC
+static uint32_t crc32_update_hardware(uint32_t crc, const uint8_t* data, size_t length) {
+    while (length >= 8) {
+        uint64_t word;
+        memcpy(&word, data, 8);
+        crc = __crc32d(crc, word);
+        data += 8;
+        length -= 8;
+    }
+    while (length--) {
+        crc = __crc32b(crc, *data++);
+    }
+    return crc;
+}
+
+static bool hardware_crc_available(void) {
+#if defined(__APPLE__) || defined(__ARM_FEATURE_CRC32)
+    return true;  // Every Apple Silicon core implements the CRC32 extension
+#elif defined(__linux__)
+    return (getauxval(AT_HWCAP) & HWCAP_CRC32) != 0;
+#else
+    return false;
+#endif
+}
+
+#else
+
+static uint32_t crc32_update_hardware(uint32_t crc, const uint8_t* data, size_t length) {
+    return crc32_update_slice8(crc, data, length);
+}
+
+static bool hardware_crc_available(void) {
+    return false;
+}
+
+#endif
+
+static crc32_update_fn backend_function(crc32_backend_t backend) {
+    switch (backend) {
+        case CRC32_BACKEND_BITWISE:  return crc32_update_bitwise;
+        case CRC32_BACKEND_TABLE:    return crc32_update_table;
+        case CRC32_BACKEND_SLICE8:   return crc32_update_slice8;
+        case CRC32_BACKEND_HARDWARE: return crc32_update_hardware;
+        default:                     return nullptr;
+    }
+}
+
+static crc32_backend_t resolve_auto_backend(void) {
+    return hardware_crc_available() ? CRC32_BACKEND_HARDWARE : CRC32_BACKEND_SLICE8;
+}
+
+static uint32_t crc32_update_auto(uint32_t crc, const uint8_t* data, size_t length);
+
+static std::atomic<crc32_update_fn> active_update(crc32_update_auto);
+static std::atomic<int> active_backend(CRC32_BACKEND_AUTO);
+
+// First call resolves CRC32_BACKEND_AUTO, so no explicit init is needed
+static uint32_t crc32_update_auto(uint32_t crc, const uint8_t* data, size_t length) {
+    crc32_set_backend(CRC32_BACKEND_AUTO);
+    return active_update.load(std::memory_order_relaxed)(crc, data, length);
+}
+
+static inline uint32_t crc32_raw_update(uint32_t crc, const uint8_t* data, size_t length) {
+    return active_update.load(std::memory_order_relaxed)(crc, data, length);
+}
+
+bool crc32_backend_supported(crc32_backend_t backend) {
+    switch (backend) {
+        case CRC32_BACKEND_AUTO:
+        case CRC32_BACKEND_BITWISE:
+        case CRC32_BACKEND_TABLE:
+        case CRC32_BACKEND_SLICE8:
+            return true;
+        case CRC32_BACKEND_HARDWARE:
+            return hardware_crc_available();
+        default:
+            return false;
+    }
+}
+
+bool crc32_set_backend(crc32_backend_t backend) {
+    if (!crc32_backend_supported(backend)) {
+        return false;
+    }
+    if (backend == CRC32_BACKEND_AUTO) {
+        backend = resolve_auto_backend();
+    }
+    active_update.store(backend_function(backend), std::memory_order_relaxed);
+    active_backend.store(backend, std::memory_order_relaxed);
+    return true;
+}
+
+crc32_backend_t crc32_get_backend(void) {
+    int backend = active_backend.load(std::memory_order_relaxed);
+    return backend == CRC32_BACKEND_AUTO ? resolve_auto_backend() : (crc32_backend_t)backend;
+}
+
+const char* crc32_backend_name(crc32_backend_t backend) {
+    switch (backend) {
+        case CRC32_BACKEND_AUTO:     return "auto";
+        case CRC32_BACKEND_BITWISE:  return "bitwise";
+        case CRC32_BACKEND_TABLE:    return "table";
+        case CRC32_BACKEND_SLICE8:   return "slice8";
+#if defined(PSOC_CRC32_X86)
+        case CRC32_BACKEND_HARDWARE: return "pclmul";
+#elif defined(PSOC_CRC32_ARM64)
+        case CRC32_BACKEND_HARDWARE: return "armv8-crc32";
+#else
+        case CRC32_BACKEND_HARDWARE: return "hardware";
+#endif
+        default:                     return "unknown";
+    }
+}
+
+uint32_t crc32_update(uint32_t crc, const uint8_t* data, size_t length) {
+    return ~crc32_raw_update(~crc, data, length);
+}
+
+uint32_t calculate_crc32_samples(const int32_t* samples, size_t count) {
+    uint32_t crc = 0xFFFFFFFF;
+    uint8_t packed[SAMPLES_PER_PIECE * 3];
+
+    // Calculate CRC on packed 24-bit format, one L1-sized piece at a time
+    while (count > 0) {
+        size_t n = count < SAMPLES_PER_PIECE ? count : SAMPLES_PER_PIECE;
+        for (size_t i = 0; i < n; i++) {
+            int32_t sample = samples[i];
+            packed[i * 3 + 0] = (uint8_t)(sample & 0xFF);
+            packed[i * 3 + 1] = (uint8_t)((sample >> 8) & 0xFF);
+            packed[i * 3 + 2] = (uint8_t)((sample >> 16) & 0xFF);
+        }
+        crc = crc32_raw_update(crc, packed, n * 3);
+        samples += n;
+        count -= n;
+    }
+
+    return ~crc;
+}
+
+uint32_t calculate_crc32_data(const uint8_t* data, size_t length) {
+    return ~crc32_raw_update(0xFFFFFFFF, data, length);
+}
+
+uint32_t calculate_crc32_unpack_24bit(const uint8_t* packed, size_t count, int32_t* samples) {
+    uint32_t crc = 0xFFFFFFFF;
+
+    while (count > 0) {
+        size_t n = count < SAMPLES_PER_PIECE ? count : SAMPLES_PER_PIECE;
+
+        // CRC the piece, then unpack it while it is still in L1
+        crc = crc32_raw_update(crc, packed, n * 3);
+        unpack_24bit_samples(packed, n, samples);
+
+        packed += n * 3;
+        samples += n;
+        count -= n;
+    }
 
     return ~crc;
 }
@@ -0,0 +1,80 @@
+#include "mapped_file.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+bool mapped_file_open(mapped_file* file, const char* path) {
+    file->data = nullptr;
+    file->size = 0;
+#ifdef _WIN32
+    file->file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING,
+                             FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file->file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    file->mapping = nullptr;
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file->file, &size)) {
+        CloseHandle(file->file);
+        return false;
+    }
+    if (size.QuadPart == 0) {
+        return true;  // Nothing to map
+    }
+    file->mapping = CreateFileMappingA(file->file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!file->mapping) {
+        CloseHandle(file->file);
+        return false;
+    }
+    file->data = static_cast<const uint8_t*>(MapViewOfFile(file->mapping, FILE_MAP_READ, 0, 0, 0));
+    if (!file->data) {
+        CloseHandle(file->mapping);
+        CloseHandle(file->file);
+        return false;
+    }
+    file->size = (size_t)size.QuadPart;
+    return true;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        close(fd);
+        return false;
+    }
+    if (info.st_size == 0) {
+        close(fd);
+        return true;  // Nothing to map
+    }
+    void* map = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);  // The mapping keeps the file open
+    if (map == MAP_FAILED) {
+        return false;
+    }
+    file->data = static_cast<const uint8_t*>(map);
+    file->size = (size_t)info.st_size;
+    return true;
+#endif
+}
+
+void mapped_file_close(mapped_file* file) {
+#ifdef _WIN32
+    if (file->data) {
+        UnmapViewOfFile(file->data);
+        CloseHandle(file->mapping);
+    }
+    CloseHandle(file->file);
+#else
+    if (file->data) {
+        munmap(const_cast<uint8_t*>(file->data), file->size);
+    }
+#endif
+    file->data = nullptr;
+    file->size = 0;
+}
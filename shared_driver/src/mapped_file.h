@@ -0,0 +1,36 @@
+#ifndef PSOC_MAPPED_FILE_H
+#define PSOC_MAPPED_FILE_H
+
+// Internal read-only file mapping shared by the capture archive reader and replay
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+struct mapped_file {
+    const uint8_t* data;          // NULL for an empty file
+    size_t size;
+#ifdef _WIN32
+    HANDLE file;
+    HANDLE mapping;
+#endif
+};
+
+/**
+ * Map a whole file for reading
+ * @param file Mapping to fill
+ * @param path File path
+ * @return false if the file is missing or could not be mapped
+ */
+bool mapped_file_open(mapped_file* file, const char* path);
+
+/**
+ * Unmap a file mapped by mapped_file_open()
+ * @param file Mapping
+ */
+void mapped_file_close(mapped_file* file);
+
+#endif // PSOC_MAPPED_FILE_H
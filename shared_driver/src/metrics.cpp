@@ -0,0 +1,158 @@
+#include "session_metrics.h"
+#include <chrono>
+#include <cmath>
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+// Index of the highest set bit (value > 0)
+static inline unsigned highest_bit(uint64_t value) {
+#if defined(_MSC_VER) && !defined(__clang__) && defined(_M_X64)
+    unsigned long index;
+    _BitScanReverse64(&index, value);
+    return (unsigned)index;
+#elif defined(__GNUC__) || defined(__clang__)
+    return 63u - (unsigned)__builtin_clzll(value);
+#else
+    unsigned index = 0;
+    while (value >>= 1) {
+        index++;
+    }
+    return index;
+#endif
+}
+
+static uint32_t bucket_of(uint64_t value_ns) {
+    if (value_ns < METRICS_SUB_BUCKETS) {
+        return (uint32_t)value_ns;
+    }
+    unsigned msb = highest_bit(value_ns);
+    uint32_t bucket = (msb - 1) * METRICS_SUB_BUCKETS + (uint32_t)((value_ns >> (msb - 2)) & (METRICS_SUB_BUCKETS - 1));
+    return bucket < METRICS_HISTOGRAM_BUCKETS ? bucket : METRICS_HISTOGRAM_BUCKETS - 1;
+}
+
+uint64_t metrics_bucket_lower_bound_ns(uint32_t bucket) {
+    if (bucket < METRICS_SUB_BUCKETS) {
+        return bucket;
+    }
+    unsigned msb = bucket / METRICS_SUB_BUCKETS + 1;
+    uint64_t sub = bucket % METRICS_SUB_BUCKETS;
+    return (METRICS_SUB_BUCKETS + sub) << (msb - 2);
+}
+
+uint64_t metrics_percentile_ns(const transfer_metrics_t* metrics, metrics_stage_t stage, double percentile) {
+    const latency_histogram_t* histogram = &metrics->stages[stage];
+    if (histogram->count == 0) {
+        return 0;
+    }
+
+    uint64_t target = (uint64_t)std::ceil(percentile / 100.0 * (double)histogram->count);
+    if (target == 0) {
+        target = 1;
+    }
+    uint64_t seen = 0;
+    for (uint32_t i = 0; i < METRICS_HISTOGRAM_BUCKETS; i++) {
+        seen += histogram->buckets[i];
+        if (seen >= target) {
+            uint64_t upper = (i + 1 < METRICS_HISTOGRAM_BUCKETS) ? metrics_bucket_lower_bound_ns(i + 1) - 1
+                                                                 : histogram->max_ns;
+            return upper < histogram->max_ns ? upper : histogram->max_ns;
+        }
+    }
+    return histogram->max_ns;
+}
+
+uint64_t metrics_now_ns(void) {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void metrics_reset(session_metrics* metrics) {
+    for (size_t s = 0; s < METRICS_STAGE_COUNT; s++) {
+        histogram_recorder* histogram = &metrics->stages[s];
+        histogram->count.store(0, std::memory_order_relaxed);
+        histogram->sum_ns.store(0, std::memory_order_relaxed);
+        histogram->min_ns.store(UINT64_MAX, std::memory_order_relaxed);
+        histogram->max_ns.store(0, std::memory_order_relaxed);
+        for (size_t i = 0; i < METRICS_HISTOGRAM_BUCKETS; i++) {
+            histogram->buckets[i].store(0, std::memory_order_relaxed);
+        }
+    }
+    metrics->jitter_ns.store(0, std::memory_order_relaxed);
+    for (size_t i = 0; i <= METRICS_MAX_CHUNKS_PER_EVENT; i++) {
+        metrics->chunks_per_event[i].store(0, std::memory_order_relaxed);
+    }
+    metrics->out_of_order_chunks.store(0, std::memory_order_relaxed);
+    metrics->duplicate_chunks.store(0, std::memory_order_relaxed);
+    metrics->last_arrival_ns = 0;
+    metrics->last_gap_ns = 0;
+    metrics->event_chunks = 0;
+}
+
+// Single writer: no read-modify-write instructions needed
+template <typename T>
+static inline void add_relaxed(std::atomic<T>* value, T amount) {
+    value->store(value->load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}
+
+void metrics_record(histogram_recorder* histogram, uint64_t value_ns) {
+    add_relaxed(&histogram->buckets[bucket_of(value_ns)], (uint32_t)1);
+    add_relaxed(&histogram->count, (uint64_t)1);
+    add_relaxed(&histogram->sum_ns, value_ns);
+    if (value_ns < histogram->min_ns.load(std::memory_order_relaxed)) {
+        histogram->min_ns.store(value_ns, std::memory_order_relaxed);
+    }
+    if (value_ns > histogram->max_ns.load(std::memory_order_relaxed)) {
+        histogram->max_ns.store(value_ns, std::memory_order_relaxed);
+    }
+}
+
+void metrics_count(std::atomic<uint32_t>* counter) {
+    add_relaxed(counter, (uint32_t)1);
+}
+
+void metrics_chunk_arrived(session_metrics* metrics, uint64_t arrival_ns) {
+    if (metrics->last_arrival_ns != 0) {
+        uint64_t gap = arrival_ns - metrics->last_arrival_ns;
+        metrics_record(&metrics->stages[METRICS_STAGE_CHUNK_INTERVAL], gap);
+
+        // J += (|D| - J) / 16, D being the change in inter-arrival time
+        if (metrics->last_gap_ns != 0) {
+            int64_t change = (int64_t)gap - (int64_t)metrics->last_gap_ns;
+            int64_t jitter = (int64_t)metrics->jitter_ns.load(std::memory_order_relaxed);
+            jitter += ((change < 0 ? -change : change) - jitter) / 16;
+            metrics->jitter_ns.store((uint64_t)jitter, std::memory_order_relaxed);
+        }
+        metrics->last_gap_ns = gap;
+
+        if (gap >= METRICS_EVENT_GAP_NS) {
+            uint32_t size = metrics->event_chunks < METRICS_MAX_CHUNKS_PER_EVENT ? metrics->event_chunks
+                                                                                 : METRICS_MAX_CHUNKS_PER_EVENT;
+            metrics_count(&metrics->chunks_per_event[size]);
+            metrics->event_chunks = 0;
+        }
+    }
+    metrics->last_arrival_ns = arrival_ns;
+    metrics->event_chunks++;
+}
+
+void metrics_export(const session_metrics* metrics, transfer_metrics_t* out) {
+    for (size_t s = 0; s < METRICS_STAGE_COUNT; s++) {
+        const histogram_recorder* histogram = &metrics->stages[s];
+        latency_histogram_t* exported = &out->stages[s];
+        exported->count = histogram->count.load(std::memory_order_relaxed);
+        exported->sum_ns = histogram->sum_ns.load(std::memory_order_relaxed);
+        exported->min_ns = exported->count ? histogram->min_ns.load(std::memory_order_relaxed) : 0;
+        exported->max_ns = histogram->max_ns.load(std::memory_order_relaxed);
+        for (size_t i = 0; i < METRICS_HISTOGRAM_BUCKETS; i++) {
+            exported->buckets[i] = histogram->buckets[i].load(std::memory_order_relaxed);
+        }
+    }
+    out->jitter_ns = metrics->jitter_ns.load(std::memory_order_relaxed);
+    for (size_t i = 0; i <= METRICS_MAX_CHUNKS_PER_EVENT; i++) {
+        out->chunks_per_event[i] = metrics->chunks_per_event[i].load(std::memory_order_relaxed);
+    }
+    out->out_of_order_chunks = metrics->out_of_order_chunks.load(std::memory_order_relaxed);
+    out->duplicate_chunks = metrics->duplicate_chunks.load(std::memory_order_relaxed);
+}
@@ -1,4 +1,6 @@
 #include "psoc_driver/psoc_driver.h"
+#include "worker_pool.h"
+#include <thread>
 
 #define PSOC_DRIVER_VERSION "1.0.0"
 
@@ -7,10 +9,29 @@ const char* psoc_driver_version(void) {
 }
 
 bool psoc_driver_init(void) {
-    // Nothing to initialize for now
-    return true;
+    return psoc_driver_init_with_config(nullptr);
+}
+
+bool psoc_driver_init_with_config(const psoc_driver_config_t* config) {
+    // Resolve the fastest CRC32 and unpack kernels up front instead of on first use
+    bool crc_ok = crc32_set_backend(CRC32_BACKEND_AUTO);
+    bool unpack_ok = unpack_set_backend(UNPACK_BACKEND_AUTO);
+
+    uint32_t worker_threads = config ? config->worker_threads : 0;
+    if (worker_threads == PSOC_DRIVER_WORKERS_AUTO) {
+        unsigned cores = std::thread::hardware_concurrency();
+        worker_threads = cores > 1 ? cores - 1 : 1;
+    }
+
+    bool pool_ok = true;
+    if (worker_threads > 0) {
+        pool_ok = worker_pool_start(worker_threads);
+    } else {
+        worker_pool_stop();
+    }
+    return crc_ok && unpack_ok && pool_ok;
 }
 
 void psoc_driver_cleanup(void) {
-    // Nothing to cleanup for now
+    worker_pool_stop();
 }
@@ -0,0 +1,279 @@
+#include "psoc_driver/replay.h"
+#include "block_assembler.h"
+#include "mapped_file.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+// Blocks each thread may decode ahead of the one the callback is waiting for
+static const uint32_t REPLAY_BLOCKS_PER_THREAD = 4;
+
+namespace {
+
+// A chunk of the log and where its payload is
+struct chunk_ref {
+    chunk_record record;
+    const uint8_t* payload;
+};
+
+// A block reassembled and decoded ahead of its delivery
+struct replay_entry {
+    std::atomic<bool> ready;
+    block_assembler* assembler;
+    bool complete;
+    bool decoded;
+    uint8_t codec;
+    waveform_data_t waveform;
+};
+
+// Blocks are numbered by position: the n-th block number present in the log.
+// Any thread claims the next position while it is within the ring of the
+// delivering (calling) thread, which also decodes while it waits.
+struct replay_job {
+    std::vector<chunk_ref> chunks;     // grouped by block number, in arrival order within a block
+    std::vector<uint32_t> first;       // chunks of position n: first[n] to first[n + 1]
+    uint32_t block_count;
+    bool decode;
+
+    std::unique_ptr<replay_entry[]> ring;
+    uint32_t ring_size;
+    std::atomic<uint32_t> next_position;  // next block to claim
+    std::atomic<uint32_t> delivered;      // blocks handed to the callback
+    std::mutex lock;
+    std::condition_variable changed;      // an entry is ready, or one was delivered
+};
+
+}
+
+static bool collect_chunk(void* context, const chunk_record& record, const uint8_t* payload) {
+    if (record.block_number >= TOTAL_BLOCKS) {
+        return false;  // As a session would reject it
+    }
+    chunk_ref ref = { record, payload };
+    static_cast<std::vector<chunk_ref>*>(context)->push_back(ref);
+    return true;
+}
+
+// Parse every notification, then group the chunks by block number with a
+// counting sort, which keeps their arrival order within each block
+static void split_log(const uint8_t* log, size_t size, replay_job* job, replay_stats_t* stats) {
+    std::vector<chunk_ref> arrivals;
+    size_t offset = 0;
+    while (size - offset >= REPLAY_LOG_LENGTH_SIZE) {
+        size_t length = log[offset] | (log[offset + 1] << 8);
+        offset += REPLAY_LOG_LENGTH_SIZE;
+        if (length > size - offset) {
+            break;
+        }
+        stats->notifications++;
+        if (!visit_notification_chunks(log + offset, length, collect_chunk, &arrivals)) {
+            stats->malformed_notifications++;
+        }
+        offset += length;
+    }
+    stats->truncated = offset != size;
+
+    std::vector<uint32_t> start(TOTAL_BLOCKS + 1, 0);
+    for (size_t i = 0; i < arrivals.size(); i++) {
+        start[arrivals[i].record.block_number + 1]++;
+    }
+    for (size_t block = 0; block < TOTAL_BLOCKS; block++) {
+        start[block + 1] += start[block];
+    }
+
+    job->chunks.resize(arrivals.size());
+    std::vector<uint32_t> fill(start.begin(), start.end() - 1);
+    for (size_t i = 0; i < arrivals.size(); i++) {
+        job->chunks[fill[arrivals[i].record.block_number]++] = arrivals[i];
+    }
+
+    job->first.clear();
+    for (size_t block = 0; block < TOTAL_BLOCKS; block++) {
+        if (start[block + 1] > start[block]) {
+            job->first.push_back(start[block]);
+        }
+    }
+    job->block_count = (uint32_t)job->first.size();
+    job->first.push_back((uint32_t)job->chunks.size());
+    stats->blocks_seen = job->block_count;
+}
+
+// Take the next block if it fits in the ring. false if every block is taken or
+// the ring is full.
+static bool claim_block(replay_job* job, uint32_t* position) {
+    uint32_t next = job->next_position.load();
+    do {
+        if (next >= job->block_count || next - job->delivered.load() >= job->ring_size) {
+            return false;
+        }
+    } while (!job->next_position.compare_exchange_weak(next, next + 1));
+    *position = next;
+    return true;
+}
+
+static void assemble_block(replay_job* job, uint32_t position) {
+    replay_entry* entry = &job->ring[position % job->ring_size];
+    block_assembler_reset(entry->assembler);
+    entry->complete = false;
+    entry->decoded = false;
+    for (uint32_t i = job->first[position]; i < job->first[position + 1] && !entry->complete; i++) {
+        entry->complete = block_assembler_add(entry->assembler, job->chunks[i].record, job->chunks[i].payload);
+    }
+
+    capture_block_view_t view;
+    if (entry->complete) {
+        view.data = block_assembler_block(entry->assembler, &view.size, &view.codec);
+        entry->codec = view.codec;
+    }
+    if (entry->complete && job->decode && view.size >= WAVEFORM_HEADER_SIZE) {
+        view.block_number = job->chunks[job->first[position]].record.block_number;
+        view.timestamp_ms = 0;  // Not used by the decoder
+        view.payload = view.data + WAVEFORM_HEADER_SIZE;
+        view.payload_size = view.size - WAVEFORM_HEADER_SIZE;
+        entry->decoded = capture_archive_decode(&view, &entry->waveform);
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(job->lock);
+        entry->ready.store(true, std::memory_order_release);
+    }
+    job->changed.notify_all();
+}
+
+static void replay_worker(replay_job* job) {
+    for (;;) {
+        uint32_t position;
+        if (claim_block(job, &position)) {
+            assemble_block(job, position);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> guard(job->lock);
+        if (job->next_position.load() >= job->block_count) {
+            return;
+        }
+        job->changed.wait(guard, [job] {
+            uint32_t next = job->next_position.load();
+            return next >= job->block_count || next - job->delivered.load() < job->ring_size;
+        });
+    }
+}
+
+bool replay_notification_log(const uint8_t* log, size_t size, const replay_options_t* options,
+                             waveform_callback_t callback, void* user_data, replay_stats_t* stats) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    replay_stats_t local_stats;
+    if (!stats) {
+        stats = &local_stats;
+    }
+    memset(stats, 0, sizeof(*stats));
+
+    uint32_t threads = options ? options->threads : REPLAY_THREADS_AUTO;
+    capture_writer_t* archive = options ? options->archive : nullptr;
+    if (threads == REPLAY_THREADS_AUTO) {
+        threads = std::thread::hardware_concurrency();
+    }
+    if (threads == 0) {
+        threads = 1;
+    }
+
+    replay_job job;
+    split_log(log, size, &job, stats);
+    job.decode = callback != nullptr;
+    job.ring_size = threads * REPLAY_BLOCKS_PER_THREAD;
+    job.ring.reset(new replay_entry[job.ring_size]);
+    job.next_position.store(0);
+    job.delivered.store(0);
+
+    bool ok = true;
+    for (uint32_t i = 0; i < job.ring_size; i++) {
+        job.ring[i].ready.store(false);
+        job.ring[i].assembler = block_assembler_create();
+        ok = ok && job.ring[i].assembler;
+    }
+
+    // The calling thread is the first decoder; fewer threads than asked for
+    // only make the replay slower
+    std::vector<std::thread> workers;
+    for (uint32_t i = 1; ok && i < threads && job.block_count > 1; i++) {
+        try {
+            workers.push_back(std::thread(replay_worker, &job));
+        } catch (const std::system_error&) {
+            break;
+        }
+    }
+
+    for (uint32_t position = 0; ok && position < job.block_count; position++) {
+        replay_entry* entry = &job.ring[position % job.ring_size];
+        while (!entry->ready.load(std::memory_order_acquire)) {
+            uint32_t claimed;
+            if (claim_block(&job, &claimed)) {
+                assemble_block(&job, claimed);
+                continue;
+            }
+            std::unique_lock<std::mutex> guard(job.lock);
+            job.changed.wait(guard, [entry] { return entry->ready.load(std::memory_order_acquire); });
+        }
+
+        if (entry->complete) {
+            stats->blocks_complete++;
+            size_t block_size;
+            uint8_t codec;
+            const uint8_t* block = block_assembler_block(entry->assembler, &block_size, &codec);
+            if (archive && block_size >= WAVEFORM_HEADER_SIZE &&
+                !capture_writer_append(archive, block, block_size, codec)) {
+                ok = false;
+            }
+        }
+        if (entry->decoded) {
+            stats->blocks_decoded++;
+            callback(&entry->waveform, entry->codec != BLOCK_CODEC_RAW, user_data);
+        }
+
+        entry->ready.store(false, std::memory_order_relaxed);
+        {
+            std::lock_guard<std::mutex> guard(job.lock);
+            job.delivered.store(position + 1);
+        }
+        job.changed.notify_all();
+    }
+
+    // After an archive failure, stop the workers claiming more blocks
+    if (!ok) {
+        std::lock_guard<std::mutex> guard(job.lock);
+        job.next_position.store(job.block_count);
+    }
+    job.changed.notify_all();
+    for (size_t i = 0; i < workers.size(); i++) {
+        workers[i].join();
+    }
+    for (uint32_t i = 0; i < job.ring_size; i++) {
+        block_assembler_destroy(job.ring[i].assembler);
+    }
+
+    if (ok && archive) {
+        ok = capture_writer_flush(archive);
+    }
+    stats->elapsed_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return ok;
+}
+
+bool replay_notification_file(const char* path, const replay_options_t* options,
+                              waveform_callback_t callback, void* user_data, replay_stats_t* stats) {
+    mapped_file file;
+    if (!mapped_file_open(&file, path)) {
+        if (stats) {
+            memset(stats, 0, sizeof(*stats));
+        }
+        return false;
+    }
+    bool ok = replay_notification_log(file.data, file.size, options, callback, user_data, stats);
+    mapped_file_close(&file);
+    return ok;
+}
@@ -0,0 +1,583 @@
+#include "psoc_driver/sample_unpack.h"
+#include "psoc_driver/protocol.h"
+#include <atomic>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define PSOC_UNPACK_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define PSOC_TARGET_SSSE3
+#define PSOC_TARGET_AVX2
+#else
+#define PSOC_TARGET_SSSE3 __attribute__((target("ssse3")))
+#define PSOC_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define PSOC_UNPACK_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace {
+
+struct unpack_kernels {
+    void (*unpack)(const uint8_t* packed, size_t count, int32_t* samples);
+    void (*unpack_float)(const uint8_t* packed, size_t count, float scale, float* out);
+    void (*convert)(const int32_t* samples, size_t count, float scale, float* out);
+    void (*min_max_columns)(const int32_t* samples, size_t count, size_t columns, int32_t* min_out,
+                            int32_t* max_out);
+};
+
+} // namespace
+
+static inline int32_t unpack_one(const uint8_t* p) {
+    // Place the 24 bits at the top of the word, then arithmetic shift to sign-extend
+    uint32_t raw = ((uint32_t)p[0] << 8) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 24);
+    return (int32_t)raw >> 8;
+}
+
+static void unpack_scalar(const uint8_t* packed, size_t count, int32_t* samples) {
+    for (size_t i = 0; i < count; i++) {
+        samples[i] = unpack_one(packed + i * 3);
+    }
+}
+
+static void unpack_float_scalar(const uint8_t* packed, size_t count, float scale, float* out) {
+    for (size_t i = 0; i < count; i++) {
+        out[i] = (float)unpack_one(packed + i * 3) * scale;
+    }
+}
+
+static void convert_scalar(const int32_t* samples, size_t count, float scale, float* out) {
+    for (size_t i = 0; i < count; i++) {
+        out[i] = (float)samples[i] * scale;
+    }
+}
+
+// Walks the columns of samples_min_max_columns() without a division per column
+struct column_walk {
+    size_t end;
+    size_t step;        // count / columns
+    size_t extra;       // count % columns
+    size_t fraction;    // extra * columns walked, modulo columns
+    size_t columns;
+};
+
+static inline void column_walk_init(column_walk* walk, size_t count, size_t columns) {
+    walk->end = 0;
+    walk->step = count / columns;
+    walk->extra = count % columns;
+    walk->fraction = 0;
+    walk->columns = columns;
+}
+
+// End of the next column; it starts where the previous one ended
+static inline size_t column_walk_next(column_walk* walk) {
+    walk->end += walk->step;
+    walk->fraction += walk->extra;
+    if (walk->fraction >= walk->columns) {
+        walk->fraction -= walk->columns;
+        walk->end++;
+    }
+    return walk->end;
+}
+
+static inline void range_min_max_scalar(const int32_t* samples, size_t start, size_t end, int32_t* min_value,
+                                        int32_t* max_value) {
+    int32_t lo = samples[start];
+    int32_t hi = lo;
+    for (size_t i = start + 1; i < end; i++) {
+        lo = samples[i] < lo ? samples[i] : lo;
+        hi = samples[i] > hi ? samples[i] : hi;
+    }
+    *min_value = lo;
+    *max_value = hi;
+}
+
+// Columns of two to four samples (an envelope about as wide as the waveform
+// is long) are answered from the min and max of every adjacent pair: the pairs
+// at a column's first and second-to-last sample cover it, overlapping when it
+// has three. Each backend builds the pair tables with its vector min/max, then
+// a column costs two lookups and no loop, so nothing mispredicts as column
+// lengths alternate. Per-column vector loads lose to the scalar loop there.
+static inline bool pair_columns_fit(size_t count, size_t columns) {
+    size_t step = count / columns;
+    return count <= SAMPLES_PER_WAVEFORM && step >= 2 && step + (count % columns ? 1 : 0) <= 4;
+}
+
+static inline void pair_tables_scalar(const int32_t* samples, size_t i, size_t count, int32_t* pair_min,
+                                      int32_t* pair_max) {
+    for (; i + 1 < count; i++) {
+        pair_min[i] = samples[i + 1] < samples[i] ? samples[i + 1] : samples[i];
+        pair_max[i] = samples[i + 1] > samples[i] ? samples[i + 1] : samples[i];
+    }
+}
+
+static void min_max_pair_columns(const int32_t* pair_min, const int32_t* pair_max, size_t count, size_t columns,
+                                 int32_t* min_out, int32_t* max_out) {
+    column_walk walk;
+    column_walk_init(&walk, count, columns);
+    size_t start = 0;
+    for (size_t c = 0; c < columns; c++) {
+        size_t end = column_walk_next(&walk);
+        int32_t first_min = pair_min[start];
+        int32_t last_min = pair_min[end - 2];
+        int32_t first_max = pair_max[start];
+        int32_t last_max = pair_max[end - 2];
+        min_out[c] = last_min < first_min ? last_min : first_min;
+        max_out[c] = last_max > first_max ? last_max : first_max;
+        start = end;
+    }
+}
+
+static void min_max_columns_scalar(const int32_t* samples, size_t count, size_t columns, int32_t* min_out,
+                                   int32_t* max_out) {
+    if (pair_columns_fit(count, columns)) {
+        int32_t pair_min[SAMPLES_PER_WAVEFORM];
+        int32_t pair_max[SAMPLES_PER_WAVEFORM];
+        pair_tables_scalar(samples, 0, count, pair_min, pair_max);
+        min_max_pair_columns(pair_min, pair_max, count, columns, min_out, max_out);
+        return;
+    }
+
+    column_walk walk;
+    column_walk_init(&walk, count, columns);
+    size_t start = 0;
+    for (size_t c = 0; c < columns; c++) {
+        size_t end = column_walk_next(&walk);
+        range_min_max_scalar(samples, start, end, &min_out[c], &max_out[c]);
+        start = end;
+    }
+}
+
+static const unpack_kernels scalar_kernels = {
+    unpack_scalar, unpack_float_scalar, convert_scalar, min_max_columns_scalar
+};
+
+#if defined(PSOC_UNPACK_X86)
+
+// Each 16-byte load yields four samples: bytes 3j..3j+2 go to the top of lane j,
+// the low byte is zeroed and an arithmetic shift by 8 sign-extends the lane.
+// A step reads 4 bytes past the samples it converts, so the vector loops stop
+// early and the scalar loop finishes the tail.
+
+PSOC_TARGET_SSSE3
+static inline __m128i unpack4_ssse3(const uint8_t* p, __m128i mask) {
+    __m128i v = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)p), mask);
+    return _mm_srai_epi32(v, 8);
+}
+
+PSOC_TARGET_SSSE3
+static void unpack_ssse3(const uint8_t* packed, size_t count, int32_t* samples) {
+    const __m128i mask = _mm_setr_epi8(-1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11);
+    size_t i = 0;
+    for (; i + 10 <= count; i += 8) {
+        _mm_storeu_si128((__m128i*)(samples + i), unpack4_ssse3(packed + i * 3, mask));
+        _mm_storeu_si128((__m128i*)(samples + i + 4), unpack4_ssse3(packed + i * 3 + 12, mask));
+    }
+    unpack_scalar(packed + i * 3, count - i, samples + i);
+}
+
+PSOC_TARGET_SSSE3
+static void unpack_float_ssse3(const uint8_t* packed, size_t count, float scale, float* out) {
+    const __m128i mask = _mm_setr_epi8(-1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11);
+    const __m128 vscale = _mm_set1_ps(scale);
+    size_t i = 0;
+    for (; i + 10 <= count; i += 8) {
+        __m128 lo = _mm_cvtepi32_ps(unpack4_ssse3(packed + i * 3, mask));
+        __m128 hi = _mm_cvtepi32_ps(unpack4_ssse3(packed + i * 3 + 12, mask));
+        _mm_storeu_ps(out + i, _mm_mul_ps(lo, vscale));
+        _mm_storeu_ps(out + i + 4, _mm_mul_ps(hi, vscale));
+    }
+    unpack_float_scalar(packed + i * 3, count - i, scale, out + i);
+}
+
+PSOC_TARGET_SSSE3
+static void convert_ssse3(const int32_t* samples, size_t count, float scale, float* out) {
+    const __m128 vscale = _mm_set1_ps(scale);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128 v = _mm_cvtepi32_ps(_mm_loadu_si128((const __m128i*)(samples + i)));
+        _mm_storeu_ps(out + i, _mm_mul_ps(v, vscale));
+    }
+    convert_scalar(samples + i, count - i, scale, out + i);
+}
+
+// PMINSD/PMAXSD are SSE4.1; compare and select does the same with SSE2
+PSOC_TARGET_SSSE3
+static inline __m128i min_epi32_sse2(__m128i a, __m128i b) {
+    __m128i take_b = _mm_cmplt_epi32(b, a);
+    return _mm_or_si128(_mm_and_si128(take_b, b), _mm_andnot_si128(take_b, a));
+}
+
+PSOC_TARGET_SSSE3
+static inline __m128i max_epi32_sse2(__m128i a, __m128i b) {
+    __m128i take_b = _mm_cmpgt_epi32(b, a);
+    return _mm_or_si128(_mm_and_si128(take_b, b), _mm_andnot_si128(take_b, a));
+}
+
+// Columns of four samples or more are reduced four at a time; the last vector
+// overlaps the one before it rather than leaving a scalar tail
+PSOC_TARGET_SSSE3
+static void min_max_columns_ssse3(const int32_t* samples, size_t count, size_t columns, int32_t* min_out,
+                                  int32_t* max_out) {
+    if (pair_columns_fit(count, columns)) {
+        // Compare and select builds the pair tables no faster than the scalar loop
+        min_max_columns_scalar(samples, count, columns, min_out, max_out);
+        return;
+    }
+
+    column_walk walk;
+    column_walk_init(&walk, count, columns);
+    size_t start = 0;
+    for (size_t c = 0; c < columns; c++) {
+        size_t end = column_walk_next(&walk);
+        if (end - start < 4) {
+            range_min_max_scalar(samples, start, end, &min_out[c], &max_out[c]);
+            start = end;
+            continue;
+        }
+
+        __m128i lo = _mm_loadu_si128((const __m128i*)(samples + start));
+        __m128i hi = lo;
+        for (size_t i = start + 4; i < end; i += 4) {
+            __m128i v = _mm_loadu_si128((const __m128i*)(samples + (i + 4 <= end ? i : end - 4)));
+            lo = min_epi32_sse2(lo, v);
+            hi = max_epi32_sse2(hi, v);
+        }
+        lo = min_epi32_sse2(lo, _mm_shuffle_epi32(lo, _MM_SHUFFLE(1, 0, 3, 2)));
+        hi = max_epi32_sse2(hi, _mm_shuffle_epi32(hi, _MM_SHUFFLE(1, 0, 3, 2)));
+        lo = min_epi32_sse2(lo, _mm_shuffle_epi32(lo, _MM_SHUFFLE(2, 3, 0, 1)));
+        hi = max_epi32_sse2(hi, _mm_shuffle_epi32(hi, _MM_SHUFFLE(2, 3, 0, 1)));
+        min_out[c] = _mm_cvtsi128_si32(lo);
+        max_out[c] = _mm_cvtsi128_si32(hi);
+        start = end;
+    }
+}
+
+// VPSHUFB shuffles within 128-bit lanes, so each lane gets its own 16-byte load
+PSOC_TARGET_AVX2
+static inline __m256i unpack8_avx2(const uint8_t* p, __m256i mask) {
+    __m256i v = _mm256_inserti128_si256(
+        _mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)p)),
+        _mm_loadu_si128((const __m128i*)(p + 12)), 1);
+    return _mm256_srai_epi32(_mm256_shuffle_epi8(v, mask), 8);
+}
+
+PSOC_TARGET_AVX2
+static void unpack_avx2(const uint8_t* packed, size_t count, int32_t* samples) {
+    const __m256i mask = _mm256_setr_epi8(-1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11,
+                                          -1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11);
+    size_t i = 0;
+    for (; i + 18 <= count; i += 16) {
+        _mm256_storeu_si256((__m256i*)(samples + i), unpack8_avx2(packed + i * 3, mask));
+        _mm256_storeu_si256((__m256i*)(samples + i + 8), unpack8_avx2(packed + i * 3 + 24, mask));
+    }
+    unpack_ssse3(packed + i * 3, count - i, samples + i);
+}
+
+PSOC_TARGET_AVX2
+static void unpack_float_avx2(const uint8_t* packed, size_t count, float scale, float* out) {
+    const __m256i mask = _mm256_setr_epi8(-1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11,
+                                          -1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11);
+    const __m256 vscale = _mm256_set1_ps(scale);
+    size_t i = 0;
+    for (; i + 18 <= count; i += 16) {
+        __m256 lo = _mm256_cvtepi32_ps(unpack8_avx2(packed + i * 3, mask));
+        __m256 hi = _mm256_cvtepi32_ps(unpack8_avx2(packed + i * 3 + 24, mask));
+        _mm256_storeu_ps(out + i, _mm256_mul_ps(lo, vscale));
+        _mm256_storeu_ps(out + i + 8, _mm256_mul_ps(hi, vscale));
+    }
+    unpack_float_ssse3(packed + i * 3, count - i, scale, out + i);
+}
+
+PSOC_TARGET_AVX2
+static void convert_avx2(const int32_t* samples, size_t count, float scale, float* out) {
+    const __m256 vscale = _mm256_set1_ps(scale);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 v = _mm256_cvtepi32_ps(_mm256_loadu_si256((const __m256i*)(samples + i)));
+        _mm256_storeu_ps(out + i, _mm256_mul_ps(v, vscale));
+    }
+    convert_scalar(samples + i, count - i, scale, out + i);
+}
+
+// Eight samples at a time, then four (PMINSD is part of the AVX2 target)
+PSOC_TARGET_AVX2
+static void min_max_columns_avx2(const int32_t* samples, size_t count, size_t columns, int32_t* min_out,
+                                 int32_t* max_out) {
+    if (pair_columns_fit(count, columns)) {
+        int32_t pair_min[SAMPLES_PER_WAVEFORM];
+        int32_t pair_max[SAMPLES_PER_WAVEFORM];
+        size_t i = 0;
+        for (; i + 9 <= count; i += 8) {
+            __m256i a = _mm256_loadu_si256((const __m256i*)(samples + i));
+            __m256i b = _mm256_loadu_si256((const __m256i*)(samples + i + 1));
+            _mm256_storeu_si256((__m256i*)(pair_min + i), _mm256_min_epi32(a, b));
+            _mm256_storeu_si256((__m256i*)(pair_max + i), _mm256_max_epi32(a, b));
+        }
+        pair_tables_scalar(samples, i, count, pair_min, pair_max);
+        min_max_pair_columns(pair_min, pair_max, count, columns, min_out, max_out);
+        return;
+    }
+
+    column_walk walk;
+    column_walk_init(&walk, count, columns);
+    size_t start = 0;
+    for (size_t c = 0; c < columns; c++) {
+        size_t end = column_walk_next(&walk);
+        size_t length = end - start;
+        if (length < 4) {
+            range_min_max_scalar(samples, start, end, &min_out[c], &max_out[c]);
+            start = end;
+            continue;
+        }
+
+        __m128i lo, hi;
+        if (length >= 8) {
+            __m256i lo8 = _mm256_loadu_si256((const __m256i*)(samples + start));
+            __m256i hi8 = lo8;
+            for (size_t i = start + 8; i < end; i += 8) {
+                __m256i v = _mm256_loadu_si256((const __m256i*)(samples + (i + 8 <= end ? i : end - 8)));
+                lo8 = _mm256_min_epi32(lo8, v);
+                hi8 = _mm256_max_epi32(hi8, v);
+            }
+            lo = _mm_min_epi32(_mm256_castsi256_si128(lo8), _mm256_extracti128_si256(lo8, 1));
+            hi = _mm_max_epi32(_mm256_castsi256_si128(hi8), _mm256_extracti128_si256(hi8, 1));
+        } else {
+            lo = _mm_loadu_si128((const __m128i*)(samples + start));
+            __m128i v = _mm_loadu_si128((const __m128i*)(samples + end - 4));
+            hi = _mm_max_epi32(lo, v);
+            lo = _mm_min_epi32(lo, v);
+        }
+        lo = _mm_min_epi32(lo, _mm_shuffle_epi32(lo, _MM_SHUFFLE(1, 0, 3, 2)));
+        hi = _mm_max_epi32(hi, _mm_shuffle_epi32(hi, _MM_SHUFFLE(1, 0, 3, 2)));
+        lo = _mm_min_epi32(lo, _mm_shuffle_epi32(lo, _MM_SHUFFLE(2, 3, 0, 1)));
+        hi = _mm_max_epi32(hi, _mm_shuffle_epi32(hi, _MM_SHUFFLE(2, 3, 0, 1)));
+        min_out[c] = _mm_cvtsi128_si32(lo);
+        max_out[c] = _mm_cvtsi128_si32(hi);
+        start = end;
+    }
+}
+
+static const unpack_kernels ssse3_kernels = { unpack_ssse3, unpack_float_ssse3, convert_ssse3, min_max_columns_ssse3 };
+static const unpack_kernels avx2_kernels = { unpack_avx2, unpack_float_avx2, convert_avx2, min_max_columns_avx2 };
+
+static bool cpu_has_ssse3(void) {
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 1);
+    return (info[2] & (1 << 9)) != 0;
+#else
+    return __builtin_cpu_supports("ssse3");
+#endif
+}
+
+static bool cpu_has_avx2(void) {
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 1);
+    bool os_saves_ymm = (info[2] & (1 << 27)) && ((_xgetbv(0) & 6) == 6);
+    __cpuidex(info, 7, 0);
+    return os_saves_ymm && (info[1] & (1 << 5));
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#elif defined(PSOC_UNPACK_NEON)
+
+// Same layout trick as the x86 kernels; TBL writes zero for out-of-range indices.
+static inline int32x4_t unpack4_neon(const uint8_t* p, uint8x16_t mask) {
+    uint8x16_t v = vqtbl1q_u8(vld1q_u8(p), mask);
+    return vshrq_n_s32(vreinterpretq_s32_u8(v), 8);
+}
+
+static const uint8_t neon_shuffle[16] = { 0xFF, 0, 1, 2, 0xFF, 3, 4, 5, 0xFF, 6, 7, 8, 0xFF, 9, 10, 11 };
+
+static void unpack_neon(const uint8_t* packed, size_t count, int32_t* samples) {
+    const uint8x16_t mask = vld1q_u8(neon_shuffle);
+    size_t i = 0;
+    for (; i + 10 <= count; i += 8) {
+        vst1q_s32(samples + i, unpack4_neon(packed + i * 3, mask));
+        vst1q_s32(samples + i + 4, unpack4_neon(packed + i * 3 + 12, mask));
+    }
+    unpack_scalar(packed + i * 3, count - i, samples + i);
+}
+
+static void unpack_float_neon(const uint8_t* packed, size_t count, float scale, float* out) {
+    const uint8x16_t mask = vld1q_u8(neon_shuffle);
+    size_t i = 0;
+    for (; i + 10 <= count; i += 8) {
+        vst1q_f32(out + i, vmulq_n_f32(vcvtq_f32_s32(unpack4_neon(packed + i * 3, mask)), scale));
+        vst1q_f32(out + i + 4, vmulq_n_f32(vcvtq_f32_s32(unpack4_neon(packed + i * 3 + 12, mask)), scale));
+    }
+    unpack_float_scalar(packed + i * 3, count - i, scale, out + i);
+}
+
+static void convert_neon(const int32_t* samples, size_t count, float scale, float* out) {
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        vst1q_f32(out + i, vmulq_n_f32(vcvtq_f32_s32(vld1q_s32(samples + i)), scale));
+    }
+    convert_scalar(samples + i, count - i, scale, out + i);
+}
+
+static void min_max_columns_neon(const int32_t* samples, size_t count, size_t columns, int32_t* min_out,
+                                 int32_t* max_out) {
+    if (pair_columns_fit(count, columns)) {
+        int32_t pair_min[SAMPLES_PER_WAVEFORM];
+        int32_t pair_max[SAMPLES_PER_WAVEFORM];
+        size_t i = 0;
+        for (; i + 5 <= count; i += 4) {
+            int32x4_t a = vld1q_s32(samples + i);
+            int32x4_t b = vld1q_s32(samples + i + 1);
+            vst1q_s32(pair_min + i, vminq_s32(a, b));
+            vst1q_s32(pair_max + i, vmaxq_s32(a, b));
+        }
+        pair_tables_scalar(samples, i, count, pair_min, pair_max);
+        min_max_pair_columns(pair_min, pair_max, count, columns, min_out, max_out);
+        return;
+    }
+
+    column_walk walk;
+    column_walk_init(&walk, count, columns);
+    size_t start = 0;
+    for (size_t c = 0; c < columns; c++) {
+        size_t end = column_walk_next(&walk);
+        if (end - start < 4) {
+            range_min_max_scalar(samples, start, end, &min_out[c], &max_out[c]);
+            start = end;
+            continue;
+        }
+
+        int32x4_t lo = vld1q_s32(samples + start);
+        int32x4_t hi = lo;
+        for (size_t i = start + 4; i < end; i += 4) {
+            int32x4_t v = vld1q_s32(samples + (i + 4 <= end ? i : end - 4));
+            lo = vminq_s32(lo, v);
+            hi = vmaxq_s32(hi, v);
+        }
+        min_out[c] = vminvq_s32(lo);
+        max_out[c] = vmaxvq_s32(hi);
+        start = end;
+    }
+}
+
+static const unpack_kernels neon_kernels = { unpack_neon, unpack_float_neon, convert_neon, min_max_columns_neon };
+
+#endif
+
+static const unpack_kernels* backend_kernels(unpack_backend_t backend) {
+    switch (backend) {
+        case UNPACK_BACKEND_SCALAR: return &scalar_kernels;
+#if defined(PSOC_UNPACK_X86)
+        case UNPACK_BACKEND_SSSE3:  return &ssse3_kernels;
+        case UNPACK_BACKEND_AVX2:   return &avx2_kernels;
+#elif defined(PSOC_UNPACK_NEON)
+        case UNPACK_BACKEND_NEON:   return &neon_kernels;
+#endif
+        default:                    return nullptr;
+    }
+}
+
+bool unpack_backend_supported(unpack_backend_t backend) {
+    switch (backend) {
+        case UNPACK_BACKEND_AUTO:
+        case UNPACK_BACKEND_SCALAR:
+            return true;
+#if defined(PSOC_UNPACK_X86)
+        case UNPACK_BACKEND_SSSE3:
+            return cpu_has_ssse3();
+        case UNPACK_BACKEND_AVX2:
+            return cpu_has_avx2();
+#elif defined(PSOC_UNPACK_NEON)
+        case UNPACK_BACKEND_NEON:
+            return true;  // NEON is mandatory on AArch64
+#endif
+        default:
+            return false;
+    }
+}
+
+static unpack_backend_t resolve_auto_backend(void) {
+#if defined(PSOC_UNPACK_X86)
+    if (cpu_has_avx2()) {
+        return UNPACK_BACKEND_AVX2;
+    }
+    if (cpu_has_ssse3()) {
+        return UNPACK_BACKEND_SSSE3;
+    }
+#elif defined(PSOC_UNPACK_NEON)
+    return UNPACK_BACKEND_NEON;
+#endif
+    return UNPACK_BACKEND_SCALAR;
+}
+
+static std::atomic<const unpack_kernels*> active_kernels(nullptr);
+static std::atomic<int> active_backend(UNPACK_BACKEND_AUTO);
+
+// First call resolves UNPACK_BACKEND_AUTO, so no explicit init is needed
+static inline const unpack_kernels* kernels(void) {
+    const unpack_kernels* k = active_kernels.load(std::memory_order_relaxed);
+    if (!k) {
+        unpack_set_backend(UNPACK_BACKEND_AUTO);
+        k = active_kernels.load(std::memory_order_relaxed);
+    }
+    return k;
+}
+
+bool unpack_set_backend(unpack_backend_t backend) {
+    if (!unpack_backend_supported(backend)) {
+        return false;
+    }
+    if (backend == UNPACK_BACKEND_AUTO) {
+        backend = resolve_auto_backend();
+    }
+    active_kernels.store(backend_kernels(backend), std::memory_order_relaxed);
+    active_backend.store(backend, std::memory_order_relaxed);
+    return true;
+}
+
+unpack_backend_t unpack_get_backend(void) {
+    int backend = active_backend.load(std::memory_order_relaxed);
+    return backend == UNPACK_BACKEND_AUTO ? resolve_auto_backend() : (unpack_backend_t)backend;
+}
+
+const char* unpack_backend_name(unpack_backend_t backend) {
+    switch (backend) {
+        case UNPACK_BACKEND_AUTO:   return "auto";
+        case UNPACK_BACKEND_SCALAR: return "scalar";
+        case UNPACK_BACKEND_SSSE3:  return "ssse3";
+        case UNPACK_BACKEND_AVX2:   return "avx2";
+        case UNPACK_BACKEND_NEON:   return "neon";
+        default:                    return "unknown";
+    }
+}
+
+void unpack_24bit_samples(const uint8_t* packed, size_t count, int32_t* samples) {
+    kernels()->unpack(packed, count, samples);
+}
+
+void unpack_24bit_samples_float(const uint8_t* packed, size_t count, float scale, float* out) {
+    kernels()->unpack_float(packed, count, scale, out);
+}
+
+void convert_samples_to_float(const int32_t* samples, size_t count, float scale, float* out) {
+    kernels()->convert(samples, count, scale, out);
+}
+
+void unpack_24bit_samples_batch(const uint8_t* packed, size_t packed_stride, size_t block_count,
+                                size_t samples_per_block, int32_t* samples) {
+    const unpack_kernels* k = kernels();
+    for (size_t b = 0; b < block_count; b++) {
+        k->unpack(packed + b * packed_stride, samples_per_block, samples + b * samples_per_block);
+    }
+}
+
+void samples_min_max_columns(const int32_t* samples, size_t count, size_t columns, int32_t* min_out,
+                             int32_t* max_out) {
+    if (columns > 0) {
+        kernels()->min_max_columns(samples, count, columns, min_out, max_out);
+    }
+}
@@ -0,0 +1,47 @@
+#ifndef PSOC_SESSION_METRICS_H
+#define PSOC_SESSION_METRICS_H
+
+// Internal recorder behind transfer_session_get_metrics(). Each histogram has a
+// single writer (the ingest thread, or the thread delivering blocks), so updates
+// are plain relaxed loads and stores; readers get a lock-free, near-consistent copy.
+
+#include "psoc_driver/metrics.h"
+#include <atomic>
+
+struct histogram_recorder {
+    std::atomic<uint64_t> count;
+    std::atomic<uint64_t> sum_ns;
+    std::atomic<uint64_t> min_ns;
+    std::atomic<uint64_t> max_ns;
+    std::atomic<uint32_t> buckets[METRICS_HISTOGRAM_BUCKETS];
+};
+
+struct session_metrics {
+    histogram_recorder stages[METRICS_STAGE_COUNT];
+    std::atomic<uint64_t> jitter_ns;
+    std::atomic<uint32_t> chunks_per_event[METRICS_MAX_CHUNKS_PER_EVENT + 1];
+    std::atomic<uint32_t> out_of_order_chunks;
+    std::atomic<uint32_t> duplicate_chunks;
+
+    // Ingest thread only
+    uint64_t last_arrival_ns;
+    uint64_t last_gap_ns;
+    uint32_t event_chunks;
+};
+
+/**
+ * Monotonic timestamp for stage timing
+ * @return Nanoseconds since an arbitrary epoch
+ */
+uint64_t metrics_now_ns(void);
+
+void metrics_reset(session_metrics* metrics);
+void metrics_record(histogram_recorder* histogram, uint64_t value_ns);
+void metrics_count(std::atomic<uint32_t>* counter);
+
+// Update the interval histogram, jitter and connection event grouping
+void metrics_chunk_arrived(session_metrics* metrics, uint64_t arrival_ns);
+
+void metrics_export(const session_metrics* metrics, transfer_metrics_t* out);
+
+#endif // PSOC_SESSION_METRICS_H
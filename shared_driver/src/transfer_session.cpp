@@ -1,31 +1,181 @@
 #include "psoc_driver/transfer_session.h"
 #include "psoc_driver/compression.h"
 #include "psoc_driver/crc32.h"
+#include "worker_pool.h"
+#include "block_assembler.h"
+#include "session_metrics.h"
+#include "wire_layout.h"
+#include <atomic>
 #include <cstring>
-#include <map>
-#include <vector>
+#include <cstddef>
 #include <chrono>
+#include <cmath>
 #include <cstdio>
+#include <new>
+#include <thread>
+
+// Stage timing, compiled in with the PSOC_DRIVER_METRICS CMake option
+#if PSOC_DRIVER_METRICS
+#define METRICS_ONLY(...) __VA_ARGS__
+#else
+#define METRICS_ONLY(...)
+#endif
+
+// Smallest chunk payload the firmware sends is MTU(23) - ATT(3) - header(12) = 8 bytes
+static const size_t MAX_CHUNKS_PER_BLOCK = BLOCK_SIZE / 8;
+static const size_t CHUNK_BITMAP_WORDS = (MAX_CHUNKS_PER_BLOCK + 63) / 64;
+
+// Blocks only overlap within the firmware's send window, so a few slots are
+// enough. Slot index is block_number % REASSEMBLY_SLOT_COUNT.
+static const size_t REASSEMBLY_SLOT_COUNT = 4;
+static_assert(REASSEMBLY_SLOT_COUNT >= SEND_WINDOW_BLOCKS, "every block in flight needs its own slot");
+
+static const size_t BLOCK_BITMAP_WORDS = (TOTAL_BLOCKS + 63) / 64;
+
+// Blocks a session's strand delivers per run before other sessions get the worker
+static const size_t STRAND_BATCH_BLOCKS = 4;
+
+// Time constant of the smoothed throughput (seconds of history that matter)
+static const double STATS_EWMA_TIME_CONSTANT_S = 2.0;
+
+// Fixed-size reassembly buffer for one block. Chunks are written straight to
+// chunk_number * stride, or to the offset a packed record carries; the bitmap
+// filters duplicates.
+struct reassembly_slot {
+    bool in_use;
+    uint16_t block_number;
+    uint16_t total_chunks;
+    uint16_t chunks_received;
+    bool packed;                  // chunks arrive as packed records (explicit offsets)
+    uint16_t stride;              // payload size of every chunk but the first (packed) and the last (0 = unknown)
+    uint16_t head_size;           // packed: payload size of chunk 0 (0 = unknown)
+    uint16_t tail_size;           // payload size of the last chunk (0 = not received)
+    uint16_t tail_offset;         // packed: where the last chunk starts
+    bool tail_parked;             // last chunk stored at end of buffer until stride is known
+    uint16_t chunk_frontier;      // one past the highest chunk number received
+    uint8_t codec;                // BLOCK_CODEC_* from the chunk flags
+    bool streaming;               // inflater is fed as chunks arrive (zlib/delta, inline delivery)
+    uint16_t stream_chunk;        // next chunk to feed to the inflater
+    delta_inflater_t* inflater;   // created by start/prewarm when blocks are decoded inline
+    uint32_t bytes_received;
+    METRICS_ONLY(uint64_t first_chunk_ns;)  // arrival of the block's first chunk
+    uint64_t chunk_bitmap[CHUNK_BITMAP_WORDS];
+    uint8_t data[BLOCK_SIZE];
+};
+
+// Completed block copied off the ingest thread for a worker to deliver
+struct decode_job {
+    std::atomic<decode_job*> next;     // delivery queue, then free list
+    uint16_t block_number;
+    uint8_t codec;
+    bool report_progress;
+    bool completes_transfer;
+    transfer_stats_t stats;            // as of this block's completion
+    size_t size;
+    uint8_t data[BLOCK_SIZE];
+};
+
+// Published waveform for the ring consumer
+struct waveform_ring_entry {
+    waveform_data_t waveform;
+    bool is_compressed;
+};
+
+// transfer_stats_t for readers on other threads: a seqlock over relaxed atomics
+struct published_stats {
+    std::atomic<uint32_t> sequence;       // odd while an update is in progress
+    std::atomic<uint32_t> blocks_received;
+    std::atomic<uint32_t> total_bytes_received;
+    std::atomic<uint32_t> total_chunks_received;
+    std::atomic<double> throughput_kbps;
+    std::atomic<double> progress_percent;
+    std::atomic<double> elapsed_seconds;
+    std::atomic<double> ewma_throughput_kbps;
+    std::atomic<double> instant_throughput_kbps;
+    std::atomic<double> eta_seconds;
+};
+
+struct decode_strand : pool_task {
+    transfer_session* session;
+};
 
 struct transfer_session {
     // State
     bool is_active;
     std::chrono::steady_clock::time_point start_time;
 
-    // Block tracking
-    std::map<uint16_t, std::vector<uint8_t>> received_blocks;
-    std::map<uint16_t, std::map<uint16_t, std::vector<uint8_t>>> block_chunks;
-    std::map<uint16_t, uint16_t> block_expected_chunks;
+    // Block tracking (completed blocks are delivered and not kept)
+    uint64_t block_bitmap[BLOCK_BITMAP_WORDS];
+    uint32_t blocks_received;
+    reassembly_slot slots[REASSEMBLY_SLOT_COUNT];
     uint16_t last_acked_block;
+    uint16_t next_expected_block; // every block before this one has been delivered
+    uint16_t block_frontier;      // one past the highest block number seen
 
-    // Statistics
+    // Chunk reserved by transfer_session_begin_chunk() and not yet committed
+    reassembly_slot* pending_slot;
+    uint16_t pending_chunk;
+    uint16_t pending_size;
+    uint16_t pending_offset;
+
+    // Statistics, brought up to date once per completed block (update_stats)
     uint32_t total_bytes_received;
     uint32_t total_chunks_received;
+    transfer_stats_t stats;
+    std::chrono::steady_clock::time_point last_block_time;
+    uint32_t bytes_at_last_block;
+    double ewma_bytes_per_second;
+    published_stats published;
+
+    METRICS_ONLY(
+        session_metrics metrics;
+        uint64_t pending_arrival_ns;  // arrival of the chunk being ingested
+        uint64_t pending_ingest_ns;   // time spent in begin_chunk() for the pending chunk
+    )
+
+    // Progress callback rate limit (transfer_session_set_progress_interval)
+    uint32_t progress_interval_ms;
+    uint32_t progress_block_interval;
+    std::chrono::steady_clock::time_point last_progress_time;
+    uint32_t blocks_at_last_progress;
+
+    // Background delivery (worker pool running at transfer_session_start). The
+    // ingest thread appends jobs to an SPSC list and schedules the strand; at
+    // most one worker runs the strand at a time, which keeps blocks in order.
+    bool background_decode;
+    decode_strand strand;
+    std::atomic<bool> strand_scheduled;
+    std::atomic<uint32_t> strand_active;  // nonzero while a worker is inside the strand
+    std::atomic<uint32_t> jobs_pending;   // queued and not yet delivered
+    decode_job* queue_head;               // strand side: already delivered, next is the oldest job
+    decode_job* queue_tail;               // ingest side
+    std::atomic<decode_job*> free_jobs;   // delivered jobs handed back by the strand
+    decode_job* spare_jobs;               // ingest side cache of free_jobs
+
+    // Optional waveform ring instead of the waveform callback. Produced by
+    // whichever thread delivers blocks; consumed by the acquire/release caller.
+    waveform_ring_entry* ring;
+    uint32_t ring_mask;                   // capacity - 1 (capacity is a power of two)
+    std::atomic<uint32_t> ring_head;      // next entry to publish
+    std::atomic<uint32_t> ring_tail;      // next entry to acquire
+    std::atomic<uint32_t> ring_dropped;   // waveforms skipped because the ring was full
+
+    capture_writer_t* archive;            // transfer_session_set_archive(), NULL when off
+
+    // Optional summary stage (transfer_session_set_summary_callback), run by
+    // whichever thread delivers blocks
+    summary_callback_t summary_callback;
+    void* summary_user_data;
+    waveform_summary_config_t summary_config;
+    int32_t* envelope;                    // envelope_width minimums, then as many maximums
 
     // Callbacks
     waveform_callback_t waveform_callback;
     void* waveform_user_data;
 
+    lazy_waveform_callback_t lazy_callback;  // when set, blocks are delivered undecoded
+    void* lazy_user_data;
+
     progress_callback_t progress_callback;
     void* progress_user_data;
 
@@ -34,110 +184,444 @@ struct transfer_session {
 
     ack_callback_t ack_callback;
     void* ack_user_data;
+
+    sack_callback_t sack_callback;
+    void* sack_user_data;
 };
 
+static bool run_decode_strand(pool_task* task);
+
+static void publish_stats(transfer_session_t* session) {
+    published_stats* published = &session->published;
+    const transfer_stats_t* stats = &session->stats;
+    uint32_t sequence = published->sequence.load(std::memory_order_relaxed);
+    published->sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    published->blocks_received.store(stats->blocks_received, std::memory_order_relaxed);
+    published->total_bytes_received.store(stats->total_bytes_received, std::memory_order_relaxed);
+    published->total_chunks_received.store(stats->total_chunks_received, std::memory_order_relaxed);
+    published->throughput_kbps.store(stats->throughput_kbps, std::memory_order_relaxed);
+    published->progress_percent.store(stats->progress_percent, std::memory_order_relaxed);
+    published->elapsed_seconds.store(stats->elapsed_seconds, std::memory_order_relaxed);
+    published->ewma_throughput_kbps.store(stats->ewma_throughput_kbps, std::memory_order_relaxed);
+    published->instant_throughput_kbps.store(stats->instant_throughput_kbps, std::memory_order_relaxed);
+    published->eta_seconds.store(stats->eta_seconds, std::memory_order_relaxed);
+
+    published->sequence.store(sequence + 2, std::memory_order_release);
+}
+
+static void reset_stats(transfer_session_t* session, std::chrono::steady_clock::time_point now) {
+    memset(&session->stats, 0, sizeof(session->stats));
+    session->stats.total_blocks = TOTAL_BLOCKS;
+    session->last_block_time = now;
+    session->bytes_at_last_block = 0;
+    session->ewma_bytes_per_second = 0.0;
+    session->last_progress_time = now;
+    session->blocks_at_last_progress = 0;
+    publish_stats(session);
+}
+
+// Fold a completed block into the stats and publish them
+static std::chrono::steady_clock::time_point update_stats(transfer_session_t* session) {
+    auto now = std::chrono::steady_clock::now();
+    transfer_stats_t* stats = &session->stats;
+    double elapsed = std::chrono::duration<double>(now - session->start_time).count();
+    double interval = std::chrono::duration<double>(now - session->last_block_time).count();
+    double bytes = session->total_bytes_received - session->bytes_at_last_block;
+
+    if (interval > 0) {
+        double rate = bytes / interval;
+        if (session->ewma_bytes_per_second == 0.0) {
+            session->ewma_bytes_per_second = rate;
+        } else {
+            // Weight by the time this sample covers, so bursts of blocks don't dominate
+            double weight = 1.0 - std::exp(-interval / STATS_EWMA_TIME_CONSTANT_S);
+            session->ewma_bytes_per_second += weight * (rate - session->ewma_bytes_per_second);
+        }
+        stats->instant_throughput_kbps = rate / 1000.0;
+    }
+    session->last_block_time = now;
+    session->bytes_at_last_block = session->total_bytes_received;
+
+    stats->blocks_received = session->blocks_received;
+    stats->total_bytes_received = session->total_bytes_received;
+    stats->total_chunks_received = session->total_chunks_received;
+    stats->elapsed_seconds = elapsed;
+    stats->throughput_kbps = elapsed > 0 ? (session->total_bytes_received / elapsed) / 1000.0 : 0.0;
+    stats->progress_percent = (session->blocks_received * 100.0) / TOTAL_BLOCKS;
+    stats->ewma_throughput_kbps = session->ewma_bytes_per_second / 1000.0;
+
+    stats->eta_seconds = 0.0;
+    if (session->ewma_bytes_per_second > 0 && session->blocks_received > 0) {
+        double bytes_per_block = (double)session->total_bytes_received / session->blocks_received;
+        stats->eta_seconds = (TOTAL_BLOCKS - session->blocks_received) * bytes_per_block /
+                             session->ewma_bytes_per_second;
+    }
+
+    publish_stats(session);
+    return now;
+}
+
+// Whether this block's progress report passes the rate limit. The last block always does.
+static bool progress_due(transfer_session_t* session, std::chrono::steady_clock::time_point now) {
+    bool due = session->blocks_received == TOTAL_BLOCKS ||
+               (session->progress_interval_ms == 0 && session->progress_block_interval == 0);
+    if (session->progress_block_interval > 0 &&
+        session->blocks_received - session->blocks_at_last_progress >= session->progress_block_interval) {
+        due = true;
+    }
+    if (session->progress_interval_ms > 0 &&
+        now - session->last_progress_time >= std::chrono::milliseconds(session->progress_interval_ms)) {
+        due = true;
+    }
+
+    if (due) {
+        session->last_progress_time = now;
+        session->blocks_at_last_progress = session->blocks_received;
+    }
+    return due;
+}
+
+// Wait until a worker has delivered every queued block and left the strand
+static void wait_for_strand(transfer_session_t* session) {
+    while (session->jobs_pending.load() > 0 || session->strand_active.load() > 0) {
+        std::this_thread::yield();
+    }
+}
+
+// Give every slot an inflater, so zlib/delta blocks stream without allocating.
+// A slot whose inflater could not be created decodes its blocks whole.
+static void create_slot_inflaters(transfer_session_t* session) {
+    for (size_t i = 0; i < REASSEMBLY_SLOT_COUNT; i++) {
+        if (!session->slots[i].inflater) {
+            session->slots[i].inflater = delta_inflater_create();
+        }
+    }
+}
+
+static void free_job_list(decode_job* job) {
+    while (job) {
+        decode_job* next = job->next.load();
+        delete job;
+        job = next;
+    }
+}
+
 transfer_session_t* transfer_session_create(void) {
     transfer_session_t* session = new transfer_session_t();
     session->is_active = false;
+    memset(session->block_bitmap, 0, sizeof(session->block_bitmap));
+    session->blocks_received = 0;
+    for (size_t i = 0; i < REASSEMBLY_SLOT_COUNT; i++) {
+        session->slots[i].in_use = false;
+        session->slots[i].inflater = nullptr;
+    }
     session->last_acked_block = 0;
+    session->next_expected_block = 0;
+    session->block_frontier = 0;
+    session->pending_slot = nullptr;
     session->total_bytes_received = 0;
     session->total_chunks_received = 0;
+    session->published.sequence.store(0);
+    reset_stats(session, std::chrono::steady_clock::now());
+    METRICS_ONLY(metrics_reset(&session->metrics);)
+    session->progress_interval_ms = 0;
+    session->progress_block_interval = 0;
+    session->background_decode = worker_pool_running();
+    session->strand.run = run_decode_strand;
+    session->strand.next.store(nullptr);
+    session->strand.session = session;
+    session->strand_scheduled.store(false);
+    session->strand_active.store(0);
+    session->jobs_pending.store(0);
+    session->queue_head = new decode_job();
+    session->queue_head->next.store(nullptr);
+    session->queue_tail = session->queue_head;
+    session->free_jobs.store(nullptr);
+    session->spare_jobs = nullptr;
+    session->ring = nullptr;
+    session->ring_mask = 0;
+    session->ring_head.store(0);
+    session->ring_tail.store(0);
+    session->ring_dropped.store(0);
+    session->archive = nullptr;
+    session->summary_callback = nullptr;
+    session->summary_user_data = nullptr;
+    memset(&session->summary_config, 0, sizeof(session->summary_config));
+    session->envelope = nullptr;
     session->waveform_callback = nullptr;
     session->waveform_user_data = nullptr;
+    session->lazy_callback = nullptr;
+    session->lazy_user_data = nullptr;
     session->progress_callback = nullptr;
     session->progress_user_data = nullptr;
     session->completion_callback = nullptr;
     session->completion_user_data = nullptr;
     session->ack_callback = nullptr;
     session->ack_user_data = nullptr;
+    session->sack_callback = nullptr;
+    session->sack_user_data = nullptr;
     return session;
 }
 
 void transfer_session_destroy(transfer_session_t* session) {
     if (session) {
+        wait_for_strand(session);
+        for (size_t i = 0; i < REASSEMBLY_SLOT_COUNT; i++) {
+            delta_inflater_destroy(session->slots[i].inflater);
+        }
+        free_job_list(session->queue_head);
+        free_job_list(session->spare_jobs);
+        free_job_list(session->free_jobs.load());
+        delete[] session->ring;
+        delete[] session->envelope;
         delete session;
     }
 }
 
 void transfer_session_set_waveform_callback(transfer_session_t* session, waveform_callback_t callback, void* user_data) {
+    wait_for_strand(session);
     session->waveform_callback = callback;
     session->waveform_user_data = user_data;
 }
 
+void transfer_session_set_lazy_waveform_callback(transfer_session_t* session, lazy_waveform_callback_t callback,
+                                                 void* user_data) {
+    wait_for_strand(session);
+    session->lazy_callback = callback;
+    session->lazy_user_data = user_data;
+}
+
+bool waveform_handle_decode(const waveform_handle_t* handle, waveform_data_t* waveform) {
+    return capture_archive_decode(&handle->block, waveform);
+}
+
+bool transfer_session_set_waveform_ring(transfer_session_t* session, uint32_t capacity) {
+    wait_for_strand(session);
+    delete[] session->ring;
+    session->ring = nullptr;
+    session->ring_mask = 0;
+    session->ring_head.store(0);
+    session->ring_tail.store(0);
+    session->ring_dropped.store(0);
+    if (capacity == 0) {
+        return true;
+    }
+    if (capacity > WAVEFORM_RING_MAX_CAPACITY) {
+        return false;
+    }
+
+    uint32_t size = 1;
+    while (size < capacity) {
+        size <<= 1;
+    }
+    session->ring = new waveform_ring_entry[size];
+    session->ring_mask = size - 1;
+    return true;
+}
+
+const waveform_data_t* transfer_session_acquire_waveform(transfer_session_t* session, bool* is_compressed) {
+    if (!session->ring) {
+        return nullptr;
+    }
+    uint32_t tail = session->ring_tail.load(std::memory_order_relaxed);
+    if (tail == session->ring_head.load(std::memory_order_acquire)) {
+        return nullptr;
+    }
+
+    const waveform_ring_entry* entry = &session->ring[tail & session->ring_mask];
+    if (is_compressed) {
+        *is_compressed = entry->is_compressed;
+    }
+    return &entry->waveform;
+}
+
+const waveform_data_t* transfer_session_acquire_latest_waveform(transfer_session_t* session, bool* is_compressed) {
+    if (!session->ring) {
+        return nullptr;
+    }
+    uint32_t head = session->ring_head.load(std::memory_order_acquire);
+    if (session->ring_tail.load(std::memory_order_relaxed) == head) {
+        return nullptr;
+    }
+
+    // Everything older than the newest entry is handed straight back to the producer
+    session->ring_tail.store(head - 1, std::memory_order_release);
+    return transfer_session_acquire_waveform(session, is_compressed);
+}
+
+void transfer_session_release_waveform(transfer_session_t* session) {
+    if (!session->ring) {
+        return;
+    }
+    uint32_t tail = session->ring_tail.load(std::memory_order_relaxed);
+    if (tail != session->ring_head.load(std::memory_order_acquire)) {
+        session->ring_tail.store(tail + 1, std::memory_order_release);
+    }
+}
+
+uint32_t transfer_session_get_dropped_waveforms(const transfer_session_t* session) {
+    return session->ring_dropped.load();
+}
+
+void transfer_session_set_summary_callback(transfer_session_t* session, summary_callback_t callback,
+                                           const waveform_summary_config_t* config, void* user_data) {
+    wait_for_strand(session);
+    delete[] session->envelope;
+    session->envelope = nullptr;
+    memset(&session->summary_config, 0, sizeof(session->summary_config));
+    if (config) {
+        session->summary_config = *config;
+    }
+    if (session->summary_config.envelope_width > SAMPLES_PER_WAVEFORM) {
+        session->summary_config.envelope_width = SAMPLES_PER_WAVEFORM;
+    }
+    if (callback && session->summary_config.envelope_width) {
+        session->envelope = new int32_t[2 * session->summary_config.envelope_width];
+    }
+    session->summary_callback = callback;
+    session->summary_user_data = user_data;
+}
+
+void transfer_session_set_archive(transfer_session_t* session, capture_writer_t* writer) {
+    wait_for_strand(session);
+    session->archive = writer;
+}
+
 void transfer_session_set_progress_callback(transfer_session_t* session, progress_callback_t callback, void* user_data) {
+    wait_for_strand(session);
     session->progress_callback = callback;
     session->progress_user_data = user_data;
 }
 
+void transfer_session_set_progress_interval(transfer_session_t* session, uint32_t min_interval_ms,
+                                           uint32_t min_blocks) {
+    wait_for_strand(session);
+    session->progress_interval_ms = min_interval_ms;
+    session->progress_block_interval = min_blocks;
+}
+
 void transfer_session_set_completion_callback(transfer_session_t* session, completion_callback_t callback, void* user_data) {
+    wait_for_strand(session);
     session->completion_callback = callback;
     session->completion_user_data = user_data;
 }
 
 void transfer_session_set_ack_callback(transfer_session_t* session, ack_callback_t callback, void* user_data) {
+    wait_for_strand(session);
     session->ack_callback = callback;
     session->ack_user_data = user_data;
 }
 
+void transfer_session_set_sack_callback(transfer_session_t* session, sack_callback_t callback, void* user_data) {
+    wait_for_strand(session);
+    session->sack_callback = callback;
+    session->sack_user_data = user_data;
+}
+
+void transfer_session_prewarm(transfer_session_t* session) {
+    wait_for_strand(session);
+
+    if (worker_pool_running()) {
+        // Every block of the send window can be queued before the first is delivered
+        size_t spare = 0;
+        for (decode_job* job = session->spare_jobs; job; job = job->next.load(std::memory_order_relaxed)) {
+            spare++;
+        }
+        for (; spare < REASSEMBLY_SLOT_COUNT; spare++) {
+            decode_job* job = new decode_job();
+            job->next.store(session->spare_jobs, std::memory_order_relaxed);
+            session->spare_jobs = job;
+        }
+
+        // Run the empty strand once, so a worker is up before the first block
+        if (!session->strand_scheduled.exchange(true)) {
+            worker_pool_submit(&session->strand);
+        }
+        while (session->strand_scheduled.load()) {
+            std::this_thread::yield();
+        }
+    } else if (!session->lazy_callback) {
+        create_slot_inflaters(session);
+    }
+
+    // Fault in the kernel and its tables (the result is discarded)
+    waveform_data_t scratch;
+    (void)calculate_crc32_unpack_24bit(session->slots[0].data + WAVEFORM_HEADER_SIZE, SAMPLES_PER_WAVEFORM,
+                                       scratch.samples);
+}
+
 void transfer_session_start(transfer_session_t* session) {
+    wait_for_strand(session);  // Callbacks of the previous transfer come first
+    session->background_decode = worker_pool_running();
+    if (!session->background_decode && !session->lazy_callback) {
+        create_slot_inflaters(session);  // Not on the ingest path
+    }
     session->is_active = true;
     session->start_time = std::chrono::steady_clock::now();
-    session->received_blocks.clear();
-    session->block_chunks.clear();
-    session->block_expected_chunks.clear();
+    memset(session->block_bitmap, 0, sizeof(session->block_bitmap));
+    session->blocks_received = 0;
+    for (size_t i = 0; i < REASSEMBLY_SLOT_COUNT; i++) {
+        session->slots[i].in_use = false;
+    }
     session->last_acked_block = 0;
+    session->next_expected_block = 0;
+    session->block_frontier = 0;
+    session->pending_slot = nullptr;
     session->total_bytes_received = 0;
     session->total_chunks_received = 0;
+    reset_stats(session, session->start_time);
+    METRICS_ONLY(metrics_reset(&session->metrics);)
 }
 
 void transfer_session_stop(transfer_session_t* session) {
     session->is_active = false;
 }
 
-static void parse_waveform_header(const uint8_t* data, waveform_header_t* header) {
-    header->block_number = data[0] | (data[1] << 8) | (data[2] << 16) | (data[3] << 24);
-    header->timestamp_ms = data[4] | (data[5] << 8) | (data[6] << 16) | (data[7] << 24);
-    header->sample_rate_hz = data[8] | (data[9] << 8) | (data[10] << 16) | (data[11] << 24);
-    header->sample_count = data[12] | (data[13] << 8);
-    header->trigger_sample = data[16] | (data[17] << 8);
-    header->pulse_freq_hz = data[18] | (data[19] << 8) | (data[20] << 16) | (data[21] << 24);
-    header->temperature_cx10 = (int16_t)(data[26] | (data[27] << 8));
-    header->gain_db = data[28];
-    header->crc32 = data[30] | (data[31] << 8) | (data[32] << 16) | (data[33] << 24);
-}
-
-static void unpack_24bit_samples(const uint8_t* sample_data, size_t sample_count, int32_t* samples) {
-    for (size_t i = 0; i < sample_count; i++) {
-        size_t offset = i * 3;
-        int32_t sample = sample_data[offset] |
-                        (sample_data[offset + 1] << 8) |
-                        (sample_data[offset + 2] << 16);
-
-        // Sign extend from 24-bit to 32-bit
-        if (sample & 0x800000) {
-            sample |= 0xFF000000;
-        }
+void transfer_session_resume(transfer_session_t* session) {
+    session->pending_slot = nullptr;  // A chunk begun before the link dropped is not coming
+    session->is_active = session->blocks_received < TOTAL_BLOCKS;
+    if (!session->sack_callback) {
+        return;
+    }
 
-        samples[i] = sample;
+    uint8_t messages[RESUME_MAX_MESSAGES * sizeof(resume_msg_t)];
+    size_t length = transfer_session_build_resume(session, messages, sizeof(messages));
+    for (size_t offset = 0; offset < length; offset += sizeof(resume_msg_t)) {
+        session->sack_callback(messages + offset, sizeof(resume_msg_t), session->sack_user_data);
     }
 }
 
-static bool process_uncompressed_block(const uint8_t* block_data, size_t block_size, waveform_data_t* waveform) {
-    if (block_size < WAVEFORM_HEADER_SIZE + 7128) {
+void parse_waveform_header(const uint8_t* data, waveform_header_t* header) {
+    read_waveform_header<PSOC_PROTOCOL_VERSION>(data, header);
+}
+
+static bool process_uncompressed_block(transfer_session_t* session, const uint8_t* block_data, size_t block_size,
+                                       waveform_data_t* waveform) {
+    (void)session;  // Only the metrics hooks read it
+    if (block_size < RAW_BLOCK_SIZE) {
         return false;
     }
 
     // Parse header
     parse_waveform_header(block_data, &waveform->header);
 
-    // Unpack 24-bit samples
+    // Unpack 24-bit samples and verify CRC in the same pass
+    METRICS_ONLY(uint64_t decode_start = metrics_now_ns();)
     const uint8_t* sample_data = block_data + WAVEFORM_HEADER_SIZE;
-    unpack_24bit_samples(sample_data, SAMPLES_PER_WAVEFORM, waveform->samples);
+    uint32_t calculated_crc = calculate_crc32_unpack_24bit(sample_data, SAMPLES_PER_WAVEFORM, waveform->samples);
+    METRICS_ONLY(metrics_record(&session->metrics.stages[METRICS_STAGE_DECODE], metrics_now_ns() - decode_start);)
+    if (calculated_crc != waveform->header.crc32) {
+        return false;
+    }
 
     return true;
 }
 
-static bool process_compressed_block(const uint8_t* block_data, size_t block_size, waveform_data_t* waveform) {
+static bool process_compressed_block(transfer_session_t* session, uint8_t codec, const uint8_t* block_data,
+                                     size_t block_size, waveform_data_t* waveform) {
+    (void)session;  // Only the metrics hooks read it
     if (block_size < WAVEFORM_HEADER_SIZE) {
         return false;
     }
@@ -149,12 +633,19 @@ static bool process_compressed_block(const uint8_t* block_data, size_t block_siz
     const uint8_t* compressed_data = block_data + WAVEFORM_HEADER_SIZE;
     size_t compressed_size = block_size - WAVEFORM_HEADER_SIZE;
 
-    if (!decompress_waveform(compressed_data, compressed_size, waveform->samples)) {
+    METRICS_ONLY(uint64_t decode_start = metrics_now_ns();)
+    bool decoded = (codec == BLOCK_CODEC_RICE)
+        ? decompress_waveform_rice(compressed_data, compressed_size, waveform->samples)
+        : decompress_waveform_zlib_delta(compressed_data, compressed_size, waveform->samples);
+    METRICS_ONLY(metrics_record(&session->metrics.stages[METRICS_STAGE_DECODE], metrics_now_ns() - decode_start);)
+    if (!decoded) {
         return false;
     }
 
     // Verify CRC
+    METRICS_ONLY(uint64_t crc_start = metrics_now_ns();)
     uint32_t calculated_crc = calculate_crc32_samples(waveform->samples, SAMPLES_PER_WAVEFORM);
+    METRICS_ONLY(metrics_record(&session->metrics.stages[METRICS_STAGE_CRC], metrics_now_ns() - crc_start);)
     if (calculated_crc != waveform->header.crc32) {
         return false;
     }
@@ -162,115 +653,957 @@ static bool process_compressed_block(const uint8_t* block_data, size_t block_siz
     return true;
 }
 
-bool transfer_session_process_chunk(transfer_session_t* session, const uint8_t* data, size_t length) {
-    if (length < 12) {
+// Decode according to the codec the firmware chose for this block
+static bool decode_block(transfer_session_t* session, uint8_t codec, const uint8_t* block_data, size_t block_size,
+                         waveform_data_t* waveform) {
+    switch (codec) {
+        case BLOCK_CODEC_RAW:
+            return process_uncompressed_block(session, block_data, block_size, waveform);
+        case BLOCK_CODEC_ZLIB_DELTA:
+        case BLOCK_CODEC_RICE:
+            return process_compressed_block(session, codec, block_data, block_size, waveform);
+        default:
+            return false;  // Codec from a newer firmware
+    }
+}
+
+// A zlib/delta block that has already been inflated chunk by chunk (slot_stream_chunks)
+static bool process_streamed_block(transfer_session_t* session, reassembly_slot* slot, waveform_data_t* waveform) {
+    (void)session;  // Only the metrics hooks read it
+    if (slot->bytes_received < WAVEFORM_HEADER_SIZE) {
         return false;
     }
 
-    // Parse chunk header
-    uint16_t block_number = data[0] | (data[1] << 8);
-    uint16_t chunk_number = data[2] | (data[3] << 8);
-    uint16_t chunk_size = data[4] | (data[5] << 8);
-    uint16_t total_chunks = data[6] | (data[7] << 8);
+    // Parse header
+    parse_waveform_header(slot->data, &waveform->header);
+
+    METRICS_ONLY(uint64_t decode_start = metrics_now_ns();)
+    bool decoded = delta_inflater_finish(slot->inflater, waveform->samples);
+    METRICS_ONLY(metrics_record(&session->metrics.stages[METRICS_STAGE_DECODE], metrics_now_ns() - decode_start);)
+    if (!decoded) {
+        return false;
+    }
 
-    // Validate block number
-    if (block_number >= TOTAL_BLOCKS) {
+    // Verify CRC
+    METRICS_ONLY(uint64_t crc_start = metrics_now_ns();)
+    uint32_t calculated_crc = calculate_crc32_samples(waveform->samples, SAMPLES_PER_WAVEFORM);
+    METRICS_ONLY(metrics_record(&session->metrics.stages[METRICS_STAGE_CRC], metrics_now_ns() - crc_start);)
+    if (calculated_crc != waveform->header.crc32) {
         return false;
     }
 
-    // Extract chunk data
-    std::vector<uint8_t> chunk_data(data + 12, data + 12 + chunk_size);
+    return true;
+}
+
+static bool is_block_received(const transfer_session_t* session, uint16_t block_number) {
+    return (session->block_bitmap[block_number / 64] >> (block_number % 64)) & 1;
+}
+
+static void slot_reset(reassembly_slot* slot, uint16_t block_number, uint16_t total_chunks, uint8_t codec,
+                       bool packed, bool stream) {
+    slot->in_use = true;
+    slot->block_number = block_number;
+    slot->total_chunks = total_chunks;
+    slot->codec = codec;
+    slot->chunks_received = 0;
+    slot->packed = packed;
+    slot->stride = 0;
+    slot->head_size = 0;
+    slot->tail_size = 0;
+    slot->tail_offset = 0;
+    slot->tail_parked = false;
+    slot->chunk_frontier = 0;
+    slot->bytes_received = 0;
+    memset(slot->chunk_bitmap, 0, sizeof(slot->chunk_bitmap));
 
-    // Store chunk
-    if (session->block_chunks.find(block_number) == session->block_chunks.end()) {
-        session->block_chunks[block_number] = std::map<uint16_t, std::vector<uint8_t>>();
-        session->block_expected_chunks[block_number] = total_chunks;
+    slot->streaming = false;
+    slot->stream_chunk = 0;
+    if (stream && codec == BLOCK_CODEC_ZLIB_DELTA && slot->inflater) {
+        delta_inflater_reset(slot->inflater);
+        slot->streaming = true;
     }
-    session->block_chunks[block_number][chunk_number] = chunk_data;
+}
 
-    session->total_chunks_received++;
-    session->total_bytes_received += chunk_size;
+static bool slot_has_chunk(const reassembly_slot* slot, uint16_t chunk_number) {
+    return (slot->chunk_bitmap[chunk_number / 64] >> (chunk_number % 64)) & 1;
+}
 
-    // Check if block is complete
-    if (session->block_chunks[block_number].size() == total_chunks) {
-        // Reassemble block
-        std::vector<uint8_t> block_data;
-        for (uint16_t i = 0; i < total_chunks; i++) {
-            const auto& chunk = session->block_chunks[block_number][i];
-            block_data.insert(block_data.end(), chunk.begin(), chunk.end());
+// Check a packed record's offset against the layout the block's other chunks
+// imply: chunk 0 gives the head size, a middle chunk the stride (and, from its
+// offset, the head size), and the last chunk where the tail starts.
+static bool slot_packed_layout_matches(const reassembly_slot* slot, uint16_t chunk_number, uint16_t chunk_size,
+                                       uint16_t chunk_offset) {
+    uint16_t last = slot->total_chunks - 1;
+    uint32_t head = slot->head_size;
+    uint32_t stride = slot->stride;
+    bool tail_known = slot->tail_size != 0;
+    uint32_t tail_offset = slot->tail_offset;
+
+    if (chunk_number == 0) {
+        if (chunk_offset != 0) {
+            return false;
+        }
+        if (chunk_number == last) {
+            return true;  // The whole block in one chunk
+        }
+        if (head != 0 && chunk_size != head) {
+            return false;
         }
+        head = chunk_size;
+    } else if (chunk_number < last) {
+        uint32_t before = (uint32_t)(chunk_number - 1) * chunk_size;
+        if (chunk_offset <= before) {
+            return false;  // Would leave no room for chunk 0
+        }
+        if ((stride != 0 && chunk_size != stride) || (head != 0 && chunk_offset - before != head)) {
+            return false;
+        }
+        head = chunk_offset - before;
+        stride = chunk_size;
+    } else {
+        if (tail_known && chunk_offset != tail_offset) {
+            return false;
+        }
+        tail_known = true;
+        tail_offset = chunk_offset;
+    }
 
-        // Process waveform
-        waveform_data_t waveform;
-        bool is_compressed = (block_data.size() < BLOCK_SIZE); // Heuristic: compressed blocks are smaller
-        bool success;
+    if (tail_known && head != 0 && (last == 1 || stride != 0)) {
+        return tail_offset == head + (uint32_t)(last - 1) * stride;
+    }
+    return true;
+}
+
+// Start of a received chunk in the slot buffer. Packed slots only know a chunk's
+// offset once the chunk itself (or, past chunk 0, a middle chunk) has arrived.
+static size_t slot_chunk_offset(const reassembly_slot* slot, uint16_t chunk_number) {
+    if (!slot->packed) {
+        return (size_t)chunk_number * slot->stride;
+    }
+    if (chunk_number == 0) {
+        return 0;
+    }
+    if (chunk_number == slot->total_chunks - 1) {
+        return slot->tail_offset;
+    }
+    return slot->head_size + (size_t)(chunk_number - 1) * slot->stride;
+}
+
+// Payload size of a received chunk
+static size_t slot_chunk_size(const reassembly_slot* slot, uint16_t chunk_number) {
+    if (chunk_number == slot->total_chunks - 1) {
+        return slot->tail_size;
+    }
+    if (slot->packed && chunk_number == 0) {
+        return slot->head_size;
+    }
+    return slot->stride;
+}
+
+// Find where a chunk payload belongs in the slot buffer without changing slot state.
+// Returns nullptr if the chunk is inconsistent with the rest of the block.
+// chunk_offset is only used for packed slots.
+static uint8_t* slot_chunk_destination(reassembly_slot* slot, uint16_t chunk_number, uint16_t chunk_size,
+                                       uint16_t chunk_offset) {
+    if (slot->packed) {
+        if (chunk_size == 0 || (size_t)chunk_offset + chunk_size > BLOCK_SIZE ||
+            !slot_packed_layout_matches(slot, chunk_number, chunk_size, chunk_offset)) {
+            return nullptr;
+        }
+        return slot->data + chunk_offset;
+    }
+
+    bool is_last = (chunk_number == slot->total_chunks - 1);
+    if (is_last) {
+        if (slot->stride == 0 && slot->total_chunks > 1) {
+            // Offset unknown until another chunk tells us the stride. Park the
+            // tail at the end of the buffer; it can never overlap other chunks there.
+            if (chunk_size > BLOCK_SIZE) {
+                return nullptr;
+            }
+            return slot->data + BLOCK_SIZE - chunk_size;
+        }
+        size_t offset = (size_t)chunk_number * slot->stride;
+        if (offset + chunk_size > BLOCK_SIZE) {
+            return nullptr;
+        }
+        return slot->data + offset;
+    }
 
-        if (is_compressed) {
-            success = process_compressed_block(block_data.data(), block_data.size(), &waveform);
+    if (slot->stride == 0) {
+        if (chunk_size == 0 || (size_t)(slot->total_chunks - 1) * chunk_size + slot->tail_size > BLOCK_SIZE) {
+            return nullptr;
+        }
+    } else if (chunk_size != slot->stride) {
+        return nullptr;
+    }
+    // The bound above keeps this clear of a parked tail
+    return slot->data + (size_t)chunk_number * chunk_size;
+}
+
+// Record a chunk whose payload has been written to slot_chunk_destination()
+static void slot_commit_chunk(reassembly_slot* slot, uint16_t chunk_number, uint16_t chunk_size,
+                              uint16_t chunk_offset) {
+    bool is_last = (chunk_number == slot->total_chunks - 1);
+    if (slot->packed) {
+        if (is_last) {
+            slot->tail_size = chunk_size;
+            slot->tail_offset = chunk_offset;
+        } else if (chunk_number == 0) {
+            slot->head_size = chunk_size;
         } else {
-            success = process_uncompressed_block(block_data.data(), block_data.size(), &waveform);
+            slot->stride = chunk_size;
+            slot->head_size = (uint16_t)(chunk_offset - (chunk_number - 1) * chunk_size);
+        }
+    } else if (is_last) {
+        slot->tail_parked = (slot->stride == 0 && slot->total_chunks > 1);
+        slot->tail_size = chunk_size;
+    } else {
+        slot->stride = chunk_size;
+        if (slot->tail_parked) {
+            memmove(slot->data + (size_t)(slot->total_chunks - 1) * slot->stride,
+                    slot->data + BLOCK_SIZE - slot->tail_size,
+                    slot->tail_size);
+            slot->tail_parked = false;
+        }
+    }
+
+    slot->chunk_bitmap[chunk_number / 64] |= 1ULL << (chunk_number % 64);
+    slot->chunks_received++;
+    slot->bytes_received += chunk_size;
+    if (chunk_number >= slot->chunk_frontier) {
+        slot->chunk_frontier = chunk_number + 1;
+    }
+}
+
+// Feed the inflater every chunk that now continues the received prefix of the
+// block, so a zlib/delta block is decoded by the time its last chunk lands.
+// Decode errors are reported by delta_inflater_finish() on completion.
+static void slot_stream_chunks(reassembly_slot* slot) {
+    if (!slot->streaming) {
+        return;
+    }
+
+    while (slot->stream_chunk < slot->total_chunks && slot_has_chunk(slot, slot->stream_chunk)) {
+        bool is_last = (slot->stream_chunk == slot->total_chunks - 1);
+        if (is_last && slot->tail_parked) {
+            break;  // Not at its final offset yet
         }
 
-        if (success && session->waveform_callback) {
-            session->waveform_callback(&waveform, is_compressed, session->waveform_user_data);
+        size_t start = slot_chunk_offset(slot, slot->stream_chunk);
+        size_t end = start + slot_chunk_size(slot, slot->stream_chunk);
+        if (start < WAVEFORM_HEADER_SIZE) {
+            start = WAVEFORM_HEADER_SIZE;  // The waveform header is not part of the stream
+        }
+        if (end > start) {
+            delta_inflater_feed(slot->inflater, slot->data + start, end - start);
         }
+        slot->stream_chunk++;
+    }
+}
+
+static void put_u16(uint8_t* p, uint16_t value) {
+    p[0] = (uint8_t)value;
+    p[1] = (uint8_t)(value >> 8);
+}
 
-        // Mark block as received
-        session->received_blocks[block_number] = block_data;
-        session->block_chunks.erase(block_number);
-        session->block_expected_chunks.erase(block_number);
+static void put_u32(uint8_t* p, uint32_t value) {
+    put_u16(p, (uint16_t)value);
+    put_u16(p + 2, (uint16_t)(value >> 16));
+}
 
-        // Send ACK if needed
-        bool should_ack = block_number > 0 && (block_number + 1) % ACK_INTERVAL == 0;
-        if (should_ack && session->ack_callback) {
-            session->ack_callback(block_number, session->ack_user_data);
+// Find the first missing chunk below limit and the missing ones in the bitmap
+// window after it. The link delivers notifications in order, so a chunk below
+// one that has arrived is lost rather than late.
+static bool slot_missing_chunks(const reassembly_slot* slot, uint16_t limit, uint16_t* first_chunk, uint32_t* missing) {
+    uint16_t chunk = 0;
+    while (chunk < limit && slot_has_chunk(slot, chunk)) {
+        chunk++;
+    }
+    if (chunk >= limit) {
+        return false;
+    }
+
+    uint32_t bits = 0;
+    for (uint16_t i = 0; i < SACK_CHUNKS_PER_ENTRY && chunk + i < limit; i++) {
+        if (!slot_has_chunk(slot, chunk + i)) {
+            bits |= 1U << i;
         }
+    }
+    *first_chunk = chunk;
+    *missing = bits;
+    return true;
+}
+
+size_t transfer_session_build_sack(const transfer_session_t* session, uint8_t* buffer, size_t capacity) {
+    if (capacity < sizeof(sack_msg_t)) {
+        return 0;
+    }
+
+    memset(buffer, 0, sizeof(sack_msg_t));
+    buffer[0] = CMD_SACK;
+    put_u16(buffer + 1, session->next_expected_block);
 
-        // Update progress
-        if (session->progress_callback) {
-            transfer_stats_t stats;
-            transfer_session_get_stats(session, &stats);
-            session->progress_callback(&stats, session->progress_user_data);
+    uint8_t entry_count = 0;
+    for (uint32_t block = session->next_expected_block;
+         block < session->block_frontier && entry_count < SACK_MAX_ENTRIES; block++) {
+        if (is_block_received(session, (uint16_t)block)) {
+            continue;
         }
 
-        // Check if transfer is complete
-        if (session->received_blocks.size() == TOTAL_BLOCKS) {
-            session->is_active = false;
-            if (session->completion_callback) {
-                transfer_stats_t stats;
-                transfer_session_get_stats(session, &stats);
-                session->completion_callback(&stats, session->completion_user_data);
+        // A block with no slot was lost entirely; the firmware clips the bitmap
+        // to the real chunk count.
+        uint16_t first_chunk = 0;
+        uint32_t missing = 0xFFFFFFFFU;
+        const reassembly_slot* slot = &session->slots[block % REASSEMBLY_SLOT_COUNT];
+        if (slot->in_use && slot->block_number == block) {
+            bool is_newest = (block + 1 == session->block_frontier);
+            uint16_t limit = is_newest ? slot->chunk_frontier : slot->total_chunks;
+            if (!slot_missing_chunks(slot, limit, &first_chunk, &missing)) {
+                continue;  // Nothing known to be lost yet
             }
         }
+
+        uint8_t* entry = buffer + offsetof(sack_msg_t, entries) + entry_count * sizeof(sack_entry_t);
+        put_u16(entry, (uint16_t)block);
+        put_u16(entry + 2, first_chunk);
+        put_u32(entry + 4, missing);
+        entry_count++;
     }
+    buffer[offsetof(sack_msg_t, entry_count)] = entry_count;
 
-    return true;
+    return sizeof(sack_msg_t);
 }
 
-void transfer_session_get_stats(const transfer_session_t* session, transfer_stats_t* stats) {
-    stats->blocks_received = session->received_blocks.size();
-    stats->total_blocks = TOTAL_BLOCKS;
-    stats->total_bytes_received = session->total_bytes_received;
-    stats->total_chunks_received = session->total_chunks_received;
+size_t transfer_session_build_resume(const transfer_session_t* session, uint8_t* buffer, size_t capacity) {
+    if (capacity < RESUME_MAX_MESSAGES * sizeof(resume_msg_t)) {
+        return 0;
+    }
+
+    // Blocks completed past the first missing one
+    uint32_t received_blocks = 0;
+    for (uint32_t i = 0; i < RESUME_BLOCKS_PER_MESSAGE; i++) {
+        uint32_t block = session->next_expected_block + 1 + i;
+        if (block < TOTAL_BLOCKS && is_block_received(session, (uint16_t)block)) {
+            received_blocks |= 1U << i;
+        }
+    }
 
-    if (session->is_active) {
-        auto now = std::chrono::steady_clock::now();
-        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - session->start_time);
-        stats->elapsed_seconds = elapsed.count() / 1000.0;
+    size_t count = 0;
+    for (uint32_t block = session->next_expected_block;
+         block < session->block_frontier && count < RESUME_MAX_MESSAGES; block++) {
+        // Chunk numbers only mean something to the sender once the stride is known
+        const reassembly_slot* slot = &session->slots[block % REASSEMBLY_SLOT_COUNT];
+        if (!slot->in_use || slot->block_number != block || slot->stride == 0) {
+            continue;
+        }
 
-        if (stats->elapsed_seconds > 0) {
-            stats->throughput_kbps = (stats->total_bytes_received / stats->elapsed_seconds) / 1000.0;
-        } else {
-            stats->throughput_kbps = 0.0;
+        uint16_t first_chunk = 0;
+        uint32_t missing = 0;
+        if (!slot_missing_chunks(slot, slot->total_chunks, &first_chunk, &missing)) {
+            continue;
+        }
+
+        uint8_t* message = buffer + count * sizeof(resume_msg_t);
+        memset(message, 0, sizeof(resume_msg_t));
+        put_u16(message + offsetof(resume_msg_t, chunk_size), slot->stride);
+        put_u16(message + offsetof(resume_msg_t, total_chunks), slot->total_chunks);
+        message[offsetof(resume_msg_t, entry_count)] = 1;
+        uint8_t* entry = message + offsetof(resume_msg_t, entry);
+        put_u16(entry, (uint16_t)block);
+        put_u16(entry + 2, first_chunk);
+        put_u32(entry + 4, missing);
+        count++;
+    }
+    if (count == 0) {
+        memset(buffer, 0, sizeof(resume_msg_t));
+        count = 1;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        uint8_t* message = buffer + i * sizeof(resume_msg_t);
+        message[0] = CMD_RESUME;
+        put_u16(message + offsetof(resume_msg_t, cumulative_block), session->next_expected_block);
+        put_u32(message + offsetof(resume_msg_t, received_blocks), received_blocks);
+    }
+    return count * sizeof(resume_msg_t);
+}
+
+static void send_sack(transfer_session_t* session) {
+    uint8_t message[sizeof(sack_msg_t)];
+    size_t length = transfer_session_build_sack(session, message, sizeof(message));
+    session->sack_callback(message, length, session->sack_user_data);
+}
+
+static decode_job* acquire_job(transfer_session_t* session) {
+    if (!session->spare_jobs) {
+        session->spare_jobs = session->free_jobs.exchange(nullptr, std::memory_order_acquire);
+    }
+    decode_job* job = session->spare_jobs;
+    if (job) {
+        session->spare_jobs = job->next.load(std::memory_order_relaxed);
+    } else {
+        job = new decode_job();  // Workers are behind; the list grows instead of blocking ingest
+    }
+    job->next.store(nullptr, std::memory_order_relaxed);
+    return job;
+}
+
+static void release_job(transfer_session_t* session, decode_job* job) {
+    decode_job* head = session->free_jobs.load(std::memory_order_relaxed);
+    do {
+        job->next.store(head, std::memory_order_relaxed);
+    } while (!session->free_jobs.compare_exchange_weak(head, job, std::memory_order_release,
+                                                       std::memory_order_relaxed));
+}
+
+static void queue_job(transfer_session_t* session, decode_job* job) {
+    session->jobs_pending.fetch_add(1);
+    session->queue_tail->next.store(job);
+    session->queue_tail = job;
+    if (!session->strand_scheduled.exchange(true)) {
+        worker_pool_submit(&session->strand);
+    }
+}
+
+// Where the next waveform is decoded: the free ring entry, or the caller's
+// buffer when there is no ring. nullptr if the ring is full; the waveform is
+// then dropped without being decoded.
+static waveform_data_t* begin_waveform(transfer_session_t* session, waveform_data_t* local) {
+    if (!session->ring) {
+        return local;
+    }
+    uint32_t head = session->ring_head.load(std::memory_order_relaxed);
+    if (head - session->ring_tail.load(std::memory_order_acquire) > session->ring_mask) {
+        session->ring_dropped.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+    return &session->ring[head & session->ring_mask].waveform;
+}
+
+// Publish a waveform decoded into begin_waveform()'s buffer
+static void finish_waveform(transfer_session_t* session, waveform_data_t* waveform, bool is_compressed) {
+    METRICS_ONLY(uint64_t callback_start = metrics_now_ns();)
+    if (session->summary_callback) {
+        waveform_summary_t summary;
+        uint16_t width = session->summary_config.envelope_width;
+        waveform_summarize(waveform, &session->summary_config, session->envelope,
+                           session->envelope + width, &summary);
+        summary.is_compressed = is_compressed;
+        session->summary_callback(&summary, session->summary_user_data);
+    }
+    if (session->ring) {
+        uint32_t head = session->ring_head.load(std::memory_order_relaxed);
+        session->ring[head & session->ring_mask].is_compressed = is_compressed;
+        session->ring_head.store(head + 1, std::memory_order_release);
+    } else if (session->waveform_callback) {
+        session->waveform_callback(waveform, is_compressed, session->waveform_user_data);
+    }
+    METRICS_ONLY(metrics_record(&session->metrics.stages[METRICS_STAGE_CALLBACK], metrics_now_ns() - callback_start);)
+}
+
+// Hand a completed block to the lazy waveform callback without decoding it
+static void deliver_lazy(transfer_session_t* session, uint16_t block_number, uint8_t codec, const uint8_t* data,
+                         size_t size) {
+    if (size < WAVEFORM_HEADER_SIZE) {
+        return;
+    }
+    METRICS_ONLY(uint64_t callback_start = metrics_now_ns();)
+    waveform_handle_t handle;
+    parse_waveform_header(data, &handle.header);
+    handle.is_compressed = codec != BLOCK_CODEC_RAW;
+    handle.block.block_number = block_number;
+    handle.block.codec = codec;
+    handle.block.timestamp_ms = handle.header.timestamp_ms;
+    handle.block.data = data;
+    handle.block.size = size;
+    handle.block.payload = data + WAVEFORM_HEADER_SIZE;
+    handle.block.payload_size = size - WAVEFORM_HEADER_SIZE;
+    session->lazy_callback(&handle, session->lazy_user_data);
+    METRICS_ONLY(metrics_record(&session->metrics.stages[METRICS_STAGE_CALLBACK], metrics_now_ns() - callback_start);)
+}
+
+static void deliver_job(transfer_session_t* session, const decode_job* job) {
+    if (session->lazy_callback) {
+        deliver_lazy(session, job->block_number, job->codec, job->data, job->size);
+    } else {
+        waveform_data_t local;
+        waveform_data_t* waveform = begin_waveform(session, &local);
+        if (waveform && decode_block(session, job->codec, job->data, job->size, waveform)) {
+            finish_waveform(session, waveform, job->codec != BLOCK_CODEC_RAW);
+        }
+    }
+    if (job->report_progress) {
+        session->progress_callback(&job->stats, session->progress_user_data);
+    }
+    if (job->completes_transfer && session->completion_callback) {
+        session->completion_callback(&job->stats, session->completion_user_data);
+    }
+}
+
+static bool run_decode_strand(pool_task* task) {
+    transfer_session_t* session = static_cast<decode_strand*>(task)->session;
+    session->strand_active.fetch_add(1);
+
+    for (size_t i = 0; i < STRAND_BATCH_BLOCKS; i++) {
+        decode_job* job = session->queue_head->next.load(std::memory_order_acquire);
+        if (!job) {
+            break;
+        }
+        deliver_job(session, job);
+        release_job(session, session->queue_head);
+        session->queue_head = job;
+        session->jobs_pending.fetch_sub(1);
+    }
+
+    bool more = session->queue_head->next.load() != nullptr;
+    if (!more) {
+        // A block queued after the check above saw us still scheduled; take it back
+        session->strand_scheduled.store(false);
+        more = session->queue_head->next.load() != nullptr && !session->strand_scheduled.exchange(true);
+    }
+
+    // Last access to the session: transfer_session_destroy() may free it after this
+    session->strand_active.fetch_sub(1);
+    return more;
+}
+
+// Decode a completed block on the ingest thread and deliver it
+static void deliver_slot(transfer_session_t* session, reassembly_slot* slot) {
+    if (session->lazy_callback) {
+        deliver_lazy(session, slot->block_number, slot->codec, slot->data, slot->bytes_received);
+        return;
+    }
+
+    waveform_data_t local;
+    waveform_data_t* waveform = begin_waveform(session, &local);
+    if (!waveform) {
+        return;
+    }
+
+    bool success = slot->streaming
+        ? process_streamed_block(session, slot, waveform)
+        : decode_block(session, slot->codec, slot->data, slot->bytes_received, waveform);
+    if (success) {
+        finish_waveform(session, waveform, slot->codec != BLOCK_CODEC_RAW);
+    }
+}
+
+static void handle_completed_block(transfer_session_t* session, reassembly_slot* slot) {
+    uint16_t block_number = slot->block_number;
+
+    if (session->archive) {
+        capture_writer_append(session->archive, slot->data, slot->bytes_received, slot->codec);
+    }
+
+    // With workers, copy the block out: the slot is needed again within the send window
+    decode_job* job = nullptr;
+    if (session->background_decode) {
+        job = acquire_job(session);
+        job->block_number = slot->block_number;
+        job->codec = slot->codec;
+        job->size = slot->bytes_received;
+        memcpy(job->data, slot->data, slot->bytes_received);
+    } else {
+        deliver_slot(session, slot);
+    }
+
+    // Mark block as received and hand the slot back for reuse
+    session->block_bitmap[block_number / 64] |= 1ULL << (block_number % 64);
+    session->blocks_received++;
+    slot->in_use = false;
+    while (session->next_expected_block < TOTAL_BLOCKS && is_block_received(session, session->next_expected_block)) {
+        session->next_expected_block++;
+    }
+
+    // Acknowledge: a SACK for every block, or a plain ACK every ACK_INTERVAL blocks.
+    // Filling a gap can also carry the cumulative block past a boundary whose
+    // block arrived earlier (e.g. blocks skipped on resume); acknowledge that too.
+    if (session->sack_callback) {
+        send_sack(session);
+    } else if (session->ack_callback) {
+        uint16_t ack_block = block_number;
+        bool should_ack = block_number > 0 && (block_number + 1) % ACK_INTERVAL == 0;
+        if (session->next_expected_block - 1 > block_number &&
+            session->next_expected_block / ACK_INTERVAL > (block_number + 1) / ACK_INTERVAL) {
+            ack_block = session->next_expected_block - 1;
+            should_ack = true;
+        }
+        if (should_ack) {
+            session->ack_callback(ack_block, session->ack_user_data);
+        }
+    }
+
+    auto now = update_stats(session);
+    bool report_progress = session->progress_callback && progress_due(session, now);
+    bool transfer_complete = (session->blocks_received == TOTAL_BLOCKS);
+    if (transfer_complete) {
+        session->is_active = false;
+    }
+
+    if (job) {
+        job->stats = session->stats;
+        job->report_progress = report_progress;
+        job->completes_transfer = transfer_complete;
+        queue_job(session, job);
+        return;
+    }
+
+    // Update progress
+    if (report_progress) {
+        session->progress_callback(&session->stats, session->progress_user_data);
+    }
+
+    // Check if transfer is complete
+    if (transfer_complete && session->completion_callback) {
+        session->completion_callback(&session->stats, session->completion_user_data);
+    }
+}
+
+// Read the chunk header at the start of a notification.
+// Returns false if the notification is too short for it or its payload.
+static bool parse_chunk_header(const uint8_t* data, size_t length, chunk_record* record) {
+    if (length < current_wire_layout::chunk_header_size) {
+        return false;
+    }
+
+    current_wire_layout::chunk_header chunk = read_chunk_header<PSOC_PROTOCOL_VERSION>(data);
+    record->block_number = chunk.block_number;
+    record->chunk_number = chunk.chunk_number;
+    record->chunk_size = chunk.chunk_size;
+    record->total_chunks = chunk.total_chunks;
+    record->chunk_offset = 0;
+    record->codec = chunk.flags & CHUNK_FLAGS_CODEC_MASK;
+    record->packed = false;
+    return current_wire_layout::chunk_header_size + record->chunk_size <= length;
+}
+
+// Read the packed record at the start of data (the rest of the notification).
+// Returns the bytes before its payload, or 0 if it is malformed; *more is set
+// when another record follows the payload.
+static size_t parse_packed_record(const uint8_t* data, size_t length, chunk_record* record, bool* more) {
+    size_t header_size = current_wire_layout::packed_record_header_size;
+    if (length < header_size) {
+        return 0;
+    }
+
+    current_wire_layout::packed_record_header header = read_packed_record_header<PSOC_PROTOCOL_VERSION>(data);
+    if (!(header.block_word & PACKED_RECORD_MARKER)) {
+        return 0;
+    }
+    record->block_number = header.block_word & PACKED_RECORD_BLOCK_MASK;
+    record->codec = (header.block_word >> PACKED_RECORD_CODEC_SHIFT) & PACKED_RECORD_CODEC_MASK;
+    record->chunk_number = header.chunk_word & PACKED_RECORD_CHUNK_MASK;
+    record->total_chunks = header.total_chunks;
+    record->chunk_offset = header.chunk_offset;
+    record->packed = true;
+
+    *more = (header.chunk_word & PACKED_RECORD_MORE) != 0;
+    size_t payload_size;
+    if (*more) {
+        if (length < header_size + PACKED_RECORD_LENGTH_SIZE) {
+            return 0;
         }
+        payload_size = data[header_size] | (data[header_size + 1] << 8);
+        header_size += PACKED_RECORD_LENGTH_SIZE;
     } else {
-        stats->elapsed_seconds = 0.0;
-        stats->throughput_kbps = 0.0;
+        payload_size = length - header_size;
+    }
+    if (header_size + payload_size > length || payload_size > UINT16_MAX) {
+        return 0;
+    }
+    record->chunk_size = (uint16_t)payload_size;
+    return header_size;
+}
+
+// Header checks that do not depend on reassembly state
+static bool chunk_record_valid(const chunk_record& record) {
+    return record.block_number < TOTAL_BLOCKS && record.total_chunks > 0 &&
+           record.total_chunks <= MAX_CHUNKS_PER_BLOCK && record.chunk_number < record.total_chunks;
+}
+
+// Whether a chunk belongs to the partial block in the slot. A chunk of another
+// block, or of a copy sent in another codec, framing or chunk layout
+// (generated again, or a new MTU, after a reconnect), starts the slot over.
+static bool slot_continues_block(const reassembly_slot* slot, const chunk_record& record) {
+    if (!slot->in_use || slot->block_number != record.block_number || slot->total_chunks != record.total_chunks ||
+        slot->codec != record.codec || slot->packed != record.packed) {
+        return false;
+    }
+    if (record.packed) {
+        return slot_packed_layout_matches(slot, record.chunk_number, record.chunk_size, record.chunk_offset);
+    }
+    return slot->stride == 0 || record.chunk_number == record.total_chunks - 1 || record.chunk_size == slot->stride;
+}
+
+// Validate a chunk and reserve the payload destination.
+// Sets *valid to false for malformed chunks; returns nullptr for anything that
+// must not be written (malformed, duplicate, or block already delivered).
+static uint8_t* begin_chunk(transfer_session_t* session, const chunk_record& record, bool* valid) {
+    *valid = false;
+    session->pending_slot = nullptr;
+
+    uint16_t block_number = record.block_number;
+    uint16_t chunk_number = record.chunk_number;
+
+    if (!chunk_record_valid(record)) {
+        return nullptr;
+    }
+
+    if (block_number >= session->block_frontier) {
+        session->block_frontier = block_number + 1;
+    }
+
+    // Ignore retransmitted chunks of blocks we already delivered. The sender
+    // only repeats those if our last SACK was lost, so answer with a fresh one.
+    if (is_block_received(session, block_number)) {
+        METRICS_ONLY(metrics_count(&session->metrics.duplicate_chunks);)
+        *valid = true;
+        if (session->sack_callback) {
+            send_sack(session);
+        }
+        return nullptr;
+    }
+
+    // Claim the slot for this block; a stale partial block in it is dropped, as
+    // is a partial copy of this one in another layout
+    reassembly_slot* slot = &session->slots[block_number % REASSEMBLY_SLOT_COUNT];
+    if (!slot_continues_block(slot, record)) {
+        // Workers decode in one go; inline delivery decodes zlib as it arrives,
+        // unless the block is delivered undecoded
+        slot_reset(slot, block_number, record.total_chunks, record.codec, record.packed,
+                   !session->background_decode && !session->lazy_callback);
+        METRICS_ONLY(slot->first_chunk_ns = session->pending_arrival_ns;)
+
+        // The previous block's tail never arrived; report it now
+        bool previous_incomplete = block_number > session->next_expected_block &&
+                                   !is_block_received(session, block_number - 1);
+        if (previous_incomplete && session->sack_callback) {
+            send_sack(session);
+        }
+    }
+
+    if (slot_has_chunk(slot, chunk_number)) {
+        METRICS_ONLY(metrics_count(&session->metrics.duplicate_chunks);)
+        *valid = true;
+        if (session->sack_callback) {
+            send_sack(session);  // Retransmit probe for a block we are still missing chunks of
+        }
+        return nullptr;  // Duplicate
+    }
+
+    uint8_t* dest = slot_chunk_destination(slot, chunk_number, record.chunk_size, record.chunk_offset);
+    if (!dest) {
+        return nullptr;
+    }
+
+    METRICS_ONLY(
+        if (chunk_number < slot->chunk_frontier) {
+            metrics_count(&session->metrics.out_of_order_chunks);
+        }
+    )
+
+    *valid = true;
+    session->pending_slot = slot;
+    session->pending_chunk = chunk_number;
+    session->pending_size = record.chunk_size;
+    session->pending_offset = record.chunk_offset;
+    return dest;
+}
+
+// begin_chunk() plus its share of the ingest timing
+static uint8_t* timed_begin_chunk(transfer_session_t* session, const chunk_record& record, bool* valid) {
+#if PSOC_DRIVER_METRICS
+    uint64_t arrival = metrics_now_ns();
+    metrics_chunk_arrived(&session->metrics, arrival);
+    session->pending_arrival_ns = arrival;
+
+    uint8_t* dest = begin_chunk(session, record, valid);
+    uint64_t elapsed = metrics_now_ns() - arrival;
+    if (dest) {
+        session->pending_ingest_ns = elapsed;  // Completed by transfer_session_commit_chunk()
+    } else {
+        metrics_record(&session->metrics.stages[METRICS_STAGE_CHUNK_INGEST], elapsed);
+    }
+    return dest;
+#else
+    return begin_chunk(session, record, valid);
+#endif
+}
+
+uint8_t* transfer_session_begin_chunk(transfer_session_t* session, const uint8_t* header, size_t length,
+                                      size_t* payload_size) {
+    // A packed record's marker bit reads as an out-of-range block number here
+    chunk_record record;
+    bool valid;
+    uint8_t* dest = nullptr;
+    if (parse_chunk_header(header, length, &record)) {
+        dest = timed_begin_chunk(session, record, &valid);
+    }
+    if (payload_size) {
+        *payload_size = dest ? session->pending_size : 0;
+    }
+    return dest;
+}
+
+void transfer_session_commit_chunk(transfer_session_t* session) {
+    reassembly_slot* slot = session->pending_slot;
+    if (!slot) {
+        return;
+    }
+    session->pending_slot = nullptr;
+
+    METRICS_ONLY(uint64_t commit_start = metrics_now_ns();)
+    slot_commit_chunk(slot, session->pending_chunk, session->pending_size, session->pending_offset);
+    slot_stream_chunks(slot);
+
+    session->total_chunks_received++;
+    session->total_bytes_received += session->pending_size;
+    METRICS_ONLY(
+        metrics_record(&session->metrics.stages[METRICS_STAGE_CHUNK_INGEST],
+                       session->pending_ingest_ns + (metrics_now_ns() - commit_start));
+    )
+
+    // Check if block is complete
+    if (slot->chunks_received == slot->total_chunks) {
+        METRICS_ONLY(
+            metrics_record(&session->metrics.stages[METRICS_STAGE_BLOCK_ASSEMBLY],
+                           session->pending_arrival_ns - slot->first_chunk_ns);
+        )
+        handle_completed_block(session, slot);
+    } else if (session->pending_chunk == slot->total_chunks - 1 && session->sack_callback) {
+        send_sack(session);  // Last chunk arrived but earlier ones are missing
     }
+}
 
-    stats->progress_percent = (stats->blocks_received * 100.0) / stats->total_blocks;
+// Copy one chunk's payload into its slot and commit it
+static bool ingest_chunk(transfer_session_t* session, const chunk_record& record, const uint8_t* payload) {
+    bool valid;
+    uint8_t* dest = timed_begin_chunk(session, record, &valid);
+    if (dest) {
+        memcpy(dest, payload, session->pending_size);
+        transfer_session_commit_chunk(session);
+    }
+    return valid;
+}
+
+static bool visit_ingest_chunk(void* context, const chunk_record& record, const uint8_t* payload) {
+    return ingest_chunk(static_cast<transfer_session_t*>(context), record, payload);
+}
+
+bool visit_notification_chunks(const uint8_t* data, size_t length, chunk_visitor_t visit, void* context) {
+    chunk_record record;
+    bool packed = length >= 2 && ((data[1] << 8) & PACKED_RECORD_MARKER);
+    if (!packed) {
+        return parse_chunk_header(data, length, &record) &&
+               visit(context, record, data + current_wire_layout::chunk_header_size);
+    }
+
+    // Records follow each other; a malformed one leaves the rest unparseable
+    bool more = true;
+    while (more) {
+        size_t header_size = parse_packed_record(data, length, &record, &more);
+        if (header_size == 0 || !visit(context, record, data + header_size)) {
+            return false;
+        }
+        size_t record_size = header_size + record.chunk_size;
+        data += record_size;
+        length -= record_size;
+    }
+    return true;
+}
+
+bool transfer_session_process_chunk(transfer_session_t* session, const uint8_t* data, size_t length) {
+    return visit_notification_chunks(data, length, visit_ingest_chunk, session);
+}
+
+void transfer_session_get_stats(const transfer_session_t* session, transfer_stats_t* stats) {
+    const published_stats* published = &session->published;
+    uint32_t sequence;
+    do {
+        sequence = published->sequence.load(std::memory_order_acquire);
+        stats->blocks_received = published->blocks_received.load(std::memory_order_relaxed);
+        stats->total_bytes_received = published->total_bytes_received.load(std::memory_order_relaxed);
+        stats->total_chunks_received = published->total_chunks_received.load(std::memory_order_relaxed);
+        stats->throughput_kbps = published->throughput_kbps.load(std::memory_order_relaxed);
+        stats->progress_percent = published->progress_percent.load(std::memory_order_relaxed);
+        stats->elapsed_seconds = published->elapsed_seconds.load(std::memory_order_relaxed);
+        stats->ewma_throughput_kbps = published->ewma_throughput_kbps.load(std::memory_order_relaxed);
+        stats->instant_throughput_kbps = published->instant_throughput_kbps.load(std::memory_order_relaxed);
+        stats->eta_seconds = published->eta_seconds.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+    } while ((sequence & 1) || published->sequence.load(std::memory_order_relaxed) != sequence);
+    stats->total_blocks = TOTAL_BLOCKS;
+}
+
+bool transfer_session_get_metrics(const transfer_session_t* session, transfer_metrics_t* metrics) {
+#if PSOC_DRIVER_METRICS
+    metrics_export(&session->metrics, metrics);
+    return true;
+#else
+    (void)session;
+    memset(metrics, 0, sizeof(*metrics));
+    return false;
+#endif
 }
 
 bool transfer_session_is_active(const transfer_session_t* session) {
     return session->is_active;
 }
+
+/* ---- Single-block reassembly (block_assembler.h) ---- */
+
+struct block_assembler {
+    reassembly_slot slot;
+};
+
+block_assembler* block_assembler_create(void) {
+    block_assembler* assembler = new (std::nothrow) block_assembler();
+    if (assembler) {
+        assembler->slot.in_use = false;
+        assembler->slot.inflater = nullptr;  // Blocks are decoded whole, never streamed
+    }
+    return assembler;
+}
+
+void block_assembler_destroy(block_assembler* assembler) {
+    delete assembler;
+}
+
+void block_assembler_reset(block_assembler* assembler) {
+    assembler->slot.in_use = false;
+}
+
+bool block_assembler_add(block_assembler* assembler, const chunk_record& record, const uint8_t* payload) {
+    reassembly_slot* slot = &assembler->slot;
+    if (slot->in_use && slot->chunks_received == slot->total_chunks) {
+        return true;
+    }
+    if (!chunk_record_valid(record)) {
+        return false;
+    }
+
+    if (!slot_continues_block(slot, record)) {
+        slot_reset(slot, record.block_number, record.total_chunks, record.codec, record.packed, false);
+    }
+    if (slot_has_chunk(slot, record.chunk_number)) {
+        return false;
+    }
+    uint8_t* dest = slot_chunk_destination(slot, record.chunk_number, record.chunk_size, record.chunk_offset);
+    if (!dest) {
+        return false;
+    }
+    memcpy(dest, payload, record.chunk_size);
+    slot_commit_chunk(slot, record.chunk_number, record.chunk_size, record.chunk_offset);
+    return slot->chunks_received == slot->total_chunks;
+}
+
+const uint8_t* block_assembler_block(const block_assembler* assembler, size_t* size, uint8_t* codec) {
+    const reassembly_slot* slot = &assembler->slot;
+    if (!slot->in_use || slot->chunks_received != slot->total_chunks) {
+        return nullptr;
+    }
+    *size = slot->bytes_received;
+    *codec = slot->codec;
+    return slot->data;
+}
@@ -0,0 +1,148 @@
+#include "psoc_driver/waveform_summary.h"
+#include "psoc_driver/protocol.h"
+#include "psoc_driver/sample_unpack.h"
+#include <cstring>
+
+// Echo detection looks at the peak of bins of this many samples first and
+// only scans single samples in the bins that start, end or peak an echo
+static const size_t ECHO_BIN_SAMPLES = 8;
+static const size_t MAX_ECHO_BINS = (SAMPLES_PER_WAVEFORM + ECHO_BIN_SAMPLES - 1) / ECHO_BIN_SAMPLES;
+
+namespace {
+
+struct echo_detector {
+    const int32_t* samples;
+    size_t count;
+    size_t bins;
+    int64_t threshold;
+    float us_per_sample;
+    waveform_summary_t* summary;
+};
+
+}
+
+static size_t bin_start(const echo_detector* d, size_t bin) {
+    return bin * d->count / d->bins;
+}
+
+static int64_t magnitude(int32_t sample) {
+    return sample < 0 ? -(int64_t)sample : (int64_t)sample;
+}
+
+// Record the echo spanning bins first_bin to last_bin, whose peak is in peak_bin.
+// Only the WAVEFORM_SUMMARY_MAX_ECHOES strongest are kept.
+static void add_echo(const echo_detector* d, size_t first_bin, size_t last_bin, size_t peak_bin) {
+    waveform_echo_t echo;
+    size_t start = bin_start(d, first_bin);
+    while (magnitude(d->samples[start]) <= d->threshold) {
+        start++;
+    }
+    size_t end = bin_start(d, last_bin + 1) - 1;
+    while (magnitude(d->samples[end]) <= d->threshold) {
+        end--;
+    }
+    size_t peak = bin_start(d, peak_bin);
+    for (size_t i = peak + 1; i < bin_start(d, peak_bin + 1); i++) {
+        if (magnitude(d->samples[i]) > magnitude(d->samples[peak])) {
+            peak = i;
+        }
+    }
+    echo.sample_index = (uint16_t)peak;
+    echo.start_sample = (uint16_t)start;
+    echo.end_sample = (uint16_t)end;
+    echo.amplitude = d->samples[peak];
+    echo.time_us = (float)peak * d->us_per_sample;
+
+    waveform_summary_t* summary = d->summary;
+    if (summary->echo_count < WAVEFORM_SUMMARY_MAX_ECHOES) {
+        summary->echoes[summary->echo_count++] = echo;
+        return;
+    }
+    uint32_t weakest = 0;
+    for (uint32_t i = 1; i < summary->echo_count; i++) {
+        if (magnitude(summary->echoes[i].amplitude) < magnitude(summary->echoes[weakest].amplitude)) {
+            weakest = i;
+        }
+    }
+    if (magnitude(echo.amplitude) > magnitude(summary->echoes[weakest].amplitude)) {
+        // Keep time order: close the gap, then append
+        memmove(&summary->echoes[weakest], &summary->echoes[weakest + 1],
+                (summary->echo_count - weakest - 1) * sizeof(waveform_echo_t));
+        summary->echoes[summary->echo_count - 1] = echo;
+    }
+}
+
+static void detect_echoes(echo_detector* d, const int32_t* bin_min, const int32_t* bin_max, size_t min_gap) {
+    bool open = false;
+    size_t first_bin = 0, last_bin = 0, peak_bin = 0;
+    int64_t peak = 0;
+    for (size_t bin = 0; bin < d->bins; bin++) {
+        int64_t bin_peak = magnitude(bin_max[bin]) > magnitude(bin_min[bin])
+            ? magnitude(bin_max[bin]) : magnitude(bin_min[bin]);
+        if (bin_peak <= d->threshold) {
+            continue;
+        }
+        // Gaps are measured between bins, so to within one bin of samples
+        if (open && bin_start(d, bin) - bin_start(d, last_bin + 1) >= min_gap) {
+            add_echo(d, first_bin, last_bin, peak_bin);
+            open = false;
+        }
+        if (!open) {
+            open = true;
+            first_bin = bin;
+            peak_bin = bin;
+            peak = bin_peak;
+        } else if (bin_peak > peak) {
+            peak_bin = bin;
+            peak = bin_peak;
+        }
+        last_bin = bin;
+    }
+    if (open) {
+        add_echo(d, first_bin, last_bin, peak_bin);
+    }
+}
+
+void waveform_summarize(const waveform_data_t* waveform, const waveform_summary_config_t* config,
+                        int32_t* envelope_min, int32_t* envelope_max, waveform_summary_t* summary) {
+    size_t count = waveform->header.sample_count;
+    if (count == 0 || count > SAMPLES_PER_WAVEFORM) {
+        count = SAMPLES_PER_WAVEFORM;
+    }
+    size_t width = config ? config->envelope_width : 0;
+    if (width > count) {
+        width = count;
+    }
+    int32_t threshold = config && config->echo_threshold > 0 ? config->echo_threshold : WAVEFORM_SUMMARY_DEFAULT_THRESHOLD;
+    size_t min_gap = config && config->echo_min_gap ? config->echo_min_gap : WAVEFORM_SUMMARY_DEFAULT_MIN_GAP;
+
+    summary->header = waveform->header;
+    summary->is_compressed = false;
+    summary->echo_count = 0;
+    summary->envelope_width = (uint16_t)width;
+    summary->envelope_min = width ? envelope_min : nullptr;
+    summary->envelope_max = width ? envelope_max : nullptr;
+    summary->waveform = waveform;
+    if (width) {
+        samples_min_max_columns(waveform->samples, count, width, envelope_min, envelope_max);
+    }
+
+    int32_t bin_min[MAX_ECHO_BINS];
+    int32_t bin_max[MAX_ECHO_BINS];
+    echo_detector detector;
+    detector.samples = waveform->samples;
+    detector.count = count;
+    detector.bins = (count + ECHO_BIN_SAMPLES - 1) / ECHO_BIN_SAMPLES;
+    detector.threshold = threshold;
+    detector.us_per_sample = waveform->header.sample_rate_hz ? 1e6f / (float)waveform->header.sample_rate_hz : 0.0f;
+    detector.summary = summary;
+    samples_min_max_columns(waveform->samples, count, detector.bins, bin_min, bin_max);
+
+    summary->min_sample = bin_min[0];
+    summary->max_sample = bin_max[0];
+    for (size_t bin = 1; bin < detector.bins; bin++) {
+        summary->min_sample = bin_min[bin] < summary->min_sample ? bin_min[bin] : summary->min_sample;
+        summary->max_sample = bin_max[bin] > summary->max_sample ? bin_max[bin] : summary->max_sample;
+    }
+    detect_echoes(&detector, bin_min, bin_max, min_gap);
+}
@@ -0,0 +1,80 @@
+#ifndef PSOC_WIRE_LAYOUT_H
+#define PSOC_WIRE_LAYOUT_H
+
+#include "psoc_driver/protocol.h"
+#include "psoc_driver/data_types.h"
+#include <cstring>
+
+// Compile-time view of the wire format (wire_format.h) for the driver's
+// parsers. Each protocol version is a specialization of wire_layout naming the
+// structs that match it byte for byte, so reading a header is one copy of the
+// packed struct instead of per-byte decoding; a new version adds a
+// specialization rather than branches in the per-chunk path.
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "the wire structs are read in place, which needs a little-endian host"
+#endif
+
+template <int Version>
+struct wire_layout;
+
+template <>
+struct wire_layout<1> {
+    typedef waveform_header_t waveform_header;
+    typedef chunk_header_t chunk_header;
+    static const size_t waveform_header_size = WAVEFORM_HEADER_SIZE;
+    static const size_t chunk_header_size = CHUNK_HEADER_SIZE;
+};
+
+// Version 2 keeps the version 1 headers and adds the packed record
+template <>
+struct wire_layout<2> : wire_layout<1> {
+    typedef packed_record_header_t packed_record_header;
+    static const size_t packed_record_header_size = PACKED_RECORD_HEADER_SIZE;
+};
+
+typedef wire_layout<PSOC_PROTOCOL_VERSION> current_wire_layout;
+
+static_assert(sizeof(wire_layout<1>::waveform_header) == wire_layout<1>::waveform_header_size,
+              "waveform header struct must be the wire header");
+static_assert(sizeof(wire_layout<1>::chunk_header) == wire_layout<1>::chunk_header_size,
+              "chunk header struct must be the wire header");
+static_assert(sizeof(wire_layout<2>::packed_record_header) == wire_layout<2>::packed_record_header_size,
+              "packed record struct must be the wire header");
+static_assert(TOTAL_BLOCKS <= PACKED_RECORD_BLOCK_MASK + 1, "block numbers must fit a packed record");
+static_assert(TOTAL_BLOCKS <= PACKED_RECORD_MARKER, "a chunk header must never look like a packed record");
+
+/**
+ * Read the chunk header at the start of a notification
+ * @param data At least wire_layout<Version>::chunk_header_size bytes
+ * @return Header fields
+ */
+template <int Version>
+inline typename wire_layout<Version>::chunk_header read_chunk_header(const uint8_t* data) {
+    typename wire_layout<Version>::chunk_header header;
+    std::memcpy(&header, data, sizeof(header));
+    return header;
+}
+
+/**
+ * Read a packed record header
+ * @param data At least wire_layout<Version>::packed_record_header_size bytes
+ * @return Header fields
+ */
+template <int Version>
+inline typename wire_layout<Version>::packed_record_header read_packed_record_header(const uint8_t* data) {
+    typename wire_layout<Version>::packed_record_header header;
+    std::memcpy(&header, data, sizeof(header));
+    return header;
+}
+
+/**
+ * Read the waveform header at the start of a block
+ * @param data At least wire_layout<Version>::waveform_header_size bytes
+ * @param header Header to fill
+ */
+template <int Version>
+inline void read_waveform_header(const uint8_t* data, typename wire_layout<Version>::waveform_header* header) {
+    std::memcpy(header, data, sizeof(*header));
+}
+
+#endif // PSOC_WIRE_LAYOUT_H
@@ -0,0 +1,190 @@
+#include "worker_pool.h"
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Tasks a worker requeued itself; the owner pops the back, thieves take the front
+struct worker {
+    std::mutex lock;
+    std::deque<pool_task*> tasks;
+    std::thread thread;
+};
+
+}
+
+// Submitted tasks go through an intrusive MPSC list (Vyukov) so submitters never
+// lock. Workers take injection_lock to act as its single consumer.
+static pool_task injection_stub;
+static std::atomic<pool_task*> injection_head(&injection_stub);
+static pool_task* injection_tail = &injection_stub;
+static std::mutex injection_lock;
+
+static std::vector<worker*> workers;
+static std::atomic<bool> running(false);
+static std::atomic<bool> stopping(false);
+
+// Tasks in the injection list or any worker deque
+static std::atomic<unsigned> queued_tasks(0);
+
+// Idle workers sleep here; submitters only touch the mutex if someone is asleep
+static std::mutex sleep_lock;
+static std::condition_variable wake;
+static std::atomic<unsigned> sleepers(0);
+
+static void injection_push(pool_task* task) {
+    task->next.store(nullptr, std::memory_order_relaxed);
+    pool_task* prev = injection_head.exchange(task, std::memory_order_acq_rel);
+    prev->next.store(task, std::memory_order_release);
+}
+
+// Caller holds injection_lock. Returns nullptr if the list is empty or a
+// submitter is half way through injection_push(); queued_tasks tells them apart.
+static pool_task* injection_pop(void) {
+    pool_task* tail = injection_tail;
+    pool_task* next = tail->next.load(std::memory_order_acquire);
+    if (tail == &injection_stub) {
+        if (!next) {
+            return nullptr;
+        }
+        injection_tail = next;
+        tail = next;
+        next = next->next.load(std::memory_order_acquire);
+    }
+    if (next) {
+        injection_tail = next;
+        return tail;
+    }
+    if (tail != injection_head.load(std::memory_order_acquire)) {
+        return nullptr;
+    }
+    injection_push(&injection_stub);
+    next = tail->next.load(std::memory_order_acquire);
+    if (next) {
+        injection_tail = next;
+        return tail;
+    }
+    return nullptr;
+}
+
+// Own deque first (most recently run, still warm), then new submissions, then steal
+static pool_task* take_task(size_t index) {
+    pool_task* task = nullptr;
+    {
+        std::lock_guard<std::mutex> guard(workers[index]->lock);
+        if (!workers[index]->tasks.empty()) {
+            task = workers[index]->tasks.back();
+            workers[index]->tasks.pop_back();
+        }
+    }
+    if (!task) {
+        std::lock_guard<std::mutex> guard(injection_lock);
+        task = injection_pop();
+    }
+    for (size_t i = 1; !task && i < workers.size(); i++) {
+        worker* victim = workers[(index + i) % workers.size()];
+        std::lock_guard<std::mutex> guard(victim->lock);
+        if (!victim->tasks.empty()) {
+            task = victim->tasks.front();
+            victim->tasks.pop_front();
+        }
+    }
+    if (task) {
+        queued_tasks.fetch_sub(1);
+    }
+    return task;
+}
+
+static void worker_main(size_t index) {
+    for (;;) {
+        pool_task* task = take_task(index);
+        if (task) {
+            if (task->run(task)) {
+                std::lock_guard<std::mutex> guard(workers[index]->lock);
+                workers[index]->tasks.push_back(task);
+                queued_tasks.fetch_add(1);
+            }
+            continue;
+        }
+
+        if (queued_tasks.load() > 0) {
+            std::this_thread::yield();  // A submission is still being linked in
+            continue;
+        }
+        if (stopping.load()) {
+            return;
+        }
+
+        // Announce the sleep before the final check so a concurrent submitter
+        // either sees us asleep or we see its task
+        std::unique_lock<std::mutex> guard(sleep_lock);
+        sleepers.fetch_add(1);
+        while (queued_tasks.load() == 0 && !stopping.load()) {
+            wake.wait(guard);
+        }
+        sleepers.fetch_sub(1);
+    }
+}
+
+bool worker_pool_start(unsigned thread_count) {
+    worker_pool_stop();
+    if (thread_count == 0) {
+        return false;
+    }
+
+    stopping.store(false);
+    for (unsigned i = 0; i < thread_count; i++) {
+        workers.push_back(new worker());
+    }
+    for (size_t i = 0; i < workers.size(); i++) {
+        try {
+            workers[i]->thread = std::thread(worker_main, i);
+        } catch (const std::system_error&) {
+            worker_pool_stop();
+            return false;
+        }
+    }
+    running.store(true);
+    return true;
+}
+
+void worker_pool_stop(void) {
+    if (workers.empty()) {
+        return;
+    }
+
+    running.store(false);
+    {
+        std::lock_guard<std::mutex> guard(sleep_lock);
+        stopping.store(true);
+    }
+    wake.notify_all();
+
+    // Workers steal from each other until the last one exits
+    for (size_t i = 0; i < workers.size(); i++) {
+        if (workers[i]->thread.joinable()) {
+            workers[i]->thread.join();
+        }
+    }
+    for (size_t i = 0; i < workers.size(); i++) {
+        delete workers[i];
+    }
+    workers.clear();
+}
+
+bool worker_pool_running(void) {
+    return running.load();
+}
+
+void worker_pool_submit(pool_task* task) {
+    injection_push(task);
+    queued_tasks.fetch_add(1);
+    if (sleepers.load() > 0) {
+        std::lock_guard<std::mutex> guard(sleep_lock);
+        wake.notify_one();
+    }
+}
@@ -0,0 +1,43 @@
+#ifndef PSOC_WORKER_POOL_H
+#define PSOC_WORKER_POOL_H
+
+// Internal executor shared by all transfer sessions (see psoc_driver_init_with_config)
+
+#include <atomic>
+
+// Unit of scheduling. run() does a bounded amount of work and returns true if
+// the task has more to do; it is then queued on the current worker, where an
+// idle worker may steal it. A task must not be submitted again while queued
+// or running (sessions guard this with their own scheduled flag).
+struct pool_task {
+    bool (*run)(pool_task* task);
+    std::atomic<pool_task*> next;   // injection queue link, owned by the pool while queued
+};
+
+/**
+ * Start the worker threads
+ * Stops any pool that is already running first.
+ * @param thread_count Number of workers (at least 1)
+ * @return true on success, false if threads could not be created
+ */
+bool worker_pool_start(unsigned thread_count);
+
+/**
+ * Run every queued task to completion, then join the workers
+ */
+void worker_pool_stop(void);
+
+/**
+ * Check whether tasks submitted now will be run by the pool
+ * @return true between worker_pool_start() and worker_pool_stop()
+ */
+bool worker_pool_running(void);
+
+/**
+ * Queue a task from any thread
+ * Never takes a lock unless a worker is asleep and has to be woken.
+ * @param task Task to run
+ */
+void worker_pool_submit(pool_task* task);
+
+#endif // PSOC_WORKER_POOL_H
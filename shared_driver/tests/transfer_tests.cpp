@@ -0,0 +1,486 @@
+// Receive path round-trip tests.
+//
+// Frames raw waveform blocks the way the firmware sends them (chunk headers,
+// or packed records with the next block's first chunk behind the previous
+// block's last), feeds them to a transfer session or a notification log and
+// checks every delivered waveform against the samples it was built from.
+//
+//   psoc_driver_tests [test]    runs one test, or all of them
+//
+// Each test is also its own CTest case (see CMakeLists.txt).
+
+#include "psoc_driver/psoc_driver.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <set>
+#include <string>
+#include <vector>
+
+static int failures = 0;
+
+#define CHECK(condition) check((condition), #condition, __FILE__, __LINE__)
+
+static bool check(bool condition, const char* expression, const char* file, int line) {
+    if (!condition) {
+        fprintf(stderr, "%s:%d: check failed: %s\n", file, line, expression);
+        failures++;
+    }
+    return condition;
+}
+
+// Payload bytes per chunk, as cut for a 247-byte MTU
+static const uint32_t STRIDE = 232;
+
+// First chunk of a block packed behind the previous block's last chunk
+static const uint32_t PACKED_HEAD = 100;
+
+static const uint32_t TEST_BLOCKS = 6;
+
+// Sample i of a block, sign-extended: spans the whole 24-bit range
+static int32_t test_sample(uint32_t block_number, uint32_t i) {
+    uint32_t raw = (i * 2654435761u + block_number * 40503u) & 0xFFFFFF;
+    return (int32_t)(raw << 8) >> 8;
+}
+
+// Raw block as generated on the device: waveform header, then 24-bit samples
+static std::vector<uint8_t> make_block(uint32_t block_number) {
+    std::vector<uint8_t> block(RAW_BLOCK_SIZE);
+    uint8_t* samples = block.data() + WAVEFORM_HEADER_SIZE;
+    for (uint32_t i = 0; i < SAMPLES_PER_WAVEFORM; i++) {
+        uint32_t raw = (uint32_t)test_sample(block_number, i) & 0xFFFFFF;
+        samples[i * 3] = (uint8_t)raw;
+        samples[i * 3 + 1] = (uint8_t)(raw >> 8);
+        samples[i * 3 + 2] = (uint8_t)(raw >> 16);
+    }
+
+    waveform_header_t header;
+    memset(&header, 0, sizeof(header));
+    header.block_number = block_number;
+    header.timestamp_ms = 1000 + block_number * 20;
+    header.sample_rate_hz = 10000000;
+    header.sample_count = SAMPLES_PER_WAVEFORM;
+    header.bits_per_sample = 24;
+    header.sensor_id = 7;
+    header.crc32 = calculate_crc32_data(samples, SAMPLES_PER_WAVEFORM * BYTES_PER_SAMPLE);
+    memcpy(block.data(), &header, sizeof(header));
+    return block;
+}
+
+static uint32_t chunk_count(uint32_t block_size, uint32_t head, uint32_t stride) {
+    return 1 + (block_size - head + stride - 1) / stride;
+}
+
+// One chunk behind a chunk_header_t, as send_chunk() sends it unpacked
+static std::vector<uint8_t> chunk_notification(uint32_t block_number, const std::vector<uint8_t>& block,
+                                               uint32_t chunk, uint32_t stride) {
+    uint32_t offset = chunk * stride;
+    uint32_t size = std::min(stride, (uint32_t)block.size() - offset);
+
+    chunk_header_t header;
+    header.block_number = (uint16_t)block_number;
+    header.chunk_number = (uint16_t)chunk;
+    header.chunk_size = (uint16_t)size;
+    header.total_chunks = (uint16_t)chunk_count((uint32_t)block.size(), stride, stride);
+    header.block_size_total = (uint16_t)block.size();
+    header.flags = BLOCK_CODEC_RAW;
+    header.reserved = 0;
+
+    std::vector<uint8_t> packet(CHUNK_HEADER_SIZE + size);
+    memcpy(packet.data(), &header, CHUNK_HEADER_SIZE);
+    memcpy(packet.data() + CHUNK_HEADER_SIZE, block.data() + offset, size);
+    return packet;
+}
+
+// Every notification of one block, chunk headers
+static std::vector<std::vector<uint8_t>> frame_chunked(uint32_t block_number, uint32_t stride) {
+    std::vector<uint8_t> block = make_block(block_number);
+    std::vector<std::vector<uint8_t>> packets;
+    uint32_t total = chunk_count((uint32_t)block.size(), stride, stride);
+    for (uint32_t c = 0; c < total; c++) {
+        packets.push_back(chunk_notification(block_number, block, c, stride));
+    }
+    return packets;
+}
+
+static void put_record(std::vector<uint8_t>* packet, uint32_t block_number, const std::vector<uint8_t>& block,
+                       uint32_t chunk, uint32_t head, bool more) {
+    uint32_t offset = chunk == 0 ? 0 : head + (chunk - 1) * STRIDE;
+    uint32_t size = std::min(chunk == 0 ? head : STRIDE, (uint32_t)block.size() - offset);
+
+    packed_record_header_t record;
+    record.block_word = (uint16_t)(PACKED_RECORD_MARKER | (BLOCK_CODEC_RAW << PACKED_RECORD_CODEC_SHIFT) | block_number);
+    record.chunk_word = (uint16_t)(chunk | (more ? PACKED_RECORD_MORE : 0));
+    record.total_chunks = (uint16_t)chunk_count((uint32_t)block.size(), head, STRIDE);
+    record.chunk_offset = (uint16_t)offset;
+
+    size_t start = packet->size();
+    packet->resize(start + PACKED_RECORD_HEADER_SIZE);
+    memcpy(packet->data() + start, &record, PACKED_RECORD_HEADER_SIZE);
+    if (more) {
+        packet->push_back((uint8_t)size);
+        packet->push_back((uint8_t)(size >> 8));
+    }
+    packet->insert(packet->end(), block.begin() + offset, block.begin() + offset + size);
+}
+
+// Packed framing: the notification with a block's last chunk also carries a
+// PACKED_HEAD-byte chunk 0 of the next block
+static std::vector<std::vector<uint8_t>> frame_packed(uint32_t blocks) {
+    std::vector<std::vector<uint8_t>> packets;
+    for (uint32_t b = 0; b < blocks; b++) {
+        std::vector<uint8_t> block = make_block(b);
+        uint32_t head = b == 0 ? STRIDE : PACKED_HEAD;
+        uint32_t total = chunk_count((uint32_t)block.size(), head, STRIDE);
+        for (uint32_t c = b == 0 ? 0 : 1; c < total; c++) {
+            bool more = c == total - 1 && b + 1 < blocks;
+            packets.push_back(std::vector<uint8_t>());
+            put_record(&packets.back(), b, block, c, head, more);
+            if (more) {
+                put_record(&packets.back(), b + 1, make_block(b + 1), 0, PACKED_HEAD, false);
+            }
+        }
+    }
+    return packets;
+}
+
+// Delivered blocks, and how many of them did not match what was sent
+struct delivery_log {
+    std::vector<uint32_t> blocks;
+    uint32_t mismatches;
+};
+
+static void on_waveform(const waveform_data_t* waveform, bool is_compressed, void* user_data) {
+    delivery_log* log = (delivery_log*)user_data;
+    uint32_t block_number = waveform->header.block_number;
+    log->blocks.push_back(block_number);
+    bool match = !is_compressed && waveform->header.sample_count == SAMPLES_PER_WAVEFORM &&
+                 waveform->header.timestamp_ms == 1000 + block_number * 20;
+    for (uint32_t i = 0; match && i < SAMPLES_PER_WAVEFORM; i++) {
+        match = waveform->samples[i] == test_sample(block_number, i);
+    }
+    if (!match) {
+        log->mismatches++;
+    }
+}
+
+static bool delivered_all(const delivery_log& log, uint32_t blocks) {
+    std::set<uint32_t> unique(log.blocks.begin(), log.blocks.end());
+    return log.mismatches == 0 && log.blocks.size() == blocks && unique.size() == blocks &&
+           *unique.rbegin() == blocks - 1;
+}
+
+// Control messages written by the session, newest last
+struct control_log {
+    std::vector<std::vector<uint8_t>> messages;
+};
+
+static void on_control(const uint8_t* message, size_t length, void* user_data) {
+    control_log* log = (control_log*)user_data;
+    log->messages.push_back(std::vector<uint8_t>(message, message + length));
+}
+
+static transfer_session_t* start_session(delivery_log* deliveries, control_log* controls) {
+    deliveries->blocks.clear();
+    deliveries->mismatches = 0;
+    transfer_session_t* session = transfer_session_create();
+    transfer_session_set_waveform_callback(session, on_waveform, deliveries);
+    if (controls) {
+        transfer_session_set_sack_callback(session, on_control, controls);
+    }
+    transfer_session_start(session);
+    return session;
+}
+
+static void feed(transfer_session_t* session, const std::vector<uint8_t>& packet) {
+    CHECK(transfer_session_process_chunk(session, packet.data(), packet.size()));
+}
+
+static void test_chunked_framing(void) {
+    delivery_log deliveries;
+    transfer_session_t* session = start_session(&deliveries, nullptr);
+    for (uint32_t b = 0; b < TEST_BLOCKS; b++) {
+        std::vector<std::vector<uint8_t>> packets = frame_chunked(b, STRIDE);
+        for (size_t i = 0; i < packets.size(); i++) {
+            feed(session, packets[i]);
+        }
+    }
+
+    CHECK(delivered_all(deliveries, TEST_BLOCKS));
+    transfer_stats_t stats;
+    transfer_session_get_stats(session, &stats);
+    CHECK(stats.blocks_received == TEST_BLOCKS);
+    transfer_session_destroy(session);
+}
+
+static void test_chunked_framing_zero_copy(void) {
+    delivery_log deliveries;
+    transfer_session_t* session = start_session(&deliveries, nullptr);
+    for (uint32_t b = 0; b < TEST_BLOCKS; b++) {
+        std::vector<std::vector<uint8_t>> packets = frame_chunked(b, STRIDE);
+        for (size_t i = 0; i < packets.size(); i++) {
+            size_t payload_size = 0;
+            uint8_t* dest = transfer_session_begin_chunk(session, packets[i].data(), packets[i].size(), &payload_size);
+            if (CHECK(dest != nullptr) && CHECK(payload_size == packets[i].size() - CHUNK_HEADER_SIZE)) {
+                memcpy(dest, packets[i].data() + CHUNK_HEADER_SIZE, payload_size);
+                transfer_session_commit_chunk(session);
+            }
+        }
+    }
+
+    CHECK(delivered_all(deliveries, TEST_BLOCKS));
+    transfer_session_destroy(session);
+}
+
+static void test_packed_framing(void) {
+    std::vector<std::vector<uint8_t>> packets = frame_packed(TEST_BLOCKS);
+    uint32_t shared = 0;
+    for (size_t i = 0; i < packets.size(); i++) {
+        shared += (packets[i][PACKED_HDR_CHUNK_WORD + 1] & (PACKED_RECORD_MORE >> 8)) ? 1 : 0;
+    }
+    CHECK(shared == TEST_BLOCKS - 1);  // Every block after the first starts behind its predecessor
+
+    delivery_log deliveries;
+    transfer_session_t* session = start_session(&deliveries, nullptr);
+    for (size_t i = 0; i < packets.size(); i++) {
+        feed(session, packets[i]);
+    }
+
+    CHECK(delivered_all(deliveries, TEST_BLOCKS));
+    transfer_session_destroy(session);
+}
+
+// A lost chunk is reported in the SACK and the block completes once it is resent
+static void test_sack_gap_recovery(void) {
+    const uint32_t lost_block = 1;
+    const uint32_t lost_chunk = 3;
+    std::vector<uint8_t> lost;
+
+    delivery_log deliveries;
+    control_log controls;
+    transfer_session_t* session = start_session(&deliveries, &controls);
+    for (uint32_t b = 0; b < 3; b++) {
+        std::vector<std::vector<uint8_t>> packets = frame_chunked(b, STRIDE);
+        for (uint32_t c = 0; c < packets.size(); c++) {
+            if (b == lost_block && c == lost_chunk) {
+                lost = packets[c];
+            } else {
+                feed(session, packets[c]);
+            }
+        }
+    }
+    CHECK(deliveries.blocks.size() == 2);
+
+    if (CHECK(!controls.messages.empty())) {
+        const std::vector<uint8_t>& raw = controls.messages.back();
+        sack_msg_t sack;
+        if (CHECK(raw.size() == sizeof(sack))) {
+            memcpy(&sack, raw.data(), sizeof(sack));
+            CHECK(sack.command == CMD_SACK);
+            CHECK(sack.cumulative_block == lost_block);
+            CHECK(sack.entry_count == 1);
+            CHECK(sack.entries[0].block_number == lost_block);
+            CHECK(sack.entries[0].first_chunk == lost_chunk);
+            CHECK(sack.entries[0].missing_chunks == 1u);
+        }
+    }
+
+    feed(session, lost);
+    CHECK(delivered_all(deliveries, 3));
+    sack_msg_t sack;
+    transfer_session_build_sack(session, (uint8_t*)&sack, sizeof(sack));
+    CHECK(sack.cumulative_block == 3);
+    CHECK(sack.entry_count == 0);
+    transfer_session_destroy(session);
+}
+
+// After a disconnect the resume message lists what is still missing; the
+// sender can finish the partial block or send it again cut another way
+static void run_resume(uint32_t resend_stride) {
+    const uint32_t partial_block = 1;
+    const uint32_t chunks_before_drop = 5;
+
+    delivery_log deliveries;
+    control_log controls;
+    transfer_session_t* session = start_session(&deliveries, &controls);
+    std::vector<std::vector<uint8_t>> first = frame_chunked(0, STRIDE);
+    std::vector<std::vector<uint8_t>> partial = frame_chunked(partial_block, STRIDE);
+    std::vector<std::vector<uint8_t>> last = frame_chunked(3, STRIDE);
+    for (size_t i = 0; i < first.size(); i++) {
+        feed(session, first[i]);
+    }
+    for (uint32_t c = 0; c < chunks_before_drop; c++) {
+        feed(session, partial[c]);
+    }
+    for (size_t i = 0; i < last.size(); i++) {
+        feed(session, last[i]);  // Block 2 lost entirely, block 3 whole
+    }
+
+    controls.messages.clear();
+    transfer_session_stop(session);
+    transfer_session_resume(session);
+    CHECK(transfer_session_is_active(session));
+
+    if (CHECK(controls.messages.size() == 1)) {
+        const std::vector<uint8_t>& raw = controls.messages[0];
+        resume_msg_t resume;
+        if (CHECK(raw.size() == sizeof(resume))) {
+            memcpy(&resume, raw.data(), sizeof(resume));
+            uint32_t total = (uint32_t)partial.size();
+            uint32_t missing = 0;
+            for (uint32_t i = 0; i < SACK_CHUNKS_PER_ENTRY && chunks_before_drop + i < total; i++) {
+                missing |= 1u << i;
+            }
+            CHECK(resume.command == CMD_RESUME);
+            CHECK(resume.cumulative_block == partial_block);
+            CHECK(resume.received_blocks == 1u << 1);  // Block 3 = cumulative + 1 + 1
+            CHECK(resume.chunk_size == STRIDE);
+            CHECK(resume.total_chunks == total);
+            CHECK(resume.entry_count == 1);
+            CHECK(resume.entry.block_number == partial_block);
+            CHECK(resume.entry.first_chunk == chunks_before_drop);
+            CHECK(resume.entry.missing_chunks == missing);
+        }
+    }
+
+    if (resend_stride == STRIDE) {
+        for (size_t c = chunks_before_drop; c < partial.size(); c++) {
+            feed(session, partial[c]);
+        }
+    } else {
+        std::vector<std::vector<uint8_t>> resent = frame_chunked(partial_block, resend_stride);
+        for (size_t i = 0; i < resent.size(); i++) {
+            feed(session, resent[i]);
+        }
+    }
+    std::vector<std::vector<uint8_t>> missing_block = frame_chunked(2, resend_stride);
+    for (size_t i = 0; i < missing_block.size(); i++) {
+        feed(session, missing_block[i]);
+    }
+
+    CHECK(delivered_all(deliveries, 4));
+    transfer_session_destroy(session);
+}
+
+static void test_resume_gap_recovery(void) {
+    run_resume(STRIDE);
+}
+
+static void test_resume_smaller_mtu(void) {
+    run_resume(STRIDE / 2);
+}
+
+// Notification log of the given notifications: 2-byte length, then the notification
+static std::vector<uint8_t> make_log(const std::vector<std::vector<uint8_t>>& packets) {
+    std::vector<uint8_t> log;
+    for (size_t i = 0; i < packets.size(); i++) {
+        log.push_back((uint8_t)packets[i].size());
+        log.push_back((uint8_t)(packets[i].size() >> 8));
+        log.insert(log.end(), packets[i].begin(), packets[i].end());
+    }
+    return log;
+}
+
+// Replay a log into an archive, then read every block back from the file
+static void run_archive_replay(const std::vector<std::vector<uint8_t>>& packets, const char* path) {
+    std::vector<uint8_t> log = make_log(packets);
+    capture_writer_t* writer = capture_writer_open(path);
+    if (!CHECK(writer != nullptr)) {
+        return;
+    }
+
+    delivery_log deliveries;
+    deliveries.mismatches = 0;
+    replay_options_t options = { 2, writer };
+    replay_stats_t stats;
+    CHECK(replay_notification_log(log.data(), log.size(), &options, on_waveform, &deliveries, &stats));
+    CHECK(capture_writer_close(writer));
+
+    CHECK(stats.notifications == packets.size());
+    CHECK(stats.malformed_notifications == 0);
+    CHECK(stats.blocks_seen == TEST_BLOCKS);
+    CHECK(stats.blocks_decoded == TEST_BLOCKS);
+    CHECK(!stats.truncated);
+    CHECK(delivered_all(deliveries, TEST_BLOCKS));
+    for (uint32_t b = 0; b < deliveries.blocks.size(); b++) {
+        CHECK(deliveries.blocks[b] == b);  // Replay delivers in block order
+    }
+
+    capture_archive_t* archive = capture_archive_open(path);
+    if (!CHECK(archive != nullptr)) {
+        return;
+    }
+    CHECK(capture_archive_is_complete(archive));
+    CHECK(capture_archive_block_count(archive) == TEST_BLOCKS);
+    CHECK(capture_archive_verify(archive) == 0);
+
+    delivery_log readback;
+    readback.mismatches = 0;
+    for (uint32_t i = 0; i < capture_archive_block_count(archive); i++) {
+        capture_block_view_t view;
+        waveform_data_t waveform;
+        if (CHECK(capture_archive_get_block_at(archive, i, &view)) && CHECK(capture_archive_decode(&view, &waveform))) {
+            CHECK(view.codec == BLOCK_CODEC_RAW);
+            CHECK(view.size == RAW_BLOCK_SIZE);
+            on_waveform(&waveform, false, &readback);
+        }
+    }
+    CHECK(delivered_all(readback, TEST_BLOCKS));
+    capture_archive_close(archive);
+    remove(path);
+}
+
+static void test_archive_replay(void) {
+    // Arrival order with a duplicate and a chunk that comes late
+    std::vector<std::vector<uint8_t>> packets;
+    for (uint32_t b = 0; b < TEST_BLOCKS; b++) {
+        std::vector<std::vector<uint8_t>> block = frame_chunked(b, STRIDE);
+        packets.insert(packets.end(), block.begin(), block.end());
+    }
+    packets.push_back(packets[4]);
+    std::swap(packets[10], packets[40]);
+    run_archive_replay(packets, "psoc_driver_tests_chunked.cap");
+
+    run_archive_replay(frame_packed(TEST_BLOCKS), "psoc_driver_tests_packed.cap");
+}
+
+struct test_case {
+    const char* name;
+    void (*run)(void);
+};
+
+static const test_case tests[] = {
+    { "chunked_framing", test_chunked_framing },
+    { "chunked_framing_zero_copy", test_chunked_framing_zero_copy },
+    { "packed_framing", test_packed_framing },
+    { "sack_gap_recovery", test_sack_gap_recovery },
+    { "resume_gap_recovery", test_resume_gap_recovery },
+    { "resume_smaller_mtu", test_resume_smaller_mtu },
+    { "archive_replay", test_archive_replay },
+};
+
+int main(int argc, char** argv) {
+    const char* only = argc > 1 ? argv[1] : nullptr;
+    if (!psoc_driver_init()) {
+        fprintf(stderr, "psoc_driver_init failed\n");
+        return 1;
+    }
+
+    bool found = false;
+    for (size_t i = 0; i < sizeof(tests) / sizeof(tests[0]); i++) {
+        if (only && strcmp(only, tests[i].name) != 0) {
+            continue;
+        }
+        found = true;
+        int before = failures;
+        tests[i].run();
+        printf("%-28s %s\n", tests[i].name, failures == before ? "ok" : "FAILED");
+    }
+    psoc_driver_cleanup();
+
+    if (!found) {
+        fprintf(stderr, "unknown test: %s\n", only);
+        return 1;
+    }
+    return failures == 0 ? 0 : 1;
+}
@@ -674,7 +674,5 @@ static const uint8_t compressed_waveform_data[] = {
 
 /* Metadata */
 #define STATIC_WAVEFORM_CRC32 0xADF9BC27U
-#define UNCOMPRESSED_WAVEFORM_DATA_SIZE 7128U
-#define COMPRESSED_WAVEFORM_DATA_SIZE 3196U
 
 #endif /* STATIC_WAVEFORM_DATA_H_ */
@@ -0,0 +1,37 @@
+/*
+ * Waveform model tables for app_waveform.c
+ * Generated by generate_compressed_waveform.py
+ *
+ * Echo recurrence coefficients and one carrier period of sine, computed here
+ * so the firmware keeps them in flash instead of calling expf/cosf/sinf.
+ * Sample rate: 50000000 Hz, carrier: 5000000 Hz
+ */
+
+#ifndef WAVEFORM_MODEL_TABLES_H_
+#define WAVEFORM_MODEL_TABLES_H_
+
+/* Rates the tables were computed for (checked against app_waveform.h) */
+#define WAVEFORM_MODEL_SAMPLE_RATE_HZ   50000000
+#define WAVEFORM_MODEL_CARRIER_FREQ_HZ  5000000
+
+/* Echo recurrence: r, 2 r cos(w) and r^2 */
+/* Echo 1: decay 0.03 per sample */
+#define WAVEFORM_ECHO1_RATIO   0.970445514f
+#define WAVEFORM_ECHO1_COEFF1  1.57021391f
+#define WAVEFORM_ECHO1_COEFF2  0.941764534f
+/* Echo 2: decay 0.03 per sample */
+#define WAVEFORM_ECHO2_RATIO   0.970445514f
+#define WAVEFORM_ECHO2_COEFF1  1.57021391f
+#define WAVEFORM_ECHO2_COEFF2  0.941764534f
+/* Echo 3: decay 0.045 per sample */
+#define WAVEFORM_ECHO3_RATIO   0.955997467f
+#define WAVEFORM_ECHO3_COEFF1  1.54683638f
+#define WAVEFORM_ECHO3_COEFF2  0.913931191f
+
+/* sin(2 pi k / period): the carrier at sample n is entry n % period */
+#define WAVEFORM_CARRIER_PERIOD_SAMPLES 10
+static const float waveform_carrier_sine[WAVEFORM_CARRIER_PERIOD_SAMPLES] = {
+    0.0f, 0.587785244f, 0.95105654f, 0.95105654f, 0.587785244f, 0.0f, -0.587785244f, -0.95105654f, -0.95105654f, -0.587785244f
+};
+
+#endif /* WAVEFORM_MODEL_TABLES_H_ */